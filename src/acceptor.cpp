@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <system_error>
+
+#include <sys/epoll.h>
+
+#include <cppws/acceptor.hpp>
+
+cppws::acceptor::acceptor(event_loop &loop, class socket &listener,
+                          handler fn, const acceptor_options &options)
+    : loop_(&loop), listener_(&listener), handler_(std::move(fn)),
+      retryDelay_(options.retry_delay),
+      nonBlocking_(options.non_blocking) {
+  std::size_t size = std::max<std::size_t>(options.batch_size, 1);
+  batch_.reserve(size);
+  for (std::size_t i = 0; i < size; ++i)
+    batch_.emplace_back(-1);
+
+  listener_->non_blocking(true);
+  loop_->add(listener_->native_handle(), EPOLLIN,
+             [this](std::uint32_t) { drain(); });
+}
+
+cppws::acceptor::~acceptor() noexcept {
+  retry_.cancel();
+  loop_->remove(listener_->native_handle());
+}
+
+void cppws::acceptor::drain() {
+  for (;;) {
+    std::size_t n;
+    try {
+      n = listener_->accept_some(batch_, nonBlocking_);
+    } catch (const std::system_error &) {
+      // Out of descriptors or memory, most likely. Throwing would end the
+      // loop and accepting for good, so the listener is retried later.
+      //
+      pause();
+      return;
+    }
+    if (n == 0)
+      return;
+
+    accepted_ += n;
+    ++batches_;
+    handler_(std::span(batch_.data(), n));
+    for (std::size_t i = 0; i < n; ++i)
+      batch_[i].close();
+
+    // A batch that was not filled emptied the backlog.
+    //
+    if (n < batch_.size())
+      return;
+  }
+}
+
+void cppws::acceptor::pause() {
+  int fd = listener_->native_handle();
+  loop_->modify(fd, 0);
+  loop_->timers().arm(retry_, retryDelay_,
+                      [this, fd] { loop_->modify(fd, EPOLLIN); });
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <charconv>
+
+#include <cppws/byte_range.hpp>
+#include <cppws/http_def.hpp>
+#include <cppws/http_request.hpp>
+
+/**
+ * Parses a non-empty run of digits.
+ */
+static bool parse_position(std::string_view v, std::uint64_t &out) noexcept {
+  if (v.empty())
+    return false;
+  auto [ptr, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+  return ec == std::errc() && ptr == v.data() + v.size();
+}
+
+cppws::range_result
+cppws::parse_byte_ranges(std::string_view value, std::uint64_t size,
+                         std::pmr::vector<byte_range> &out) {
+  out.clear();
+
+  value = trim_ows(value);
+  std::size_t eq = value.find('=');
+  if (eq == std::string_view::npos ||
+      !iequals(trim_ows(value.substr(0, eq)), "bytes"))
+    return range_result::Ignore;
+  value.remove_prefix(eq + 1);
+
+  std::size_t specs = 0;
+  while (!value.empty()) {
+    std::size_t comma = value.find(',');
+    std::string_view spec = trim_ows(value.substr(0, comma));
+    value.remove_prefix(comma == std::string_view::npos ? value.size()
+                                                        : comma + 1);
+    if (spec.empty())
+      continue;
+    if (++specs > max_byte_ranges)
+      return range_result::Ignore;
+
+    std::size_t dash = spec.find('-');
+    if (dash == std::string_view::npos)
+      return range_result::Ignore;
+    std::string_view from = spec.substr(0, dash);
+    std::string_view to = spec.substr(dash + 1);
+
+    std::uint64_t first, last;
+    if (from.empty()) {
+      // Suffix range: the last n bytes.
+      //
+      std::uint64_t n;
+      if (!parse_position(to, n))
+        return range_result::Ignore;
+      if (n == 0 || size == 0)
+        continue;
+      first = n >= size ? 0 : size - n;
+      last = size - 1;
+    } else {
+      if (!parse_position(from, first))
+        return range_result::Ignore;
+      if (to.empty()) {
+        last = size - 1;
+      } else {
+        if (!parse_position(to, last) || last < first)
+          return range_result::Ignore;
+        last = std::min(last, size - 1);
+      }
+      if (first >= size)
+        continue;
+    }
+    out.push_back({first, last});
+  }
+
+  if (specs == 0)
+    return range_result::Ignore;
+  if (out.empty())
+    return range_result::Unsatisfiable;
+
+  std::ranges::sort(out, {}, &byte_range::first);
+  auto merged = out.begin();
+  for (auto it = out.begin() + 1; it != out.end(); ++it) {
+    if (it->first <= merged->last + 1)
+      merged->last = std::max(merged->last, it->last);
+    else
+      *++merged = *it;
+  }
+  out.erase(merged + 1, out.end());
+  return range_result::Satisfiable;
+}
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include <zlib.h>
+
+#include <cppws/compression.hpp>
+#include <cppws/http_def.hpp>
+
+/**
+ * Parses the q-value of an Accept-Encoding element, e.g. ";q=0.5", as an
+ * integer in thousandths.
+ */
+static int parse_qvalue(std::string_view params) {
+  std::size_t pos = params.find("q=");
+  if (pos == std::string_view::npos)
+    return 1000;
+
+  std::string_view q = params.substr(pos + 2);
+  int value = 0;
+  auto [ptr, ec] = std::from_chars(q.data(), q.data() + q.size(), value);
+  if (ec != std::errc{} || value > 1)
+    return value >= 1 ? 1000 : 0;
+
+  value *= 1000;
+  if (ptr != q.data() + q.size() && *ptr == '.') {
+    int scale = 100;
+    for (++ptr; ptr != q.data() + q.size() && std::isdigit(*ptr) && scale;
+         ++ptr, scale /= 10)
+      value += (*ptr - '0') * scale;
+  }
+  return std::min(value, 1000);
+}
+
+cppws::content_coding
+cppws::negotiate_encoding(std::string_view acceptEncoding,
+                          content_coding_set available) noexcept {
+
+  struct candidate {
+    content_coding coding;
+    std::string_view name;
+    std::string_view alias;
+    int q = -1;
+  };
+
+  // In order of preference when q-values are equal.
+  //
+  candidate candidates[] = {
+      {content_coding::Brotli, "br", "br"},
+      {content_coding::Zstd, "zstd", "zstd"},
+      {content_coding::Gzip, "gzip", "x-gzip"},
+      {content_coding::Deflate, "deflate", "deflate"},
+  };
+  int any = -1;
+
+  while (!acceptEncoding.empty()) {
+    std::size_t comma = acceptEncoding.find(',');
+    std::string_view element = acceptEncoding.substr(0, comma);
+    acceptEncoding = comma == std::string_view::npos
+                         ? std::string_view()
+                         : acceptEncoding.substr(comma + 1);
+
+    std::size_t semi = element.find(';');
+    std::string_view coding = trim_ows(element.substr(0, semi));
+    int q = semi == std::string_view::npos
+                ? 1000
+                : parse_qvalue(element.substr(semi + 1));
+
+    if (coding == "*") {
+      any = q;
+      continue;
+    }
+    for (candidate &c : candidates) {
+      const char *first = coding.data();
+      const char *last = first + coding.size();
+      if (iequals_sv(first, last, c.name) || iequals_sv(first, last, c.alias))
+        c.q = q;
+    }
+  }
+
+  content_coding best = content_coding::Identity;
+  int bestQ = 0;
+  for (candidate &c : candidates) {
+    int q = c.q < 0 ? any : c.q;
+    if ((available & coding_bit(c.coding)) && q > bestQ) {
+      best = c.coding;
+      bestQ = q;
+    }
+  }
+  return best;
+}
+
+bool cppws::is_compressible(std::string_view contentType) noexcept {
+  contentType = trim_ows(contentType.substr(0, contentType.find(';')));
+
+  if (contentType.starts_with("text/"))
+    return true;
+  if (contentType.ends_with("+json") || contentType.ends_with("+xml"))
+    return true;
+
+  constexpr std::string_view compressible[] = {
+      "application/json",       "application/javascript",
+      "application/xml",        "application/x-www-form-urlencoded",
+      "application/wasm",       "image/svg+xml",
+      "application/ld+json",    "application/manifest+json",
+  };
+  return std::ranges::find(compressible, contentType) !=
+         std::end(compressible);
+}
+
+static std::int64_t steady_ns() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::int64_t process_cpu_ns() noexcept {
+  struct timespec ts;
+  ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return static_cast<std::int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+cppws::compression_governor::compression_governor(
+    const compression_options &options)
+    : options_(options), level_(options.max_level), lastWall_(steady_ns()),
+      lastCpu_(process_cpu_ns()) {}
+
+int cppws::compression_governor::level() noexcept {
+  std::int64_t now = steady_ns();
+  if (now >= nextSample_.load(std::memory_order_relaxed))
+    sample(now);
+  return level_.load(std::memory_order_relaxed);
+}
+
+void cppws::compression_governor::sample(std::int64_t now) noexcept {
+  if (sampling_.test_and_set(std::memory_order_acquire))
+    return;
+
+  constexpr std::int64_t interval = 250'000'000;
+  if (now >= nextSample_.load(std::memory_order_relaxed)) {
+    std::int64_t cpu = process_cpu_ns();
+    double cores = std::max(1u, std::thread::hardware_concurrency());
+    double wall = static_cast<double>(now - lastWall_);
+    double utilization =
+        wall > 0 ? static_cast<double>(cpu - lastCpu_) / (wall * cores) : 0;
+
+    constexpr double low = 0.5;
+    constexpr double high = 0.9;
+    double t = std::clamp((utilization - low) / (high - low), 0.0, 1.0);
+    int level = options_.max_level -
+                static_cast<int>(t * (options_.max_level - options_.min_level) +
+                                 0.5);
+
+    level_.store(level, std::memory_order_relaxed);
+    lastWall_ = now;
+    lastCpu_ = cpu;
+    nextSample_.store(now + interval, std::memory_order_relaxed);
+  }
+  sampling_.clear(std::memory_order_release);
+}
+
+cppws::compression_governor &cppws::compression_governor::global() {
+  static compression_governor governor;
+  return governor;
+}
+
+struct cppws::compressor::state {
+  z_stream stream{};
+  bool initialized = false;
+  int windowBits = 0;
+  int level = 0;
+
+  ~state() {
+    if (initialized)
+      ::deflateEnd(&stream);
+  }
+};
+
+cppws::compressor::compressor() : state_(std::make_unique<state>()) {}
+
+cppws::compressor::~compressor() noexcept = default;
+
+bool cppws::compressor::compress(content_coding coding, int level,
+                                 std::string_view in, std::pmr::string &out,
+                                 std::size_t maxSize) {
+
+  if (coding != content_coding::Gzip && coding != content_coding::Deflate)
+    throw std::invalid_argument("Unsupported content coding");
+
+  // 15 bits of window for the zlib format ("deflate"), +16 selects the gzip
+  // wrapper.
+  //
+  int windowBits = coding == content_coding::Gzip ? 15 + 16 : 15;
+  z_stream &zs = state_->stream;
+
+  if (state_->initialized && state_->windowBits != windowBits) {
+    ::deflateEnd(&zs);
+    state_->initialized = false;
+  }
+
+  if (!state_->initialized) {
+    zs = {};
+    if (::deflateInit2(&zs, level, Z_DEFLATED, windowBits, 8,
+                       Z_DEFAULT_STRATEGY) != Z_OK)
+      throw std::runtime_error("Failed to initialize compressor");
+    state_->initialized = true;
+    state_->windowBits = windowBits;
+    state_->level = level;
+  } else {
+    ::deflateReset(&zs);
+    if (state_->level != level) {
+      ::deflateParams(&zs, level, Z_DEFAULT_STRATEGY);
+      state_->level = level;
+    }
+  }
+
+  // zlib counts in uInt, so the input is fed in pieces that fit, and the
+  // output grows a chunk at a time up to the given limit.
+  //
+  constexpr std::size_t MAX_AVAIL = std::numeric_limits<uInt>::max();
+  constexpr std::size_t CHUNK = 16 * 1024;
+  std::size_t start = out.size();
+  zs.avail_in = 0;
+  int rc = Z_OK;
+  while (rc != Z_STREAM_END) {
+    if (zs.avail_in == 0 && !in.empty()) {
+      std::size_t n = std::min(in.size(), MAX_AVAIL);
+      zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+      zs.avail_in = static_cast<uInt>(n);
+      in.remove_prefix(n);
+    }
+
+    std::size_t room = std::min(CHUNK, maxSize - (out.size() - start));
+    if (room == 0)
+      return false;
+
+    std::size_t at = out.size();
+    out.resize(at + room);
+    zs.next_out = reinterpret_cast<Bytef *>(out.data() + at);
+    zs.avail_out = static_cast<uInt>(room);
+    rc = ::deflate(&zs, in.empty() ? Z_FINISH : Z_NO_FLUSH);
+    out.resize(at + room - zs.avail_out);
+
+    if (rc != Z_OK && rc != Z_BUF_ERROR && rc != Z_STREAM_END)
+      throw std::runtime_error("Failed to compress response body");
+  }
+  return true;
+}
@@ -0,0 +1,76 @@
+#include <cppws/conditional.hpp>
+#include <cppws/http_def.hpp>
+#include <cppws/http_date.hpp>
+
+/**
+ * True if any entity tag in a comma separated list matches. "*" matches any
+ * current representation, whether it has an entity tag or not.
+ */
+static bool any_etag_matches(std::string_view list, std::string_view etag,
+                             bool weak) noexcept {
+  if (cppws::trim_ows(list) == "*")
+    return true;
+
+  while (!list.empty()) {
+    std::size_t comma = list.find(',');
+    if (cppws::etag_equals(cppws::trim_ows(list.substr(0, comma)), etag,
+                           weak))
+      return true;
+    if (comma == std::string_view::npos)
+      break;
+    list.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
+bool cppws::etag_equals(std::string_view a, std::string_view b,
+                        bool weak) noexcept {
+  bool aWeak = a.starts_with("W/");
+  bool bWeak = b.starts_with("W/");
+  if (!weak && (aWeak || bWeak))
+    return false;
+  if (aWeak)
+    a.remove_prefix(2);
+  if (bWeak)
+    b.remove_prefix(2);
+  return !a.empty() && a == b;
+}
+
+cppws::precondition_result
+cppws::evaluate_preconditions(const http_request &request,
+                              const resource_validators &validators) noexcept {
+
+  bool safe = request.http_method() == http_method::GET ||
+              request.http_method() == http_method::HEAD;
+
+  std::time_t date;
+  const std::pmr::string *header;
+
+  // 1. If-Match, otherwise 2. If-Unmodified-Since
+  //
+  if ((header = request.http_header(http_request_header::IfMatch))) {
+    if (!any_etag_matches(*header, validators.etag, false))
+      return precondition_result::PreconditionFailed;
+  } else if ((header = request.http_header(
+                  http_request_header::IfUnmodifiedSince)) &&
+             validators.last_modified >= 0 && parse_http_date(*header, date)) {
+    if (validators.last_modified > date)
+      return precondition_result::PreconditionFailed;
+  }
+
+  // 3. If-None-Match, otherwise 4. If-Modified-Since
+  //
+  if ((header = request.http_header(http_request_header::IfNoneMatch))) {
+    if (any_etag_matches(*header, validators.etag, true))
+      return safe ? precondition_result::NotModified
+                  : precondition_result::PreconditionFailed;
+  } else if (safe &&
+             (header =
+                  request.http_header(http_request_header::IfModifiedSince)) &&
+             validators.last_modified >= 0 && parse_http_date(*header, date)) {
+    if (validators.last_modified <= date)
+      return precondition_result::NotModified;
+  }
+
+  return precondition_result::Proceed;
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <cppws/connection_buffer.hpp>
+#include <cppws/socket.hpp>
+
+static std::atomic<std::uint64_t> grows;
+static std::atomic<std::uint64_t> compactions;
+static std::atomic<std::uint64_t> releases;
+static std::atomic<std::uint64_t> allocated;
+
+cppws::connection_buffer::connection_buffer(connection_buffer &&other) noexcept
+    : resource_(other.resource_),
+      storage_(std::exchange(other.storage_, nullptr)),
+      capacity_(std::exchange(other.capacity_, 0)),
+      begin_(std::exchange(other.begin_, 0)),
+      end_(std::exchange(other.end_, 0)), maxSize_(other.maxSize_),
+      filled_(std::exchange(other.filled_, false)) {}
+
+cppws::connection_buffer &
+cppws::connection_buffer::operator=(connection_buffer &&other) noexcept {
+  if (this != &other) {
+    deallocate();
+    resource_ = other.resource_;
+    storage_ = std::exchange(other.storage_, nullptr);
+    capacity_ = std::exchange(other.capacity_, 0);
+    begin_ = std::exchange(other.begin_, 0);
+    end_ = std::exchange(other.end_, 0);
+    maxSize_ = other.maxSize_;
+    filled_ = std::exchange(other.filled_, false);
+  }
+  return *this;
+}
+
+void cppws::connection_buffer::reserve(std::size_t capacity) {
+  capacity = std::min(std::bit_ceil(std::max(capacity, MIN_SIZE)), maxSize_);
+  if (capacity <= capacity_)
+    return;
+
+  auto *storage = static_cast<char *>(resource_->allocate(capacity));
+  if (storage_) {
+    std::memcpy(storage, storage_ + begin_, size());
+    grows.fetch_add(1, std::memory_order_relaxed);
+  }
+  end_ -= begin_;
+  begin_ = 0;
+  deallocate();
+  storage_ = storage;
+  capacity_ = capacity;
+  allocated.fetch_add(capacity, std::memory_order_relaxed);
+}
+
+void cppws::connection_buffer::deallocate() noexcept {
+  if (!storage_)
+    return;
+  resource_->deallocate(storage_, capacity_);
+  allocated.fetch_sub(capacity_, std::memory_order_relaxed);
+  storage_ = nullptr;
+  capacity_ = 0;
+}
+
+std::span<char> cppws::connection_buffer::prepare(std::size_t n) {
+  n = std::min(n, maxSize_ - std::min(maxSize_, size()));
+  if (n == 0)
+    return {};
+
+  if (capacity_ - end_ < n && begin_ > 0 && capacity_ - size() >= n) {
+    std::memmove(storage_, storage_ + begin_, size());
+    end_ -= begin_;
+    begin_ = 0;
+    compactions.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (capacity_ - end_ < n)
+    reserve(size() + n);
+  return {storage_ + end_, n};
+}
+
+std::span<char> cppws::connection_buffer::read_space() {
+  std::size_t free = capacity_ - end_;
+  if (capacity_ == 0 || (filled_ && capacity_ < maxSize_))
+    free = std::max(capacity_ * 2, MIN_SIZE) - size();
+  else if (free == 0)
+    free = begin_ > 0 ? begin_ : capacity_;
+  return prepare(free);
+}
+
+std::size_t cppws::connection_buffer::take(std::span<char> out) noexcept {
+  std::size_t n = std::min(out.size(), size());
+  if (n == 0)
+    return 0;
+  std::memcpy(out.data(), storage_ + begin_, n);
+  consume(n);
+  return n;
+}
+
+std::size_t cppws::connection_buffer::read_some(class socket &connection) {
+  std::span<char> space = read_space();
+  if (space.empty())
+    throw std::length_error("Connection buffer is full");
+  std::size_t received = connection.read(space.data(), space.size());
+  commit(received);
+  filled_ = received == space.size();
+  return received;
+}
+
+std::ptrdiff_t
+cppws::connection_buffer::try_read_some(class socket &connection) {
+  std::span<char> space = read_space();
+  if (space.empty())
+    throw std::length_error("Connection buffer is full");
+  std::ptrdiff_t received = connection.try_read(space.data(), space.size());
+  if (received > 0) {
+    commit(received);
+    filled_ = static_cast<std::size_t>(received) == space.size();
+  }
+  return received;
+}
+
+bool cppws::connection_buffer::release() noexcept {
+  if (!empty())
+    return false;
+  filled_ = false;
+  if (storage_) {
+    deallocate();
+    releases.fetch_add(1, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+std::pmr::memory_resource *cppws::connection_buffer::pool() {
+  // Never destroyed, so that buffers released during static destruction
+  // still have a pool to return to.
+  //
+  static auto *resource = new std::pmr::synchronized_pool_resource(
+      std::pmr::pool_options{.largest_required_pool_block = 64 << 10});
+  return resource;
+}
+
+cppws::connection_buffer_stats cppws::connection_buffer::stats() noexcept {
+  return {.grows = grows.load(std::memory_order_relaxed),
+          .compactions = compactions.load(std::memory_order_relaxed),
+          .releases = releases.load(std::memory_order_relaxed),
+          .allocated = allocated.load(std::memory_order_relaxed)};
+}
@@ -0,0 +1,136 @@
+#include <cerrno>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cppws/event_loop.hpp>
+
+static void check(int res) {
+  if (res < 0)
+    throw std::system_error(errno, std::system_category());
+}
+
+cppws::event_loop::event_loop() {
+  epollFd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  check(epollFd_);
+  wakeFd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (wakeFd_ < 0) {
+    int err = errno;
+    ::close(epollFd_);
+    throw std::system_error(err, std::system_category());
+  }
+
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;
+  check(::epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev));
+}
+
+cppws::event_loop::~event_loop() noexcept {
+  watches_.clear();
+  removed_.clear();
+  ::close(wakeFd_);
+  ::close(epollFd_);
+}
+
+void cppws::event_loop::add(int fd, std::uint32_t events, callback fn) {
+  auto w = std::make_unique<watch>(fd, std::move(fn));
+
+  struct epoll_event ev = {};
+  ev.events = events;
+  ev.data.ptr = w.get();
+  check(::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev));
+  watches_[fd] = std::move(w);
+}
+
+void cppws::event_loop::modify(int fd, std::uint32_t events) {
+  auto it = watches_.find(fd);
+  if (it == watches_.end())
+    return;
+
+  struct epoll_event ev = {};
+  ev.events = events;
+  ev.data.ptr = it->second.get();
+  check(::epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev));
+}
+
+void cppws::event_loop::remove(int fd) noexcept {
+  auto it = watches_.find(fd);
+  if (it == watches_.end())
+    return;
+
+  ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+  it->second->fd = -1;
+  removed_.push_back(std::move(it->second));
+  watches_.erase(it);
+}
+
+void cppws::event_loop::post(task fn) {
+  {
+    std::unique_lock l{lock_};
+    tasks_.push_back(std::move(fn));
+  }
+  wake();
+}
+
+void cppws::event_loop::wake() noexcept {
+  std::uint64_t one = 1;
+  [[maybe_unused]] ::ssize_t n = ::write(wakeFd_, &one, sizeof one);
+}
+
+void cppws::event_loop::stop() noexcept {
+  stopping_ = true;
+  wake();
+}
+
+void cppws::event_loop::run() {
+  while (!stopping_.exchange(false))
+    run_once(-1);
+}
+
+void cppws::event_loop::run_tasks() {
+  std::uint64_t count;
+  [[maybe_unused]] ::ssize_t n = ::read(wakeFd_, &count, sizeof count);
+
+  {
+    std::unique_lock l{lock_};
+    runningTasks_.swap(tasks_);
+  }
+  for (task &fn : runningTasks_)
+    fn();
+  runningTasks_.clear();
+}
+
+void cppws::event_loop::run_once(int timeoutMs) {
+  owner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+  constexpr int max_events = 256;
+  struct epoll_event events[max_events];
+
+  int timerMs = timers_.next_timeout();
+  if (timerMs >= 0 && (timeoutMs < 0 || timerMs < timeoutMs))
+    timeoutMs = timerMs;
+
+  int n = ::epoll_wait(epollFd_, events, max_events, timeoutMs);
+  if (n < 0) {
+    if (errno == EINTR)
+      return;
+    throw std::system_error(errno, std::system_category());
+  }
+
+  for (int i = 0; i < n; ++i) {
+    auto *w = static_cast<watch *>(events[i].data.ptr);
+    if (!w)
+      run_tasks();
+    else if (w->fd >= 0)
+      w->fn(events[i].events);
+  }
+  removed_.clear();
+
+  if (timers_.size() > 0) {
+    timers_.advance();
+    removed_.clear();
+  }
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <format>
+#include <limits>
+#include <stdexcept>
+
+#include <cppws/filter.hpp>
+
+cppws::bearer_auth_filter::bearer_auth_filter(std::string_view token,
+                                              std::string_view realm)
+    : expected_(std::format("Bearer {}", token)),
+      unauthorized_(http::UNAUTHORIZED,
+                    {http::header(http_response_header::WWWAuthenticate,
+                                  std::format("Bearer realm=\"{}\"", realm))},
+                    http::body("Missing or invalid bearer token.")) {}
+
+const cppws::prebuilt_response *
+cppws::bearer_auth_filter::operator()(request_manager &manager) const {
+  const std::pmr::string *auth =
+      manager.request().http_header(http_request_header::Authorization);
+  if (!auth || auth->length() != expected_.length())
+    return &unauthorized_;
+
+  // Compare without an early exit so that the time taken does not reveal
+  // how much of the token matched.
+  //
+  unsigned char diff = 0;
+  for (std::size_t i = 0; i < expected_.length(); ++i)
+    diff |= static_cast<unsigned char>((*auth)[i] ^ expected_[i]);
+  return diff == 0 ? nullptr : &unauthorized_;
+}
+
+cppws::cors_filter::cors_filter(std::string_view origin,
+                                std::string_view methods,
+                                std::string_view headers,
+                                std::chrono::seconds maxAge)
+    : origin_(origin),
+      preflight_(http::NO_CONTENT,
+                 {http::header("Access-Control-Allow-Origin", origin),
+                  http::header("Access-Control-Allow-Methods", methods),
+                  http::header("Access-Control-Allow-Headers", headers),
+                  http::header("Access-Control-Max-Age",
+                               std::to_string(maxAge.count())),
+                  http::header(http_response_header::Vary, "Origin")}),
+      forbidden_(http::FORBIDDEN, {},
+                 http::body("Origin not allowed by CORS policy.")) {}
+
+const cppws::prebuilt_response *
+cppws::cors_filter::operator()(request_manager &manager) const {
+  const std::pmr::string *origin = manager.request().http_header("Origin");
+  if (!origin)
+    return nullptr; // Same-origin request
+
+  if (origin_ != "*" && std::string_view(*origin) != origin_)
+    return &forbidden_;
+
+  if (manager.request().http_method() == http_method::OPTIONS)
+    return &preflight_;
+
+  // Without the header, the browser hides the response from the page.
+  //
+  manager.header("Access-Control-Allow-Origin", origin_);
+  if (origin_ != "*")
+    manager.header(http_response_header::Vary, "Origin");
+  return nullptr;
+}
+
+/**
+ * Converts a rate in requests per second to the interval between requests in
+ * nanoseconds. Rates below one request a year are treated as one a year.
+ */
+static std::int64_t emission_interval(double rate) {
+  if (!(rate > 0))
+    throw std::invalid_argument("rate_limit_filter: rate must be positive");
+
+  constexpr double MAX_INTERVAL = 365.0 * 24 * 3600 * 1e9;
+  return static_cast<std::int64_t>(std::clamp(1e9 / rate, 1.0, MAX_INTERVAL));
+}
+
+/**
+ * Gets how far ahead of the clock the limiter may run, saturated so that
+ * advancing the arrival time cannot overflow.
+ */
+static std::int64_t burst_tolerance(std::int64_t interval,
+                                    std::uint32_t burst) {
+  constexpr std::int64_t MAX_TOLERANCE =
+      std::numeric_limits<std::int64_t>::max() / 4;
+  std::int64_t n = std::max<std::int64_t>(burst, 1);
+  return n > MAX_TOLERANCE / interval ? MAX_TOLERANCE : interval * n;
+}
+
+cppws::rate_limit_filter::rate_limit_filter(double rate, std::uint32_t burst)
+    : state_(std::make_shared<state>()),
+      limited_(std::make_shared<prebuilt_response>(
+          http::TOO_MANY_REQUESTS,
+          std::initializer_list<http_header_line>{
+              http::header(http_response_header::RetryAfter, "1")},
+          http::body("Rate limit exceeded."))),
+      interval_(emission_interval(rate)),
+      tolerance_(burst_tolerance(interval_, burst)) {}
+
+const cppws::prebuilt_response *
+cppws::rate_limit_filter::operator()(request_manager &) const {
+  using clock = std::chrono::steady_clock;
+  std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         clock::now().time_since_epoch())
+                         .count();
+
+  // Theoretical arrival time: the point in time at which the limiter would be
+  // fully drained. A request is allowed as long as it does not push the TAT
+  // more than `tolerance_` into the future.
+  //
+  std::int64_t tat = state_->tat.load(std::memory_order_relaxed);
+  for (;;) {
+    std::int64_t next = std::max(tat, now) + interval_;
+    if (next - now > tolerance_)
+      return limited_.get();
+    if (state_->tat.compare_exchange_weak(tat, next,
+                                          std::memory_order_relaxed))
+      return nullptr;
+  }
+}
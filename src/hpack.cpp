@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <array>
+
+#include <cppws/hpack.hpp>
+
+namespace {
+
+struct huffman_code {
+  std::uint32_t code;
+  std::uint8_t bits;
+};
+
+/**
+ * Huffman code of every octet and of EOS (RFC 7541 appendix B).
+ */
+constexpr huffman_code huffman_codes[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12}, {0x1ff9, 13}, {0x15, 6},
+    {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6}, {0x0, 5}, {0x1, 5}, {0x2, 5},
+    {0x19, 6}, {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6},
+    {0x5c, 7}, {0xfb, 8}, {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+    {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7},
+    {0x61, 7}, {0x62, 7}, {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7},
+    {0x68, 7}, {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7}, {0xfd, 8},
+    {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5}, {0x25, 6},
+    {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7}, {0x28, 6}, {0x29, 6},
+    {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5}, {0x9, 5},
+    {0x2d, 6}, {0x77, 7}, {0x78, 7}, {0x79, 7}, {0x7a, 7}, {0x7b, 7},
+    {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+    {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20}, {0x3fffd3, 22},
+    {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22},
+    {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23},
+    {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23}, {0xffffec, 24},
+    {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24},
+    {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23},
+    {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23}, {0x3fffd9, 22},
+    {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22},
+    {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22},
+    {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21}, {0x7fffea, 23},
+    {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21},
+    {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21},
+    {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21}, {0x7fffed, 23},
+    {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20},
+    {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23},
+    {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23}, {0x3ffffe0, 26},
+    {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22},
+    {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26},
+    {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27}, {0x7ffffdf, 27},
+    {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19},
+    {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27},
+    {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24}, {0x1fffe4, 21},
+    {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28},
+    {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20},
+    {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21}, {0x3fffe9, 22},
+    {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22},
+    {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24},
+    {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23}, {0x3ffffeb, 26},
+    {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27},
+    {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27},
+    {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27}, {0x7ffffee, 27},
+    {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+};
+
+constexpr std::size_t eos = 256;
+constexpr int max_code_bits = 30;
+
+/**
+ * The code is canonical: codes of the same length are consecutive, and
+ * shorter codes sort before longer ones. Decoding therefore only needs the
+ * first code of every length and the symbols sorted by code.
+ */
+struct huffman_decode_table {
+  std::uint16_t symbols[257] = {};
+  std::uint32_t first[max_code_bits + 1] = {};
+  std::uint16_t offset[max_code_bits + 1] = {};
+  std::uint16_t count[max_code_bits + 1] = {};
+};
+
+constexpr huffman_decode_table make_decode_table() {
+  huffman_decode_table t;
+  std::size_t n = 0;
+  for (int bits = 1; bits <= max_code_bits; ++bits) {
+    t.offset[bits] = static_cast<std::uint16_t>(n);
+    std::size_t begin = n;
+    for (std::size_t s = 0; s < 257; ++s) {
+      if (huffman_codes[s].bits == bits)
+        t.symbols[n++] = static_cast<std::uint16_t>(s);
+    }
+    for (std::size_t i = begin + 1; i < n; ++i) {
+      for (std::size_t j = i; j > begin; --j) {
+        if (huffman_codes[t.symbols[j - 1]].code <
+            huffman_codes[t.symbols[j]].code)
+          break;
+        std::swap(t.symbols[j], t.symbols[j - 1]);
+      }
+    }
+    t.count[bits] = static_cast<std::uint16_t>(n - begin);
+    t.first[bits] = n > begin ? huffman_codes[t.symbols[begin]].code : 0;
+  }
+  return t;
+}
+
+constexpr huffman_decode_table huffman_decoding = make_decode_table();
+
+struct static_entry {
+  std::string_view name;
+  std::string_view value;
+};
+
+/**
+ * Static table (RFC 7541 appendix A).
+ */
+constexpr static_entry static_table[cppws::hpack_table::static_size] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+} // namespace
+
+/**
+ * Appends an integer with an N-bit prefix (RFC 7541 section 5.1). \p flags
+ * holds the bits of the first octet above the prefix.
+ */
+static void encode_integer(std::string &out, std::uint8_t flags, int prefix,
+                           std::size_t value) {
+  std::size_t max = (std::size_t(1) << prefix) - 1;
+  if (value < max) {
+    out.push_back(static_cast<char>(flags | value));
+    return;
+  }
+  out.push_back(static_cast<char>(flags | max));
+  value -= max;
+  while (value >= 128) {
+    out.push_back(static_cast<char>(0x80 | (value & 0x7f)));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+static std::size_t decode_integer(std::string_view &in, int prefix) {
+  std::size_t max = (std::size_t(1) << prefix) - 1;
+  std::size_t value = static_cast<unsigned char>(in.front()) & max;
+  in.remove_prefix(1);
+  if (value < max)
+    return value;
+
+  for (int shift = 0;; shift += 7) {
+    if (in.empty())
+      throw cppws::hpack_error("Truncated integer");
+    if (shift > 28)
+      throw cppws::hpack_error("Integer overflow");
+    auto b = static_cast<unsigned char>(in.front());
+    in.remove_prefix(1);
+    value += std::size_t(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return value;
+  }
+}
+
+/**
+ * Reads a string literal. Huffman coded strings are decoded into \p buffer;
+ * raw strings are returned as a view of the input.
+ */
+static std::string_view decode_string(std::string_view &in,
+                                      std::string &buffer) {
+  if (in.empty())
+    throw cppws::hpack_error("Truncated string");
+  bool huffman = in.front() & 0x80;
+  std::size_t length = decode_integer(in, 7);
+  if (length > in.size())
+    throw cppws::hpack_error("Truncated string");
+
+  std::string_view raw = in.substr(0, length);
+  in.remove_prefix(length);
+  if (!huffman)
+    return raw;
+  buffer.clear();
+  cppws::hpack_huffman_decode(buffer, raw);
+  return buffer;
+}
+
+static void encode_string(std::string &out, std::string_view s) {
+  std::size_t huffman = cppws::hpack_huffman_length(s);
+  if (huffman <= s.size()) {
+    encode_integer(out, 0x80, 7, huffman);
+    cppws::hpack_huffman_encode(out, s);
+  } else {
+    encode_integer(out, 0, 7, s.size());
+    out.append(s);
+  }
+}
+
+static constexpr std::size_t entry_size(std::string_view name,
+                                        std::string_view value) noexcept {
+  return name.size() + value.size() + 32;
+}
+
+std::size_t cppws::hpack_huffman_length(std::string_view in) noexcept {
+  std::size_t bits = 0;
+  for (unsigned char c : in)
+    bits += huffman_codes[c].bits;
+  return (bits + 7) / 8;
+}
+
+void cppws::hpack_huffman_encode(std::string &out, std::string_view in) {
+  std::uint64_t acc = 0;
+  int pending = 0;
+  for (unsigned char c : in) {
+    const huffman_code &h = huffman_codes[c];
+    acc = (acc << h.bits) | h.code;
+    pending += h.bits;
+    while (pending >= 8) {
+      pending -= 8;
+      out.push_back(static_cast<char>(acc >> pending));
+    }
+  }
+  // Pad with the most significant bits of EOS, which are all ones.
+  //
+  if (pending > 0)
+    out.push_back(static_cast<char>((acc << (8 - pending)) |
+                                    ((1u << (8 - pending)) - 1)));
+}
+
+void cppws::hpack_huffman_decode(std::string &out, std::string_view in) {
+  const huffman_decode_table &t = huffman_decoding;
+  std::uint32_t code = 0;
+  int bits = 0;
+  for (unsigned char c : in) {
+    for (int i = 7; i >= 0; --i) {
+      code = (code << 1) | ((c >> i) & 1);
+      ++bits;
+      if (code - t.first[bits] < t.count[bits]) {
+        std::uint16_t symbol = t.symbols[t.offset[bits] + code - t.first[bits]];
+        if (symbol == eos)
+          throw hpack_error("EOS in Huffman coded string");
+        out.push_back(static_cast<char>(symbol));
+        code = 0;
+        bits = 0;
+      } else if (bits == max_code_bits) {
+        throw hpack_error("Invalid Huffman code");
+      }
+    }
+  }
+  // Padding is shorter than an octet and made of the leading ones of EOS.
+  //
+  if (bits > 7 || code != (1u << bits) - 1)
+    throw hpack_error("Invalid Huffman padding");
+}
+
+bool cppws::hpack_table::get(std::size_t index, std::string_view &name,
+                             std::string_view &value) const noexcept {
+  if (index == 0)
+    return false;
+  if (index <= static_size) {
+    name = static_table[index - 1].name;
+    value = static_table[index - 1].value;
+    return true;
+  }
+  index -= static_size + 1;
+  if (index >= entries_.size())
+    return false;
+  name = entries_[index].name;
+  value = entries_[index].value;
+  return true;
+}
+
+std::size_t cppws::hpack_table::find(std::string_view name,
+                                     std::string_view value,
+                                     bool &nameOnly) const noexcept {
+  std::size_t nameIndex = 0;
+  for (std::size_t i = 0; i < static_size; ++i) {
+    if (static_table[i].name != name)
+      continue;
+    if (static_table[i].value == value) {
+      nameOnly = false;
+      return i + 1;
+    }
+    if (!nameIndex)
+      nameIndex = i + 1;
+  }
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    if (entries_[i].name != name)
+      continue;
+    if (entries_[i].value == value) {
+      nameOnly = false;
+      return static_size + 1 + i;
+    }
+    if (!nameIndex)
+      nameIndex = static_size + 1 + i;
+  }
+  nameOnly = true;
+  return nameIndex;
+}
+
+void cppws::hpack_table::evict(std::size_t limit) {
+  while (size_ > limit) {
+    size_ -= entry_size(entries_.back().name, entries_.back().value);
+    entries_.pop_back();
+  }
+}
+
+void cppws::hpack_table::insert(std::string_view name,
+                                std::string_view value) {
+  std::size_t size = entry_size(name, value);
+  if (size > maxSize_) {
+    // An entry larger than the table empties it (RFC 7541 section 4.4).
+    //
+    evict(0);
+    return;
+  }
+  // Copy first: the strings may refer to an entry about to be evicted.
+  //
+  entry e{std::string(name), std::string(value)};
+  evict(maxSize_ - size);
+  entries_.push_front(std::move(e));
+  size_ += size;
+}
+
+void cppws::hpack_table::max_size(std::size_t size) {
+  maxSize_ = size;
+  evict(size);
+}
+
+void cppws::hpack_decoder::decode(std::string_view block,
+                                  const field_callback &fn) {
+  bool fields = false;
+  while (!block.empty()) {
+    auto b = static_cast<unsigned char>(block.front());
+    std::string_view name;
+    std::string_view value;
+
+    if (b & 0x80) {
+      // Indexed field.
+      //
+      if (!table_.get(decode_integer(block, 7), name, value))
+        throw hpack_error("Invalid index");
+      fn(name, value);
+    } else if ((b & 0xe0) == 0x20) {
+      // Dynamic table size update, only allowed before the first field.
+      //
+      std::size_t size = decode_integer(block, 5);
+      if (fields || size > limit_)
+        throw hpack_error("Invalid table size update");
+      table_.max_size(size);
+      continue;
+    } else {
+      // Literal field, with incremental indexing (01), without indexing
+      // (0000) or never indexed (0001).
+      //
+      bool indexing = (b & 0xc0) == 0x40;
+      std::size_t index = decode_integer(block, indexing ? 6 : 4);
+      if (index == 0)
+        name = decode_string(block, name_);
+      else if (!table_.get(index, name, value))
+        throw hpack_error("Invalid index");
+      value = decode_string(block, value_);
+      fn(name, value);
+      if (indexing)
+        table_.insert(name, value);
+    }
+    fields = true;
+  }
+}
+
+void cppws::hpack_encoder::max_table_size(std::size_t size) {
+  pendingSize_ = sizeUpdate_ ? std::min(pendingSize_, size) : size;
+  sizeUpdate_ = true;
+}
+
+void cppws::hpack_encoder::encode(std::string &out, std::string_view name,
+                                  std::string_view value, bool index) {
+  if (sizeUpdate_) {
+    // Keep the table within the limit of the decoder, but no larger than
+    // it was configured.
+    //
+    std::size_t size = std::min(pendingSize_, limit_);
+    encode_integer(out, 0x20, 5, size);
+    table_.max_size(size);
+    sizeUpdate_ = false;
+  }
+
+  bool nameOnly;
+  std::size_t found = table_.find(name, value, nameOnly);
+  if (found && !nameOnly) {
+    encode_integer(out, 0x80, 7, found);
+    return;
+  }
+
+  index = index && entry_size(name, value) <= table_.max_size();
+  encode_integer(out, index ? 0x40 : 0x00, index ? 6 : 4, found);
+  if (!found)
+    encode_string(out, name);
+  encode_string(out, value);
+  if (index)
+    table_.insert(name, value);
+}
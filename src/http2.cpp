@@ -0,0 +1,1080 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <cppws/http2.hpp>
+
+static constexpr std::string_view client_preface =
+    "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+static constexpr std::size_t frame_header_length = 9;
+static constexpr std::int64_t max_window = 0x7fffffff;
+
+namespace http2_flag {
+constexpr std::uint8_t END_STREAM = 0x1;
+constexpr std::uint8_t ACK = 0x1;
+constexpr std::uint8_t END_HEADERS = 0x4;
+constexpr std::uint8_t PADDED = 0x8;
+constexpr std::uint8_t PRIORITY = 0x20;
+} // namespace http2_flag
+
+namespace http2_setting {
+constexpr std::uint16_t HEADER_TABLE_SIZE = 0x1;
+constexpr std::uint16_t ENABLE_PUSH = 0x2;
+constexpr std::uint16_t MAX_CONCURRENT_STREAMS = 0x3;
+constexpr std::uint16_t INITIAL_WINDOW_SIZE = 0x4;
+constexpr std::uint16_t MAX_FRAME_SIZE = 0x5;
+constexpr std::uint16_t MAX_HEADER_LIST_SIZE = 0x6;
+} // namespace http2_setting
+
+static std::uint32_t read_u32(const char *p) noexcept {
+  const auto *u = reinterpret_cast<const unsigned char *>(p);
+  return std::uint32_t(u[0]) << 24 | std::uint32_t(u[1]) << 16 |
+         std::uint32_t(u[2]) << 8 | u[3];
+}
+
+static void append_u32(std::string &out, std::uint32_t v) {
+  char b[4] = {static_cast<char>(v >> 24), static_cast<char>(v >> 16),
+               static_cast<char>(v >> 8), static_cast<char>(v)};
+  out.append(b, 4);
+}
+
+static void append_setting(std::string &out, std::uint16_t id,
+                           std::uint32_t value) {
+  out.push_back(static_cast<char>(id >> 8));
+  out.push_back(static_cast<char>(id));
+  append_u32(out, value);
+}
+
+/**
+ * Decodes base64url (RFC 4648 section 5), as used by HTTP2-Settings.
+ */
+static bool base64url_decode(std::string_view in, std::string &out) {
+  std::uint32_t acc = 0;
+  int bits = 0;
+  for (char c : in) {
+    int v;
+    if (c >= 'A' && c <= 'Z')
+      v = c - 'A';
+    else if (c >= 'a' && c <= 'z')
+      v = c - 'a' + 26;
+    else if (c >= '0' && c <= '9')
+      v = c - '0' + 52;
+    else if (c == '-')
+      v = 62;
+    else if (c == '_')
+      v = 63;
+    else if (c == '=')
+      break;
+    else
+      return false;
+    acc = (acc << 6) | static_cast<std::uint32_t>(v);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out.push_back(static_cast<char>(acc >> bits));
+    }
+  }
+  return true;
+}
+
+/**
+ * Parses the method of a request from its name.
+ */
+static bool parse_method(std::string_view name, cppws::http_method &method) {
+  using enum cppws::http_method;
+  for (cppws::http_method m :
+       {GET, HEAD, POST, PUT, DELETE, CONNECT, OPTIONS, TRACE, PATCH}) {
+    if (to_string(m) == name) {
+      method = m;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Headers that only apply to an HTTP/1.1 connection and are not allowed in
+ * HTTP/2 (RFC 9113 section 8.2.2).
+ */
+static bool connection_specific(std::string_view name) noexcept {
+  return cppws::iequals(name, "connection") ||
+         cppws::iequals(name, "keep-alive") ||
+         cppws::iequals(name, "proxy-connection") ||
+         cppws::iequals(name, "transfer-encoding") ||
+         cppws::iequals(name, "upgrade");
+}
+
+bool cppws::is_h2c_upgrade(const http_request &request) {
+  return request.http_version() == 110 &&
+         has_token(request.http_header(http_request_header::Upgrade), "h2c") &&
+         has_token(request.http_header(http_request_header::Connection),
+                   "upgrade") &&
+         has_token(request.http_header(http_request_header::Connection),
+                   "http2-settings") &&
+         request.http_header("HTTP2-Settings");
+}
+
+std::shared_ptr<cppws::http2_connection>
+cppws::http2_connection::accept(class socket &&connection, event_loop &loop,
+                                std::shared_ptr<request_mapper> mapper,
+                                const http2_options &options) {
+  connection.non_blocking(true);
+  auto c = std::make_shared<http2_connection>(
+      private_tag{}, std::move(connection), loop, std::move(mapper), options);
+  c->append_settings();
+  loop.post([c] { c->start(); });
+  return c;
+}
+
+std::shared_ptr<cppws::http2_connection>
+cppws::http2_connection::upgrade(request_manager &manager, event_loop &loop,
+                                 std::shared_ptr<request_mapper> mapper,
+                                 const http2_options &options) {
+  const http_request &request = manager.request();
+  std::string settings;
+  if (!is_h2c_upgrade(request) ||
+      !base64url_decode(trim_ows(*request.http_header("HTTP2-Settings")),
+                        settings) ||
+      settings.size() % 6 != 0)
+    return nullptr;
+
+  manager.status(http::SWITCHING_PROTOCOLS)
+      .header("Connection", "Upgrade")
+      .header("Upgrade", "h2c")
+      .compression(false);
+  manager.send();
+
+  class socket connection = manager.detach();
+  connection.non_blocking(true);
+  auto c = std::make_shared<http2_connection>(
+      private_tag{}, std::move(connection), loop, std::move(mapper), options);
+  c->append_settings();
+  c->apply_settings(settings);
+
+  // The upgrade request is stream 1, half closed by the client. It is
+  // answered right away; the frames are built once the loop runs.
+  //
+  auto s = std::make_shared<stream>(1);
+  s->remoteClosed = true;
+  s->sendWindow = c->peerInitialWindow_;
+  c->streams_.emplace(1, s);
+  c->lastStreamId_ = 1;
+
+  try {
+    request_manager m{request, *s, s->response};
+    dispatch_request(*c->mapper_, m);
+  } catch (...) {
+  }
+
+  loop.post([c, s] {
+    c->start();
+    c->respond(*s);
+  });
+  return c;
+}
+
+cppws::http2_connection::http2_connection(
+    private_tag, class socket &&connection, event_loop &loop,
+    std::shared_ptr<request_mapper> mapper, const http2_options &options)
+    : socket_(std::move(connection)), loop_(&loop), mapper_(std::move(mapper)),
+      options_(options),
+      workers_(options.workers ? options.workers : worker_pool::shared()),
+      decoder_(options.header_table_size),
+      input_(frame_header_length + options.max_frame_size) {
+  output_.watermarks(options.output_high_water, options.output_low_water);
+}
+
+void cppws::http2_connection::start() {
+  started_ = true;
+  loop_->add(socket_.native_handle(), EPOLLIN | EPOLLRDHUP,
+             [self = shared_from_this()](std::uint32_t events) {
+               self->on_event(events);
+             });
+  flush();
+  watch_idle();
+}
+
+void cppws::http2_connection::close() {
+  if (!loop_->in_loop_thread()) {
+    loop_->post([self = shared_from_this()] { self->close(); });
+    return;
+  }
+  if (closed_ || goingAway_)
+    return;
+
+  goingAway_ = true;
+  std::string payload;
+  append_u32(payload, lastStreamId_);
+  append_u32(payload, http2_error::NO_ERROR);
+  append_frame(http2_frame_type::Goaway, 0, 0, payload);
+  flush();
+}
+
+void cppws::http2_connection::append_frame(http2_frame_type type,
+                                           std::uint8_t flags,
+                                           std::uint32_t id,
+                                           std::string_view payload) {
+  char header[frame_header_length] = {
+      static_cast<char>(payload.size() >> 16),
+      static_cast<char>(payload.size() >> 8),
+      static_cast<char>(payload.size()),
+      static_cast<char>(type),
+      static_cast<char>(flags),
+      static_cast<char>((id >> 24) & 0x7f),
+      static_cast<char>(id >> 16),
+      static_cast<char>(id >> 8),
+      static_cast<char>(id)};
+  pending_.append(header, frame_header_length);
+  pending_.append(payload);
+}
+
+void cppws::http2_connection::append_settings() {
+  std::string payload;
+  append_setting(payload, http2_setting::ENABLE_PUSH, 0);
+  append_setting(payload, http2_setting::MAX_CONCURRENT_STREAMS,
+                 options_.max_concurrent_streams);
+  append_setting(payload, http2_setting::INITIAL_WINDOW_SIZE,
+                 options_.initial_window_size);
+  append_setting(payload, http2_setting::MAX_FRAME_SIZE,
+                 options_.max_frame_size);
+  append_setting(payload, http2_setting::HEADER_TABLE_SIZE,
+                 options_.header_table_size);
+  append_setting(payload, http2_setting::MAX_HEADER_LIST_SIZE,
+                 options_.max_header_list_size);
+  append_frame(http2_frame_type::Settings, 0, 0, payload);
+
+  // The connection window can only be raised with WINDOW_UPDATE.
+  //
+  if (options_.connection_window_size > recvWindow_) {
+    payload.clear();
+    append_u32(payload, static_cast<std::uint32_t>(
+                            options_.connection_window_size - recvWindow_));
+    append_frame(http2_frame_type::WindowUpdate, 0, 0, payload);
+    recvWindow_ = options_.connection_window_size;
+  }
+}
+
+bool cppws::http2_connection::apply_settings(std::string_view payload) {
+  for (; payload.size() >= 6; payload.remove_prefix(6)) {
+    auto id = static_cast<std::uint16_t>(
+        static_cast<unsigned char>(payload[0]) << 8 |
+        static_cast<unsigned char>(payload[1]));
+    std::uint32_t value = read_u32(payload.data() + 2);
+
+    switch (id) {
+    case http2_setting::HEADER_TABLE_SIZE:
+      encoder_.max_table_size(value);
+      break;
+    case http2_setting::ENABLE_PUSH:
+      if (value > 1)
+        return connection_error(http2_error::PROTOCOL_ERROR);
+      break;
+    case http2_setting::INITIAL_WINDOW_SIZE: {
+      if (value > max_window)
+        return connection_error(http2_error::FLOW_CONTROL_ERROR);
+      // Applies retroactively to the windows of open streams.
+      //
+      std::int64_t delta = std::int64_t(value) - peerInitialWindow_;
+      for (auto &[id, s] : streams_) {
+        s->sendWindow += delta;
+        if (s->sendWindow > max_window)
+          return connection_error(http2_error::FLOW_CONTROL_ERROR);
+      }
+      peerInitialWindow_ = value;
+      break;
+    }
+    case http2_setting::MAX_FRAME_SIZE:
+      if (value < (1 << 14) || value > (1 << 24) - 1)
+        return connection_error(http2_error::PROTOCOL_ERROR);
+      peerMaxFrameSize_ = value;
+      break;
+    default:
+      break;
+    }
+  }
+  return true;
+}
+
+void cppws::http2_connection::on_event(std::uint32_t events) {
+  if (closed_)
+    return;
+
+  if (events & EPOLLOUT)
+    flush();
+  if (closed_ || !(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+    watch_idle();
+    return;
+  }
+
+  // A full buffer holds a complete frame or the preface, which processing
+  // consumes; the rest of the input is read on the next event.
+  //
+  bool eof = false;
+  while (!input_.full()) {
+    std::ptrdiff_t n;
+    try {
+      n = input_.try_read_some(socket_);
+    } catch (const std::system_error &) {
+      n = 0;
+    }
+    if (n == 0)
+      eof = true;
+    if (n <= 0 || !input_.filled())
+      break;
+  }
+
+  process_input();
+  if (eof) {
+    shutdown();
+    return;
+  }
+  flush();
+  watch_idle();
+}
+
+bool cppws::http2_connection::process_input() {
+  std::size_t pos = 0;
+  if (!prefaceReceived_) {
+    std::size_t n = std::min(input_.size(), client_preface.size());
+    if (input_.view().substr(0, n) != client_preface.substr(0, n))
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    if (n < client_preface.size())
+      return true;
+    prefaceReceived_ = true;
+    pos = client_preface.size();
+  }
+
+  bool ok = true;
+  while (ok && !closeAfterFlush_ &&
+         input_.size() - pos >= frame_header_length) {
+    const char *p = input_.data().data() + pos;
+    const auto *u = reinterpret_cast<const unsigned char *>(p);
+    std::uint32_t length = std::uint32_t(u[0]) << 16 | u[1] << 8 | u[2];
+    auto type = static_cast<http2_frame_type>(p[3]);
+    auto flags = static_cast<std::uint8_t>(p[4]);
+    std::uint32_t id = read_u32(p + 5) & 0x7fffffff;
+
+    if (length > options_.max_frame_size) {
+      ok = connection_error(http2_error::FRAME_SIZE_ERROR);
+      break;
+    }
+    if (input_.size() - pos < frame_header_length + length)
+      break;
+    pos += frame_header_length + length;
+
+    // The client preface ends with a SETTINGS frame.
+    //
+    if (!settingsReceived_ && type != http2_frame_type::Settings) {
+      ok = connection_error(http2_error::PROTOCOL_ERROR);
+      break;
+    }
+    ok = process_frame(type, flags, id,
+                       std::string_view(p + frame_header_length, length));
+  }
+  input_.consume(pos);
+  return ok;
+}
+
+bool cppws::http2_connection::process_frame(http2_frame_type type,
+                                            std::uint8_t flags,
+                                            std::uint32_t id,
+                                            std::string_view payload) {
+  if (continuationId_ && type != http2_frame_type::Continuation)
+    return connection_error(http2_error::PROTOCOL_ERROR);
+
+  switch (type) {
+  case http2_frame_type::Data:
+    return on_data(flags, id, payload);
+
+  case http2_frame_type::Headers:
+    return on_headers(flags, id, payload);
+
+  case http2_frame_type::Continuation:
+    if (id == 0 || id != continuationId_)
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    if (headerBlock_.size() + payload.size() >
+        2 * std::size_t(options_.max_header_list_size))
+      return connection_error(http2_error::ENHANCE_YOUR_CALM);
+    headerBlock_.append(payload);
+    if (flags & http2_flag::END_HEADERS) {
+      continuationId_ = 0;
+      return on_header_block(id, continuationEnd_);
+    }
+    return true;
+
+  case http2_frame_type::Priority:
+    if (id == 0)
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    if (payload.size() != 5)
+      reset_stream(id, http2_error::FRAME_SIZE_ERROR);
+    return true;
+
+  case http2_frame_type::RstStream:
+    if (id == 0 || id > lastStreamId_)
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    if (payload.size() != 4)
+      return connection_error(http2_error::FRAME_SIZE_ERROR);
+    streams_.erase(id);
+    return true;
+
+  case http2_frame_type::Settings:
+    return on_settings(flags, id, payload);
+
+  case http2_frame_type::PushPromise:
+    return connection_error(http2_error::PROTOCOL_ERROR);
+
+  case http2_frame_type::Ping:
+    if (id != 0)
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    if (payload.size() != 8)
+      return connection_error(http2_error::FRAME_SIZE_ERROR);
+    if (!(flags & http2_flag::ACK))
+      append_frame(http2_frame_type::Ping, http2_flag::ACK, 0, payload);
+    return true;
+
+  case http2_frame_type::Goaway:
+    if (id != 0)
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    goingAway_ = true;
+    return true;
+
+  case http2_frame_type::WindowUpdate:
+    return on_window_update(id, payload);
+
+  default:
+    // Unknown frame types are ignored (RFC 9113 section 4.1).
+    //
+    return true;
+  }
+}
+
+bool cppws::http2_connection::on_settings(std::uint8_t flags,
+                                          std::uint32_t id,
+                                          std::string_view payload) {
+  if (id != 0)
+    return connection_error(http2_error::PROTOCOL_ERROR);
+  if (flags & http2_flag::ACK) {
+    if (!payload.empty())
+      return connection_error(http2_error::FRAME_SIZE_ERROR);
+    return true;
+  }
+  if (payload.size() % 6 != 0)
+    return connection_error(http2_error::FRAME_SIZE_ERROR);
+  if (!apply_settings(payload))
+    return false;
+
+  settingsReceived_ = true;
+  append_frame(http2_frame_type::Settings, http2_flag::ACK, 0, {});
+  return true;
+}
+
+bool cppws::http2_connection::on_window_update(std::uint32_t id,
+                                               std::string_view payload) {
+  if (payload.size() != 4)
+    return connection_error(http2_error::FRAME_SIZE_ERROR);
+  std::uint32_t increment = read_u32(payload.data()) & 0x7fffffff;
+
+  if (id == 0) {
+    if (increment == 0)
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    sendWindow_ += increment;
+    if (sendWindow_ > max_window)
+      return connection_error(http2_error::FLOW_CONTROL_ERROR);
+    return true;
+  }
+
+  auto it = streams_.find(id);
+  if (it == streams_.end()) {
+    if (id > lastStreamId_)
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    return true;
+  }
+  stream &s = *it->second;
+  if (increment == 0) {
+    reset_stream(id, http2_error::PROTOCOL_ERROR);
+    return true;
+  }
+  s.sendWindow += increment;
+  if (s.sendWindow > max_window)
+    reset_stream(id, http2_error::FLOW_CONTROL_ERROR);
+  return true;
+}
+
+bool cppws::http2_connection::on_headers(std::uint8_t flags, std::uint32_t id,
+                                         std::string_view payload) {
+  if (id == 0 || id % 2 == 0)
+    return connection_error(http2_error::PROTOCOL_ERROR);
+
+  std::string_view block = payload;
+  if (flags & http2_flag::PADDED) {
+    if (block.empty())
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    std::size_t padding = static_cast<unsigned char>(block.front());
+    block.remove_prefix(1);
+    if (padding > block.size())
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    block.remove_suffix(padding);
+  }
+  if (flags & http2_flag::PRIORITY) {
+    if (block.size() < 5)
+      return connection_error(http2_error::FRAME_SIZE_ERROR);
+    block.remove_prefix(5);
+  }
+
+  headerBlock_.assign(block);
+  bool endStream = flags & http2_flag::END_STREAM;
+  if (!(flags & http2_flag::END_HEADERS)) {
+    continuationId_ = id;
+    continuationEnd_ = endStream;
+    return true;
+  }
+  return on_header_block(id, endStream);
+}
+
+bool cppws::http2_connection::on_header_block(std::uint32_t id,
+                                              bool endStream) {
+  stream *s = nullptr;
+  bool trailers = false;
+  bool refuse = false;
+  if (auto it = streams_.find(id); it != streams_.end()) {
+    s = it->second.get();
+    if (s->remoteClosed)
+      return connection_error(http2_error::STREAM_CLOSED);
+    trailers = true;
+  } else if (id <= lastStreamId_) {
+    return connection_error(http2_error::STREAM_CLOSED);
+  } else {
+    lastStreamId_ = id;
+    std::size_t active = std::ranges::count_if(streams_, [](const auto &e) {
+      return !e.second->responded;
+    });
+    refuse = goingAway_ || active >= options_.max_concurrent_streams;
+    if (!refuse) {
+      auto created = std::make_shared<stream>(id);
+      s = created.get();
+      streams_.emplace(id, std::move(created));
+    }
+  }
+
+  // The block is decoded even if the stream is refused, to keep the HPACK
+  // context in sync with the client.
+  //
+  struct header_state {
+    std::string_view pseudo[4];
+    bool regular = false;
+    bool assigned = false;
+    bool malformed = false;
+    std::size_t size = 0;
+  } st;
+  enum { Method, Scheme, Authority, Path };
+
+  auto begin_request = [&] {
+    st.assigned = true;
+    http_method method;
+    if (st.pseudo[Method].empty() || st.pseudo[Scheme].empty() ||
+        !st.pseudo[Path].starts_with('/') ||
+        !parse_method(st.pseudo[Method], method) ||
+        method == http_method::CONNECT) {
+      st.malformed = true;
+      return;
+    }
+    s->request.assign(method, st.pseudo[Path], 200);
+    if (!st.pseudo[Authority].empty())
+      s->request.add_header("Host", st.pseudo[Authority]);
+  };
+
+  // Pseudo-header values are kept in the decoder's buffers only during the
+  // callback, so they are copied until the request line is assigned.
+  //
+  std::string pseudoValues[4];
+  auto on_field = [&](std::string_view name, std::string_view value) {
+    st.size += name.size() + value.size() + 32;
+    if (st.size > options_.max_header_list_size)
+      st.malformed = true;
+    if (st.malformed || !s)
+      return;
+
+    if (name.starts_with(':')) {
+      int i = name == ":method"      ? Method
+              : name == ":scheme"    ? Scheme
+              : name == ":authority" ? Authority
+              : name == ":path"      ? Path
+                                     : -1;
+      if (trailers || st.regular || i < 0 || !st.pseudo[i].empty()) {
+        st.malformed = true;
+        return;
+      }
+      pseudoValues[i].assign(value);
+      st.pseudo[i] = pseudoValues[i];
+      return;
+    }
+
+    bool upper = std::ranges::any_of(
+        name, [](char c) { return c >= 'A' && c <= 'Z'; });
+    if (upper || connection_specific(name) ||
+        (name == "te" && value != "trailers")) {
+      st.malformed = true;
+      return;
+    }
+    if (trailers)
+      return;
+    if (!st.regular) {
+      st.regular = true;
+      begin_request();
+      if (st.malformed)
+        return;
+    }
+    if (name == "host" && !st.pseudo[Authority].empty())
+      return;
+    if (name == "content-length") {
+      std::int64_t length;
+      if (std::from_chars(value.data(), value.data() + value.size(), length)
+              .ec != std::errc{}) {
+        st.malformed = true;
+        return;
+      }
+      s->expectedLength = length;
+    }
+    s->request.add_header(name, value);
+  };
+
+  try {
+    decoder_.decode(headerBlock_, [&on_field](std::string_view name,
+                                              std::string_view value) {
+      on_field(name, value);
+    });
+  } catch (const hpack_error &) {
+    return connection_error(http2_error::COMPRESSION_ERROR);
+  }
+  headerBlock_.clear();
+
+  if (refuse) {
+    if (!goingAway_)
+      reset_stream(id, http2_error::REFUSED_STREAM);
+    return true;
+  }
+  if (!trailers && !st.assigned && !st.malformed)
+    begin_request();
+  if (st.malformed || (trailers && !endStream)) {
+    reset_stream(id, http2_error::PROTOCOL_ERROR);
+    return true;
+  }
+
+  if (!trailers) {
+    s->sendWindow = peerInitialWindow_;
+    s->recvWindow = options_.initial_window_size;
+  }
+  if (endStream) {
+    s->remoteClosed = true;
+    if (s->expectedLength >= 0 &&
+        static_cast<std::size_t>(s->expectedLength) != s->received) {
+      reset_stream(id, http2_error::PROTOCOL_ERROR);
+      return true;
+    }
+    dispatch(streams_.at(id));
+  }
+  return true;
+}
+
+bool cppws::http2_connection::on_data(std::uint8_t flags, std::uint32_t id,
+                                      std::string_view payload) {
+  if (id == 0)
+    return connection_error(http2_error::PROTOCOL_ERROR);
+
+  // Flow control covers the whole payload, padding included.
+  //
+  auto length = static_cast<std::int64_t>(payload.size());
+  if (length > recvWindow_)
+    return connection_error(http2_error::FLOW_CONTROL_ERROR);
+  recvWindow_ -= length;
+  recvUnacked_ += length;
+  if (recvUnacked_ >= options_.connection_window_size / 2) {
+    std::string increment;
+    append_u32(increment, static_cast<std::uint32_t>(recvUnacked_));
+    append_frame(http2_frame_type::WindowUpdate, 0, 0, increment);
+    recvWindow_ += recvUnacked_;
+    recvUnacked_ = 0;
+  }
+
+  auto it = streams_.find(id);
+  if (it == streams_.end() || it->second->remoteClosed) {
+    if (id > lastStreamId_)
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    reset_stream(id, http2_error::STREAM_CLOSED);
+    return true;
+  }
+  stream &s = *it->second;
+
+  std::string_view data = payload;
+  if (flags & http2_flag::PADDED) {
+    if (data.empty())
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    std::size_t padding = static_cast<unsigned char>(data.front());
+    data.remove_prefix(1);
+    if (padding > data.size())
+      return connection_error(http2_error::PROTOCOL_ERROR);
+    data.remove_suffix(padding);
+  }
+
+  if (length > s.recvWindow) {
+    reset_stream(id, http2_error::FLOW_CONTROL_ERROR);
+    return true;
+  }
+  s.recvWindow -= length;
+  s.received += data.size();
+  if (s.received > options_.max_request_body) {
+    reset_stream(id, http2_error::CANCEL);
+    return true;
+  }
+  s.request.append_body(data);
+
+  if (flags & http2_flag::END_STREAM) {
+    s.remoteClosed = true;
+    if (s.expectedLength >= 0 &&
+        static_cast<std::size_t>(s.expectedLength) != s.received) {
+      reset_stream(id, http2_error::PROTOCOL_ERROR);
+      return true;
+    }
+    dispatch(it->second);
+  } else if (s.recvWindow <= options_.initial_window_size / 2) {
+    std::string increment;
+    append_u32(increment, static_cast<std::uint32_t>(
+                              options_.initial_window_size - s.recvWindow));
+    append_frame(http2_frame_type::WindowUpdate, 0, id, increment);
+    s.recvWindow = options_.initial_window_size;
+  }
+  return true;
+}
+
+cppws::http2_connection::stream::~stream() {
+  for (const response_buffer::body_part &p : parts)
+    if (p.fd >= 0)
+      ::close(p.fd);
+}
+
+void cppws::http2_connection::stream::write_response(response_buffer &r,
+                                                     bool includeBody) {
+  r.finish_head();
+  if (includeBody) {
+    // Callers may close their files once the response is sent, while the
+    // frames leave as the windows allow, so the stream keeps descriptors of
+    // its own.
+    //
+    std::vector<response_buffer::body_part> all;
+    r.body_parts(all);
+    parts.reserve(all.size());
+    for (response_buffer::body_part p : all) {
+      if (p.fd >= 0 && (p.fd = ::fcntl(p.fd, F_DUPFD_CLOEXEC, 0)) < 0)
+        throw std::system_error(errno, std::system_category());
+      parts.push_back(p);
+    }
+  }
+  answered = true;
+}
+
+void cppws::http2_connection::stream::write_response(
+    std::string_view response) {
+  serialized.assign(response);
+  answered = true;
+}
+
+void cppws::http2_connection::dispatch(std::shared_ptr<stream> s) {
+  // The stream is complete: nothing on the loop thread touches its request
+  // any more, and its response is only looked at once the handler returned.
+  //
+  workers_->post([self = shared_from_this(), s = std::move(s)] {
+    try {
+      request_manager manager{s->request, *s, s->response};
+      dispatch_request(*self->mapper_, manager);
+    } catch (...) {
+    }
+    self->loop_->post([self, s] { self->respond(*s); });
+  });
+}
+
+void cppws::http2_connection::respond(stream &s) {
+  auto it = streams_.find(s.id);
+  if (closed_ || it == streams_.end() || it->second.get() != &s)
+    return;
+
+  // The stream is reset if the handler could not answer, or answered with
+  // an interim response, e.g. a protocol switch, which has no HTTP/2
+  // equivalent.
+  //
+  std::string block;
+  if (!s.answered || !encode_head(s, block)) {
+    reset_stream(s.id, s.answered ? http2_error::HTTP_1_1_REQUIRED
+                                  : http2_error::INTERNAL_ERROR);
+    flush();
+    watch_idle();
+    return;
+  }
+  for (const response_buffer::body_part &p : s.parts)
+    s.remaining += p.length;
+
+  // Header blocks larger than a frame continue in CONTINUATION frames.
+  //
+  std::string_view rest = block;
+  std::uint8_t flags = s.remaining == 0 ? http2_flag::END_STREAM : 0;
+  http2_frame_type type = http2_frame_type::Headers;
+  do {
+    std::string_view fragment = rest.substr(0, peerMaxFrameSize_);
+    rest.remove_prefix(fragment.size());
+    append_frame(type, flags | (rest.empty() ? http2_flag::END_HEADERS : 0),
+                 s.id, fragment);
+    type = http2_frame_type::Continuation;
+    flags = 0;
+  } while (!rest.empty());
+  s.responded = true;
+
+  flush();
+  watch_idle();
+}
+
+bool cppws::http2_connection::encode_head(stream &s, std::string &block) {
+  int code = s.response.status().status_code;
+  std::string_view head = s.response.headers();
+
+  // Responses written in HTTP/1.1 syntax are split into status line, header
+  // lines and body; the body is sent from the stream's copy.
+  //
+  if (!s.serialized.empty()) {
+    std::string_view response = s.serialized;
+    std::size_t end = response.find("\r\n\r\n");
+    head = response.substr(0, end);
+    if (end != std::string_view::npos && end + 4 < response.size())
+      s.parts.push_back({-1, end + 4, response.size() - end - 4});
+
+    std::size_t eol = head.find("\r\n");
+    std::string_view line = head.substr(0, eol);
+    std::size_t sp = line.find(' ');
+    std::string_view digits = sp == std::string_view::npos
+                                  ? std::string_view()
+                                  : line.substr(sp + 1, 3);
+    if (digits.size() != 3 ||
+        std::from_chars(digits.data(), digits.data() + 3, code).ec !=
+            std::errc{})
+      return false;
+    head.remove_prefix(eol == std::string_view::npos ? head.size() : eol + 2);
+  }
+  if (code < 200 || code > 999)
+    return false;
+
+  // ":status" replaces the status line and names are lower case.
+  //
+  char status[3] = {static_cast<char>('0' + code / 100),
+                    static_cast<char>('0' + code / 10 % 10),
+                    static_cast<char>('0' + code % 10)};
+  encoder_.encode(block, ":status", std::string_view(status, 3));
+  std::string name;
+  while (!head.empty()) {
+    std::size_t eol = head.find("\r\n");
+    std::string_view field = head.substr(0, eol);
+    head.remove_prefix(eol == std::string_view::npos ? head.size() : eol + 2);
+    std::size_t colon = field.find(':');
+    if (colon == std::string_view::npos)
+      continue;
+
+    name.assign(field.substr(0, colon));
+    std::ranges::transform(name, name.begin(), [](unsigned char c) {
+      return static_cast<char>(std::tolower(c));
+    });
+    if (connection_specific(name))
+      continue;
+    encoder_.encode(block, name, trim_ows(field.substr(colon + 1)),
+                    name != "set-cookie" && name != "content-length");
+  }
+  return true;
+}
+
+std::size_t cppws::http2_connection::append_data(stream &s, std::size_t n) {
+  // Frames do not span parts; file slices are read one frame at a time.
+  //
+  const response_buffer::body_part &p = s.parts[s.part];
+  n = static_cast<std::size_t>(
+      std::min<std::uint64_t>(n, p.length - s.partSent));
+  std::string_view payload;
+  if (p.fd < 0) {
+    std::string_view text = s.serialized.empty()
+                                ? std::string_view(s.response.body())
+                                : std::string_view(s.serialized);
+    payload = text.substr(p.offset + s.partSent, n);
+  } else {
+    frame_.resize(n);
+    ::ssize_t r;
+    do {
+      r = ::pread(p.fd, frame_.data(), n, p.offset + s.partSent);
+    } while (r < 0 && errno == EINTR);
+    if (r <= 0)
+      return 0;
+    payload = std::string_view(frame_.data(), static_cast<std::size_t>(r));
+  }
+
+  s.partSent += payload.size();
+  s.remaining -= payload.size();
+  if (s.partSent == p.length) {
+    ++s.part;
+    s.partSent = 0;
+  }
+  append_frame(http2_frame_type::Data,
+               s.remaining == 0 ? http2_flag::END_STREAM : 0, s.id, payload);
+  return payload.size();
+}
+
+bool cppws::http2_connection::write_data() {
+  // Streams take turns, one frame at a time, so that a large response does
+  // not hold back the others. Streams whose file cannot be read any more
+  // are reset afterwards.
+  //
+  std::vector<std::uint32_t> failed;
+  bool progress = true;
+  bool more = false;
+  while (progress && sendWindow_ > 0) {
+    if (output_.paused() ||
+        pending_.size() + output_.size() >= options_.output_high_water) {
+      more = true;
+      break;
+    }
+    progress = false;
+    for (auto &[id, s] : streams_) {
+      if (!s->responded || s->remaining == 0)
+        continue;
+      std::int64_t n = std::min<std::int64_t>(
+          {static_cast<std::int64_t>(
+               std::min<std::uint64_t>(s->remaining, max_window)),
+           s->sendWindow, sendWindow_,
+           static_cast<std::int64_t>(peerMaxFrameSize_)});
+      if (n <= 0)
+        continue;
+
+      std::size_t sent = append_data(*s, static_cast<std::size_t>(n));
+      if (sent == 0) {
+        failed.push_back(id);
+        s->remaining = 0;
+        continue;
+      }
+      s->sendWindow -= static_cast<std::int64_t>(sent);
+      sendWindow_ -= static_cast<std::int64_t>(sent);
+      progress = true;
+      if (sendWindow_ <= 0)
+        break;
+    }
+  }
+
+  for (std::uint32_t id : failed)
+    reset_stream(id, http2_error::INTERNAL_ERROR);
+  std::erase_if(streams_, [](const auto &e) {
+    const stream &s = *e.second;
+    return s.remoteClosed && s.responded && s.remaining == 0;
+  });
+  if (goingAway_ && streams_.empty())
+    closeAfterFlush_ = true;
+  return more;
+}
+
+void cppws::http2_connection::reset_stream(std::uint32_t id,
+                                           std::uint32_t code) {
+  std::string payload;
+  append_u32(payload, code);
+  append_frame(http2_frame_type::RstStream, 0, id, payload);
+  streams_.erase(id);
+}
+
+bool cppws::http2_connection::connection_error(std::uint32_t code) {
+  std::string payload;
+  append_u32(payload, lastStreamId_);
+  append_u32(payload, code);
+  append_frame(http2_frame_type::Goaway, 0, 0, payload);
+  goingAway_ = true;
+  closeAfterFlush_ = true;
+  return false;
+}
+
+void cppws::http2_connection::flush() {
+  while (!closed_) {
+    bool more = closeAfterFlush_ ? false : write_data();
+    if (!pending_.empty()) {
+      output_.push(std::make_shared<const std::string>(std::move(pending_)));
+      pending_.clear();
+    }
+    if (!started_)
+      return;
+
+    bool drained;
+    try {
+      drained = output_.flush(socket_);
+    } catch (const std::system_error &) {
+      shutdown();
+      return;
+    }
+    if (drained == pollingOutput_) {
+      pollingOutput_ = !drained;
+      std::uint32_t events = EPOLLIN | EPOLLRDHUP;
+      if (!drained)
+        events |= EPOLLOUT;
+      loop_->modify(socket_.native_handle(), events);
+    }
+    if (!drained)
+      return;
+    if (closeAfterFlush_) {
+      shutdown();
+      return;
+    }
+    if (!more)
+      return;
+  }
+}
+
+void cppws::http2_connection::shutdown() {
+  if (closed_)
+    return;
+  closed_ = true;
+  idleTimer_.cancel();
+  loop_->remove(socket_.native_handle());
+  socket_.close();
+  streams_.clear();
+  output_.clear();
+}
+
+void cppws::http2_connection::watch_idle() {
+  if (closed_)
+    return;
+
+  // Connections without streams hold no input buffer while idle.
+  //
+  if (streams_.empty())
+    input_.release();
+  if (options_.idle_timeout <= std::chrono::milliseconds::zero())
+    return;
+
+  // Every event of a connection without streams starts the idle period
+  // over; re-arming the timer is as cheap as checking it.
+  //
+  if (streams_.empty())
+    loop_->timers().arm(idleTimer_, options_.idle_timeout,
+                        [this] { close(); });
+  else
+    idleTimer_.cancel();
+}
+
+cppws::h2c_upgrade_mapper::h2c_upgrade_mapper(
+    std::shared_ptr<request_mapper> mapper, event_loop &loop,
+    const http2_options &options)
+    : mapper_(std::move(mapper)), loop_(&loop), options_(options),
+      upgrade_([this](request_manager &manager) {
+        if (!http2_connection::upgrade(manager, *loop_, mapper_, options_))
+          dispatch_request(*mapper_, manager);
+      }) {}
+
+const cppws::request_mapper::handler *
+cppws::h2c_upgrade_mapper::resolve(const http_request &request) {
+  if (is_h2c_upgrade(request))
+    return &upgrade_;
+  return mapper_->resolve(request);
+}
@@ -0,0 +1,215 @@
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+#include <cppws/http_date.hpp>
+
+namespace {
+
+constexpr std::size_t line_words =
+    (cppws::http_date_cache::line_length + sizeof(std::uint64_t) - 1) /
+    sizeof(std::uint64_t);
+
+/**
+ * Sequence locked copy of the Date header line. The line is stored as atomic
+ * words so that readers racing with the writer never perform a data race;
+ * torn reads are detected through the sequence number and retried.
+ */
+struct date_state {
+  std::atomic<std::uint64_t> seq{0};
+  std::atomic<std::int64_t> second{-1};
+  std::atomic_flag writing = ATOMIC_FLAG_INIT;
+  std::atomic<std::uint64_t> words[line_words];
+};
+
+date_state state;
+
+std::int64_t current_second() noexcept {
+  struct timespec ts;
+#ifdef CLOCK_REALTIME_COARSE
+  ::clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+  ::clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+  return ts.tv_sec;
+}
+
+void refresh(std::int64_t now) noexcept {
+  if (state.writing.test_and_set(std::memory_order_acquire))
+    return; // Another thread is already refreshing
+
+  if (state.second.load(std::memory_order_relaxed) != now) {
+    std::uint64_t buf[line_words] = {};
+    char *line = reinterpret_cast<char *>(buf);
+    std::memcpy(line, "Date: ", 6);
+    char *end =
+        cppws::format_http_date(line + 6, static_cast<std::time_t>(now));
+    std::memcpy(end, "\r\n", 2);
+
+    std::uint64_t seq = state.seq.load(std::memory_order_relaxed);
+    state.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < line_words; ++i)
+      state.words[i].store(buf[i], std::memory_order_relaxed);
+    state.seq.store(seq + 2, std::memory_order_release);
+    state.second.store(now, std::memory_order_release);
+  }
+  state.writing.clear(std::memory_order_release);
+}
+
+} // namespace
+
+char *cppws::format_http_date(char *out, std::time_t t) noexcept {
+  static constexpr char days[][4] = {"Sun", "Mon", "Tue", "Wed",
+                                     "Thu", "Fri", "Sat"};
+  static constexpr char months[][4] = {"Jan", "Feb", "Mar", "Apr",
+                                       "May", "Jun", "Jul", "Aug",
+                                       "Sep", "Oct", "Nov", "Dec"};
+
+  struct tm tm;
+  ::gmtime_r(&t, &tm);
+
+  const auto two = [&out](int v) {
+    *out++ = static_cast<char>('0' + v / 10);
+    *out++ = static_cast<char>('0' + v % 10);
+  };
+
+  std::memcpy(out, days[tm.tm_wday], 3);
+  out += 3;
+  *out++ = ',';
+  *out++ = ' ';
+  two(tm.tm_mday);
+  *out++ = ' ';
+  std::memcpy(out, months[tm.tm_mon], 3);
+  out += 3;
+  *out++ = ' ';
+  int year = tm.tm_year + 1900;
+  two(year / 100);
+  two(year % 100);
+  *out++ = ' ';
+  two(tm.tm_hour);
+  *out++ = ':';
+  two(tm.tm_min);
+  *out++ = ':';
+  two(tm.tm_sec);
+  std::memcpy(out, " GMT", 4);
+  return out + 4;
+}
+
+static int parse_month(std::string_view name) noexcept {
+  constexpr std::string_view months[] = {"Jan", "Feb", "Mar", "Apr",
+                                         "May", "Jun", "Jul", "Aug",
+                                         "Sep", "Oct", "Nov", "Dec"};
+  for (int i = 0; i < 12; ++i) {
+    if (months[i] == name)
+      return i;
+  }
+  return -1;
+}
+
+static bool parse_number(std::string_view &str, std::size_t digits,
+                         int &out) noexcept {
+  if (str.size() < digits)
+    return false;
+  out = 0;
+  for (std::size_t i = 0; i < digits; ++i) {
+    if (str[i] < '0' || str[i] > '9')
+      return false;
+    out = out * 10 + (str[i] - '0');
+  }
+  str.remove_prefix(digits);
+  return true;
+}
+
+static bool expect(std::string_view &str, char c) noexcept {
+  if (str.empty() || str.front() != c)
+    return false;
+  str.remove_prefix(1);
+  return true;
+}
+
+static bool parse_time(std::string_view &str, struct tm &tm) noexcept {
+  return parse_number(str, 2, tm.tm_hour) && expect(str, ':') &&
+         parse_number(str, 2, tm.tm_min) && expect(str, ':') &&
+         parse_number(str, 2, tm.tm_sec);
+}
+
+bool cppws::parse_http_date(std::string_view str, std::time_t &out) noexcept {
+  struct tm tm = {};
+
+  std::size_t comma = str.find(',');
+  if (comma == 3) {
+    // IMF-fixdate: Sun, 06 Nov 1994 08:49:37 GMT
+    //
+    str.remove_prefix(4);
+    if (!expect(str, ' ') || !parse_number(str, 2, tm.tm_mday) ||
+        !expect(str, ' ') || str.size() < 4 ||
+        (tm.tm_mon = parse_month(str.substr(0, 3))) < 0)
+      return false;
+    str.remove_prefix(3);
+    if (!expect(str, ' ') || !parse_number(str, 4, tm.tm_year) ||
+        !expect(str, ' ') || !parse_time(str, tm) || str != " GMT")
+      return false;
+    tm.tm_year -= 1900;
+  } else if (comma != std::string_view::npos) {
+    // RFC 850: Sunday, 06-Nov-94 08:49:37 GMT
+    //
+    str.remove_prefix(comma + 1);
+    if (!expect(str, ' ') || !parse_number(str, 2, tm.tm_mday) ||
+        !expect(str, '-') || str.size() < 4 ||
+        (tm.tm_mon = parse_month(str.substr(0, 3))) < 0)
+      return false;
+    str.remove_prefix(3);
+    if (!expect(str, '-') || !parse_number(str, 2, tm.tm_year) ||
+        !expect(str, ' ') || !parse_time(str, tm) || str != " GMT")
+      return false;
+    if (tm.tm_year < 70)
+      tm.tm_year += 100;
+  } else {
+    // asctime: Sun Nov  6 08:49:37 1994
+    //
+    if (str.size() != 24 ||
+        (tm.tm_mon = parse_month(str.substr(4, 3))) < 0)
+      return false;
+    std::string_view day = str.substr(8, 2);
+    if (day.front() == ' ')
+      day.remove_prefix(1);
+    if (!parse_number(day, day.size(), tm.tm_mday))
+      return false;
+    str.remove_prefix(11);
+    if (!parse_time(str, tm) || !expect(str, ' ') ||
+        !parse_number(str, 4, tm.tm_year))
+      return false;
+    tm.tm_year -= 1900;
+  }
+
+  if (tm.tm_mday < 1 || tm.tm_mday > 31 || tm.tm_hour > 23 ||
+      tm.tm_min > 59 || tm.tm_sec > 60)
+    return false;
+
+  out = ::timegm(&tm);
+  return out != static_cast<std::time_t>(-1);
+}
+
+char *cppws::http_date_cache::copy(char *out) noexcept {
+  std::int64_t now = current_second();
+  if (state.second.load(std::memory_order_acquire) != now)
+    refresh(now);
+
+  std::uint64_t buf[line_words];
+  for (;;) {
+    std::uint64_t seq = state.seq.load(std::memory_order_acquire);
+    if (seq & 1)
+      continue;
+    for (std::size_t i = 0; i < line_words; ++i)
+      buf[i] = state.words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq != 0 && state.seq.load(std::memory_order_relaxed) == seq)
+      break;
+    if (seq == 0)
+      refresh(now);
+  }
+  std::memcpy(out, buf, line_length);
+  return out + line_length;
+}
@@ -1,30 +1,78 @@
-#include <cppws/http_request.hpp>
+#include <new>
 #include <ranges>
+#include <stdexcept>
+#include <system_error>
 
-static void read_http_line(std::pmr::string &out, std::istream &stream) {
-  out.clear();
-  int pc = 0;
-  int c = 0;
-  while (stream && !(c == '\n' && pc == '\r')) {
-    pc = c;
-    c = stream.get();
-    out.append(1, c);
-  }
-  if (c == '\n' && pc == '\r') {
-    out.pop_back();
-    out.pop_back();
-  }
+#include <cppws/connection_buffer.hpp>
+#include <cppws/http_request.hpp>
+#include <cppws/socket.hpp>
+
+/**
+ * Gets the Content-Length of a request, 0 without one. Returns false if the
+ * header is malformed.
+ */
+static bool content_length(const cppws::http_request &request,
+                           std::size_t &length) {
+  length = 0;
+  const std::pmr::string *value =
+      request.http_header(cppws::http_request_header::ContentLength);
+  return !value ||
+         std::from_chars(value->data(), value->data() + value->length(),
+                         length)
+                 .ec == std::errc{};
 }
 
 bool cppws::http_request::accept(http_request &out, std::istream &stream) {
+  return accept_head(out, stream) && accept_body(out, stream);
+}
 
-  std::pmr::string line{&out.buffer_};
+bool cppws::http_request::accept_head(http_request &out,
+                                      std::istream &stream) {
+  std::pmr::string head{&out.buffer_};
+  while (!head.ends_with("\r\n\r\n")) {
+    int c = stream.get();
+    if (c == std::istream::traits_type::eof())
+      return false;
+    head.push_back(static_cast<char>(c));
+  }
+  head.resize(head.size() - 2);
+  return out.parse_head(head);
+}
 
-  // Get request line.
-  read_http_line(line, stream);
+bool cppws::http_request::accept_head(http_request &out,
+                                      connection_buffer &input,
+                                      class socket &connection) {
+  // Only the bytes that arrived since the last search are searched, along
+  // with the three before them that may start the blank line.
+  //
+  std::size_t searched = 0;
+  try {
+    for (;;) {
+      std::string_view data = input.view();
+      std::size_t end =
+          data.find("\r\n\r\n", searched < 3 ? 0 : searched - 3);
+      if (end != std::string_view::npos) {
+        bool parsed = out.parse_head(data.substr(0, end + 2));
+        input.consume(end + 4);
+        return parsed;
+      }
+      searched = data.size();
+      if (input.full() || input.read_some(connection) == 0)
+        return false;
+    }
+  } catch (const std::system_error &) {
+    return false; // Connection reset, or shut down by a deadline
+  }
+}
 
+bool cppws::http_request::parse_head(std::string_view head) {
+  std::size_t eol = head.find("\r\n");
+  std::string_view line = head.substr(0, eol);
+  head.remove_prefix(eol == std::string_view::npos ? head.size() : eol + 2);
+
+  // Get request line.
   auto [str, res] =
-      from_chars(line.data(), line.data() + line.length(), out.httpMethod_);
+      from_chars(line.data(), line.data() + line.length(), httpMethod_);
   if (res != std::errc{})
     return false;
 
@@ -32,71 +80,144 @@ bool cppws::http_request::accept(http_request &out, std::istream &stream) {
   while (str != line.data() + line.length() && *str != ' ')
     ++str;
 
-  out.requestUri_ = std::pmr::vector<std::pmr::string>{&out.buffer_};
-  for (auto rng : std::string_view(save, str) | std::views::split('/')) {
-    if (rng.empty())
-      continue;
-    out.requestUri_.push_back(
-        std::pmr::string(rng.begin(), rng.end(), &out.buffer_));
-  }
+  set_target(std::string_view(save, str));
 
   std::string_view rest{str, line.data() + line.length()};
   if (!rest.starts_with(" HTTP/"))
     return false;
 
   rest = rest.substr(6);
-  if (!std::isdigit(rest.front()))
+  if (rest.empty() || !std::isdigit(rest.front()))
     return false;
 
-  out.httpVersion_ = 100 * (rest.front() - '0');
+  httpVersion_ = 100 * (rest.front() - '0');
   rest = rest.substr(1);
 
   if (rest.starts_with('.')) {
     rest = rest.substr(1);
-    if (!std::isdigit(rest.front()))
+    if (rest.empty() || !std::isdigit(rest.front()))
       return false;
-    out.httpVersion_ += 10 * (rest.front() - '0');
+    httpVersion_ += 10 * (rest.front() - '0');
     rest = rest.substr(1);
   }
 
   if (!rest.empty())
     return false;
 
-  // Get the HTTP headers
+  // Get the HTTP headers, one per line.
   //
-  out.headerNames_.clear();
-  out.headers_.clear();
-  for (;;) {
-    read_http_line(line, stream);
-    if (line.empty())
-      break;
+  headerNames_.clear();
+  headers_.clear();
+  standardHeaders_.clear();
+  while (!head.empty()) {
+    eol = head.find("\r\n");
+    line = head.substr(0, eol);
+    head.remove_prefix(eol == std::string_view::npos ? head.size() : eol + 2);
 
     std::size_t delim = line.find(": ");
-    if (delim == std::pmr::string::npos)
+    if (delim == std::string_view::npos)
       return false;
+    add_header(line.substr(0, delim), line.substr(delim + 2));
+  }
+  return true;
+}
 
-    http_request_header hdr;
-    if (from_chars(line.data(), line.data() + delim, hdr).ec == std::errc{}) {
-      out.standardHeaders_.insert({hdr, line.substr(delim + 2)});
-    } else {
-      out.headerNames_.push_back(line.substr(0, delim));
-      out.headers_.insert(
-          {std::string_view(out.headerNames_.back()), line.substr(delim + 2)});
-    }
+/**
+ * Sizes the body of a request for the announced length. Returns false if
+ * the length is malformed, above the limit or cannot be allocated.
+ */
+static bool
+make_body_room(const cppws::http_request &request,
+               std::pmr::vector<std::byte> &body, std::size_t maxSize,
+               std::size_t &length) {
+  body.clear();
+  if (!content_length(request, length) || length > maxSize)
+    return false;
+  try {
+    body.resize(length);
+  } catch (const std::bad_alloc &) {
+    return false;
+  } catch (const std::length_error &) {
+    return false;
   }
+  return true;
+}
 
-  // Get contents
-  //
-  out.data_.clear();
-  auto clen = out.standardHeaders_.find(http_request_header::ContentLength);
-  if (clen != out.standardHeaders_.end()) {
-    std::size_t length;
-    if (std::from_chars(clen->second.data(),
-                        clen->second.data() + clen->second.length(), length)
-            .ec != std::errc{})
-      return false;
-    out.data_.resize(length);
-    stream.read(reinterpret_cast<char *>(out.data_.data()), length);
+bool cppws::http_request::accept_body(http_request &out, std::istream &stream,
+                                      std::size_t maxSize) {
+  std::size_t length;
+  if (!make_body_room(out, out.data_, maxSize, length))
+    return false;
+  if (length > 0 &&
+      !stream.read(reinterpret_cast<char *>(out.data_.data()), length))
+    return false; // Truncated, e.g. cut off by a deadline
+  return true;
+}
+
+bool cppws::http_request::accept_body(http_request &out,
+                                      connection_buffer &input,
+                                      class socket &connection,
+                                      std::size_t maxSize) {
+  std::size_t length;
+  if (!make_body_room(out, out.data_, maxSize, length))
+    return false;
+
+  char *body = reinterpret_cast<char *>(out.data_.data());
+  std::size_t received = input.take({body, length});
+  try {
+    while (received < length) {
+      std::size_t n = connection.read(body + received, length - received);
+      if (n == 0)
+        return false; // Truncated, e.g. cut off by a deadline
+      received += n;
+    }
+  } catch (const std::system_error &) {
+    return false;
   }
   return true;
 }
+
+void cppws::http_request::set_target(std::string_view target) {
+  target_.assign(target);
+  requestUri_ = std::pmr::vector<std::pmr::string>{&buffer_};
+  for (auto rng : target | std::views::split('/')) {
+    if (rng.empty())
+      continue;
+    requestUri_.push_back(std::pmr::string(rng.begin(), rng.end(), &buffer_));
+  }
+}
+
+void cppws::http_request::assign(enum http_method method,
+                                 std::string_view target, int version) {
+  httpMethod_ = method;
+  httpVersion_ = version;
+  set_target(target);
+  headerNames_.clear();
+  headers_.clear();
+  standardHeaders_.clear();
+  data_.clear();
+}
+
+void cppws::http_request::add_header(std::string_view name,
+                                     std::string_view value) {
+  std::pmr::string *existing = http_header(name);
+  if (existing) {
+    existing->append(iequals(name, "Cookie") ? "; " : ", ");
+    existing->append(value);
+    return;
+  }
+
+  http_request_header hdr;
+  if (from_chars(name.data(), name.data() + name.size(), hdr).ec ==
+      std::errc{}) {
+    standardHeaders_.emplace(hdr, value);
+  } else {
+    headerNames_.emplace_back(name);
+    headers_.emplace(std::string_view(headerNames_.back()), value);
+  }
+}
+
+void cppws::http_request::append_body(std::string_view data) {
+  const auto *p = reinterpret_cast<const std::byte *>(data.data());
+  data_.insert(data_.end(), p, p + data.size());
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <cppws/event_loop.hpp>
+#include <cppws/inplace_function.hpp>
+#include <cppws/socket.hpp>
+#include <cppws/timer_wheel.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Settings of an acceptor.
+ */
+struct acceptor_options {
+  /** Connections handed to the handler at once. */
+  std::size_t batch_size = 64;
+  /**
+   * Time the listener is left alone after accepting failed, e.g. because
+   * the process ran out of file descriptors, before it is tried again.
+   */
+  std::chrono::milliseconds retry_delay{100};
+  /**
+   * Whether the connections are non-blocking, for handlers that serve them
+   * on an event loop like http2_connection. Blocking connections suit
+   * handlers that read with blocking calls, like processor_pool.
+   */
+  bool non_blocking = false;
+};
+
+/**
+ * \brief Accepts the connections of a listening socket on an event loop.
+ *
+ * Whenever the listener is readable, the acceptor drains its backlog with
+ * socket::accept_some() and passes the connections to the handler in
+ * batches, rather than waking up once per connection. A storm of
+ * connections thus costs one wakeup and one handler call per batch, e.g.
+ * one lock of the queue of a processor_pool:
+ *
+ * \code
+ * processor_pool pool{mapper, 8};
+ * acceptor accept{loop, listener, [&](std::span<socket> connections) {
+ *   pool.post(connections);
+ * }};
+ * \endcode
+ *
+ * Connections are blocking unless acceptor_options::non_blocking is set;
+ * those the handler does not move away are closed when it returns.
+ * Connections that fail while pending are skipped. If accepting fails
+ * otherwise, e.g. because the process runs out of file descriptors, the
+ * pending connections stay in the backlog and the listener is not watched
+ * for a while, so that the loop neither spins on it nor stops.
+ *
+ * Acceptors are created and destroyed on the loop thread, or before the
+ * loop runs.
+ */
+class acceptor {
+public:
+  /**
+   * \brief Handler of a batch of accepted connections.
+   */
+  using handler = inplace_function<void(std::span<socket> connections)>;
+
+  /**
+   * \brief Starts accepting connections.
+   *
+   * \param loop Loop the listener is watched on.
+   * \param listener Listening socket, switched to non-blocking mode. It
+   * has to outlive the acceptor.
+   * \param fn Handler of the accepted connections, run on the loop thread.
+   * \param options Settings of the acceptor.
+   */
+  acceptor(event_loop &loop, class socket &listener, handler fn,
+           const acceptor_options &options = {});
+  ~acceptor() noexcept;
+
+  acceptor(const acceptor &) = delete;
+  acceptor &operator=(const acceptor &) = delete;
+
+  /**
+   * \brief Gets the number of connections accepted so far.
+   */
+  std::uint64_t accepted() const noexcept { return accepted_; }
+
+  /**
+   * \brief Gets the number of batches handed to the handler so far.
+   */
+  std::uint64_t batches() const noexcept { return batches_; }
+
+private:
+  void drain();
+  void pause();
+
+  event_loop *loop_;
+  class socket *listener_;
+  handler handler_;
+  std::vector<class socket> batch_;
+  std::chrono::milliseconds retryDelay_;
+  bool nonBlocking_;
+  timer_wheel::timer retry_;
+  std::uint64_t accepted_ = 0;
+  std::uint64_t batches_ = 0;
+};
+
+} // namespace cppws
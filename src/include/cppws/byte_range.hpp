@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace cppws {
+
+/**
+ * \brief Inclusive range of bytes of a representation, as in
+ * "Content-Range: bytes first-last/size".
+ */
+struct byte_range {
+  std::uint64_t first;
+  std::uint64_t last;
+
+  constexpr std::uint64_t length() const noexcept { return last - first + 1; }
+
+  constexpr bool operator==(const byte_range &) const noexcept = default;
+};
+
+/**
+ * \brief Outcome of parsing a Range header.
+ */
+enum class range_result {
+  /** The header is absent, malformed or not worth honoring: send it all. */
+  Ignore,
+  /** At least one range overlaps the representation: answer 206. */
+  Satisfiable,
+  /** No range overlaps the representation: answer 416. */
+  Unsatisfiable
+};
+
+/**
+ * \brief Maximum number of ranges honored in a single request. Requests for
+ * more ranges are answered with the full representation.
+ */
+inline constexpr std::size_t max_byte_ranges = 16;
+
+/**
+ * \brief Parses the value of a Range header against a representation of the
+ * given size.
+ *
+ * Ranges are clamped to the representation, sorted, and overlapping or
+ * adjacent ranges are coalesced, so the result never asks for a byte twice.
+ *
+ * \param value Value of the Range header, e.g. "bytes=0-499,-500".
+ * \param size Size of the representation in bytes.
+ * \param out Receives the satisfiable ranges.
+ */
+range_result parse_byte_ranges(std::string_view value, std::uint64_t size,
+                               std::pmr::vector<byte_range> &out);
+
+} // namespace cppws
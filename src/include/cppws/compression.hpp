@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+namespace cppws {
+
+/**
+ * \brief Content codings that responses can be encoded with. Only gzip and
+ * deflate are produced on the fly; the others are served from precompressed
+ * files.
+ */
+enum class content_coding { Identity, Gzip, Deflate, Brotli, Zstd };
+
+constexpr std::string_view to_string(content_coding coding) noexcept {
+  switch (coding) {
+  case content_coding::Gzip:
+    return "gzip";
+  case content_coding::Deflate:
+    return "deflate";
+  case content_coding::Brotli:
+    return "br";
+  case content_coding::Zstd:
+    return "zstd";
+  default:
+    return "identity";
+  }
+}
+
+/**
+ * \brief Set of content codings, as a bit mask of coding_bit() values.
+ */
+using content_coding_set = unsigned;
+
+constexpr content_coding_set coding_bit(content_coding coding) noexcept {
+  return 1u << static_cast<unsigned>(coding);
+}
+
+/**
+ * \brief Codings that compressor can produce.
+ */
+inline constexpr content_coding_set dynamic_codings =
+    coding_bit(content_coding::Gzip) | coding_bit(content_coding::Deflate);
+
+/**
+ * \brief Selects the preferred available coding from an Accept-Encoding
+ * header value, honoring q-values. Ties are broken in favor of br, then zstd,
+ * then gzip, then deflate.
+ *
+ * \param acceptEncoding Value of the Accept-Encoding header.
+ * \param available Codings the response is available in.
+ * \return The selected coding, or content_coding::Identity.
+ */
+content_coding
+negotiate_encoding(std::string_view acceptEncoding,
+                   content_coding_set available = dynamic_codings) noexcept;
+
+/**
+ * \brief True if bodies of the given content type are worth compressing.
+ * Media types that are already compressed (images, archives, ...) are not.
+ */
+bool is_compressible(std::string_view contentType) noexcept;
+
+/**
+ * \brief Settings of the response compression stage.
+ */
+struct compression_options {
+  /** Bodies smaller than this are sent uncompressed. */
+  std::size_t min_size = 1024;
+  /** Level used while the workers have CPU to spare. */
+  int max_level = 6;
+  /** Level used while the workers are saturated. */
+  int min_level = 1;
+};
+
+/**
+ * \brief Chooses a compression level based on how busy the process is.
+ *
+ * Process CPU time is sampled at most every 250ms. Below 50% utilization of
+ * the available cores max_level is used; from there the level drops linearly
+ * to reach min_level at 90% utilization.
+ */
+class compression_governor {
+public:
+  explicit compression_governor(const compression_options &options = {});
+
+  /**
+   * \brief Gets the compression level to use right now.
+   */
+  int level() noexcept;
+
+  /**
+   * \brief Gets the options the governor was created with.
+   */
+  const compression_options &options() const noexcept { return options_; }
+
+  /**
+   * \brief Gets the governor shared by all request processors.
+   */
+  static compression_governor &global();
+
+private:
+  void sample(std::int64_t now) noexcept;
+
+  compression_options options_;
+  std::atomic<int> level_;
+  std::atomic<std::int64_t> nextSample_{0};
+  std::atomic_flag sampling_ = ATOMIC_FLAG_INIT;
+  std::int64_t lastWall_ = 0;
+  std::int64_t lastCpu_ = 0;
+};
+
+/**
+ * \brief Compresses response bodies with gzip or deflate.
+ *
+ * The compression state is kept between calls and reset rather than
+ * reallocated, so a compressor should be owned by a connection or processor
+ * and reused for every response.
+ */
+class compressor {
+public:
+  compressor();
+  ~compressor() noexcept;
+
+  compressor(const compressor &) = delete;
+  compressor &operator=(const compressor &) = delete;
+
+  /**
+   * \brief Compresses \p in, appending the encoded data to \p out chunk by
+   * chunk.
+   *
+   * \param coding Coding to use, gzip or deflate.
+   * \param level Compression level, 1 (fastest) to 9 (smallest).
+   * \param in Data to compress, of any size.
+   * \param out String the compressed data is appended to.
+   * \param maxSize Number of bytes the compressed data may take at most.
+   * \return False if compression was abandoned because the data would not
+   * fit in \p maxSize bytes; \p out then holds an incomplete stream.
+   */
+  bool compress(content_coding coding, int level, std::string_view in,
+                std::pmr::string &out,
+                std::size_t maxSize = std::numeric_limits<std::size_t>::max());
+
+private:
+  struct state;
+  std::unique_ptr<state> state_;
+};
+
+} // namespace cppws
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <ctime>
+#include <string_view>
+
+#include <cppws/http_request.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Validators describing the current representation of a resource.
+ */
+struct resource_validators {
+  /** Entity tag including the quotes (and W/ prefix if weak), or empty. */
+  std::string_view etag;
+  /** Last modification time, or -1 if unknown. */
+  std::time_t last_modified = -1;
+};
+
+/**
+ * \brief Outcome of evaluating the conditional headers of a request.
+ */
+enum class precondition_result {
+  /** Conditions hold (or there are none): generate the full response. */
+  Proceed,
+  /** The client's cached copy is current: answer 304 Not Modified. */
+  NotModified,
+  /** A precondition of a state changing request failed: answer 412. */
+  PreconditionFailed
+};
+
+/**
+ * \brief Compares two entity tags.
+ *
+ * \param a First entity tag.
+ * \param b Second entity tag.
+ * \param weak true to use the weak comparison function, which ignores the
+ * W/ prefix; false to use the strong one, under which weak tags never match.
+ */
+bool etag_equals(std::string_view a, std::string_view b, bool weak) noexcept;
+
+/**
+ * \brief Evaluates If-Match, If-Unmodified-Since, If-None-Match and
+ * If-Modified-Since in the order given by RFC 7232 section 6.
+ *
+ * The resource is assumed to exist, so "*" in If-Match and If-None-Match
+ * always matches.
+ *
+ * \param request Request carrying the conditional headers.
+ * \param validators Validators of the current representation.
+ */
+precondition_result
+evaluate_preconditions(const http_request &request,
+                       const resource_validators &validators) noexcept;
+
+} // namespace cppws
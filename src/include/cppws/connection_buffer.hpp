@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+
+namespace cppws {
+
+class socket;
+
+/**
+ * \brief Counters of all connection buffers of the process.
+ */
+struct connection_buffer_stats {
+  /** Times a buffer moved to a larger size class. */
+  std::uint64_t grows = 0;
+  /** Times unconsumed bytes were moved down to make room. */
+  std::uint64_t compactions = 0;
+  /** Times an idle buffer returned its storage to the pool. */
+  std::uint64_t releases = 0;
+  /** Bytes currently allocated by buffers. */
+  std::uint64_t allocated = 0;
+};
+
+/**
+ * \brief Input buffer of a connection.
+ *
+ * Bytes are read from the socket into the free space at the end of the
+ * buffer and committed, parsed in place through data(), and consumed from
+ * the front once the parser is done with them. Unlike a socket stream there
+ * is no virtual call or sentry per character: parsers see everything
+ * received so far as one contiguous span.
+ *
+ * Storage comes in power-of-two size classes, from MIN_SIZE up to the
+ * maximum size of the buffer. A buffer starts without storage and moves up
+ * a class whenever it runs out of room, or when a read filled all the space
+ * it was given, since more input is likely waiting then. Consumed space at
+ * the front is reclaimed first by moving the unconsumed bytes down, which
+ * is cheap since parsers consume all but the incomplete tail. Connections
+ * call release() when they go idle, so that idle connections hold no
+ * buffer at all.
+ */
+class connection_buffer {
+public:
+  /**
+   * \brief Smallest size class.
+   */
+  static constexpr std::size_t MIN_SIZE = 1024;
+
+  /**
+   * \brief Creates an empty buffer without storage.
+   *
+   * \param maxSize Maximum number of unconsumed bytes.
+   * \param resource Memory resource used to allocate the buffer.
+   */
+  explicit connection_buffer(std::size_t maxSize = 64 << 10,
+                             std::pmr::memory_resource *resource = pool())
+      : resource_(resource), maxSize_(maxSize) {}
+
+  ~connection_buffer() { deallocate(); }
+
+  connection_buffer(connection_buffer &&other) noexcept;
+  connection_buffer &operator=(connection_buffer &&other) noexcept;
+
+  /**
+   * \brief Gets the bytes received but not consumed yet.
+   */
+  std::span<char> data() noexcept {
+    return {storage_ + begin_, end_ - begin_};
+  }
+
+  /**
+   * \brief Gets the bytes received but not consumed yet.
+   */
+  std::span<const char> data() const noexcept {
+    return {storage_ + begin_, end_ - begin_};
+  }
+
+  /**
+   * \brief Gets the bytes received but not consumed yet, as text.
+   */
+  std::string_view view() const noexcept {
+    return {storage_ + begin_, end_ - begin_};
+  }
+
+  /**
+   * \brief Gets the number of bytes received but not consumed yet.
+   */
+  std::size_t size() const noexcept { return end_ - begin_; }
+
+  /**
+   * \brief True if no bytes are waiting to be consumed.
+   */
+  bool empty() const noexcept { return begin_ == end_; }
+
+  /**
+   * \brief True if no more bytes can be received before some are consumed.
+   */
+  bool full() const noexcept { return size() >= maxSize_; }
+
+  /**
+   * \brief Gets the maximum number of unconsumed bytes.
+   */
+  std::size_t max_size() const noexcept { return maxSize_; }
+
+  /**
+   * \brief True if the last read filled all the space it was given, so that
+   * more input is likely waiting.
+   */
+  bool filled() const noexcept { return filled_; }
+
+  /**
+   * \brief Gets the number of bytes allocated.
+   */
+  std::size_t capacity() const noexcept { return capacity_; }
+
+  /**
+   * \brief Gets free space at the end of the buffer to receive into.
+   *
+   * \param n Number of bytes wanted.
+   * \return Up to \p n bytes of free space, empty if the buffer is full.
+   */
+  std::span<char> prepare(std::size_t n);
+
+  /**
+   * \brief Appends \p n bytes received into the space from prepare().
+   */
+  void commit(std::size_t n) noexcept { end_ += n; }
+
+  /**
+   * \brief Drops the first \p n bytes, which the parser is done with.
+   */
+  void consume(std::size_t n) noexcept {
+    begin_ += n;
+    if (begin_ == end_)
+      begin_ = end_ = 0;
+  }
+
+  /**
+   * \brief Moves up to out.size() bytes to \p out.
+   *
+   * \return Number of bytes moved.
+   */
+  std::size_t take(std::span<char> out) noexcept;
+
+  /**
+   * \brief Receives what is available from a connection into the free
+   * space of the buffer, blocking until some bytes arrive.
+   *
+   * \param connection Connection to read from.
+   * \return Number of bytes received, 0 at the end of the stream.
+   * \throw std::length_error if the buffer is full.
+   * \throw std::system_error if the connection fails.
+   */
+  std::size_t read_some(class socket &connection);
+
+  /**
+   * \brief Receives what is available from a non-blocking connection into
+   * the free space of the buffer.
+   *
+   * \return Number of bytes received, 0 at the end of the stream, or -1 if
+   * no data is available right now.
+   * \throw std::length_error if the buffer is full.
+   * \throw std::system_error if the connection fails.
+   */
+  std::ptrdiff_t try_read_some(class socket &connection);
+
+  /**
+   * \brief Drops all bytes.
+   */
+  void clear() noexcept { begin_ = end_ = 0; }
+
+  /**
+   * \brief Returns the storage of an empty buffer to its memory resource,
+   * and starts over from the smallest size class.
+   *
+   * \return true if the buffer was empty.
+   */
+  bool release() noexcept;
+
+  /**
+   * \brief Gets the memory resource buffers allocate from by default, pooled
+   * by size class and shared by all threads.
+   */
+  static std::pmr::memory_resource *pool();
+
+  /**
+   * \brief Gets the counters of all buffers.
+   */
+  static connection_buffer_stats stats() noexcept;
+
+private:
+  std::span<char> read_space();
+  void reserve(std::size_t capacity);
+  void deallocate() noexcept;
+
+  std::pmr::memory_resource *resource_;
+  char *storage_ = nullptr;
+  std::size_t capacity_ = 0;
+  std::size_t begin_ = 0;
+  std::size_t end_ = 0;
+  std::size_t maxSize_;
+  bool filled_ = false;
+};
+
+} // namespace cppws
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <cppws/inplace_function.hpp>
+#include <cppws/timer_wheel.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Readiness based event loop over epoll.
+ *
+ * File descriptors are registered with a callback that is invoked on the
+ * loop thread whenever the descriptor is ready. Thousands of connections
+ * can be served by a single loop, without a thread per connection.
+ *
+ * Only post() and stop() may be called from other threads; everything else
+ * has to be called on the loop thread (or before the loop runs).
+ */
+class event_loop {
+public:
+  /**
+   * \brief Callback invoked with the ready events (EPOLLIN, EPOLLOUT, ...).
+   */
+  using callback = inplace_function<void(std::uint32_t events)>;
+
+  /**
+   * \brief Task posted to the loop.
+   */
+  using task = inplace_function<void()>;
+
+  /**
+   * \brief Creates the loop.
+   * \throw std::system_error if the epoll instance cannot be created.
+   */
+  event_loop();
+  ~event_loop() noexcept;
+
+  event_loop(const event_loop &) = delete;
+  event_loop &operator=(const event_loop &) = delete;
+
+  /**
+   * \brief Registers a file descriptor.
+   *
+   * \param fd Descriptor to watch. The loop does not take ownership.
+   * \param events Events to watch for (EPOLLIN, EPOLLOUT, ...).
+   * \param fn Callback invoked with the ready events.
+   */
+  void add(int fd, std::uint32_t events, callback fn);
+
+  /**
+   * \brief Changes the events a registered descriptor is watched for.
+   */
+  void modify(int fd, std::uint32_t events);
+
+  /**
+   * \brief Unregisters a descriptor. The callback is destroyed once the
+   * current batch of events has been dispatched, so a callback may remove
+   * its own descriptor.
+   */
+  void remove(int fd) noexcept;
+
+  /**
+   * \brief Runs a task on the loop thread. May be called from any thread.
+   */
+  void post(task fn);
+
+  /**
+   * \brief Runs the loop on the calling thread until stop() is called.
+   */
+  void run();
+
+  /**
+   * \brief Waits for events once and dispatches them.
+   *
+   * \param timeoutMs Maximum time to wait, or -1 to wait indefinitely.
+   */
+  void run_once(int timeoutMs);
+
+  /**
+   * \brief Makes run() return, or the next call to run() if the loop is not
+   * running. May be called from any thread.
+   */
+  void stop() noexcept;
+
+  /**
+   * \brief True if called from the thread running the loop.
+   */
+  bool in_loop_thread() const noexcept {
+    return owner_.load(std::memory_order_relaxed) == std::this_thread::get_id();
+  }
+
+  /**
+   * \brief Gets the number of registered descriptors.
+   */
+  std::size_t size() const noexcept { return watches_.size(); }
+
+  /**
+   * \brief Gets the timers of the loop. Their callbacks run on the loop
+   * thread, after the ready descriptors; the loop waits for events no
+   * longer than until the next timer may expire.
+   */
+  timer_wheel &timers() noexcept { return timers_; }
+
+private:
+  struct watch {
+    int fd;
+    callback fn;
+  };
+
+  void wake() noexcept;
+  void run_tasks();
+
+  int epollFd_ = -1;
+  int wakeFd_ = -1;
+  std::atomic_bool stopping_ = false;
+  std::atomic<std::thread::id> owner_;
+
+  timer_wheel timers_;
+  std::unordered_map<int, std::unique_ptr<watch>> watches_;
+  std::vector<std::unique_ptr<watch>> removed_;
+
+  std::mutex lock_;
+  std::vector<task> tasks_;
+  std::vector<task> runningTasks_;
+};
+
+} // namespace cppws
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+#include <cppws/http_response.hpp>
+#include <cppws/request_manager.hpp>
+
+namespace cppws {
+
+using namespace std::chrono_literals;
+
+/**
+ * \brief A filter inspects a request before it reaches its handler. It either
+ * lets the request through by returning nullptr, or rejects it by returning
+ * the response to send instead.
+ */
+template <typename F>
+concept request_filter = requires(const F &f, request_manager &m) {
+  { f(m) } -> std::convertible_to<const prebuilt_response *>;
+};
+
+/**
+ * \brief Handler wrapped in a statically composed chain of filters.
+ *
+ * The chain is built once when the route is registered. Filters are run in
+ * order for every request and the first one to reject the request
+ * short-circuits the chain; no allocation takes place per request.
+ *
+ * \tparam Handler Handler invoked if every filter lets the request through.
+ * \tparam Filters Filters run before the handler.
+ */
+template <typename Handler, request_filter... Filters> class pipeline {
+  std::tuple<Filters...> filters_;
+  Handler handler_;
+
+public:
+  pipeline(Handler handler, Filters... filters)
+      : filters_(std::move(filters)...), handler_(std::move(handler)) {}
+
+  void operator()(request_manager &manager) const {
+    const prebuilt_response *rejected = std::apply(
+        [&manager](const Filters &...filters) {
+          const prebuilt_response *r = nullptr;
+          ((r = filters(manager)) || ...);
+          return r;
+        },
+        filters_);
+
+    if (rejected)
+      manager.write(*rejected);
+    else
+      handler_(manager);
+  }
+};
+
+/**
+ * \brief Wraps a handler in a chain of filters.
+ *
+ * \param handler Handler invoked if the request passes all filters.
+ * \param filters Filters to run, in order, before the handler.
+ */
+template <typename Handler, typename... Filters>
+pipeline<std::decay_t<Handler>, std::decay_t<Filters>...>
+filtered(Handler &&handler, Filters &&...filters) {
+  return {std::forward<Handler>(handler), std::forward<Filters>(filters)...};
+}
+
+/**
+ * \brief Rejects requests that do not carry the expected bearer token in the
+ * Authorization header.
+ */
+class bearer_auth_filter {
+  std::string expected_;
+  prebuilt_response unauthorized_;
+
+public:
+  /**
+   * \param token Token that requests have to present.
+   * \param realm Realm reported in the WWW-Authenticate challenge.
+   */
+  explicit bearer_auth_filter(std::string_view token,
+                              std::string_view realm = "cppws");
+
+  const prebuilt_response *operator()(request_manager &manager) const;
+};
+
+/**
+ * \brief Handles cross-origin requests: answers preflight (OPTIONS) requests,
+ * rejects requests from origins that are not allowed and marks the responses
+ * to the others with Access-Control-Allow-Origin.
+ *
+ * Preflights reach a filtered handler only if it is mapped to OPTIONS; pass
+ * the filter to route_mapper::preflight() to answer them for every route.
+ */
+class cors_filter {
+  std::string origin_;
+  prebuilt_response preflight_;
+  prebuilt_response forbidden_;
+
+public:
+  /**
+   * \param origin Allowed origin, or "*" to allow any origin.
+   * \param methods Value of Access-Control-Allow-Methods.
+   * \param headers Value of Access-Control-Allow-Headers.
+   * \param maxAge How long clients may cache the preflight result.
+   */
+  explicit cors_filter(
+      std::string_view origin,
+      std::string_view methods = "GET, HEAD, POST, PUT, PATCH, DELETE",
+      std::string_view headers = "Content-Type, Authorization",
+      std::chrono::seconds maxAge = 600s);
+
+  const prebuilt_response *operator()(request_manager &manager) const;
+};
+
+/**
+ * \brief Limits the request rate of a route using the generic cell rate
+ * algorithm. The limiter state is a single atomic, so it can be shared
+ * between routes and worker threads without locking.
+ */
+class rate_limit_filter {
+  struct state {
+    std::atomic<std::int64_t> tat{0};
+  };
+
+  std::shared_ptr<state> state_;
+  std::shared_ptr<const prebuilt_response> limited_;
+  std::int64_t interval_;
+  std::int64_t tolerance_;
+
+public:
+  /**
+   * \param rate Number of requests allowed per second on average.
+   * \param burst Number of requests that may arrive at once.
+   * \throw std::invalid_argument if the rate is not positive.
+   */
+  explicit rate_limit_filter(double rate, std::uint32_t burst = 1);
+
+  const prebuilt_response *operator()(request_manager &manager) const;
+};
+
+} // namespace cppws
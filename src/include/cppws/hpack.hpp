@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <cppws/inplace_function.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Error raised when a header block cannot be decoded. HTTP/2
+ * connections treat it as a COMPRESSION_ERROR.
+ */
+class hpack_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * \brief Dynamic table of an HPACK context (RFC 7541 section 2.3.2), indexed
+ * together with the static table.
+ */
+class hpack_table {
+public:
+  /**
+   * \brief Number of entries of the static table.
+   */
+  static constexpr std::size_t static_size = 61;
+
+  explicit hpack_table(std::size_t maxSize) : maxSize_(maxSize) {}
+
+  /**
+   * \brief Looks up an entry by its HPACK index (1 based, static entries
+   * first).
+   *
+   * \return false if there is no such entry.
+   */
+  bool get(std::size_t index, std::string_view &name,
+           std::string_view &value) const noexcept;
+
+  /**
+   * \brief Finds an entry.
+   *
+   * \param name Name to look for.
+   * \param value Value to look for.
+   * \param[out] nameOnly true if only the name matched.
+   * \return The index of the entry, or 0 if even the name is unknown.
+   */
+  std::size_t find(std::string_view name, std::string_view value,
+                   bool &nameOnly) const noexcept;
+
+  /**
+   * \brief Adds an entry, evicting the oldest ones as needed.
+   */
+  void insert(std::string_view name, std::string_view value);
+
+  /**
+   * \brief Changes the maximum size of the table, evicting entries as needed.
+   */
+  void max_size(std::size_t size);
+
+  /**
+   * \brief Gets the maximum size of the table.
+   */
+  std::size_t max_size() const noexcept { return maxSize_; }
+
+  /**
+   * \brief Gets the size of the table, as defined by RFC 7541 section 4.1.
+   */
+  std::size_t size() const noexcept { return size_; }
+
+  /**
+   * \brief Gets the number of entries of the dynamic table.
+   */
+  std::size_t entries() const noexcept { return entries_.size(); }
+
+private:
+  struct entry {
+    std::string name;
+    std::string value;
+  };
+
+  void evict(std::size_t limit);
+
+  std::deque<entry> entries_;
+  std::size_t size_ = 0;
+  std::size_t maxSize_;
+};
+
+/**
+ * \brief Decodes HPACK header blocks (RFC 7541). One decoder is kept per
+ * connection, since blocks refer to the dynamic table built by earlier ones.
+ */
+class hpack_decoder {
+public:
+  /**
+   * \brief Callback invoked for every decoded field. The views are only valid
+   * during the call.
+   */
+  using field_callback =
+      inplace_function<void(std::string_view name, std::string_view value)>;
+
+  /**
+   * \param maxTableSize Table size limit announced to the encoder (the
+   * SETTINGS_HEADER_TABLE_SIZE of HTTP/2).
+   */
+  explicit hpack_decoder(std::size_t maxTableSize = 4096)
+      : table_(maxTableSize), limit_(maxTableSize) {}
+
+  /**
+   * \brief Decodes a complete header block.
+   *
+   * \param block Header block.
+   * \param fn Callback invoked for every field, in order.
+   * \throw hpack_error if the block is malformed.
+   */
+  void decode(std::string_view block, const field_callback &fn);
+
+  /**
+   * \brief Gets the dynamic table.
+   */
+  const hpack_table &table() const noexcept { return table_; }
+
+private:
+  hpack_table table_;
+  std::size_t limit_;
+  std::string name_;
+  std::string value_;
+};
+
+/**
+ * \brief Encodes HPACK header blocks (RFC 7541).
+ */
+class hpack_encoder {
+public:
+  /**
+   * \param maxTableSize Size of the dynamic table to use.
+   */
+  explicit hpack_encoder(std::size_t maxTableSize = 4096)
+      : table_(maxTableSize), limit_(maxTableSize) {}
+
+  /**
+   * \brief Appends a field to a header block.
+   *
+   * Fields in the static or dynamic table are sent as an index. Other fields
+   * are added to the dynamic table unless \p index is false, e.g. for values
+   * that are unlikely to repeat or are sensitive. Strings are Huffman coded
+   * when that makes them shorter.
+   *
+   * \param out Header block being built.
+   * \param name Name of the field, in lower case.
+   * \param value Value of the field.
+   * \param index false to keep the field out of the dynamic table.
+   */
+  void encode(std::string &out, std::string_view name, std::string_view value,
+              bool index = true);
+
+  /**
+   * \brief Applies a table size limit announced by the decoder. The change
+   * is signaled at the start of the next header block.
+   */
+  void max_table_size(std::size_t size);
+
+  /**
+   * \brief Gets the dynamic table.
+   */
+  const hpack_table &table() const noexcept { return table_; }
+
+private:
+  hpack_table table_;
+  std::size_t limit_;
+  std::size_t pendingSize_ = 0;
+  bool sizeUpdate_ = false;
+};
+
+/**
+ * \brief Appends the HPACK Huffman code of a string (RFC 7541 appendix B) to
+ * \p out.
+ */
+void hpack_huffman_encode(std::string &out, std::string_view in);
+
+/**
+ * \brief Gets the length of the Huffman code of a string, in bytes.
+ */
+std::size_t hpack_huffman_length(std::string_view in) noexcept;
+
+/**
+ * \brief Decodes a Huffman coded string and appends it to \p out.
+ *
+ * \throw hpack_error if the code is invalid.
+ */
+void hpack_huffman_decode(std::string &out, std::string_view in);
+
+} // namespace cppws
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <cppws/connection_buffer.hpp>
+#include <cppws/event_loop.hpp>
+#include <cppws/hpack.hpp>
+#include <cppws/http_request.hpp>
+#include <cppws/output_queue.hpp>
+#include <cppws/request_manager.hpp>
+#include <cppws/request_mapper.hpp>
+#include <cppws/response_buffer.hpp>
+#include <cppws/socket.hpp>
+#include <cppws/worker_pool.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Frame types of HTTP/2 (RFC 9113 section 6).
+ */
+enum class http2_frame_type : std::uint8_t {
+  Data = 0x0,
+  Headers = 0x1,
+  Priority = 0x2,
+  RstStream = 0x3,
+  Settings = 0x4,
+  PushPromise = 0x5,
+  Ping = 0x6,
+  Goaway = 0x7,
+  WindowUpdate = 0x8,
+  Continuation = 0x9
+};
+
+/**
+ * \brief Error codes of RST_STREAM and GOAWAY frames (RFC 9113 section 7).
+ */
+namespace http2_error {
+constexpr std::uint32_t NO_ERROR = 0x0;
+constexpr std::uint32_t PROTOCOL_ERROR = 0x1;
+constexpr std::uint32_t INTERNAL_ERROR = 0x2;
+constexpr std::uint32_t FLOW_CONTROL_ERROR = 0x3;
+constexpr std::uint32_t SETTINGS_TIMEOUT = 0x4;
+constexpr std::uint32_t STREAM_CLOSED = 0x5;
+constexpr std::uint32_t FRAME_SIZE_ERROR = 0x6;
+constexpr std::uint32_t REFUSED_STREAM = 0x7;
+constexpr std::uint32_t CANCEL = 0x8;
+constexpr std::uint32_t COMPRESSION_ERROR = 0x9;
+constexpr std::uint32_t CONNECT_ERROR = 0xa;
+constexpr std::uint32_t ENHANCE_YOUR_CALM = 0xb;
+constexpr std::uint32_t INADEQUATE_SECURITY = 0xc;
+constexpr std::uint32_t HTTP_1_1_REQUIRED = 0xd;
+} // namespace http2_error
+
+/**
+ * \brief Settings of HTTP/2 connections.
+ */
+struct http2_options {
+  /** Streams a client may have open at once. */
+  std::uint32_t max_concurrent_streams = 128;
+  /** Receive window of every stream, i.e. request body bytes in flight. */
+  std::uint32_t initial_window_size = 1 << 20;
+  /** Receive window of the connection, shared by all streams. */
+  std::uint32_t connection_window_size = 16 << 20;
+  /** Largest frame payload accepted. */
+  std::uint32_t max_frame_size = 1 << 14;
+  /** Size of the HPACK table used to decode request headers. */
+  std::uint32_t header_table_size = 4096;
+  /** Largest decoded header list of a request (RFC 9113 section 6.5.2). */
+  std::uint32_t max_header_list_size = 64 << 10;
+  /** Largest request body; larger requests are reset with CANCEL. */
+  std::size_t max_request_body = 16 << 20;
+  /**
+   * Time a connection without open streams may stay silent before it is
+   * closed with GOAWAY, or 0 to keep idle connections open.
+   */
+  std::chrono::milliseconds idle_timeout{60000};
+  /**
+   * Output queued for the client at which no more DATA frames are built, so
+   * that large responses are not copied into frames all at once.
+   */
+  std::size_t output_high_water = 256 << 10;
+  /** Output queued at which building DATA frames resumes. */
+  std::size_t output_low_water = 64 << 10;
+  /** Threads the handlers run on, or null for worker_pool::shared(). */
+  std::shared_ptr<worker_pool> workers = {};
+};
+
+/**
+ * \brief Server side of an HTTP/2 connection over cleartext TCP (h2c).
+ *
+ * Connections are served by an event loop. Any number of requests may be in
+ * flight on one connection: every stream is assembled into an http_request
+ * and dispatched to a request_mapper once complete, and the responses are
+ * interleaved frame by frame within the flow control windows granted by the
+ * client. Handlers run on a worker_pool, so that a slow handler does not
+ * hold up the other connections of the loop, and build their responses
+ * with a request_manager as usual; protocol upgrades (detach()) are not
+ * available on HTTP/2 streams. Frames are built on the loop thread straight
+ * from the response_buffer of the stream: file slices are read a frame at a
+ * time as the windows allow, never into memory as a whole.
+ *
+ * Connections are either started with prior knowledge, when the client is
+ * known to speak HTTP/2 (accept()), or upgraded from an HTTP/1.1 request
+ * carrying "Upgrade: h2c" (upgrade(), or h2c_upgrade_mapper).
+ */
+class http2_connection
+    : public std::enable_shared_from_this<http2_connection> {
+  struct private_tag {};
+
+public:
+  /**
+   * \brief Serves a connection whose client starts with the HTTP/2 preface.
+   *
+   * \param connection Connection to serve.
+   * \param loop Event loop that will serve the connection.
+   * \param mapper Mapper resolving the handlers of requests.
+   * \param options Settings of the connection.
+   * \return The connection.
+   */
+  static std::shared_ptr<http2_connection>
+  accept(class socket &&connection, event_loop &loop,
+         std::shared_ptr<request_mapper> mapper,
+         const http2_options &options = {});
+
+  /**
+   * \brief Upgrades an HTTP/1.1 request to HTTP/2 (RFC 7540 section 3.2).
+   *
+   * The request must be a valid upgrade request, see is_h2c_upgrade(). The
+   * server answers 101 Switching Protocols and the request becomes stream 1
+   * of the new connection. Its handler is run right away, on the calling
+   * thread; the response is sent once the loop serves the connection.
+   *
+   * \param manager Context of the upgrade request.
+   * \param loop Event loop that will serve the connection.
+   * \param mapper Mapper resolving the handlers of requests, including the
+   * upgrade request itself.
+   * \param options Settings of the connection.
+   * \return The connection, or nullptr if the request cannot be upgraded
+   * (nothing has been sent then).
+   */
+  static std::shared_ptr<http2_connection>
+  upgrade(request_manager &manager, event_loop &loop,
+          std::shared_ptr<request_mapper> mapper,
+          const http2_options &options = {});
+
+  http2_connection(private_tag, class socket &&connection, event_loop &loop,
+                   std::shared_ptr<request_mapper> mapper,
+                   const http2_options &options);
+
+  /**
+   * \brief Closes the connection gracefully: no new streams are accepted
+   * and the connection is closed once the open ones are done. May be called
+   * from any thread.
+   */
+  void close();
+
+  /**
+   * \brief Gets the number of open streams. Only meaningful on the loop
+   * thread.
+   */
+  std::size_t streams() const noexcept { return streams_.size(); }
+
+  /**
+   * \brief Gets the event loop serving the connection.
+   */
+  event_loop &loop() noexcept { return *loop_; }
+
+private:
+  /**
+   * The handler of a stream fills in the response on a worker thread; the
+   * loop thread only looks at it once the handler returned.
+   */
+  struct stream final : response_sink {
+    explicit stream(std::uint32_t id)
+        : id(id), request(std::pmr::get_default_resource(), 1024) {}
+    ~stream() override;
+
+    void write_response(response_buffer &response, bool includeBody) override;
+    void write_response(std::string_view response) override;
+
+    std::uint32_t id;
+    http_request request;
+    std::int64_t sendWindow = 0;
+    std::int64_t recvWindow = 0;
+    std::int64_t expectedLength = -1;
+    std::size_t received = 0;
+    bool remoteClosed = false;
+    bool responded = false;
+
+    response_buffer response;
+    std::string serialized;
+    bool answered = false;
+    std::vector<response_buffer::body_part> parts;
+    std::size_t part = 0;
+    std::uint64_t partSent = 0;
+    std::uint64_t remaining = 0;
+  };
+
+  void start();
+  void on_event(std::uint32_t events);
+  bool process_input();
+  bool process_frame(http2_frame_type type, std::uint8_t flags,
+                     std::uint32_t id, std::string_view payload);
+  bool on_headers(std::uint8_t flags, std::uint32_t id,
+                  std::string_view payload);
+  bool on_header_block(std::uint32_t id, bool endStream);
+  bool on_data(std::uint8_t flags, std::uint32_t id, std::string_view payload);
+  bool on_settings(std::uint8_t flags, std::uint32_t id,
+                   std::string_view payload);
+  bool apply_settings(std::string_view payload);
+  bool on_window_update(std::uint32_t id, std::string_view payload);
+  void dispatch(std::shared_ptr<stream> s);
+  void respond(stream &s);
+  bool encode_head(stream &s, std::string &block);
+  std::size_t append_data(stream &s, std::size_t n);
+  void reset_stream(std::uint32_t id, std::uint32_t code);
+  bool connection_error(std::uint32_t code);
+  void append_frame(http2_frame_type type, std::uint8_t flags,
+                    std::uint32_t id, std::string_view payload);
+  void append_settings();
+  bool write_data();
+  void flush();
+  void shutdown();
+  void watch_idle();
+
+  class socket socket_;
+  event_loop *loop_;
+  std::shared_ptr<request_mapper> mapper_;
+  http2_options options_;
+
+  std::shared_ptr<worker_pool> workers_;
+
+  hpack_decoder decoder_;
+  hpack_encoder encoder_;
+  std::string frame_;
+
+  std::unordered_map<std::uint32_t, std::shared_ptr<stream>> streams_;
+  std::uint32_t lastStreamId_ = 0;
+  std::uint32_t continuationId_ = 0;
+  bool continuationEnd_ = false;
+  std::string headerBlock_;
+
+  std::uint32_t peerMaxFrameSize_ = 1 << 14;
+  std::int64_t peerInitialWindow_ = 65535;
+  std::int64_t sendWindow_ = 65535;
+  std::int64_t recvWindow_ = 65535;
+  std::int64_t recvUnacked_ = 0;
+
+  connection_buffer input_;
+  bool prefaceReceived_ = false;
+  bool settingsReceived_ = false;
+  bool started_ = false;
+  std::string pending_;
+  output_queue output_{~std::size_t(0)};
+  bool pollingOutput_ = false;
+  bool goingAway_ = false;
+  bool closeAfterFlush_ = false;
+  bool closed_ = false;
+  timer_wheel::timer idleTimer_;
+};
+
+/**
+ * \brief True if a request asks to upgrade the connection to h2c, i.e. has
+ * "Upgrade: h2c", "Connection: Upgrade, HTTP2-Settings" and a single
+ * HTTP2-Settings header.
+ */
+bool is_h2c_upgrade(const http_request &request);
+
+/**
+ * \brief request_mapper that upgrades h2c upgrade requests to HTTP/2 and
+ * resolves every other request, as well as the requests of the upgraded
+ * connections, with another mapper.
+ */
+class h2c_upgrade_mapper : public request_mapper {
+public:
+  /**
+   * \param mapper Mapper resolving the handlers of requests.
+   * \param loop Event loop serving upgraded connections.
+   * \param options Settings of upgraded connections.
+   */
+  h2c_upgrade_mapper(std::shared_ptr<request_mapper> mapper, event_loop &loop,
+                     const http2_options &options = {});
+
+  const handler *resolve(const http_request &request) override;
+
+private:
+  std::shared_ptr<request_mapper> mapper_;
+  event_loop *loop_;
+  http2_options options_;
+  handler upgrade_;
+};
+
+} // namespace cppws
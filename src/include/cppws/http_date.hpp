@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <ctime>
+#include <string_view>
+
+namespace cppws {
+
+/**
+ * \brief Length of an IMF-fixdate timestamp, e.g.
+ * "Sun, 06 Nov 1994 08:49:37 GMT".
+ */
+constexpr std::size_t http_date_length = 29;
+
+/**
+ * \brief Formats a point in time as an IMF-fixdate timestamp (RFC 7231).
+ *
+ * \param out Output buffer, must have room for http_date_length characters.
+ * \param t Point in time to format.
+ * \return Pointer past the last character written.
+ */
+char *format_http_date(char *out, std::time_t t) noexcept;
+
+/**
+ * \brief Parses an HTTP date. IMF-fixdate is the only format servers
+ * generate, but the obsolete RFC 850 and asctime formats are accepted too.
+ *
+ * \param str Date to parse.
+ * \param[out] out Receives the parsed point in time.
+ * \return true if the date could be parsed.
+ */
+bool parse_http_date(std::string_view str, std::time_t &out) noexcept;
+
+/**
+ * \brief Preformatted "Date: ...\r\n" header line shared by all responses.
+ *
+ * The line is reformatted at most once per second by whichever thread first
+ * notices that the second has changed. Readers copy it under a sequence lock,
+ * so the common path is a clock read and a 40 byte copy.
+ */
+class http_date_cache {
+public:
+  /**
+   * \brief Length of the header line, including the trailing CRLF.
+   */
+  static constexpr std::size_t line_length = 6 + http_date_length + 2;
+
+  /**
+   * \brief Copies the current Date header line.
+   *
+   * \param out Output buffer, must have room for line_length characters.
+   * \return Pointer past the last character written.
+   */
+  static char *copy(char *out) noexcept;
+};
+
+/**
+ * \brief Server header line emitted with every response.
+ */
+inline constexpr std::string_view server_header_line = "Server: cppws\r\n";
+
+} // namespace cppws
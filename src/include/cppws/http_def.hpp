@@ -27,10 +27,11 @@ enum class http_content_type {
   VideoMp4,
   MultipartFormData,
   MultipartMixed,
+  TextEventStream,
   Unknown
 };
 
-inline std::string_view to_string(http_content_type ct) {
+constexpr std::string_view to_string(http_content_type ct) {
   switch (ct) {
   case http_content_type::TextPlain:
     return "text/plain";
@@ -68,6 +69,8 @@ inline std::string_view to_string(http_content_type ct) {
     return "multipart/form-data";
   case http_content_type::MultipartMixed:
     return "multipart/mixed";
+  case http_content_type::TextEventStream:
+    return "text/event-stream";
   default:
     return "unknown";
   }
@@ -90,6 +93,18 @@ inline bool iequals_sv(const char *first, const char *last,
   return iequals_n(first, sv.data(), len);
 }
 
+/**
+ * \brief Strips optional whitespace (spaces and tabs) from both ends of a
+ * header value element.
+ */
+constexpr std::string_view trim_ows(std::string_view v) noexcept {
+  while (!v.empty() && (v.front() == ' ' || v.front() == '\t'))
+    v.remove_prefix(1);
+  while (!v.empty() && (v.back() == ' ' || v.back() == '\t'))
+    v.remove_suffix(1);
+  return v;
+}
+
 inline std::from_chars_result from_chars(const char *first, const char *last,
                                          http_content_type &value) {
   // We'll try matching known content-types, case-insensitive, full match only
@@ -120,6 +135,7 @@ inline std::from_chars_result from_chars(const char *first, const char *last,
       {http_content_type::VideoMp4, "video/mp4"},
       {http_content_type::MultipartFormData, "multipart/form-data"},
       {http_content_type::MultipartMixed, "multipart/mixed"},
+      {http_content_type::TextEventStream, "text/event-stream"},
   };
 
   for (const auto &entry : table) {
@@ -133,4 +149,43 @@ inline std::from_chars_result from_chars(const char *first, const char *last,
   return {first, std::errc::invalid_argument};
 }
 
+/**
+ * \brief Maps a file name extension (without the dot) to a content type.
+ *
+ * \return The content type, or ApplicationOctetStream for unknown extensions.
+ */
+inline http_content_type content_type_for_extension(std::string_view ext) {
+  struct extension_entry {
+    std::string_view ext;
+    http_content_type type;
+  };
+
+  constexpr extension_entry table[] = {
+      {"html", http_content_type::TextHtml},
+      {"htm", http_content_type::TextHtml},
+      {"css", http_content_type::TextCss},
+      {"js", http_content_type::TextJavascript},
+      {"mjs", http_content_type::TextJavascript},
+      {"json", http_content_type::ApplicationJson},
+      {"txt", http_content_type::TextPlain},
+      {"xml", http_content_type::ApplicationXml},
+      {"svg", http_content_type::ImageSvgXml},
+      {"png", http_content_type::ImagePng},
+      {"jpg", http_content_type::ImageJpeg},
+      {"jpeg", http_content_type::ImageJpeg},
+      {"gif", http_content_type::ImageGif},
+      {"pdf", http_content_type::ApplicationPdf},
+      {"zip", http_content_type::ApplicationZip},
+      {"gz", http_content_type::ApplicationGzip},
+      {"mp3", http_content_type::AudioMpeg},
+      {"mp4", http_content_type::VideoMp4},
+  };
+
+  for (const auto &entry : table) {
+    if (iequals_sv(ext.data(), ext.data() + ext.size(), entry.ext))
+      return entry.type;
+  }
+  return http_content_type::ApplicationOctetStream;
+}
+
 } // namespace cppws
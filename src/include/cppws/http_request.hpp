@@ -1,14 +1,20 @@
 #pragma once
 
+#include <deque>
 #include <iostream>
+#include <limits>
 #include <memory_resource>
 #include <string>
 #include <unordered_map>
 
+#include <cppws/http_def.hpp>
 #include <cppws/url.hpp>
 
 namespace cppws {
 
+class connection_buffer;
+class socket;
+
 /**
  * Enumerates all available http methods.
  */
@@ -364,6 +370,83 @@ public:
    */
   static bool accept(http_request &out, std::istream &stream);
 
+  /**
+   * \brief Reads in the request line and headers of a new HTTP request, the
+   * first half of accept().
+   *
+   * \param[out] out Variable that receives the parsed request.
+   * \param[inout] stream Stream to parse the request from.
+   * \return true if the request line and headers could be parsed.
+   */
+  static bool accept_head(http_request &out, std::istream &stream);
+
+  /**
+   * \brief Reads in the body of a request whose head was read with
+   * accept_head(), the second half of accept().
+   *
+   * \param[inout] out Request to read the body of.
+   * \param[inout] stream Stream to read the body from.
+   * \param maxSize Largest body accepted.
+   * \return true if the body could be read, false if it is larger than
+   * \p maxSize or was cut off.
+   */
+  static bool
+  accept_body(http_request &out, std::istream &stream,
+              std::size_t maxSize = std::numeric_limits<std::size_t>::max());
+
+  /**
+   * \brief Reads in the request line and headers of a new HTTP request from
+   * a connection, parsing them in place in its input buffer.
+   *
+   * \param[out] out Variable that receives the parsed request.
+   * \param[inout] input Input buffer of the connection. The head is consumed;
+   * bytes received past it stay in the buffer.
+   * \param connection Connection to receive more input from.
+   * \return true if the request line and headers could be parsed, false if
+   * they are malformed, do not fit the buffer, or the connection ended or
+   * failed first.
+   */
+  static bool accept_head(http_request &out, connection_buffer &input,
+                          class socket &connection);
+
+  /**
+   * \brief Reads in the body of a request whose head was read with
+   * accept_head(). The body is taken from the input buffer as far as it was
+   * received already, and the rest is read straight into the request.
+   *
+   * \param[inout] out Request to read the body of.
+   * \param[inout] input Input buffer of the connection.
+   * \param connection Connection to receive the rest of the body from.
+   * \param maxSize Largest body accepted.
+   * \return true if the body could be read, false if it is larger than
+   * \p maxSize, cannot be allocated or was cut off.
+   */
+  static bool
+  accept_body(http_request &out, connection_buffer &input,
+              class socket &connection,
+              std::size_t maxSize = std::numeric_limits<std::size_t>::max());
+
+  /**
+   * \brief Replaces the request with an empty one, for transports that do not
+   * read requests in HTTP/1.x syntax (e.g. HTTP/2 streams).
+   *
+   * \param method HTTP method of the request.
+   * \param target Request target, e.g. "/users?id=4".
+   * \param version HTTP version, see http_version().
+   */
+  void assign(enum http_method method, std::string_view target, int version);
+
+  /**
+   * \brief Adds a header to the request. Repeated headers are combined into
+   * a comma separated list ("; " separated for Cookie).
+   */
+  void add_header(std::string_view name, std::string_view value);
+
+  /**
+   * \brief Appends data to the request body.
+   */
+  void append_body(std::string_view data);
+
   /**
    * \brief HTTP method of the request.
    */
@@ -376,6 +459,11 @@ public:
    */
   int http_version() const noexcept { return httpVersion_; }
 
+  /**
+   * \brief Gets the request target as received, e.g. "/users/?id=4".
+   */
+  std::string_view target() const noexcept { return target_; }
+
   /**
    * \brief Gets the resource URI referenced by the request.
    */
@@ -430,21 +518,78 @@ public:
   }
   /** \} */
 
+  /**
+   * \brief Invokes \p fn with the name and value of every header of the
+   * request, in no particular order.
+   */
+  template <typename F> void for_each_header(F &&fn) const {
+    for (const auto &[name, value] : standardHeaders_)
+      fn(to_string(name), std::string_view(value));
+    for (const auto &[name, value] : headers_)
+      fn(name, std::string_view(value));
+  }
+
 private:
+  void set_target(std::string_view target);
+  bool parse_head(std::string_view head);
+
+  /**
+   * Hash and equality of header names, which are case-insensitive.
+   */
+  struct header_name_hash {
+    std::size_t operator()(std::string_view name) const noexcept {
+      std::size_t h = 14695981039346656037ull;
+      for (unsigned char c : name)
+        h = (h ^ (c | 0x20)) * 1099511628211ull;
+      return h;
+    }
+  };
+
+  struct header_name_equal {
+    bool operator()(std::string_view a, std::string_view b) const noexcept {
+      return iequals(a, b);
+    }
+  };
+
   std::pmr::monotonic_buffer_resource buffer_;
 
   enum http_method httpMethod_ = http_method::GET;
   int httpVersion_ = 110;
 
+  std::pmr::string target_{&buffer_};
   std::pmr::vector<std::pmr::string> requestUri_{&buffer_};
 
-  std::pmr::vector<std::pmr::string> headerNames_{&buffer_};
-  std::pmr::unordered_map<std::string_view, std::pmr::string> headers_{
-      &buffer_};
+  std::pmr::deque<std::pmr::string> headerNames_{&buffer_};
+  std::pmr::unordered_map<std::string_view, std::pmr::string,
+                          header_name_hash, header_name_equal>
+      headers_{&buffer_};
   std::pmr::unordered_map<http_request_header, std::pmr::string>
       standardHeaders_{&buffer_};
 
   std::pmr::vector<std::byte> data_{&buffer_};
 };
 
+/**
+ * \brief True if a comma separated header value contains a token, compared
+ * case-insensitively.
+ *
+ * \param value Header value, or nullptr if the header is missing.
+ * \param token Token to look for.
+ */
+inline bool has_token(const std::pmr::string *value,
+                      std::string_view token) noexcept {
+  if (!value)
+    return false;
+  std::string_view list = *value;
+  while (!list.empty()) {
+    std::size_t comma = list.find(',');
+    if (iequals(trim_ows(list.substr(0, comma)), token))
+      return true;
+    if (comma == std::string_view::npos)
+      break;
+    list.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
 } // namespace cppws
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <array>
 #include <cctype>
 #include <charconv>
+#include <cstdint>
 #include <iostream>
+#include <span>
 #include <string_view>
 #include <system_error>
+#include <utility>
 
+#include <cppws/http_date.hpp>
 #include <cppws/http_def.hpp>
 #include <cppws/http_request.hpp>
 
@@ -259,35 +264,114 @@ struct http_body {
   std::span<const std::byte> content;
 };
 
-constexpr std::ostream &operator<<(std::ostream &stream,
-                                   const http_resonse_line &line) {
+/**
+ * \brief Fixed capacity character buffer that can be filled in at compile
+ * time. Holds pre-serialized fragments of responses.
+ */
+template <std::size_t N> struct http_blob {
+  char data[N] = {};
+  std::size_t size = 0;
+
+  constexpr void append(std::string_view str) {
+    for (char c : str)
+      data[size++] = c;
+  }
 
-  stream << "HTTP/" << (line.http_version / 100);
-  if (line.http_version % 100 != 0)
-    stream << '.' << ((line.http_version % 100) / 10);
+  constexpr std::string_view view() const noexcept { return {data, size}; }
+};
 
-  stream << ' ' << line.status_code;
-  stream << ' ' << line.reason << "\r\n";
-  return stream;
+/**
+ * \brief Writes the decimal representation of \p value using a two digit
+ * lookup table.
+ *
+ * \param out Output buffer, must have room for at least 20 characters.
+ * \param value Value to write.
+ * \return Pointer past the last character written.
+ */
+constexpr char *format_decimal(char *out, std::uint64_t value) noexcept {
+  constexpr std::string_view digits =
+      "0001020304050607080910111213141516171819"
+      "2021222324252627282930313233343536373839"
+      "4041424344454647484950515253545556575859"
+      "6061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+
+  char tmp[20];
+  char *p = tmp + sizeof tmp;
+  while (value >= 100) {
+    std::size_t i = (value % 100) * 2;
+    value /= 100;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  }
+  if (value >= 10) {
+    std::size_t i = value * 2;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  } else {
+    *--p = static_cast<char>('0' + value);
+  }
+
+  while (p != tmp + sizeof tmp)
+    *out++ = *p++;
+  return out;
 }
 
-constexpr std::ostream &operator<<(std::ostream &stream,
-                                   const http_header_line &line) {
-  return stream << line.header << ": " << line.value << "\r\n";
+/**
+ * \brief Serializes a status line, including the trailing CRLF.
+ */
+constexpr http_blob<64> make_status_line(const http_resonse_line &line) {
+  http_blob<64> blob;
+  blob.append("HTTP/");
+  blob.data[blob.size++] = static_cast<char>('0' + line.http_version / 100);
+  if (line.http_version % 100 != 0) {
+    blob.data[blob.size++] = '.';
+    blob.data[blob.size++] =
+        static_cast<char>('0' + (line.http_version % 100) / 10);
+  }
+  blob.data[blob.size++] = ' ';
+  blob.size =
+      format_decimal(blob.data + blob.size, line.status_code) - blob.data;
+  blob.data[blob.size++] = ' ';
+  blob.append(line.reason);
+  blob.append("\r\n");
+  return blob;
 }
 
-constexpr std::ostream &operator<<(std::ostream &stream,
-                                   const http_body &body) {
-  std::string len = std::to_string(body.content.size());
-  stream << http_header_line("Content-Length", len)
-         << http_header_line("Content-Type", body.content_type) << "\r\n";
-  stream.write(reinterpret_cast<const char *>(body.content.data()),
-               body.content.size());
-  return stream;
+namespace detail {
+
+template <std::size_t... I>
+constexpr auto make_header_prefixes(std::index_sequence<I...>) {
+  const auto prefix = [](http_response_header header) {
+    http_blob<32> blob;
+    blob.append(to_string(header));
+    blob.append(": ");
+    return blob;
+  };
+  return std::array<http_blob<32>, sizeof...(I)>{
+      prefix(static_cast<http_response_header>(I))...};
+}
+
+inline constexpr auto header_prefixes = make_header_prefixes(
+    std::make_index_sequence<
+        static_cast<std::size_t>(http_response_header::Unknown)>());
+
+} // namespace detail
+
+/**
+ * \brief Gets the pre-serialized "Name: " prefix of a standard header line.
+ */
+constexpr std::string_view header_prefix(http_response_header header) noexcept {
+  std::size_t i = static_cast<std::size_t>(header);
+  return i < detail::header_prefixes.size() ? detail::header_prefixes[i].view()
+                                            : std::string_view();
 }
 
 namespace http {
 
+constexpr http_resonse_line SWITCHING_PROTOCOLS = {
+    .http_version = 110, .status_code = 101, .reason = "Switching Protocols"};
+
 constexpr http_resonse_line OK = {
     .http_version = 110, .status_code = 200, .reason = "OK"};
 
@@ -300,6 +384,9 @@ constexpr http_resonse_line ACCEPTED = {
 constexpr http_resonse_line NO_CONTENT = {
     .http_version = 110, .status_code = 204, .reason = "No Content"};
 
+constexpr http_resonse_line PARTIAL_CONTENT = {
+    .http_version = 110, .status_code = 206, .reason = "Partial Content"};
+
 constexpr http_resonse_line MOVED_PERMANENTLY = {
     .http_version = 110, .status_code = 301, .reason = "Moved Permanently"};
 
@@ -324,6 +411,23 @@ constexpr http_resonse_line NOT_FOUND = {
 constexpr http_resonse_line METHOD_NOT_ALLOWED = {
     .http_version = 110, .status_code = 405, .reason = "Method Not Allowed"};
 
+constexpr http_resonse_line PRECONDITION_FAILED = {
+    .http_version = 110, .status_code = 412, .reason = "Precondition Failed"};
+
+constexpr http_resonse_line CONTENT_TOO_LARGE = {
+    .http_version = 110, .status_code = 413, .reason = "Content Too Large"};
+
+constexpr http_resonse_line RANGE_NOT_SATISFIABLE = {
+    .http_version = 110,
+    .status_code = 416,
+    .reason = "Range Not Satisfiable"};
+
+constexpr http_resonse_line UPGRADE_REQUIRED = {
+    .http_version = 110, .status_code = 426, .reason = "Upgrade Required"};
+
+constexpr http_resonse_line TOO_MANY_REQUESTS = {
+    .http_version = 110, .status_code = 429, .reason = "Too Many Requests"};
+
 constexpr http_resonse_line INTERNAL_SERVER_ERROR = {
     .http_version = 110, .status_code = 500, .reason = "Internal Server Error"};
 
@@ -352,12 +456,110 @@ body(std::span<const std::byte> content,
   return http_body(to_string(type), content);
 }
 
-constexpr http_body
+inline http_body
 body(std::string_view content,
      http_content_type type = http_content_type::TextPlain) {
   return http_body(to_string(type), std::as_bytes(std::span(content)));
 }
 
+/**
+ * \brief A status line together with its serialized form.
+ */
+struct status_entry {
+  http_resonse_line line;
+  http_blob<64> serialized = make_status_line(line);
+};
+
+/**
+ * \brief Status lines of the constants above, serialized at compile time.
+ */
+inline constexpr status_entry status_lines[] = {
+    {SWITCHING_PROTOCOLS},
+    {OK},
+    {CREATED},
+    {ACCEPTED},
+    {NO_CONTENT},
+    {PARTIAL_CONTENT},
+    {MOVED_PERMANENTLY},
+    {FOUND},
+    {NOT_MODIFIED},
+    {BAD_REQUEST},
+    {UNAUTHORIZED},
+    {FORBIDDEN},
+    {NOT_FOUND},
+    {METHOD_NOT_ALLOWED},
+    {PRECONDITION_FAILED},
+    {CONTENT_TOO_LARGE},
+    {RANGE_NOT_SATISFIABLE},
+    {UPGRADE_REQUIRED},
+    {TOO_MANY_REQUESTS},
+    {INTERNAL_SERVER_ERROR},
+    {NOT_IMPLEMENTED},
+    {BAD_GATEWAY},
+    {SERVICE_UNAVAILABLE},
+};
+
 } // namespace http
 
+/**
+ * \brief Gets the pre-serialized form of a status line.
+ *
+ * \return The serialized status line including the trailing CRLF, or an empty
+ * view if the status line is not one of the constants in cppws::http.
+ */
+constexpr std::string_view
+serialized_status_line(const http_resonse_line &line) noexcept {
+  for (const http::status_entry &entry : http::status_lines) {
+    if (entry.line.status_code == line.status_code &&
+        entry.line.http_version == line.http_version &&
+        entry.line.reason == line.reason)
+      return entry.serialized.view();
+  }
+  return {};
+}
+
+inline std::ostream &operator<<(std::ostream &stream,
+                                const http_resonse_line &line) {
+
+  std::string_view serialized = serialized_status_line(line);
+  if (!serialized.empty())
+    return stream.write(serialized.data(), serialized.size());
+
+  stream << "HTTP/" << (line.http_version / 100);
+  if (line.http_version % 100 != 0)
+    stream << '.' << ((line.http_version % 100) / 10);
+
+  stream << ' ' << line.status_code;
+  stream << ' ' << line.reason << "\r\n";
+  return stream;
+}
+
+inline std::ostream &operator<<(std::ostream &stream,
+                                const http_header_line &line) {
+  return stream << line.header << ": " << line.value << "\r\n";
+}
+
+inline std::ostream &operator<<(std::ostream &stream, const http_body &body) {
+  std::string_view length = header_prefix(http_response_header::ContentLength);
+  std::string_view type = header_prefix(http_response_header::ContentType);
+
+  char date[http_date_cache::line_length];
+  http_date_cache::copy(date);
+
+  char len[20];
+  char *end = format_decimal(len, body.content.size());
+
+  stream.write(date, sizeof date)
+      .write(server_header_line.data(), server_header_line.size())
+      .write(length.data(), length.size())
+      .write(len, end - len)
+      .write("\r\n", 2)
+      .write(type.data(), type.size())
+      .write(body.content_type.data(), body.content_type.size())
+      .write("\r\n\r\n", 4)
+      .write(reinterpret_cast<const char *>(body.content.data()),
+             body.content.size());
+  return stream;
+}
+
 } // namespace cppws
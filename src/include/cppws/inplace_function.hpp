@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace cppws {
+
+template <typename Signature, std::size_t Capacity = 64,
+          std::size_t Alignment = alignof(std::max_align_t)>
+class inplace_function;
+
+/**
+ * \brief Move-only, type erased callable that stores its target inline.
+ *
+ * Unlike std::function, an inplace_function never allocates: callables that
+ * do not fit in \p Capacity bytes are rejected at compile time. Invoking the
+ * function is a single indirect call.
+ *
+ * The callable is invoked as const, so that one function, e.g. a handler
+ * shared by the request processors, can be called from several threads at
+ * once. Mutable callables are rejected; state they change has to be
+ * synchronized by the callable, e.g. held by pointer to an atomic.
+ *
+ * \tparam R Return type of the call signature.
+ * \tparam Args Argument types of the call signature.
+ * \tparam Capacity Size of the inline storage in bytes.
+ * \tparam Alignment Alignment of the inline storage.
+ */
+template <typename R, typename... Args, std::size_t Capacity,
+          std::size_t Alignment>
+class inplace_function<R(Args...), Capacity, Alignment> {
+
+  struct vtable {
+    R (*invoke)(const void *, Args &&...);
+    void (*move)(void *dst, void *src) noexcept;
+    void (*destroy)(void *) noexcept;
+  };
+
+  template <typename F>
+  static constexpr vtable vtable_for = {
+      [](const void *self, Args &&...args) -> R {
+        return std::invoke(*static_cast<const F *>(self),
+                           std::forward<Args>(args)...);
+      },
+      [](void *dst, void *src) noexcept {
+        ::new (dst) F(std::move(*static_cast<F *>(src)));
+        static_cast<F *>(src)->~F();
+      },
+      [](void *self) noexcept { static_cast<F *>(self)->~F(); }};
+
+  const vtable *vtable_ = nullptr;
+  alignas(Alignment) std::byte storage_[Capacity];
+
+public:
+  /**
+   * \brief True if a callable of type \p F can be stored inline.
+   */
+  template <typename F>
+  static constexpr bool stores_inline =
+      sizeof(F) <= Capacity && Alignment % alignof(F) == 0 &&
+      std::is_nothrow_move_constructible_v<F>;
+
+  /**
+   * \brief Constructs an empty function.
+   * \group cppws::inplace_function::inplace_function
+   * \{
+   */
+  inplace_function() noexcept = default;
+  inplace_function(std::nullptr_t) noexcept {}
+  /** \} */
+
+  /**
+   * \brief Constructs a function holding a copy of the callable \p fn,
+   * which has to be invocable as const.
+   */
+  template <typename F, typename D = std::decay_t<F>>
+    requires(!std::is_same_v<D, inplace_function> &&
+             std::is_invocable_r_v<R, const D &, Args...>)
+  inplace_function(F &&fn) {
+    static_assert(sizeof(D) <= Capacity,
+                  "Callable does not fit in the inplace_function storage.");
+    static_assert(Alignment % alignof(D) == 0,
+                  "Callable is over-aligned for the inplace_function storage.");
+    static_assert(std::is_nothrow_move_constructible_v<D>,
+                  "Callable must be nothrow move constructible.");
+    ::new (static_cast<void *>(storage_)) D(std::forward<F>(fn));
+    vtable_ = &vtable_for<D>;
+  }
+
+  /**
+   * \brief Invokes the stored callable, which is const.
+   */
+  R operator()(Args... args) const {
+    return vtable_->invoke(storage_, std::forward<Args>(args)...);
+  }
+
+  /**
+   * \brief True if the function holds a callable.
+   */
+  explicit operator bool() const noexcept { return vtable_ != nullptr; }
+
+  ~inplace_function() noexcept { reset(); }
+
+  inplace_function(const inplace_function &) = delete;
+  inplace_function &operator=(const inplace_function &) = delete;
+
+  inplace_function(inplace_function &&other) noexcept { move(other); }
+
+  inplace_function &operator=(inplace_function &&other) noexcept {
+    if (this == &other)
+      return *this;
+    reset();
+    move(other);
+    return *this;
+  }
+
+  inplace_function &operator=(std::nullptr_t) noexcept {
+    reset();
+    return *this;
+  }
+
+private:
+  void reset() noexcept {
+    if (vtable_)
+      vtable_->destroy(storage_);
+    vtable_ = nullptr;
+  }
+
+  void move(inplace_function &other) noexcept {
+    if (!other.vtable_)
+      return;
+    other.vtable_->move(storage_, other.storage_);
+    vtable_ = other.vtable_;
+    other.vtable_ = nullptr;
+  }
+};
+
+} // namespace cppws
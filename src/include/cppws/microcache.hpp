@@ -0,0 +1,184 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <cppws/request_manager.hpp>
+
+namespace cppws {
+
+using namespace std::chrono_literals;
+
+/**
+ * \brief Settings of a microcache.
+ */
+struct microcache_options {
+  /** Upper bound of the memory used by cached responses, in bytes. */
+  std::size_t max_bytes = 64 << 20;
+  /** Number of independently locked shards. */
+  std::size_t shards = 16;
+  /** Lifetime of responses that carry no max-age or s-maxage directive. */
+  std::chrono::milliseconds ttl = 1s;
+  /**
+   * Request headers whose values select between variants of a response.
+   * Accept-Encoding is reduced to the coding it negotiates.
+   */
+  std::vector<http_request_header> vary = {
+      http_request_header::AcceptEncoding};
+  /**
+   * How long a request waits for another request that refills the same
+   * entry before running the handler itself.
+   */
+  std::chrono::milliseconds fill_timeout = 5s;
+};
+
+/**
+ * \brief Short lived cache of fully serialized responses.
+ *
+ * Responses to GET requests are keyed by the request URI and the values of
+ * the configured vary headers, and kept for their max-age (or the configured
+ * TTL). A hit is answered with a single write of the stored bytes, with a
+ * fresh Date header, without running the handler. Conditional requests are
+ * evaluated against the ETag and Last-Modified headers of the stored
+ * response. While an entry is being refilled, concurrent requests for it
+ * wait for that refill rather than running the handler as well.
+ *
+ * Entries are spread over shards that are locked independently, and each
+ * shard evicts its least recently used entries to stay within its share of
+ * max_bytes. Uncacheable responses are remembered for the TTL so that the
+ * requests for them are not serialized behind one another.
+ *
+ * Use cached() to put a cache in front of a handler:
+ *
+ * \code
+ * auto cache = std::make_shared<microcache>();
+ * mapper.map(http_method::GET, "/feed", cached(feed_handler, cache));
+ * \endcode
+ */
+class microcache {
+  struct shard;
+
+public:
+  /**
+   * \brief Outcome of a cache lookup.
+   */
+  class ticket {
+  public:
+    ticket() noexcept = default;
+    ticket(ticket &&other) noexcept;
+    ticket &operator=(ticket &&) = delete;
+    ~ticket();
+
+    /**
+     * \brief Gets the cached response, or nullptr on a miss.
+     */
+    const prebuilt_response *response() const noexcept {
+      return response_.get();
+    }
+
+    /**
+     * \brief Gets the validators of the cached response, against which
+     * conditional requests are evaluated, or nullptr if the cached response
+     * is not subject to them.
+     */
+    const resource_validators *validators() const noexcept {
+      return response_ && conditional_ ? &validators_ : nullptr;
+    }
+
+    /**
+     * \brief True if the holder of the ticket is expected to refill the
+     * entry through microcache::fill(). Otherwise, on a miss, the request
+     * is to be handled without caching.
+     */
+    bool fills() const noexcept { return shard_ != nullptr; }
+
+  private:
+    friend class microcache;
+
+    std::shared_ptr<const prebuilt_response> response_;
+    resource_validators validators_;
+    bool conditional_ = false;
+    shard *shard_ = nullptr;
+    std::string key_;
+  };
+
+  /**
+   * \brief Constructs an empty cache.
+   */
+  explicit microcache(microcache_options options = {});
+
+  ~microcache();
+
+  /**
+   * \brief Looks up the response to a request, waiting for a concurrent
+   * refill of the entry if there is one.
+   */
+  ticket lookup(const http_request &request);
+
+  /**
+   * \brief Stores the response built by the handler, if it is cacheable,
+   * and sends it.
+   *
+   * \param t Ticket returned by lookup() for the request.
+   * \param manager Context the handler built the response in.
+   */
+  void fill(ticket &t, request_manager &manager);
+
+  /**
+   * \brief Gets the memory used by the cached entries, in bytes.
+   */
+  std::size_t size() const;
+
+private:
+  static void release(shard &s, const std::string &key);
+
+  microcache_options options_;
+  std::unique_ptr<shard[]> shards_;
+};
+
+/**
+ * \brief Handler that is only run when the response is not in a microcache.
+ *
+ * \tparam Handler Handler producing the response.
+ */
+template <typename Handler> class cached_handler {
+  Handler handler_;
+  std::shared_ptr<microcache> cache_;
+
+public:
+  cached_handler(Handler handler, std::shared_ptr<microcache> cache)
+      : handler_(std::move(handler)), cache_(std::move(cache)) {}
+
+  void operator()(request_manager &manager) const {
+    microcache::ticket t = cache_->lookup(manager.request());
+    if (const prebuilt_response *response = t.response()) {
+      const resource_validators *validators = t.validators();
+      if (!validators || !manager.validate(*validators))
+        manager.write(*response);
+      return;
+    }
+
+    handler_(manager);
+    if (t.fills())
+      cache_->fill(t, manager);
+  }
+};
+
+/**
+ * \brief Puts a microcache in front of a handler.
+ *
+ * \param handler Handler producing the response on a miss.
+ * \param cache Cache to use, which may be shared between routes.
+ */
+template <typename Handler>
+cached_handler<std::decay_t<Handler>>
+cached(Handler &&handler, std::shared_ptr<microcache> cache) {
+  return {std::forward<Handler>(handler), std::move(cache)};
+}
+
+} // namespace cppws
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <cppws/socket.hpp>
+
+namespace cppws {
+
+/**
+ * \brief What an output_queue does when a chunk does not fit.
+ */
+enum class overflow_policy {
+  /** Drop the oldest chunks that have not started being written. */
+  DropOldest,
+  /** Drop the chunk being pushed. */
+  DropNewest,
+  /** Give up on the connection. */
+  Disconnect
+};
+
+/**
+ * \brief Bounded queue of data waiting to be written to a non-blocking
+ * connection.
+ *
+ * Chunks are reference counted and immutable, so one buffer can be queued on
+ * any number of connections without being copied. Queued bytes are written
+ * with gather writes as the connection accepts them.
+ *
+ * Besides the hard limit of the overflow policy, a queue may have a high and
+ * a low watermark to push back on its producer before data is lost: the
+ * queue is paused once it holds the high watermark, and resumes once flushes
+ * brought it down to the low one. Producers check paused() and wait for the
+ * queue to resume rather than queue more.
+ */
+class output_queue {
+public:
+  /**
+   * \brief Immutable chunk of output, possibly shared between queues.
+   */
+  using chunk = std::shared_ptr<const std::string>;
+
+  /**
+   * \brief Creates an empty queue.
+   *
+   * \param maxBytes Number of queued bytes above which the overflow policy
+   * applies.
+   * \param policy Overflow policy.
+   */
+  explicit output_queue(std::size_t maxBytes = 1 << 20,
+                        overflow_policy policy = overflow_policy::DropOldest)
+      : maxBytes_(maxBytes), policy_(policy) {}
+
+  /**
+   * \brief Queues a chunk.
+   *
+   * A chunk is always accepted by an empty queue. Otherwise, if the queue
+   * would grow beyond its limit, the overflow policy decides: DropOldest
+   * makes room by dropping whole chunks that have not been partially
+   * written (the queue can still exceed its limit by the chunk being
+   * written), DropNewest drops \p data.
+   *
+   * \return false if the policy is Disconnect and the chunk does not fit;
+   * the chunk is not queued and the connection should be closed.
+   */
+  bool push(chunk data);
+
+  /**
+   * \brief Copies bytes into a new chunk and queues it.
+   */
+  bool push(std::string_view data) {
+    return push(std::make_shared<const std::string>(data));
+  }
+
+  /**
+   * \brief Sets the watermarks of the queue.
+   *
+   * \param high Number of queued bytes at which the queue pauses.
+   * \param low Number of queued bytes at or below which a paused queue
+   * resumes; clamped to \p high.
+   */
+  void watermarks(std::size_t high, std::size_t low) noexcept;
+
+  /**
+   * \brief Writes as much of the queue as the connection accepts.
+   *
+   * \param connection Non-blocking connection to write to.
+   * \return true if the queue was drained, false if the connection would
+   * block. The queue resumes if it is down to its low watermark.
+   * \throw std::system_error if the connection fails.
+   */
+  bool flush(class socket &connection);
+
+  /**
+   * \brief Drops all queued chunks.
+   */
+  void clear() noexcept;
+
+  /**
+   * \brief Gets the number of bytes waiting to be written.
+   */
+  std::size_t size() const noexcept { return bytes_; }
+
+  /**
+   * \brief True if nothing is waiting to be written.
+   */
+  bool empty() const noexcept { return chunks_.empty(); }
+
+  /**
+   * \brief True from the time the queue reached its high watermark until it
+   * is down to its low watermark again.
+   */
+  bool paused() const noexcept { return paused_; }
+
+  /**
+   * \brief Gets the number of chunks dropped by the overflow policy.
+   */
+  std::uint64_t dropped() const noexcept { return dropped_; }
+
+private:
+  std::deque<chunk> chunks_;
+  std::size_t offset_ = 0;
+  std::size_t bytes_ = 0;
+  std::size_t maxBytes_;
+  std::size_t highWater_ = ~std::size_t(0);
+  std::size_t lowWater_ = ~std::size_t(0);
+  overflow_policy policy_;
+  bool paused_ = false;
+  std::uint64_t dropped_ = 0;
+};
+
+} // namespace cppws
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cppws/request_manager.hpp>
+#include <cppws/upstream.hpp>
+
+namespace cppws {
+
+/**
+ * \brief How an upstream_group picks the upstream of a request.
+ */
+enum class balancing {
+  /** Each upstream in turn. */
+  round_robin,
+  /** The upstream with the fewest requests in progress. */
+  least_outstanding,
+  /**
+   * The upstream a hash of the request maps to on a hash ring, so that
+   * requests with the same key keep going to the same upstream and only
+   * the keys of an upstream that leaves the group move elsewhere.
+   */
+  consistent_hash
+};
+
+/**
+ * \brief Settings of an upstream_group.
+ */
+struct proxy_options {
+  balancing policy = balancing::round_robin;
+  /**
+   * Request header hashed by consistent_hash, e.g. a session cookie. The
+   * request target is hashed if this is empty or the header is missing.
+   */
+  std::string hash_header = {};
+  /** Consecutive failures after which an upstream is ejected. */
+  std::size_t max_fails = 3;
+  /** How long an ejected upstream receives no requests. */
+  std::chrono::milliseconds eject_time{10000};
+  /** Name added to Via headers, or empty to not add one. */
+  std::string via = "cppws";
+  /** Settings of the connection pool shared by the upstreams. */
+  upstream_options upstream = {};
+};
+
+/**
+ * \brief State of an upstream of a group, see upstream_group::status().
+ */
+struct upstream_status {
+  upstream_address address;
+  /** Requests in progress. */
+  std::size_t outstanding;
+  /** Requests that failed since the last success. */
+  std::size_t fails;
+  /** True if the upstream is ejected for failing. */
+  bool ejected;
+};
+
+/**
+ * \brief Set of interchangeable upstreams that requests are balanced over,
+ * with the keep-alive connections to them.
+ *
+ * Upstreams are checked passively: an upstream that fails max_fails
+ * requests in a row, by refusing connections, breaking them or timing out,
+ * is ejected for eject_time and receives no requests meanwhile. If every
+ * upstream is ejected, they are all used again rather than failing every
+ * request. Idempotent requests that fail before a response was sent are
+ * retried once on another upstream.
+ *
+ * Use proxy() to map a group to a route:
+ *
+ * \code
+ * auto group = std::make_shared<upstream_group>(
+ *     std::vector<upstream_address>{{"10.0.0.7", 8080}, {"10.0.0.8", 8080}},
+ *     proxy_options{.policy = balancing::least_outstanding});
+ * mapper.map(http_method::GET, "/api", proxy(group));
+ * \endcode
+ */
+class upstream_group {
+public:
+  /**
+   * \brief Creates a group.
+   *
+   * \throw std::invalid_argument if there are no upstreams.
+   */
+  explicit upstream_group(std::vector<upstream_address> upstreams,
+                          proxy_options options = {});
+
+  upstream_group(const upstream_group &) = delete;
+  upstream_group &operator=(const upstream_group &) = delete;
+
+  /**
+   * \brief Forwards a request to an upstream of the group and answers it
+   * with the upstream's response, or with 502 Bad Gateway if no upstream
+   * could be reached.
+   *
+   * \throw upstream_error if the response was cut short after it started.
+   */
+  void forward(request_manager &manager);
+
+  /**
+   * \brief Picks the upstream of a request, as forward() does first.
+   *
+   * \return Index of the upstream in the group.
+   */
+  std::size_t pick(const http_request &request) const;
+
+  /**
+   * \brief Gets the state of the upstreams, in the order of the group.
+   */
+  std::vector<upstream_status> status() const;
+
+  /**
+   * \brief Gets the connection pool of the group.
+   */
+  upstream_pool &pool() noexcept { return pool_; }
+
+private:
+  struct member {
+    upstream_address address;
+    std::atomic<std::size_t> outstanding = 0;
+    std::atomic<std::size_t> fails = 0;
+    /** End of the ejection, in ticks of the steady clock. */
+    std::atomic<std::int64_t> ejectedUntil = 0;
+  };
+
+  std::size_t pick(const http_request &request, std::size_t skip) const;
+  void succeeded(member &m) noexcept;
+  void failed(member &m) noexcept;
+
+  proxy_options options_;
+  std::vector<member> members_;
+  /** Points of the hash ring and the upstream each belongs to, sorted. */
+  std::vector<std::pair<std::uint64_t, std::size_t>> ring_;
+  mutable std::atomic<std::size_t> next_ = 0;
+  upstream_pool pool_;
+};
+
+/**
+ * \brief Handler forwarding requests to an upstream_group.
+ */
+class proxy_handler {
+  std::shared_ptr<upstream_group> group_;
+
+public:
+  explicit proxy_handler(std::shared_ptr<upstream_group> group)
+      : group_(std::move(group)) {}
+
+  void operator()(request_manager &manager) const {
+    group_->forward(manager);
+  }
+};
+
+/**
+ * \brief Creates a handler forwarding requests to a group of upstreams.
+ *
+ * \param group Upstreams to forward to, which may be shared between routes.
+ */
+inline proxy_handler proxy(std::shared_ptr<upstream_group> group) {
+  return proxy_handler{std::move(group)};
+}
+
+} // namespace cppws
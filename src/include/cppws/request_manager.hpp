@@ -0,0 +1,325 @@
+#pragma once
+
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <span>
+#include <string_view>
+
+#include <cppws/conditional.hpp>
+#include <cppws/http_request.hpp>
+#include <cppws/http_response.hpp>
+#include <cppws/response_buffer.hpp>
+#include <cppws/socket.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Destination of the responses of connections that do not write
+ * HTTP/1.1 to a socket, such as HTTP/2 streams.
+ */
+class response_sink {
+public:
+  virtual ~response_sink() = default;
+
+  /**
+   * \brief Takes over a response built by a handler, to be translated for
+   * the connection.
+   *
+   * The sink completes the head with response_buffer::finish_head() and
+   * encodes status, headers and body from the buffer itself. File slices
+   * of the body may be closed once this returns.
+   *
+   * \param response Complete response.
+   * \param includeBody false to only send the head of the response.
+   */
+  virtual void write_response(response_buffer &response,
+                              bool includeBody) = 0;
+
+  /**
+   * \brief Takes over a complete response in HTTP/1.1 syntax (status line,
+   * headers and body), e.g. a prebuilt_response, to be translated for the
+   * connection.
+   */
+  virtual void write_response(std::string_view response) = 0;
+};
+
+/**
+ * Context for handling requests
+ *
+ * Besides giving access to the request, the manager builds the response
+ * directly in the output buffer of the connection:
+ *
+ * \code
+ * manager.status(http::OK)
+ *     .header(http_response_header::CacheControl, "no-store")
+ *     .content_type(http_content_type::ApplicationJson)
+ *     .format(R"({{"id": {}}})", id);
+ * \endcode
+ *
+ * The response is sent when the handler returns, unless the handler sends it
+ * earlier through send().
+ */
+class request_manager {
+public:
+  /**
+   * \brief Constructs the context for handling a request.
+   *
+   * \param request Request being handled.
+   * \param connection Connection the request was received on.
+   * \param response Output buffer the response is built in. The buffer is
+   * cleared by the constructor.
+   */
+  request_manager(const http_request &request, class socket &connection,
+                  response_buffer &response)
+      : request_(&request), connection_(&connection), response_(&response) {
+    response_->clear();
+  }
+
+  /**
+   * \brief Constructs the context for handling a request whose response is
+   * passed to a sink rather than written to a socket.
+   *
+   * \param request Request being handled.
+   * \param sink Destination of the response.
+   * \param response Output buffer the response is built in. The buffer is
+   * cleared by the constructor.
+   */
+  request_manager(const http_request &request, response_sink &sink,
+                  response_buffer &response)
+      : request_(&request), connection_(nullptr), sink_(&sink),
+        response_(&response) {
+    response_->clear();
+  }
+
+  /**
+   * \brief Gets the request being handled.
+   */
+  const http_request &request() const noexcept { return *request_; }
+
+  /**
+   * \brief Gets the connection the request was received on. Requests passed
+   * to a response_sink have no connection of their own.
+   */
+  class socket &connection() noexcept { return *connection_; }
+
+  /**
+   * \brief True if the response is written to a connection rather than to a
+   * response_sink, i.e. a streamed body may follow send() on connection().
+   */
+  bool has_connection() const noexcept { return connection_ != nullptr; }
+
+  /**
+   * \brief Gets the buffer the response is built in.
+   */
+  response_buffer &response() noexcept { return *response_; }
+
+  /**
+   * \brief Sets the status line of the response (200 OK by default).
+   */
+  request_manager &status(const http_resonse_line &line) noexcept {
+    response_->status(line);
+    return *this;
+  }
+
+  /**
+   * \brief Appends a header to the response.
+   * \group cppws::request_manager::header
+   * \{
+   */
+  request_manager &header(std::string_view name, std::string_view value) {
+    response_->header(name, value);
+    return *this;
+  }
+
+  request_manager &header(http_response_header name, std::string_view value) {
+    response_->header(name, value);
+    return *this;
+  }
+  /** \} */
+
+  /**
+   * \brief Sets the content type of the response body.
+   * \group cppws::request_manager::content_type
+   * \{
+   */
+  request_manager &content_type(std::string_view type) {
+    response_->content_type(type);
+    return *this;
+  }
+
+  request_manager &content_type(http_content_type type) {
+    return content_type(to_string(type));
+  }
+  /** \} */
+
+  /**
+   * \brief Replaces the response body and its content type.
+   */
+  request_manager &body(const http_body &body) {
+    response_->content_type(body.content_type);
+    response_->body().assign(
+        reinterpret_cast<const char *>(body.content.data()),
+        body.content.size());
+    return *this;
+  }
+
+  /**
+   * \brief Appends text to the response body.
+   */
+  request_manager &append(std::string_view text) {
+    response_->body().append(text);
+    return *this;
+  }
+
+  /**
+   * \brief Formats text in place at the end of the response body.
+   */
+  template <typename... Args>
+  request_manager &format(std::format_string<Args...> fmt, Args &&...args) {
+    std::format_to(body_appender(), fmt, std::forward<Args>(args)...);
+    return *this;
+  }
+
+  /**
+   * \brief Output iterator that appends to the response body, for use with
+   * std::format_to and similar algorithms.
+   */
+  std::back_insert_iterator<std::pmr::string> body_appender() noexcept {
+    return std::back_inserter(response_->body());
+  }
+
+  /**
+   * \brief Extends the body by \p n bytes and returns them for the caller to
+   * fill in. Call commit_body() with the number of bytes actually written.
+   */
+  std::span<char> prepare_body(std::size_t n) {
+    std::pmr::string &body = response_->body();
+    prepared_ = body.size();
+    body.resize(prepared_ + n);
+    return {body.data() + prepared_, n};
+  }
+
+  /**
+   * \brief Marks the first \p n bytes returned by the last prepare_body() call
+   * as part of the body; the remaining prepared bytes are discarded.
+   */
+  void commit_body(std::size_t n) { response_->body().resize(prepared_ + n); }
+
+  /**
+   * \brief Adds the validators of the resource to the response and answers
+   * conditional requests before any body is generated:
+   *
+   * \code
+   * if (manager.validate({.etag = "\"v42\""}))
+   *   return; // 304 Not Modified or 412 Precondition Failed
+   * \endcode
+   *
+   * \param validators Validators of the current representation.
+   * \return true if the request was answered with 304 or 412, in which case
+   * the handler should return without producing a body.
+   */
+  bool validate(const resource_validators &validators);
+
+  /**
+   * \brief Sends a file as the body of the response, honoring the Range and
+   * If-Range headers of GET requests.
+   *
+   * Depending on the request, the whole file is sent, or a 206 response with
+   * a single range or a multipart/byteranges body, or a 416 response. The
+   * file contents are copied to the connection by the kernel and never read
+   * into memory. Set the content type beforehand, and call validate() first
+   * so that If-Range can be evaluated against the validators of the file:
+   *
+   * \code
+   * if (manager.validate({.etag = etag, .last_modified = st.st_mtime}))
+   *   return;
+   * manager.content_type("video/mp4").send_file(fd, st.st_size);
+   * \endcode
+   *
+   * The response is sent before the function returns, so the descriptor
+   * may be closed afterwards. Any body built so far is discarded.
+   *
+   * \param fd File descriptor of the file, positioned anywhere.
+   * \param size Size of the file in bytes.
+   */
+  void send_file(int fd, std::uint64_t size);
+
+  /**
+   * \brief Enables or disables compression of the response body (enabled by
+   * default). When enabled, bodies that are large enough and of a
+   * compressible type are encoded according to the Accept-Encoding header of
+   * the request, at a level chosen by compression_governor::global().
+   */
+  request_manager &compression(bool enabled) noexcept {
+    compression_ = enabled;
+    return *this;
+  }
+
+  /**
+   * \brief Enables sending a large body generated in memory without copying
+   * it into the kernel (see response_buffer::zerocopy()). Disabled by
+   * default; responses passed to a response_sink are always copied.
+   */
+  request_manager &zerocopy(bool enabled) noexcept {
+    response_->zerocopy(enabled);
+    return *this;
+  }
+
+  /**
+   * \brief Sends the response that was built. Does nothing if a response has
+   * already been sent.
+   */
+  void send();
+
+  /**
+   * \brief Serializes the response built so far, compressed as send() would,
+   * without sending it. Used by response caches.
+   *
+   * \return true if the response was serialized into \p out; false if it was
+   * already sent or has a body that cannot be serialized.
+   */
+  bool snapshot(prebuilt_response &out);
+
+  /**
+   * \brief Writes pre-serialized response bytes to the connection in place of
+   * the response being built.
+   *
+   * \param bytes Complete HTTP response (status line, headers and body).
+   */
+  void write(std::string_view bytes);
+
+  /**
+   * \brief Writes a prebuilt response to the connection in place of the
+   * response being built.
+   */
+  void write(const prebuilt_response &response);
+
+  /**
+   * \brief Takes the connection away from the request processor, e.g. after
+   * a protocol upgrade. Nothing is sent on the connection on behalf of the
+   * handler afterwards.
+   *
+   * \throw std::logic_error if the response is passed to a response_sink.
+   */
+  class socket detach();
+
+  /**
+   * \brief True once a response has been written to the connection.
+   */
+  bool sent() const noexcept { return sent_; }
+
+private:
+  void encode();
+
+  const http_request *request_;
+  class socket *connection_;
+  response_sink *sink_ = nullptr;
+  response_buffer *response_;
+  resource_validators validators_;
+  std::size_t prepared_ = 0;
+  bool sent_ = false;
+  bool compression_ = true;
+};
+
+} // namespace cppws
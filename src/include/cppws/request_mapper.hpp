@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cppws/http_request.hpp>
+#include <cppws/inplace_function.hpp>
+#include <cppws/request_manager.hpp>
+
+namespace cppws {
+
+/**
+ * Maps URL endpoints to request handlers.
+ */
+class request_mapper {
+public:
+  /**
+   * \brief Handler type invoked for a request. Handlers are stored inline and
+   * never allocate when resolved or called.
+   */
+  using handler = inplace_function<void(request_manager &)>;
+
+  virtual ~request_mapper() noexcept {}
+
+  /**
+   * \brief Resolve a handler for the given request.
+   *
+   * \param request Request to resolve a handler for.
+   * \return Pointer to the handler that will be used to handle the request, or
+   * nullptr if a handler did not exist. The handler is owned by the mapper and
+   * must remain valid for as long as the mapper is alive.
+   */
+  virtual const handler *resolve(const http_request &request) = 0;
+};
+
+/**
+ * \brief Resolves the handler of a request and runs it, then sends the
+ * response unless the handler did.
+ *
+ * Requests without a handler are answered with 404 Not Found, and handlers
+ * that throw before sending a response with 500 Internal Server Error.
+ *
+ * \param mapper Mapper resolving the handler.
+ * \param manager Context of the request.
+ */
+void dispatch_request(request_mapper &mapper, request_manager &manager);
+
+} // namespace cppws
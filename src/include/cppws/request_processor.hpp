@@ -2,41 +2,125 @@
 
 #include <atomic>
 #include <condition_variable>
-#include <functional>
+#include <cstddef>
+#include <deque>
+#include <memory>
 #include <memory_resource>
 #include <mutex>
+#include <span>
 #include <thread>
+#include <vector>
 
+#include <cppws/connection_buffer.hpp>
+#include <cppws/event_loop.hpp>
 #include <cppws/http_request.hpp>
+#include <cppws/request_mapper.hpp>
+#include <cppws/response_buffer.hpp>
 #include <cppws/socket.hpp>
-#include <cppws/socket_stream.hpp>
+#include <cppws/tls.hpp>
 
 namespace cppws {
 
 using namespace std::chrono_literals;
 
 /**
- * Context for handling requests
+ * \brief Time limits of the connections of a request_processor.
  */
-class request_manager {};
+struct processor_timeouts {
+  /** Time for the request line and headers to arrive, handshake included. */
+  std::chrono::milliseconds header_read = 10s;
+  /**
+   * Slowest accepted upload of a request body, in bytes per second, or 0 for
+   * no limit.
+   */
+  std::size_t min_body_rate = 1024;
+  /** Time allowed for a body on top of what min_body_rate implies. */
+  std::chrono::milliseconds body_grace = 5s;
+  /** Time a handler has to complete its response, or 0 for no limit. */
+  std::chrono::milliseconds handler = 0ms;
+  /**
+   * Time for the client to acknowledge a body sent with zero-copy (see
+   * response_buffer::zerocopy()) before the connection is reset.
+   */
+  std::chrono::milliseconds zerocopy_ack = 5s;
+};
 
 /**
- * Maps URL endpoints to request handlers.
+ * \brief Thread that cuts off connections whose deadline has passed.
+ *
+ * Request processors read and write with blocking calls, so a client that
+ * sends nothing, or a byte every now and then, would hold a processor
+ * forever. The watchdog keeps the deadlines of the connections in the timer
+ * wheel of an event loop running on its own thread, and shuts a connection
+ * down once its deadline passes, which makes any pending call on it return.
  */
-class request_mapper {
+class connection_watchdog {
 public:
-  using handler = std::function<void(request_manager &)>;
+  /**
+   * \brief Deadline of one connection at a time, e.g. the one a processor
+   * is serving.
+   */
+  class deadline {
+  public:
+    explicit deadline(connection_watchdog &watchdog) noexcept
+        : watchdog_(&watchdog) {}
+    ~deadline();
+
+    deadline(const deadline &) = delete;
+    deadline &operator=(const deadline &) = delete;
+
+    /**
+     * \brief Sets the deadline of a connection, replacing the previous one.
+     * May be called from any thread.
+     *
+     * \param fd Connection to shut down once the deadline passes.
+     * \param timeout Time from now until the deadline.
+     */
+    void arm(int fd, std::chrono::milliseconds timeout);
+
+    /**
+     * \brief Clears the deadline. Once this returns, the connection will not
+     * be shut down, so that it may be closed safely.
+     */
+    void cancel() noexcept;
 
-  virtual ~request_mapper() noexcept {}
+    /**
+     * \brief True if the connection was shut down since the deadline was
+     * last armed.
+     */
+    bool expired() const noexcept;
+
+  private:
+    void expire();
+
+    connection_watchdog *watchdog_;
+    timer_wheel::timer timer_;
+    mutable std::mutex lock_;
+    int fd_ = -1;
+    timer_wheel::clock::time_point due_;
+    bool expired_ = false;
+  };
 
   /**
-   * \brief Resolve a handler for the given request.
-   *
-   * \param request Request to resolve a handler for.
-   * \return A functor that will be used to handle the request, or an empty
-   * std::function if a handler did not exist.
+   * \brief Starts the watchdog thread.
    */
-  virtual handler resolve(const http_request &request) = 0;
+  connection_watchdog();
+  ~connection_watchdog() noexcept;
+
+  connection_watchdog(const connection_watchdog &) = delete;
+  connection_watchdog &operator=(const connection_watchdog &) = delete;
+
+  /**
+   * \brief Gets the watchdog shared by the request processors, started on
+   * first use.
+   */
+  static std::shared_ptr<connection_watchdog> shared();
+
+private:
+  event_loop loop_;
+  std::mutex lock_;
+  bool running_ = true;
+  std::thread thread_;
 };
 
 /**
@@ -55,9 +139,37 @@ public:
       std::shared_ptr<request_mapper> mapper,
       std::pmr::memory_resource *upstream = std::pmr::get_default_resource());
 
+  /**
+   * \brief Constructs a new request processor that serves connections over
+   * TLS.
+   *
+   * \param mapper Pointer to a request_mapper that is used to resolve handlers
+   * for the requests.
+   * \param tls TLS context shared by the processors of a server, so that
+   * sessions can be resumed on any of them.
+   * \param upstream Allocator used by the processor.
+   */
+  request_processor(
+      std::shared_ptr<request_mapper> mapper,
+      std::shared_ptr<const tls_context> tls,
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource());
+
+  /**
+   * \brief Stops the processor, after the request it is serving if any, and
+   * joins its thread.
+   */
+  ~request_processor() noexcept;
+
+  request_processor(const request_processor &) = delete;
+  request_processor &operator=(const request_processor &) = delete;
+
   /**
    * \brief Accept a new connection on the given socket.
    *
+   * With a TLS context, the TLS handshake is performed first. The request
+   * is read on the calling thread with blocking calls, so the socket has to
+   * be blocking. Connections are accepted from one thread at a time.
+   *
    * \param socket Socket connection to accept.
    * \return true if the socket was accepted.
    */
@@ -87,25 +199,118 @@ public:
    */
   bool wait_until_available(const std::chrono::milliseconds &timeout = 500ms);
 
+  /**
+   * \brief Sets the time limits of the connections, enforced through the
+   * shared connection_watchdog. Call before accepting connections.
+   */
+  void timeouts(const processor_timeouts &timeouts);
+
+  /**
+   * \brief Sets the largest request body accepted, 16 MiB by default.
+   * Requests announcing a larger one are answered with 413 Content Too
+   * Large without reading the body. Call before accepting connections.
+   */
+  void max_request_body(std::size_t bytes);
+
 private:
   void run();
   void process_request();
 
-  std::pmr::monotonic_buffer_resource buffer_;
+  std::pmr::unsynchronized_pool_resource buffer_;
 
-  std::atomic_bool running_;
-  std::atomic_bool busy_;
+  std::atomic_bool running_ = true;
+  std::atomic_bool busy_ = false;
 
   std::mutex lock_;
   std::condition_variable availableCondition_;
   std::condition_variable newConnectionCondition_;
 
   bool hasRequest_ = false;
-  pmr::socket_iostream stream_;
+  class socket connection_;
+  connection_buffer input_;
+  response_buffer response_;
   http_request processedRequest_;
-  std::thread::id runner_;
 
   std::shared_ptr<request_mapper> mapper_;
+  std::shared_ptr<const tls_context> tls_;
+
+  processor_timeouts timeouts_;
+  std::size_t maxRequestBody_ = 16 << 20;
+  std::shared_ptr<connection_watchdog> watchdog_ =
+      connection_watchdog::shared();
+  connection_watchdog::deadline deadline_{*watchdog_};
+
+  std::thread thread_;
+};
+
+/**
+ * \brief Request processors fed from one queue of connections.
+ *
+ * Connections are queued in batches, under one lock of the queue, e.g. by
+ * an acceptor. Each processor has a feeder thread that takes the next
+ * connection once the processor is idle and reads its request, so that the
+ * thread queueing the connections never blocks on a client. Requests are
+ * read with blocking calls; connections have to be blocking.
+ */
+class processor_pool {
+public:
+  /**
+   * \brief Starts the processors.
+   *
+   * \param mapper Resolves the handlers of the requests.
+   * \param size Number of processors; at least one is started.
+   * \param tls TLS context of the connections, or null for plain ones.
+   */
+  explicit processor_pool(
+      std::shared_ptr<request_mapper> mapper,
+      std::size_t size = std::thread::hardware_concurrency(),
+      std::shared_ptr<const tls_context> tls = nullptr);
+
+  /**
+   * \brief Closes the queued connections, lets the processors finish the
+   * requests they are reading or serving, and joins the threads.
+   */
+  ~processor_pool() noexcept;
+
+  processor_pool(const processor_pool &) = delete;
+  processor_pool &operator=(const processor_pool &) = delete;
+
+  /**
+   * \brief Queues a batch of connections. The sockets are moved from.
+   */
+  void post(std::span<socket> connections);
+
+  /**
+   * \brief Sets the time limits of the connections of every processor. Call
+   * before posting connections.
+   */
+  void timeouts(const processor_timeouts &timeouts);
+
+  /**
+   * \brief Sets the largest request body accepted by every processor. Call
+   * before posting connections.
+   */
+  void max_request_body(std::size_t bytes);
+
+  /**
+   * \brief Gets the number of processors.
+   */
+  std::size_t size() const noexcept { return processors_.size(); }
+
+  /**
+   * \brief Gets the number of connections waiting for a processor.
+   */
+  std::size_t queued();
+
+private:
+  void feed(request_processor &processor);
+
+  std::vector<std::unique_ptr<request_processor>> processors_;
+  std::mutex lock_;
+  std::condition_variable ready_;
+  std::deque<class socket> queue_;
+  bool stopping_ = false;
+  std::vector<std::thread> feeders_;
 };
 
 } // namespace cppws
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cppws/compression.hpp>
+#include <cppws/http_response.hpp>
+#include <cppws/socket.hpp>
+
+namespace cppws {
+
+class prebuilt_response;
+
+/**
+ * \brief Output buffer that a response is built in before it is written to a
+ * connection.
+ *
+ * The buffer is owned by the connection and reused between responses: clear()
+ * keeps the allocated capacity, so steady state responses do not allocate.
+ * Headers and body are kept in separate buffers and written with a single
+ * gather write once the response is complete.
+ */
+class response_buffer {
+public:
+  /**
+   * \brief Part of the body: a slice of a file, or (if fd is negative) a
+   * range of body().
+   */
+  struct body_part {
+    int fd;
+    std::uint64_t offset;
+    std::uint64_t length;
+  };
+
+  /**
+   * \brief Smallest body sent with zero-copy; copying smaller ones costs
+   * less than pinning their pages and collecting the completion.
+   */
+  static constexpr std::size_t ZEROCOPY_MIN_SIZE = 64 << 10;
+
+  /**
+   * \brief Constructs an empty response buffer.
+   *
+   * \param upstream Memory resource the buffers are allocated from.
+   */
+  explicit response_buffer(
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource());
+
+  /**
+   * \brief Resets the buffer to an empty "200 OK" response, keeping the
+   * allocated capacity.
+   */
+  void clear() noexcept;
+
+  /**
+   * \brief Sets the status line of the response.
+   */
+  void status(const http_resonse_line &line) noexcept { status_ = line; }
+
+  /**
+   * \brief Gets the status line of the response.
+   */
+  const http_resonse_line &status() const noexcept { return status_; }
+
+  /**
+   * \brief Appends a header line to the response.
+   */
+  void header(std::string_view name, std::string_view value);
+
+  /**
+   * \brief Appends a standard header line to the response.
+   */
+  void header(http_response_header name, std::string_view value);
+
+  /**
+   * \brief Sets the content type of the response body.
+   */
+  void content_type(std::string_view type);
+
+  /**
+   * \brief Gets the content type of the response body.
+   */
+  std::string_view content_type() const noexcept { return contentType_; }
+
+  /**
+   * \brief Gets the body buffer of the response.
+   */
+  std::pmr::string &body() noexcept { return body_; }
+
+  /**
+   * \brief Gets the body buffer of the response.
+   */
+  const std::pmr::string &body() const noexcept { return body_; }
+
+  /**
+   * \brief Appends a slice of a file to the body.
+   *
+   * The slice is copied from the file to the connection by the kernel when
+   * the response is sent, so the descriptor must stay open until then. Text
+   * appended to body() afterwards follows the slice.
+   *
+   * \param fd File descriptor of the file.
+   * \param offset Offset of the slice in the file.
+   * \param length Length of the slice.
+   */
+  void file(int fd, std::uint64_t offset, std::uint64_t length);
+
+  /**
+   * \brief Marks the body as streamed: the caller writes it to the connection
+   * after the head, and its end is signaled by closing the connection. No
+   * Content-Length is sent and the body is neither compressed nor cached.
+   */
+  void streaming(bool enabled) noexcept { streaming_ = enabled; }
+
+  /**
+   * \brief True if the body is streamed by the caller.
+   */
+  bool streaming() const noexcept { return streaming_; }
+
+  /**
+   * \brief Sends the body without copying it into the kernel (see
+   * socket::write_zerocopy()), for large bodies generated in memory rather
+   * than read from files.
+   *
+   * The kernel reads the body while it is transmitted, so the body buffer
+   * is set aside when the response is sent, and returned to the memory
+   * resource only once the kernel reports that it is done with it; the next
+   * response is built in a new buffer. Bodies smaller than
+   * ZEROCOPY_MIN_SIZE, with file slices, or on connections without
+   * zero-copy support are copied as usual. Reset by clear().
+   */
+  void zerocopy(bool enabled) noexcept { zerocopy_ = enabled; }
+
+  /**
+   * \brief True if the body is sent with zero-copy.
+   */
+  bool zerocopy() const noexcept { return zerocopy_; }
+
+  /**
+   * \brief Gets the number of bodies set aside until the kernel is done
+   * sending them.
+   */
+  std::size_t zerocopy_pending() const noexcept { return pending_.size(); }
+
+  /**
+   * \brief Waits for the bodies sent with zero-copy on a connection to
+   * complete and returns them to the memory resource. Call before the
+   * connection is closed, as completions cannot be collected afterwards.
+   *
+   * A connection that does not complete in time, e.g. because the client
+   * stopped reading, is reset: the kernel then drops the data that is still
+   * queued, and the bodies are released all the same.
+   *
+   * \param connection Connection the bodies were sent on.
+   * \param timeout Time for the client to acknowledge the data.
+   * \return false if the connection had to be reset.
+   */
+  bool reclaim(socket &connection, std::chrono::milliseconds timeout);
+
+  /**
+   * \brief Removes the body, including any file slices.
+   */
+  void clear_body() noexcept;
+
+  /**
+   * \brief Gets the length of the body, including file slices.
+   */
+  std::uint64_t content_length() const noexcept {
+    return body_.size() + fileBytes_;
+  }
+
+  /**
+   * \brief True if the body is large enough and of a type worth compressing,
+   * has not been encoded by the handler already and has no file slices.
+   *
+   * \param minSize Minimum body size worth compressing.
+   */
+  bool compressible(std::size_t minSize) const noexcept;
+
+  /**
+   * \brief Compresses the body and adds the matching Content-Encoding header.
+   * The body is left untouched if compression does not make it smaller.
+   *
+   * \param coding Coding to compress with.
+   * \param level Compression level.
+   * \return true if the body was compressed.
+   */
+  bool compress(content_coding coding, int level);
+
+  /**
+   * \brief Gets the serialized header lines appended so far.
+   */
+  std::string_view headers() const noexcept { return headers_; }
+
+  /**
+   * \brief Finds the value of the first header line with the given name
+   * (compared case-insensitively).
+   *
+   * \return The value, or an empty view if there is no such header.
+   */
+  std::string_view header_value(std::string_view name) const noexcept;
+
+  /**
+   * \brief Serializes the response into a prebuilt_response, e.g. to be
+   * cached. Bodies with file slices and streamed bodies cannot be
+   * serialized.
+   *
+   * \return true if the response was serialized into \p out.
+   */
+  bool snapshot(prebuilt_response &out);
+
+  /**
+   * \brief Writes the response to a connection.
+   *
+   * \param connection Connection to write to.
+   * \param includeBody false to only send the head of the response (e.g. for
+   * HEAD requests). Content-Length still describes the full body.
+   */
+  void send(socket &connection, bool includeBody = true);
+
+  /**
+   * \brief Completes the header lines as send() does, with Date, Server and
+   * the headers describing the body, for connections that encode the head
+   * themselves rather than in HTTP/1.1 syntax (HTTP/2). The body of a
+   * status that has none is dropped.
+   */
+  void finish_head();
+
+  /**
+   * \brief Appends the parts the body consists of to \p out, in order.
+   */
+  void body_parts(std::vector<body_part> &out) const;
+
+private:
+  /**
+   * A body sent with zero-copy, in use by the kernel until the given send
+   * has completed.
+   */
+  struct pending_body {
+    std::uint32_t send;
+    std::pmr::string body;
+  };
+
+  std::string_view serialize_status();
+  void send_zerocopy(socket &connection, std::string_view line);
+  void collect(socket &connection, std::chrono::milliseconds timeout);
+  std::string_view serialize_head();
+  bool has_body() const noexcept;
+  template <typename String> void append_entity_headers(String &out) const;
+
+  http_resonse_line status_ = http::OK;
+  std::pmr::string statusLine_;
+  std::pmr::string headers_;
+  std::pmr::string contentType_;
+  std::pmr::string body_;
+  std::pmr::vector<body_part> parts_;
+  std::size_t mapped_ = 0;
+  std::uint64_t fileBytes_ = 0;
+
+  bool encoded_ = false;
+  bool streaming_ = false;
+  bool zerocopy_ = false;
+  std::pmr::vector<pending_body> pending_;
+  std::unique_ptr<compressor> compressor_;
+  std::pmr::string scratch_;
+};
+
+/**
+ * \brief A complete HTTP response that is serialized once, typically when
+ * routes are set up, and written verbatim whenever it is needed.
+ *
+ * The stored bytes do not include the Date and Server headers; these are
+ * inserted after the status line when the response is written.
+ */
+class prebuilt_response {
+public:
+  /**
+   * \brief Serializes a response.
+   *
+   * \param status Status line of the response.
+   * \param headers Additional headers of the response.
+   * \param body Body of the response. It is left out, along with its
+   * Content-Length and Content-Type, for 1xx, 204 and 304 responses.
+   */
+  prebuilt_response(const http_resonse_line &status,
+                    std::initializer_list<http_header_line> headers = {},
+                    const http_body &body = http::body(""));
+
+  /**
+   * \brief Gets the serialized response.
+   */
+  std::string_view bytes() const noexcept { return bytes_; }
+
+  /**
+   * \brief Constructs an empty response, to be assigned later.
+   */
+  prebuilt_response() noexcept : statusLength_(0) {}
+
+  /**
+   * \brief Gets the serialized status line.
+   */
+  std::string_view status_line() const noexcept {
+    return std::string_view(bytes_).substr(0, statusLength_);
+  }
+
+  /**
+   * \brief Gets the serialized headers and body following the status line.
+   */
+  std::string_view rest() const noexcept {
+    return std::string_view(bytes_).substr(statusLength_);
+  }
+
+  /**
+   * \brief Writes the response, with up to date Date and Server headers, to
+   * a connection.
+   */
+  void send(socket &connection) const;
+
+  /**
+   * \brief Appends the response, with up to date Date and Server headers, to
+   * a string.
+   */
+  void serialize(std::string &out) const;
+
+private:
+  friend class response_buffer;
+
+  std::string bytes_;
+  std::size_t statusLength_;
+};
+
+/**
+ * \brief Writes all bytes referenced by the given buffers to a connection,
+ * retrying on partial writes.
+ *
+ * \param connection Connection to write to.
+ * \param iov Buffers to write. The array is modified as data is written.
+ * \param count Number of buffers.
+ */
+void write_all(socket &connection, struct iovec *iov, int count);
+
+} // namespace cppws
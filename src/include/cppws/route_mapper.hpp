@@ -0,0 +1,109 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <cppws/filter.hpp>
+#include <cppws/request_mapper.hpp>
+
+namespace cppws {
+
+/**
+ * \brief request_mapper that dispatches on the request method and URI path.
+ *
+ * Routes are registered once at startup and their handlers are kept for the
+ * lifetime of the mapper, so resolving a request neither copies nor allocates
+ * a handler. Routes must not be added while requests are being resolved.
+ */
+class route_mapper : public request_mapper {
+public:
+  /**
+   * \brief Maps a handler to an exact path, e.g. "/users/login".
+   *
+   * \param method HTTP method the route applies to.
+   * \param path Path of the route.
+   * \param fn Callable invoked with the request_manager of matched requests,
+   * as const.
+   */
+  template <typename F>
+  void map(enum http_method method, std::string_view path, F &&fn) {
+    add_route(method, path, false, make_handler(std::forward<F>(fn)));
+  }
+
+  /**
+   * \brief Maps a handler to every path starting with the given segments,
+   * e.g. "/static" matches "/static/css/site.css". Longer prefixes take
+   * precedence over shorter ones; exact routes take precedence over prefixes.
+   *
+   * \param method HTTP method the route applies to.
+   * \param prefix Path prefix of the route.
+   * \param fn Callable invoked with the request_manager of matched requests,
+   * as const.
+   */
+  template <typename F>
+  void map_prefix(enum http_method method, std::string_view prefix, F &&fn) {
+    add_route(method, prefix, true, make_handler(std::forward<F>(fn)));
+  }
+
+  /**
+   * \brief Answers CORS preflight requests with the given filter.
+   *
+   * Preflights are OPTIONS requests for a route that is usually mapped to
+   * another method, so they are answered before routes are looked up.
+   *
+   * \param filter Filter checking the origin of preflight requests.
+   */
+  void preflight(cors_filter filter);
+
+  const handler *resolve(const http_request &request) override;
+
+private:
+  struct route {
+    enum http_method method;
+    std::vector<std::string> segments;
+    handler fn;
+  };
+
+  struct string_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view v) const noexcept {
+      return std::hash<std::string_view>{}(v);
+    }
+  };
+
+  /**
+   * Callables too large to be stored inline are boxed once here, so that the
+   * registered handler only holds a pointer.
+   */
+  template <typename F> handler make_handler(F &&fn) {
+    using D = std::decay_t<F>;
+    static_assert(std::is_invocable_v<const D &, request_manager &>,
+                  "Handlers are invoked as const: give the callable a const "
+                  "operator()(request_manager &).");
+    if constexpr (handler::stores_inline<D>) {
+      return handler(std::forward<F>(fn));
+    } else {
+      auto box = std::make_shared<D>(std::forward<F>(fn));
+      D *target = box.get();
+      owners_.push_back(std::move(box));
+      return handler([target](request_manager &m) { (*target)(m); });
+    }
+  }
+
+  void add_route(enum http_method method, std::string_view path, bool prefix,
+                 handler &&fn);
+
+  handler preflight_;
+  std::deque<route> routes_;
+  std::vector<std::shared_ptr<void>> owners_;
+  std::unordered_map<std::string, const route *, string_hash,
+                     std::equal_to<>>
+      exact_;
+  std::vector<const route *> prefixes_;
+};
+
+} // namespace cppws
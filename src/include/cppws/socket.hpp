@@ -1,25 +1,179 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <string>
 #include <string_view>
 
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+struct ssl_st;
+
 namespace cppws {
 
+class tls_context;
+
+/**
+ * \brief Address family of a socket.
+ */
+enum class socket_family {
+  /** TCP over IPv4. */
+  IPv4,
+  /** TCP over IPv6; listeners accept IPv4 connections too by default. */
+  IPv6,
+  /**
+   * Unix domain stream socket, for peers on the same host. Data skips the
+   * TCP/IP stack altogether.
+   */
+  Unix,
+};
+
+/**
+ * \brief TCP settings of a connection. Settings at zero keep the system
+ * default.
+ */
+struct socket_options {
+  /** Send small writes at once rather than coalesce them (TCP_NODELAY). */
+  bool no_delay = true;
+  /** Size of the kernel receive buffer in bytes (SO_RCVBUF). */
+  int receive_buffer = 0;
+  /** Size of the kernel send buffer in bytes (SO_SNDBUF). */
+  int send_buffer = 0;
+  /**
+   * Time sent data may stay unacknowledged before the connection is dropped
+   * (TCP_USER_TIMEOUT).
+   */
+  std::chrono::milliseconds user_timeout{0};
+  /**
+   * Time blocking reads busy poll the device queue before they sleep
+   * (SO_BUSY_POLL). Trades CPU time for latency; raising it above the
+   * net.core.busy_read sysctl takes CAP_NET_ADMIN.
+   */
+  std::chrono::microseconds busy_poll{0};
+};
+
+/**
+ * \brief Settings of a listening socket.
+ */
+struct listen_options {
+  /** Connections waiting to be accepted before new ones are refused. */
+  int backlog = SOMAXCONN;
+  /** Let several sockets listen on the port, e.g. one per thread. */
+  bool reuse_port = true;
+  /**
+   * Time a connection may stay silent after the handshake before it is
+   * dropped; accept() only returns connections that sent data already,
+   * saving a wakeup per connection (TCP_DEFER_ACCEPT). Zero to accept
+   * connections as soon as they are established.
+   */
+  std::chrono::seconds defer_accept{0};
+  /**
+   * Length of the queue of TCP Fast Open handshakes, which carry the
+   * request in the SYN, or zero to disable them (TCP_FASTOPEN). The data of
+   * such a SYN may be replayed by the network.
+   */
+  int fast_open = 0;
+  /**
+   * IPv6 listeners only: accept IPv6 connections only, rather than IPv4
+   * ones too (IPV6_V6ONLY).
+   */
+  bool ipv6_only = false;
+  /** Settings inherited by the accepted connections. */
+  socket_options connection;
+};
+
 class socket {
 public:
   socket();
   explicit socket(int sockfd);
 
-  void listen(int port, int n = 3);
+  /**
+   * \brief Creates an unconnected socket of the given family.
+   *
+   * \throw std::system_error if the socket cannot be created.
+   */
+  explicit socket(socket_family family);
+
+  void listen(int port, int n = SOMAXCONN);
 
+  /**
+   * \brief Binds the socket to a port on all interfaces and listens for
+   * connections.
+   *
+   * \param port Port number to listen on, or 0 for any free port, which
+   * port() reports afterwards.
+   * \param options Settings of the socket and of the accepted connections.
+   * \throw std::system_error if a setting is not supported, or the port
+   * is in use.
+   */
+  void listen(int port, const listen_options &options);
+
+  /**
+   * \brief Binds a Unix domain socket to a path and listens for
+   * connections. A socket file left over at the path is replaced.
+   *
+   * \param path Path of the socket file, or a name starting with '@' for
+   * the abstract namespace, which leaves no file behind.
+   * \param n Maximum number of pending connections at once.
+   * \throw std::invalid_argument if the path is too long.
+   * \throw std::system_error if the path cannot be bound.
+   */
+  void listen_unix(std::string_view path, int n = SOMAXCONN);
+
+  /**
+   * \brief Waits for a connection on a listening socket and accepts it.
+   *
+   * \return The connection, with the address of the peer in host() and
+   * port(). Peers of Unix domain sockets have the host "unix:" followed by
+   * their path, if any, and port 0.
+   * \throw std::system_error if accepting fails.
+   */
   socket accept();
 
+  /**
+   * \brief Accepts the connections pending on a non-blocking listening
+   * socket, in one call per connection but without waiting in between.
+   *
+   * The connections are closed on exec and, if requested, non-blocking, set
+   * up by the same call that accepts them. Connections that fail while
+   * pending, e.g. reset by their peer or refused by a firewall rule, are
+   * skipped.
+   *
+   * \param out Sockets the connections are moved to, from the first on.
+   * \param nonBlocking Whether the connections are non-blocking, e.g. for
+   * handlers run on an event loop. Blocking connections suit handlers that
+   * read their requests with blocking calls, like request_processor.
+   * \return Number of connections accepted, up to out.size(), or 0 if none
+   * are pending.
+   * \throw std::system_error if accepting fails before any connection was
+   * accepted, e.g. because the process is out of file descriptors.
+   */
+  std::size_t accept_some(std::span<socket> out, bool nonBlocking = false);
+
+  /**
+   * \brief Connects to a server.
+   *
+   * \param host Numeric address of the server, IPv6 ones (e.g. "::1") on
+   * IPv6 sockets.
+   * \param port Port of the server.
+   */
   void connect(std::string_view host, int port = 8080);
 
+  /**
+   * \brief Connects a Unix domain socket to a server on the same host.
+   *
+   * \param path Path of the socket file, or a name starting with '@' in
+   * the abstract namespace.
+   * \throw std::invalid_argument if the path is too long.
+   * \throw std::system_error if the connection fails.
+   */
+  void connect_unix(std::string_view path);
+
   std::string_view host() const noexcept {
     return host_.empty() ? std::string_view("127.0.0.1")
                          : std::string_view(host_);
@@ -29,8 +183,140 @@ public:
 
   std::size_t write(const char *str, std::size_t len);
 
+  std::size_t write(const struct iovec *iov, int count);
+
+  /**
+   * \brief Copies bytes from a file to the socket without passing them
+   * through user space.
+   *
+   * \param fd File descriptor of the file to read from.
+   * \param offset Offset in the file to start reading at, advanced by the
+   * number of bytes written.
+   * \param count Maximum number of bytes to write.
+   * \return Number of bytes written.
+   */
+  std::size_t send_file(int fd, std::uint64_t &offset, std::size_t count);
+
   std::size_t read(char *str, std::size_t len);
 
+  /**
+   * \brief Reads from a non-blocking socket.
+   *
+   * \return Number of bytes read, 0 at the end of the stream, or -1 if no
+   * data is available right now.
+   */
+  std::ptrdiff_t try_read(char *str, std::size_t len);
+
+  /**
+   * \brief Writes to a non-blocking socket.
+   *
+   * \return Number of bytes written, or -1 if the socket buffer is full.
+   */
+  std::ptrdiff_t try_write(const struct iovec *iov, int count);
+
+  /**
+   * \brief Enables or disables non-blocking mode.
+   */
+  void non_blocking(bool enabled);
+
+  /**
+   * \brief Applies TCP settings to a connected or listening TCP socket.
+   *
+   * \throw std::system_error if a setting is not supported.
+   */
+  void apply(const socket_options &options);
+
+  /**
+   * \brief Holds back partial segments while corked, so that data written
+   * in several calls, e.g. a head followed by a file, leaves in full
+   * segments; uncorking sends what is left (TCP_CORK).
+   *
+   * \return false if the socket does not support corking, e.g. because it
+   * is not a TCP socket.
+   */
+  bool cork(bool enabled) noexcept;
+
+  /**
+   * \brief Enables or disables zero-copy sends with write_zerocopy()
+   * (SO_ZEROCOPY).
+   *
+   * \return false if the socket does not support them, e.g. because it is
+   * not a TCP socket or uses TLS.
+   */
+  bool zerocopy(bool enabled) noexcept;
+
+  /**
+   * \brief Writes without copying the data into the kernel (MSG_ZEROCOPY).
+   *
+   * The kernel sends the pages of the buffers as they are, so these must
+   * not be changed or freed until zerocopy_completed() covers the send.
+   * Each call that writes something is one send, numbered by
+   * zerocopy_sent(). Without zero-copy support, or when the kernel runs out
+   * of memory to pin pages, this is an ordinary copying write.
+   *
+   * \return Number of bytes written.
+   */
+  std::size_t write_zerocopy(const struct iovec *iov, int count);
+
+  /**
+   * \brief Gets the number of zero-copy sends so far.
+   */
+  std::uint32_t zerocopy_sent() const noexcept { return zerocopySent_; }
+
+  /**
+   * \brief Collects the completions of zero-copy sends from the error queue
+   * of the socket.
+   *
+   * \param timeout Time to wait for the sends still in flight.
+   * \return Number of sends completed so far. Their buffers are no longer
+   * used by the kernel.
+   */
+  std::uint32_t zerocopy_completed(std::chrono::milliseconds timeout = {});
+
+  /**
+   * \brief Closes the connection with a reset, discarding the data that was
+   * not sent yet (SO_LINGER with a zero timeout).
+   */
+  void abort() noexcept;
+
+  /**
+   * \brief Performs the server side of a TLS handshake on a connected,
+   * blocking socket. Afterwards all reads and writes on the socket are
+   * encrypted, including file copies with send_file().
+   *
+   * \param context Context providing the certificate and the session store.
+   * \throw tls_error if the handshake fails.
+   */
+  void tls_accept(const tls_context &context);
+
+  /**
+   * \brief True if the connection is encrypted with TLS.
+   */
+  bool secure() const noexcept { return tls_ != nullptr; }
+
+  /**
+   * \brief True if encryption of outgoing data has been handed over to the
+   * kernel (kTLS), so that send_file() copies files without passing them
+   * through user space.
+   */
+  bool kernel_tls() const noexcept { return ktls_; }
+
+  /**
+   * \brief True if the TLS handshake resumed an earlier session.
+   */
+  bool tls_resumed() const noexcept;
+
+  /**
+   * \brief Gets the application protocol negotiated with ALPN, or an empty
+   * view if none was.
+   */
+  std::string_view alpn_protocol() const noexcept;
+
+  /**
+   * \brief Gets the file descriptor of the socket.
+   */
+  int native_handle() const noexcept { return fd_; }
+
   void close() noexcept;
 
   operator bool() const noexcept { return fd_ >= 0; }
@@ -39,8 +325,18 @@ private:
   int fd_ = -1;
   std::string host_;
   int port_ = -1;
+  ::ssl_st *tls_ = nullptr;
+  bool ktls_ = false;
+  bool zerocopy_ = false;
+  std::uint32_t zerocopySent_ = 0;
+  std::uint32_t zerocopyDone_ = 0;
 
+  socket(int fd, const struct sockaddr_storage &peer);
   void move(socket &) noexcept;
+  std::ptrdiff_t tls_read(char *str, std::size_t len);
+  std::ptrdiff_t tls_write(const struct iovec *iov, int count);
+  std::size_t tls_send_file(int fd, std::uint64_t &offset, std::size_t count);
+  void tls_close() noexcept;
 
 public:
   virtual ~socket() noexcept { close(); }
@@ -75,7 +371,43 @@ public:
    * \param port Port number to listen on.
    * \param n Maximum number of pending connections at once.
    */
-  explicit server_socket(int port, int n = 3) : socket() { listen(port, n); }
+  explicit server_socket(int port, int n = SOMAXCONN) : socket() {
+    listen(port, n);
+  }
+
+  /**
+   * \brief Creates a new server socket that listens on the specified port.
+   * \param port Port number to listen on.
+   * \param options Settings of the socket and of the accepted connections.
+   */
+  server_socket(int port, const listen_options &options) : socket() {
+    listen(port, options);
+  }
+
+  /**
+   * \brief Creates a new server socket of the given family that listens on
+   * the specified port, e.g. a dual-stack IPv6 one.
+   * \param family IPv4 or IPv6.
+   * \param port Port number to listen on.
+   * \param options Settings of the socket and of the accepted connections.
+   */
+  server_socket(socket_family family, int port,
+                const listen_options &options = {})
+      : socket(family) {
+    listen(port, options);
+  }
+
+  /**
+   * \brief Creates a new Unix domain server socket that listens on the
+   * specified path.
+   * \param path Path of the socket file, or a name starting with '@' for
+   * the abstract namespace.
+   * \param n Maximum number of pending connections at once.
+   */
+  explicit server_socket(std::string_view path, int n = SOMAXCONN)
+      : socket(socket_family::Unix) {
+    listen_unix(path, n);
+  }
 
   using socket::accept;
   using socket::close;
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <memory_resource>
+#include <system_error>
 #include <vector>
 
 #include <cppws/socket.hpp>
@@ -11,6 +12,10 @@ namespace cppws {
 /**
  * \brief streambuf implementation that reads characters from a socket.
  *
+ * Socket streams are kept for code built on iostreams. Request processing
+ * reads through a connection_buffer instead, which avoids the virtual calls
+ * and sentries of the stream layer for every character.
+ *
  * \tparam Char character type
  * \tparam Traits character traits of the stream
  * \tparam Alloc allocator used to allocate the stream buffer.
@@ -35,9 +40,10 @@ public:
    */
   basic_socket_streambuf(class socket &&sock, const Alloc &allocator,
                          std::size_t ibufsz = 1024, std::size_t obufsz = 1024)
-      : socket_(std::move(sock)), ibuf_(allocator), obuf_(allocator) {
+      : ibuf_(allocator), obuf_(allocator), socket_(std::move(sock)) {
     ibuf_.resize(ibufsz);
     obuf_.resize(obufsz);
+    setp(obuf_.data(), obuf_.data() + obuf_.size());
   }
 
   /**
@@ -62,21 +68,26 @@ public:
 
 protected:
   int_type overflow(int_type ch) override {
-    if (pptr() == epptr()) {
-      sync();
-    }
-    if (pptr() != epptr()) {
-      Traits::assign(*pptr(), ch);
-      return *pptr();
-    }
-    return Traits::eof();
+    if (sync() != 0)
+      return Traits::eof();
+    if (Traits::eq_int_type(ch, Traits::eof()))
+      return Traits::not_eof(ch);
+
+    // Without an output buffer, every character is written on its own.
+    //
+    char c = Traits::to_char_type(ch);
+    if (pptr() == epptr())
+      return write_out(&c, 1) ? ch : Traits::eof();
+    Traits::assign(*pptr(), c);
+    pbump(1);
+    return ch;
   }
 
   int_type sync() override {
-    std::size_t n = socket_.write(reinterpret_cast<const char *>(obuf_.data()),
-                                  obuf_.size() * sizeof(Char));
-    setp(obuf_.data(), obuf_.data() + n / sizeof(Char));
-    return pptr() == epptr() ? Traits::eof() : *pptr();
+    if (!write_out(pbase(), pptr() - pbase()))
+      return -1;
+    setp(obuf_.data(), obuf_.data() + obuf_.size());
+    return 0;
   }
 
   int_type underflow() override {
@@ -87,6 +98,26 @@ protected:
     }
     return gptr() == egptr() ? Traits::eof() : Traits::to_int_type(*gptr());
   }
+
+private:
+  /**
+   * Writes bytes in full, as the socket may take fewer at a time. Returns
+   * false if the connection failed or was closed.
+   */
+  bool write_out(const char *p, std::size_t left) {
+    try {
+      while (left > 0) {
+        std::size_t n = socket_.write(p, left);
+        if (n == 0)
+          return false;
+        p += n;
+        left -= n;
+      }
+    } catch (const std::system_error &) {
+      return false;
+    }
+    return true;
+  }
 };
 
 /**
@@ -98,14 +129,14 @@ class basic_socket_iostream : public std::basic_iostream<Char, Traits> {
   basic_socket_streambuf<Char, Traits, Alloc> streambuf_;
 
 public:
-  basic_socket_iostream() = default;
+  basic_socket_iostream() : std::basic_iostream<Char, Traits>(&streambuf_) {}
 
   /**
    * \brief Constructs a new socket stream.
    * \param socket Socket to read/write
    * \param allocator Allocator used to allocate the internal stream buffer.
    */
-  basic_socket_iostream(socket &&socket, const Alloc &allocator = Alloc())
+  basic_socket_iostream(class socket &&socket, const Alloc &allocator = Alloc())
       : std::basic_iostream<Char, Traits>(&streambuf_),
         streambuf_(std::move(socket), allocator) {}
 
@@ -145,10 +176,21 @@ public:
   }
 
   virtual ~basic_socket_iostream() noexcept {}
-  basic_socket_iostream(basic_socket_iostream &&) noexcept = default;
+  // The stream state moves, but the stream keeps reading from its own
+  // buffer rather than the one of the other stream.
+  //
+  basic_socket_iostream(basic_socket_iostream &&other) noexcept
+      : std::basic_iostream<Char, Traits>(std::move(other)),
+        streambuf_(std::move(other.streambuf_)) {
+    this->set_rdbuf(&streambuf_);
+  }
   basic_socket_iostream(const basic_socket_iostream &) = delete;
 
-  basic_socket_iostream &operator=(basic_socket_iostream &&) noexcept = default;
+  basic_socket_iostream &operator=(basic_socket_iostream &&other) noexcept {
+    std::basic_iostream<Char, Traits>::operator=(std::move(other));
+    streambuf_ = std::move(other.streambuf_);
+    return *this;
+  }
   basic_socket_iostream &operator=(const basic_socket_iostream &) = delete;
 };
 
@@ -161,14 +203,14 @@ class basic_socket_istream : public std::basic_istream<Char, Traits> {
   basic_socket_streambuf<Char, Traits, Alloc> streambuf_;
 
 public:
-  basic_socket_istream() = default;
+  basic_socket_istream() : std::basic_istream<Char, Traits>(&streambuf_) {}
 
   /**
    * \brief Constructs a new socket stream.
    * \param socket Socket to read/write
    * \param allocator Allocator used to allocate the internal stream buffer.
    */
-  basic_socket_istream(socket &&socket, const Alloc &allocator = Alloc())
+  basic_socket_istream(class socket &&socket, const Alloc &allocator = Alloc())
       : std::basic_istream<Char, Traits>(&streambuf_),
         streambuf_(std::move(socket), allocator, 1024, 0) {}
 
@@ -208,10 +250,21 @@ public:
   }
 
   virtual ~basic_socket_istream() noexcept {}
-  basic_socket_istream(basic_socket_istream &&) noexcept = default;
+  // The stream state moves, but the stream keeps reading from its own
+  // buffer rather than the one of the other stream.
+  //
+  basic_socket_istream(basic_socket_istream &&other) noexcept
+      : std::basic_istream<Char, Traits>(std::move(other)),
+        streambuf_(std::move(other.streambuf_)) {
+    this->set_rdbuf(&streambuf_);
+  }
   basic_socket_istream(const basic_socket_istream &) = delete;
 
-  basic_socket_istream &operator=(basic_socket_istream &&) noexcept = default;
+  basic_socket_istream &operator=(basic_socket_istream &&other) noexcept {
+    std::basic_istream<Char, Traits>::operator=(std::move(other));
+    streambuf_ = std::move(other.streambuf_);
+    return *this;
+  }
   basic_socket_istream &operator=(const basic_socket_istream &) = delete;
 };
 
@@ -224,14 +277,14 @@ class basic_socket_ostream : public std::basic_ostream<Char, Traits> {
   basic_socket_streambuf<Char, Traits, Alloc> streambuf_;
 
 public:
-  basic_socket_ostream() = default;
+  basic_socket_ostream() : std::basic_ostream<Char, Traits>(&streambuf_) {}
 
   /**
    * \brief Constructs a new socket stream.
    * \param socket Socket to read/write
    * \param allocator Allocator used to allocate the internal stream buffer.
    */
-  basic_socket_ostream(socket &&socket, const Alloc &allocator = Alloc())
+  basic_socket_ostream(class socket &&socket, const Alloc &allocator = Alloc())
       : std::basic_ostream<Char, Traits>(&streambuf_),
         streambuf_(std::move(socket), allocator, 0, 1024) {}
 
@@ -271,54 +324,85 @@ public:
   }
 
   virtual ~basic_socket_ostream() noexcept {}
-  basic_socket_ostream(basic_socket_ostream &&) noexcept = default;
+  // The stream state moves, but the stream keeps reading from its own
+  // buffer rather than the one of the other stream.
+  //
+  basic_socket_ostream(basic_socket_ostream &&other) noexcept
+      : std::basic_ostream<Char, Traits>(std::move(other)),
+        streambuf_(std::move(other.streambuf_)) {
+    this->set_rdbuf(&streambuf_);
+  }
   basic_socket_ostream(const basic_socket_ostream &) = delete;
 
-  basic_socket_ostream &operator=(basic_socket_ostream &&) noexcept = default;
+  basic_socket_ostream &operator=(basic_socket_ostream &&other) noexcept {
+    std::basic_ostream<Char, Traits>::operator=(std::move(other));
+    streambuf_ = std::move(other.streambuf_);
+    return *this;
+  }
   basic_socket_ostream &operator=(const basic_socket_ostream &) = delete;
 };
 
+// Sockets carry bytes, which the stream buffer hands out as chars whatever
+// the character type of the stream; streams of other character types are
+// deprecated.
+//
 using socket_streambuf = basic_socket_streambuf<char>;
-using socket_wstreambuf = basic_socket_streambuf<wchar_t>;
-using socket_u8streambuf = basic_socket_streambuf<char8_t>;
-using socket_u16streambuf = basic_socket_streambuf<char16_t>;
-using socket_u32streambuf = basic_socket_streambuf<char32_t>;
+using socket_wstreambuf [[deprecated("Use the char streams")]] =
+    basic_socket_streambuf<wchar_t>;
+using socket_u8streambuf [[deprecated("Use the char streams")]] =
+    basic_socket_streambuf<char8_t>;
+using socket_u16streambuf [[deprecated("Use the char streams")]] =
+    basic_socket_streambuf<char16_t>;
+using socket_u32streambuf [[deprecated("Use the char streams")]] =
+    basic_socket_streambuf<char32_t>;
 
 using socket_iostream = basic_socket_iostream<char>;
 using socket_istream = basic_socket_istream<char>;
 using socket_ostream = basic_socket_ostream<char>;
 
-using socket_wiostream = basic_socket_iostream<wchar_t>;
-using socket_wistream = basic_socket_istream<wchar_t>;
-using socket_wostream = basic_socket_ostream<wchar_t>;
-
-using socket_u8iostream = basic_socket_iostream<char8_t>;
-using socket_u8istream = basic_socket_istream<char8_t>;
-using socket_u8ostream = basic_socket_ostream<char8_t>;
-
-using socket_u16iostream = basic_socket_iostream<char16_t>;
-using socket_u16istream = basic_socket_istream<char16_t>;
-using socket_u16ostream = basic_socket_ostream<char16_t>;
-
-using socket_u32iostream = basic_socket_iostream<char32_t>;
-using socket_u32istream = basic_socket_istream<char32_t>;
-using socket_u32ostream = basic_socket_ostream<char32_t>;
+using socket_wiostream [[deprecated("Use the char streams")]] =
+    basic_socket_iostream<wchar_t>;
+using socket_wistream [[deprecated("Use the char streams")]] =
+    basic_socket_istream<wchar_t>;
+using socket_wostream [[deprecated("Use the char streams")]] =
+    basic_socket_ostream<wchar_t>;
+
+using socket_u8iostream [[deprecated("Use the char streams")]] =
+    basic_socket_iostream<char8_t>;
+using socket_u8istream [[deprecated("Use the char streams")]] =
+    basic_socket_istream<char8_t>;
+using socket_u8ostream [[deprecated("Use the char streams")]] =
+    basic_socket_ostream<char8_t>;
+
+using socket_u16iostream [[deprecated("Use the char streams")]] =
+    basic_socket_iostream<char16_t>;
+using socket_u16istream [[deprecated("Use the char streams")]] =
+    basic_socket_istream<char16_t>;
+using socket_u16ostream [[deprecated("Use the char streams")]] =
+    basic_socket_ostream<char16_t>;
+
+using socket_u32iostream [[deprecated("Use the char streams")]] =
+    basic_socket_iostream<char32_t>;
+using socket_u32istream [[deprecated("Use the char streams")]] =
+    basic_socket_istream<char32_t>;
+using socket_u32ostream [[deprecated("Use the char streams")]] =
+    basic_socket_ostream<char32_t>;
 
 namespace pmr {
 
 using socket_streambuf =
     basic_socket_streambuf<char, std::char_traits<char>,
                            std::pmr::polymorphic_allocator<char>>;
-using socket_wstreambuf =
+using socket_wstreambuf [[deprecated("Use the char streams")]] =
     basic_socket_streambuf<wchar_t, std::char_traits<wchar_t>,
                            std::pmr::polymorphic_allocator<wchar_t>>;
-using socket_u8streambuf =
+using socket_u8streambuf [[deprecated("Use the char streams")]] =
     basic_socket_streambuf<char8_t, std::char_traits<char8_t>,
                            std::pmr::polymorphic_allocator<char8_t>>;
-using socket_u16streambuf =
+using socket_u16streambuf [[deprecated("Use the char streams")]] =
     basic_socket_streambuf<char16_t, std::char_traits<char16_t>,
                            std::pmr::polymorphic_allocator<char16_t>>;
-using socket_u32streambuf =
+using socket_u32streambuf [[deprecated("Use the char streams")]] =
     basic_socket_streambuf<char32_t, std::char_traits<char32_t>,
                            std::pmr::polymorphic_allocator<char32_t>>;
 
@@ -332,43 +416,43 @@ using socket_ostream =
     basic_socket_ostream<char, std::char_traits<char>,
                          std::pmr::polymorphic_allocator<char>>;
 
-using socket_wiostream =
+using socket_wiostream [[deprecated("Use the char streams")]] =
     basic_socket_iostream<wchar_t, std::char_traits<wchar_t>,
                           std::pmr::polymorphic_allocator<wchar_t>>;
-using socket_wistream =
+using socket_wistream [[deprecated("Use the char streams")]] =
     basic_socket_istream<wchar_t, std::char_traits<wchar_t>,
                          std::pmr::polymorphic_allocator<wchar_t>>;
-using socket_wostream =
+using socket_wostream [[deprecated("Use the char streams")]] =
     basic_socket_ostream<wchar_t, std::char_traits<wchar_t>,
                          std::pmr::polymorphic_allocator<wchar_t>>;
 
-using socket_u8iostream =
+using socket_u8iostream [[deprecated("Use the char streams")]] =
     basic_socket_iostream<char8_t, std::char_traits<char8_t>,
                           std::pmr::polymorphic_allocator<char8_t>>;
-using socket_u8istream =
+using socket_u8istream [[deprecated("Use the char streams")]] =
     basic_socket_istream<char8_t, std::char_traits<char8_t>,
                          std::pmr::polymorphic_allocator<char8_t>>;
-using socket_u8ostream =
+using socket_u8ostream [[deprecated("Use the char streams")]] =
     basic_socket_ostream<char8_t, std::char_traits<char8_t>,
                          std::pmr::polymorphic_allocator<char8_t>>;
 
-using socket_u16iostream =
+using socket_u16iostream [[deprecated("Use the char streams")]] =
     basic_socket_iostream<char16_t, std::char_traits<char16_t>,
                           std::pmr::polymorphic_allocator<char16_t>>;
-using socket_u16istream =
+using socket_u16istream [[deprecated("Use the char streams")]] =
     basic_socket_istream<char16_t, std::char_traits<char16_t>,
                          std::pmr::polymorphic_allocator<char16_t>>;
-using socket_u16ostream =
+using socket_u16ostream [[deprecated("Use the char streams")]] =
     basic_socket_ostream<char16_t, std::char_traits<char16_t>,
                          std::pmr::polymorphic_allocator<char16_t>>;
 
-using socket_u32iostream =
+using socket_u32iostream [[deprecated("Use the char streams")]] =
     basic_socket_iostream<char32_t, std::char_traits<char32_t>,
                           std::pmr::polymorphic_allocator<char32_t>>;
-using socket_u32istream =
+using socket_u32istream [[deprecated("Use the char streams")]] =
     basic_socket_istream<char32_t, std::char_traits<char32_t>,
                          std::pmr::polymorphic_allocator<char32_t>>;
-using socket_u32ostream =
+using socket_u32ostream [[deprecated("Use the char streams")]] =
     basic_socket_ostream<char32_t, std::char_traits<char32_t>,
                          std::pmr::polymorphic_allocator<char32_t>>;
 
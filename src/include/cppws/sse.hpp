@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cppws/event_loop.hpp>
+#include <cppws/output_queue.hpp>
+#include <cppws/request_manager.hpp>
+#include <cppws/socket.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Event of a text/event-stream.
+ */
+struct sse_event {
+  /** Event type; the client's default ("message") if empty. */
+  std::string_view event = {};
+  /** Payload, sent as one data field per line. */
+  std::string_view data = {};
+  /** Event id, sent back by reconnecting clients as Last-Event-ID. */
+  std::string_view id = {};
+  /** Reconnection delay for the client, or zero to leave it unchanged. */
+  std::chrono::milliseconds retry{0};
+};
+
+/**
+ * \brief Appends the wire format of an event to \p out.
+ *
+ * Line breaks (CRLF, LF or CR) in the data start a new data field. Line
+ * breaks in the event type and id would end the field early, so these are
+ * cut at the first line break.
+ */
+void append_sse_event(std::string &out, const sse_event &event);
+
+/**
+ * \brief Settings of event streams.
+ */
+struct sse_options {
+  /** Bytes queued for a slow client before the overflow policy applies. */
+  std::size_t max_queued_bytes = 1 << 20;
+  /** What to do with events that do not fit the queue of a slow client. */
+  overflow_policy overflow = overflow_policy::DropOldest;
+  /** Bytes queued at which the stream is paused, see sse_stream::paused(). */
+  std::size_t high_water = 256 << 10;
+  /** Bytes queued at which a paused stream resumes. */
+  std::size_t low_water = 64 << 10;
+  /** Reconnection delay sent to the client at the start of the stream. */
+  std::chrono::milliseconds retry{0};
+};
+
+/**
+ * \brief Server-Sent Events stream (a text/event-stream response that stays
+ * open).
+ *
+ * A stream is created from a request with accept(), which sends the head of
+ * the response and hands the connection over to an event loop. Events are
+ * then queued and written without blocking, so one loop serves any number of
+ * subscribers:
+ *
+ * \code
+ * mapper.map(http_method::GET, "/events", [&](request_manager &m) {
+ *   if (auto stream = sse_stream::accept(m, loop))
+ *     channel.subscribe(std::move(stream));
+ * });
+ * \endcode
+ *
+ * Each stream has a bounded output queue. When a client does not keep up,
+ * the stream first pauses at sse_options::high_water, so that producers that
+ * can wait hold back their events until on_resume() is called. Beyond
+ * sse_options::max_queued_bytes, events are dropped or the client is
+ * disconnected according to sse_options::overflow.
+ *
+ * Events may be sent from any thread. When called from another thread than
+ * the loop's, the event is serialized on the calling thread and queued by
+ * the loop.
+ */
+class sse_stream : public std::enable_shared_from_this<sse_stream> {
+  struct private_tag {};
+
+public:
+  /**
+   * \brief Sends the head of an event stream response and hands the
+   * connection over to an event loop.
+   *
+   * \param manager Context of the request.
+   * \param loop Event loop that will serve the connection.
+   * \param options Settings of the stream.
+   * \return The stream.
+   */
+  static std::shared_ptr<sse_stream> accept(request_manager &manager,
+                                            event_loop &loop,
+                                            const sse_options &options = {});
+
+  sse_stream(private_tag, class socket &&connection, event_loop &loop,
+             const sse_options &options, std::string lastEventId);
+
+  /**
+   * \brief Sends an event.
+   */
+  void send(const sse_event &event);
+
+  /**
+   * \brief Sends serialized events, e.g. shared with other streams.
+   *
+   * \param data One or more complete events, see append_sse_event().
+   */
+  void send(output_queue::chunk data);
+
+  /**
+   * \brief Sends a comment line, which clients ignore. Useful to keep idle
+   * connections from being closed by intermediaries.
+   */
+  void comment(std::string_view text = {});
+
+  /**
+   * \brief Ends the stream once the queued events are written.
+   */
+  void close();
+
+  /**
+   * \brief True once the connection is closed, by either side.
+   */
+  bool closed() const noexcept {
+    return closed_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief True while the client is too slow for more events, i.e. from the
+   * time its queue reached the high watermark until it is down to the low
+   * one.
+   */
+  bool paused() const noexcept {
+    return paused_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Sets a callback invoked on the loop thread whenever the stream
+   * resumes after being paused, or is closed while paused. Must be called
+   * on the loop thread, e.g. from a task posted to loop().
+   */
+  void on_resume(event_loop::task fn);
+
+  /**
+   * \brief Gets the Last-Event-ID sent by a reconnecting client, or an
+   * empty string.
+   */
+  const std::string &last_event_id() const noexcept { return lastEventId_; }
+
+  /**
+   * \brief Gets the number of events dropped because the client was too
+   * slow. Only meaningful on the loop thread.
+   */
+  std::uint64_t dropped() const noexcept { return queue_.dropped(); }
+
+  /**
+   * \brief Gets the event loop serving the connection.
+   */
+  event_loop &loop() noexcept { return *loop_; }
+
+private:
+  friend class sse_channel;
+
+  void start();
+  void enqueue(output_queue::chunk data);
+  void on_event(std::uint32_t events);
+  void flush();
+  void update_paused();
+  void shutdown();
+
+  class socket socket_;
+  event_loop *loop_;
+  output_queue queue_;
+  event_loop::task onResume_;
+  std::string lastEventId_;
+  bool started_ = false;
+  bool pollingOutput_ = false;
+  bool closeAfterFlush_ = false;
+  std::atomic_bool paused_ = false;
+  std::atomic_bool closed_ = false;
+};
+
+/**
+ * \brief Broadcasts events to a set of streams.
+ *
+ * An event is serialized once, and the same buffer is queued on every
+ * subscriber, with one task posted per event loop rather than per stream.
+ * Closed streams are dropped from the channel as events are published.
+ * All functions may be called from any thread.
+ */
+class sse_channel {
+public:
+  /**
+   * \brief Adds a stream to the channel.
+   */
+  void subscribe(std::shared_ptr<sse_stream> stream);
+
+  /**
+   * \brief Sends an event to all subscribers.
+   *
+   * \return Number of streams the event was queued for.
+   */
+  std::size_t publish(const sse_event &event);
+
+  /**
+   * \brief Sends serialized events to all subscribers.
+   *
+   * \return Number of streams the events were queued for.
+   */
+  std::size_t publish(output_queue::chunk data);
+
+  /**
+   * \brief Gets the number of subscribers, including closed streams that
+   * have not been dropped yet.
+   */
+  std::size_t size() const;
+
+private:
+  using stream_list = std::vector<std::shared_ptr<sse_stream>>;
+
+  /**
+   * Subscribers served by one event loop. The list is replaced rather than
+   * modified, so that posted tasks can share it.
+   */
+  struct group {
+    event_loop *loop;
+    std::shared_ptr<const stream_list> streams;
+  };
+
+  mutable std::mutex lock_;
+  std::vector<group> groups_;
+};
+
+} // namespace cppws
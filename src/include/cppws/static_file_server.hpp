@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <cppws/request_manager.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Settings of a static_file_server.
+ */
+struct static_file_options {
+  /** Maximum number of files kept open in the cache. */
+  std::size_t max_open_files = 1024;
+  /** File served for requests to a directory. */
+  std::string index = "index.html";
+  /** Value of the Cache-Control header of served files, or empty for none. */
+  std::string cache_control = "public, max-age=3600";
+  /**
+   * Serve precompressed variants of compressible files: ".br", ".zst" and
+   * ".gz" files next to them are used when they are up to date, and a gzip
+   * variant is built in memory when there is none.
+   */
+  bool precompress = true;
+  /** Files smaller than this are not compressed in memory. */
+  std::size_t precompress_min_size = 1024;
+  /** Files larger than this are not compressed in memory. */
+  std::size_t precompress_max_size = 16 << 20;
+};
+
+/**
+ * \brief Handler that serves the files of a directory tree.
+ *
+ * Open descriptors, sizes, validators and content types of served files are
+ * kept in an LRU cache, so a repeated request costs no system calls besides
+ * the ones sending the response. Cached entries are invalidated through
+ * inotify as soon as the files change. File contents are sent with
+ * sendfile(), and conditional and range requests are honored.
+ *
+ * Compressible files are served in the best encoding the client accepts
+ * among their precompressed variants (see static_file_options::precompress),
+ * so compression is paid once per file rather than once per request.
+ *
+ * The server is cheap to copy; copies share the cache. Map it to a prefix
+ * for both GET and HEAD:
+ *
+ * \code
+ * static_file_server assets{"/srv/www/assets", "/assets"};
+ * mapper.map_prefix(http_method::GET, "/assets", assets);
+ * mapper.map_prefix(http_method::HEAD, "/assets", assets);
+ * \endcode
+ */
+class static_file_server {
+public:
+  /**
+   * \brief Constructs a server for a directory.
+   *
+   * \param root Directory to serve.
+   * \param mount Path prefix the server is mapped to, which is stripped from
+   * request paths before they are resolved against \p root.
+   * \param options Settings of the server.
+   * \throw std::system_error if the directory cannot be opened or watched.
+   */
+  static_file_server(const std::filesystem::path &root,
+                     std::string_view mount = "/",
+                     static_file_options options = {});
+
+  /**
+   * \brief Serves the file a request refers to, or 404 Not Found.
+   */
+  void operator()(request_manager &manager) const;
+
+  /**
+   * \brief Opens the files of the directory tree, and builds their
+   * precompressed variants, ahead of the first requests. Stops when the cache
+   * is full.
+   */
+  void preload() const;
+
+  /**
+   * \brief Gets the number of files in the cache.
+   */
+  std::size_t cached_files() const;
+
+private:
+  struct state;
+  std::shared_ptr<state> state_;
+};
+
+} // namespace cppws
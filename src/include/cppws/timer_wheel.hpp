@@ -0,0 +1,131 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <cppws/inplace_function.hpp>
+
+namespace cppws {
+
+using namespace std::chrono_literals;
+
+/**
+ * \brief Hierarchical timing wheel.
+ *
+ * Time advances in ticks of a fixed resolution. Timers due within 64 ticks
+ * sit in the slot of their tick on the first level; later ones sit on
+ * coarser levels, 64 times coarser each, and move down a level whenever
+ * the wheel below wraps around. Arming and cancelling a timer are O(1),
+ * and so is advancing by one tick apart from the timers that expire or
+ * move down. Timers never fire early, and late by up to one tick plus the
+ * time until advance() is called.
+ *
+ * Timers are owned by the code that arms them, e.g. as a member of a
+ * connection, so that arming one never allocates. A wheel is not thread
+ * safe; the event_loop has one for the callbacks running on its thread.
+ */
+class timer_wheel {
+public:
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * \brief Callback invoked when a timer expires.
+   */
+  using callback = inplace_function<void()>;
+
+  /**
+   * \brief Timer that can be armed on a wheel. Destroying a timer cancels
+   * it.
+   */
+  class timer {
+  public:
+    timer() noexcept = default;
+    ~timer() { cancel(); }
+
+    timer(const timer &) = delete;
+    timer &operator=(const timer &) = delete;
+
+    /**
+     * \brief True if the timer is armed and has not expired yet.
+     */
+    bool armed() const noexcept { return wheel_ != nullptr; }
+
+    /**
+     * \brief Disarms the timer, if it is armed.
+     */
+    void cancel() noexcept;
+
+  private:
+    friend class timer_wheel;
+
+    timer_wheel *wheel_ = nullptr;
+    timer *prev_ = nullptr;
+    timer *next_ = nullptr;
+    std::uint64_t expiry_ = 0;
+    std::uint16_t slot_ = 0;
+    callback fn_;
+  };
+
+  /**
+   * \brief Creates an empty wheel starting at the current time.
+   *
+   * \param resolution Duration of a tick.
+   */
+  explicit timer_wheel(std::chrono::milliseconds resolution = 10ms);
+  ~timer_wheel();
+
+  timer_wheel(const timer_wheel &) = delete;
+  timer_wheel &operator=(const timer_wheel &) = delete;
+
+  /**
+   * \brief Arms a timer, or re-arms it if it is already armed.
+   *
+   * \param t Timer to arm. It must stay alive until it expires or is
+   * cancelled.
+   * \param delay Time after which the timer expires.
+   * \param fn Callback invoked by advance() once the timer expired. The
+   * timer is disarmed then and may be armed again by the callback.
+   */
+  void arm(timer &t, std::chrono::milliseconds delay, callback fn);
+
+  /**
+   * \brief Expires the timers that are due at \p now.
+   *
+   * \return Number of timers that expired.
+   */
+  std::size_t advance(clock::time_point now = clock::now());
+
+  /**
+   * \brief Gets the time until advance() may have timers to expire, in
+   * milliseconds rounded up, or -1 if no timer is armed. Suited as the
+   * timeout of a poll.
+   */
+  int next_timeout(clock::time_point now = clock::now()) const noexcept;
+
+  /**
+   * \brief Gets the number of armed timers.
+   */
+  std::size_t size() const noexcept { return size_; }
+
+private:
+  static constexpr int LEVELS = 4;
+  static constexpr int SLOT_BITS = 6;
+  static constexpr std::uint64_t SLOTS = 1 << SLOT_BITS;
+
+  std::uint64_t tick_of(clock::time_point t) const noexcept;
+  void link(timer &t) noexcept;
+  void unlink(timer &t) noexcept;
+  void cascade(int level) noexcept;
+
+  clock::time_point origin_;
+  clock::duration resolution_;
+  /** Next tick to process. */
+  std::uint64_t now_ = 0;
+  std::size_t size_ = 0;
+  timer *slots_[LEVELS][SLOTS] = {};
+  /** Non-empty slots of each level, one bit per slot. */
+  std::uint64_t occupied_[LEVELS] = {};
+};
+
+} // namespace cppws
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct ssl_ctx_st;
+
+namespace cppws {
+
+/**
+ * \brief Error reported by the TLS library.
+ */
+class tls_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * \brief Settings of a TLS server context.
+ */
+struct tls_options {
+  /** PEM file with the certificate, followed by its chain. */
+  std::string certificate_file;
+  /** PEM file with the private key of the certificate. */
+  std::string private_key_file;
+  /**
+   * Application protocols offered with ALPN, most preferred first, e.g.
+   * {"h2", "http/1.1"}. Empty to not negotiate a protocol.
+   */
+  std::vector<std::string> alpn;
+  /** Sessions kept in the server side cache for resumption. */
+  std::size_t session_cache_size = 20 * 1024;
+  /** Lifetime of cached sessions and session tickets. */
+  std::chrono::seconds session_timeout{300};
+  /**
+   * Issue session tickets, so that resumptions do not need a cache entry.
+   * The ticket keys are kept by the context and rotated automatically.
+   */
+  bool session_tickets = true;
+  /**
+   * Hand the record layer to the kernel (kTLS) after the handshake where
+   * supported, so that files can still be sent with sendfile().
+   */
+  bool kernel_tls = true;
+};
+
+/**
+ * \brief Counters of the handshakes of a tls_context.
+ */
+struct tls_session_stats {
+  /** Completed handshakes, including resumptions. */
+  long handshakes;
+  /** Handshakes that resumed a session from the cache or a ticket. */
+  long resumed;
+  /** Resumptions that were asked for but failed, e.g. expired sessions. */
+  long misses;
+  /** Sessions currently in the cache. */
+  long cached;
+};
+
+/**
+ * \brief Server side TLS context: certificate, protocol settings and the
+ * session store shared by every connection accepted with it.
+ *
+ * A context is typically created once at startup and shared by all threads
+ * accepting connections (see socket::tls_accept()); sharing it is what lets
+ * a client resume its session on any connection without a full handshake.
+ *
+ * Creating a context makes the process ignore SIGPIPE, so that writing to a
+ * connection the peer has closed fails with EPIPE instead.
+ */
+class tls_context {
+public:
+  /**
+   * \brief Creates a context.
+   *
+   * \throw tls_error if the certificate or key cannot be loaded.
+   */
+  explicit tls_context(const tls_options &options);
+  ~tls_context() noexcept;
+
+  tls_context(const tls_context &) = delete;
+  tls_context &operator=(const tls_context &) = delete;
+
+  /**
+   * \brief Gets the handshake counters of the context.
+   */
+  tls_session_stats stats() const noexcept;
+
+  /**
+   * \brief Gets the OpenSSL context (SSL_CTX).
+   */
+  ::ssl_ctx_st *native_handle() const noexcept { return ctx_; }
+
+private:
+  ::ssl_ctx_st *ctx_ = nullptr;
+  std::string alpn_;
+};
+
+} // namespace cppws
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cppws/http_request.hpp>
+#include <cppws/request_manager.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Error talking to an upstream server: it could not be reached, the
+ * connection broke or the response was malformed.
+ */
+class upstream_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+/**
+ * \brief Address of an upstream server.
+ */
+struct upstream_address {
+  /**
+   * Numeric address of the server, e.g. "10.0.0.7" or "::1", or the path of
+   * a Unix domain socket on the same host after "unix:", e.g.
+   * "unix:/run/app.sock" or "unix:@app" in the abstract namespace. The
+   * port is ignored for Unix domain sockets.
+   */
+  std::string host;
+  int port = 80;
+};
+
+/**
+ * \brief Settings of an upstream_pool.
+ */
+struct upstream_options {
+  /** Idle keep-alive connections kept per upstream. */
+  std::size_t max_idle = 16;
+  /** Idle connections older than this are closed rather than reused. */
+  std::chrono::milliseconds idle_timeout{30000};
+  /** Requests sent on a connection before it is retired. */
+  std::size_t max_requests = 1000;
+  /** Longest wait for the upstream to accept or produce data. */
+  std::chrono::milliseconds io_timeout{30000};
+  /** Largest response head accepted. */
+  std::size_t max_header_size = 64 << 10;
+};
+
+/**
+ * \brief Request sent to an upstream with upstream_pool::fetch().
+ */
+struct upstream_request {
+  http_method method = http_method::GET;
+  std::string target = "/";
+  /** Headers of the request. Host defaults to the upstream address. */
+  std::vector<std::pair<std::string, std::string>> headers = {};
+  std::string body = {};
+};
+
+/**
+ * \brief Response received from an upstream.
+ */
+struct upstream_response {
+  int status = 0;
+  std::string reason;
+  std::vector<std::pair<std::string, std::string>> headers;
+  /** Body of the response, with any transfer coding removed. */
+  std::string body;
+
+  /**
+   * \brief Finds the value of the first header with the given name (compared
+   * case-insensitively), or an empty view if there is none.
+   */
+  std::string_view header(std::string_view name) const noexcept;
+};
+
+/**
+ * \brief Counters of an upstream_pool.
+ */
+struct upstream_stats {
+  /** Connections opened. */
+  std::uint64_t connects;
+  /** Requests sent on a kept-alive connection instead of a new one. */
+  std::uint64_t reused;
+  /** Idle connections found closed, expired or unhealthy when reused. */
+  std::uint64_t discarded;
+};
+
+/**
+ * \brief HTTP/1.1 client for upstream servers, keeping connections alive
+ * between requests in per-upstream pools.
+ *
+ * Opening a connection costs a round trip before the first request can be
+ * sent; reusing one does not. Connections are returned to the pool once a
+ * response has been read completely and checked again before they are
+ * reused, since the upstream may close them while they are idle. Requests
+ * that hit such a connection are retried once on a new one if they are
+ * idempotent. Several requests can be pipelined on one connection with
+ * fetch_all().
+ *
+ * Calls block the calling thread, like the handlers that make them; a pool
+ * may be shared by any number of threads.
+ */
+class upstream_pool {
+public:
+  /**
+   * \brief Creates an empty pool.
+   */
+  explicit upstream_pool(const upstream_options &options = {});
+  ~upstream_pool() noexcept;
+
+  upstream_pool(const upstream_pool &) = delete;
+  upstream_pool &operator=(const upstream_pool &) = delete;
+
+  /**
+   * \brief Sends a request and reads the response into memory.
+   *
+   * \throw upstream_error if the request failed.
+   */
+  upstream_response fetch(const upstream_address &address,
+                          const upstream_request &request);
+
+  /**
+   * \brief Sends requests on a single connection without waiting for the
+   * responses in between (pipelining), then reads the responses in order.
+   *
+   * \throw upstream_error if a request failed.
+   */
+  std::vector<upstream_response>
+  fetch_all(const upstream_address &address,
+            std::span<const upstream_request> requests);
+
+  /**
+   * \brief Forwards the request of a handler to an upstream and answers it
+   * with the upstream's response.
+   *
+   * Hop-by-hop headers are removed in both directions. The response body is
+   * streamed to the client as it arrives, never held in memory as a whole,
+   * unless the response goes to a response_sink (HTTP/2), which needs the
+   * complete response. Bodies relayed unchanged are spliced from the
+   * upstream socket to the client socket within the kernel.
+   *
+   * \param address Upstream to forward to.
+   * \param manager Context of the request.
+   * \param via Name this proxy adds to the Via header in both directions
+   * (RFC 9110 section 7.6.3), or empty to leave Via alone.
+   * \throw upstream_error if the request failed. Nothing has been sent to
+   * the client if manager.sent() is false; otherwise the response was cut
+   * short and the connection should be closed.
+   */
+  void forward(const upstream_address &address, request_manager &manager,
+               std::string_view via = {});
+
+  /**
+   * \brief Closes all idle connections.
+   */
+  void clear() noexcept;
+
+  /**
+   * \brief Gets the number of idle connections in the pool.
+   */
+  std::size_t idle() const noexcept;
+
+  /**
+   * \brief Gets the counters of the pool.
+   */
+  upstream_stats stats() const noexcept;
+
+private:
+  class connection;
+
+  std::unique_ptr<connection> acquire(const upstream_address &address,
+                                      bool &reused);
+  void release(std::unique_ptr<connection> c) noexcept;
+
+  upstream_options options_;
+
+  mutable std::mutex lock_;
+  std::unordered_map<std::string, std::vector<std::unique_ptr<connection>>>
+      idle_;
+
+  std::atomic<std::uint64_t> connects_ = 0;
+  std::atomic<std::uint64_t> reused_ = 0;
+  std::atomic<std::uint64_t> discarded_ = 0;
+};
+
+} // namespace cppws
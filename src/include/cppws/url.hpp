@@ -48,8 +48,8 @@ public:
       if (end_ - ptr_ < 3)
         throw std::runtime_error("Expected two hexadecimal values after '%'");
 
-      int lo = ptr_[1];
-      int hi = ptr_[2];
+      int hi = ptr_[1];
+      int lo = ptr_[2];
 
       if (lo <= 'f' && lo >= 'a')
         lo = lo - 'a' + 10;
@@ -58,7 +58,8 @@ public:
       else if (lo <= '9' && lo >= '0')
         lo = lo - '0';
       else
-        throw std::runtime_error("Expected a hexadecimal digit after '%'");
+        throw std::runtime_error(
+            "Expected a hexadecimal digit after '%' and first hex digit.");
 
       if (hi <= 'f' && hi >= 'a')
         hi = hi - 'a' + 10;
@@ -67,8 +68,7 @@ public:
       else if (hi <= '9' && hi >= '0')
         hi = hi - '0';
       else
-        throw std::runtime_error(
-            "Expected a hexadecimal digit after '%' and first hex digit.");
+        throw std::runtime_error("Expected a hexadecimal digit after '%'");
 
       return lo | (hi << 4);
 
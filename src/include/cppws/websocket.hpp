@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cppws/connection_buffer.hpp>
+#include <cppws/event_loop.hpp>
+#include <cppws/request_manager.hpp>
+#include <cppws/socket.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Opcodes of WebSocket frames (RFC 6455 section 5.2).
+ */
+enum class websocket_opcode : std::uint8_t {
+  Continuation = 0x0,
+  Text = 0x1,
+  Binary = 0x2,
+  Close = 0x8,
+  Ping = 0x9,
+  Pong = 0xA
+};
+
+/**
+ * \brief Status codes of WebSocket close frames (RFC 6455 section 7.4.1).
+ */
+namespace websocket_close {
+constexpr std::uint16_t NORMAL = 1000;
+constexpr std::uint16_t GOING_AWAY = 1001;
+constexpr std::uint16_t PROTOCOL_ERROR = 1002;
+constexpr std::uint16_t UNSUPPORTED_DATA = 1003;
+constexpr std::uint16_t NO_STATUS = 1005;
+constexpr std::uint16_t ABNORMAL = 1006;
+constexpr std::uint16_t INVALID_PAYLOAD = 1007;
+constexpr std::uint16_t POLICY_VIOLATION = 1008;
+constexpr std::uint16_t MESSAGE_TOO_BIG = 1009;
+constexpr std::uint16_t INTERNAL_ERROR = 1011;
+} // namespace websocket_close
+
+/**
+ * \brief Settings of WebSocket connections.
+ */
+struct websocket_options {
+  /** Largest message accepted, after reassembly of fragments. */
+  std::size_t max_message_size = 16 << 20;
+  /** Supported subprotocols, in order of preference. */
+  std::vector<std::string> protocols;
+};
+
+class websocket;
+
+/**
+ * \brief Receives the events of a WebSocket connection. All callbacks are
+ * invoked on the event loop thread of the connection.
+ */
+class websocket_handler {
+public:
+  virtual ~websocket_handler() = default;
+
+  /**
+   * \brief Called once the connection is registered with its event loop.
+   */
+  virtual void on_open(websocket & /*ws*/) {}
+
+  /**
+   * \brief Called for every complete message.
+   *
+   * \param ws Connection the message was received on.
+   * \param message Payload of the message, valid during the call.
+   * \param binary true for binary messages, false for (UTF-8) text.
+   */
+  virtual void on_message(websocket &ws, std::string_view message,
+                          bool binary) = 0;
+
+  /**
+   * \brief Called once when the connection is closed, cleanly or not.
+   *
+   * \param ws Connection that was closed.
+   * \param code Close status code; websocket_close::ABNORMAL if the
+   * connection was lost without a close frame.
+   * \param reason Reason sent by the peer, if any.
+   */
+  virtual void on_close(websocket & /*ws*/, std::uint16_t /*code*/,
+                        std::string_view /*reason*/) {}
+};
+
+/**
+ * \brief Server side of a WebSocket connection.
+ *
+ * A connection is created by upgrading an HTTP request with accept(), after
+ * which the socket is served by an event_loop rather than a request
+ * processor thread. Fragmented messages are reassembled, pings are answered
+ * and the closing handshake is carried out by the connection; the handler
+ * only sees complete messages.
+ *
+ * \code
+ * mapper.map(http_method::GET, "/live", [&loop, handler](request_manager &m) {
+ *   websocket::accept(m, loop, handler);
+ * });
+ * \endcode
+ *
+ * The send functions may be called from any thread. When called from
+ * another thread than the loop's, the frame is serialized on the calling
+ * thread and written by the loop.
+ */
+class websocket : public std::enable_shared_from_this<websocket> {
+  struct private_tag {};
+
+public:
+  /**
+   * \brief Completes the opening handshake of a WebSocket request and hands
+   * the connection over to an event loop.
+   *
+   * Requests that are not valid WebSocket handshakes are answered with 400
+   * Bad Request, or 426 Upgrade Required for unsupported versions.
+   *
+   * \param manager Context of the upgrade request.
+   * \param loop Event loop that will serve the connection.
+   * \param handler Handler of the connection's events.
+   * \param options Settings of the connection.
+   * \return The connection, or nullptr if the handshake failed.
+   */
+  static std::shared_ptr<websocket>
+  accept(request_manager &manager, event_loop &loop,
+         std::shared_ptr<websocket_handler> handler,
+         const websocket_options &options = {});
+
+  websocket(private_tag, class socket &&connection, event_loop &loop,
+            std::shared_ptr<websocket_handler> handler,
+            const websocket_options &options, std::string protocol);
+
+  /**
+   * \brief Sends a text message.
+   */
+  void send_text(std::string_view text) {
+    send(websocket_opcode::Text, text);
+  }
+
+  /**
+   * \brief Sends a binary message.
+   */
+  void send_binary(std::string_view data) {
+    send(websocket_opcode::Binary, data);
+  }
+
+  /**
+   * \brief Sends a ping. The peer answers with a pong that is discarded.
+   */
+  void ping(std::string_view payload = {}) {
+    send(websocket_opcode::Ping, payload.substr(0, 125));
+  }
+
+  /**
+   * \brief Starts the closing handshake.
+   *
+   * \param code Status code to send.
+   * \param reason Reason to send, at most 123 bytes.
+   */
+  void close(std::uint16_t code = websocket_close::NORMAL,
+             std::string_view reason = {});
+
+  /**
+   * \brief Gets the subprotocol selected during the handshake, or an empty
+   * string.
+   */
+  const std::string &protocol() const noexcept { return protocol_; }
+
+  /**
+   * \brief Gets the event loop serving the connection.
+   */
+  event_loop &loop() noexcept { return *loop_; }
+
+private:
+  void start();
+  void send(websocket_opcode opcode, std::string_view payload);
+  void on_event(std::uint32_t events);
+  bool read_frames();
+  bool handle_frame(bool fin, websocket_opcode opcode, std::string_view data);
+  void deliver(std::string_view message, bool binary);
+  void fail(std::uint16_t code);
+  void flush();
+  void shutdown(std::uint16_t code, std::string_view reason);
+
+  class socket socket_;
+  event_loop *loop_;
+  std::shared_ptr<websocket_handler> handler_;
+  std::size_t maxMessageSize_;
+  std::string protocol_;
+
+  connection_buffer input_;
+  std::string message_;
+  websocket_opcode messageOpcode_ = websocket_opcode::Continuation;
+
+  std::string output_;
+  std::size_t written_ = 0;
+  bool pollingOutput_ = false;
+
+  bool closeSent_ = false;
+  bool closeAfterFlush_ = false;
+  bool closed_ = false;
+};
+
+/**
+ * \brief Computes the Sec-WebSocket-Accept value for a Sec-WebSocket-Key.
+ */
+std::string websocket_accept_key(std::string_view key);
+
+/**
+ * \brief XORs data with a WebSocket masking key, in place.
+ *
+ * Uses AVX2 or SSE2 to process 32 or 16 bytes at a time when the CPU
+ * supports it.
+ *
+ * \param data Data to (un)mask.
+ * \param length Length of the data.
+ * \param key Masking key as it appears on the wire (in memory order).
+ */
+void websocket_mask(char *data, std::size_t length, std::uint32_t key) noexcept;
+
+} // namespace cppws
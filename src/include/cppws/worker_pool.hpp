@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <cppws/inplace_function.hpp>
+
+namespace cppws {
+
+/**
+ * \brief Fixed set of threads running posted tasks, in the order they were
+ * posted.
+ *
+ * Handlers may block, e.g. on a database or an upstream, so connections
+ * served by an event loop run them on a pool rather than on the loop
+ * thread, which would stall every other connection of the loop meanwhile.
+ */
+class worker_pool {
+public:
+  /**
+   * \brief Task run on one of the threads.
+   */
+  using task = inplace_function<void()>;
+
+  /**
+   * \brief Starts the threads.
+   *
+   * \param threads Number of threads; at least one is started.
+   */
+  explicit worker_pool(
+      std::size_t threads = std::thread::hardware_concurrency());
+
+  /**
+   * \brief Runs the tasks that are still queued, then joins the threads.
+   */
+  ~worker_pool() noexcept;
+
+  worker_pool(const worker_pool &) = delete;
+  worker_pool &operator=(const worker_pool &) = delete;
+
+  /**
+   * \brief Queues a task. May be called from any thread, including the
+   * threads of the pool.
+   */
+  void post(task fn);
+
+  /**
+   * \brief Queues a batch of tasks at once, taking the lock of the queue
+   * once rather than once per task. The tasks are moved from.
+   */
+  void post(std::span<task> tasks);
+
+  /**
+   * \brief Gets the number of threads.
+   */
+  std::size_t size() const noexcept { return threads_.size(); }
+
+  /**
+   * \brief Gets the pool shared by the connections that are not given one,
+   * started on first use with a thread per core.
+   */
+  static std::shared_ptr<worker_pool> shared();
+
+private:
+  void run();
+
+  std::mutex lock_;
+  std::condition_variable ready_;
+  std::deque<task> queue_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+} // namespace cppws
@@ -0,0 +1,283 @@
+#include <array>
+#include <charconv>
+#include <condition_variable>
+#include <ctime>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <cppws/compression.hpp>
+#include <cppws/http_date.hpp>
+#include <cppws/microcache.hpp>
+
+using clock_type = std::chrono::steady_clock;
+
+namespace {
+
+struct string_hash {
+  using is_transparent = void;
+  std::size_t operator()(std::string_view v) const noexcept {
+    return std::hash<std::string_view>{}(v);
+  }
+};
+
+/**
+ * Serialized response along with the validators of its representation.
+ */
+struct stored_response {
+  cppws::prebuilt_response response;
+  std::string etag;
+  std::time_t last_modified = -1;
+  /** True if conditional requests may be answered from the response. */
+  bool conditional = false;
+};
+
+struct entry {
+  std::string key;
+  /** Cached response, or nullptr if the response is not cacheable. */
+  std::shared_ptr<const stored_response> response;
+  clock_type::time_point expires;
+  std::size_t size;
+};
+
+} // namespace
+
+struct cppws::microcache::shard {
+  std::mutex lock;
+  std::condition_variable filled;
+
+  /** Entries, most recently used first. */
+  std::list<entry> lru;
+  std::unordered_map<std::string_view, std::list<entry>::iterator> index;
+  std::unordered_set<std::string, string_hash, std::equal_to<>> filling;
+  std::size_t bytes = 0;
+  std::size_t limit = 0;
+
+  void erase(std::list<entry>::iterator it) {
+    bytes -= it->size;
+    index.erase(it->key);
+    lru.erase(it);
+  }
+};
+
+/**
+ * Computes how long a response may be cached from its status and headers.
+ *
+ * \return The lifetime, or zero if the response must not be cached.
+ */
+static std::chrono::milliseconds freshness(const cppws::response_buffer &r,
+                                           std::chrono::milliseconds ttl) {
+  using cppws::http_response_header;
+
+  switch (r.status().status_code) {
+  case 200:
+  case 203:
+  case 204:
+  case 300:
+  case 301:
+  case 404:
+  case 410:
+    break;
+  default:
+    return {};
+  }
+
+  if (!r.header_value(to_string(http_response_header::SetCookie)).empty())
+    return {};
+
+  std::string_view cc =
+      r.header_value(to_string(http_response_header::CacheControl));
+  bool shared = false;
+  while (!cc.empty()) {
+    std::size_t comma = cc.find(',');
+    std::string_view directive = cppws::trim_ows(cc.substr(0, comma));
+    cc.remove_prefix(comma == std::string_view::npos ? cc.size() : comma + 1);
+
+    std::size_t eq = directive.find('=');
+    std::string_view name = directive.substr(0, eq);
+    if (cppws::iequals(name, "no-store") || cppws::iequals(name, "private") ||
+        cppws::iequals(name, "no-cache"))
+      return {};
+
+    bool smax = cppws::iequals(name, "s-maxage");
+    if (eq == std::string_view::npos ||
+        !(smax || (!shared && cppws::iequals(name, "max-age"))))
+      continue;
+
+    std::string_view value = directive.substr(eq + 1);
+    std::uint64_t seconds;
+    auto [ptr, ec] =
+        std::from_chars(value.data(), value.data() + value.size(), seconds);
+    if (ec != std::errc())
+      continue;
+    ttl = std::chrono::seconds(seconds);
+    shared = shared || smax;
+  }
+  return ttl;
+}
+
+cppws::microcache::ticket::ticket(ticket &&other) noexcept
+    : response_(std::move(other.response_)), validators_(other.validators_),
+      conditional_(other.conditional_), shard_(other.shard_),
+      key_(std::move(other.key_)) {
+  other.shard_ = nullptr;
+}
+
+cppws::microcache::ticket::~ticket() {
+  if (shard_)
+    release(*shard_, key_);
+}
+
+cppws::microcache::microcache(microcache_options options)
+    : options_(std::move(options)) {
+  if (options_.shards == 0)
+    options_.shards = 1;
+  shards_ = std::make_unique<shard[]>(options_.shards);
+  for (std::size_t i = 0; i < options_.shards; ++i)
+    shards_[i].limit = options_.max_bytes / options_.shards;
+}
+
+cppws::microcache::~microcache() = default;
+
+void cppws::microcache::release(shard &s, const std::string &key) {
+  {
+    std::unique_lock l{s.lock};
+    s.filling.erase(key);
+  }
+  s.filled.notify_all();
+}
+
+cppws::microcache::ticket
+cppws::microcache::lookup(const http_request &request) {
+  ticket t;
+  if (request.http_method() != http_method::GET ||
+      request.http_header(http_request_header::Authorization))
+    return t;
+
+  // Build the key on the stack so that hits do not allocate for typical
+  // URI lengths.
+  //
+  std::array<std::byte, 512> mem;
+  std::pmr::monotonic_buffer_resource res{mem.data(), mem.size()};
+  std::pmr::string key{&res};
+  for (const std::pmr::string &seg : request.uri()) {
+    key.append(1, '/');
+    key.append(seg);
+  }
+  for (http_request_header h : options_.vary) {
+    key.append(1, '\n');
+    const std::pmr::string *value = request.http_header(h);
+    if (!value)
+      continue;
+    if (h == http_request_header::AcceptEncoding)
+      key.append(to_string(negotiate_encoding(*value)));
+    else
+      key.append(*value);
+  }
+
+  std::string_view k = key;
+  shard &s = shards_[std::hash<std::string_view>{}(k) % options_.shards];
+
+  std::unique_lock l{s.lock};
+  clock_type::time_point deadline = clock_type::now() + options_.fill_timeout;
+  for (;;) {
+    auto it = s.index.find(k);
+    if (it != s.index.end() && it->second->expires > clock_type::now()) {
+      s.lru.splice(s.lru.begin(), s.lru, it->second);
+      if (const auto &stored = it->second->response) {
+        t.response_ = {stored, &stored->response};
+        t.validators_ = {stored->etag, stored->last_modified};
+        t.conditional_ = stored->conditional;
+      }
+      return t;
+    }
+
+    if (!s.filling.contains(k)) {
+      t.key_.assign(k);
+      s.filling.insert(t.key_);
+      t.shard_ = &s;
+      return t;
+    }
+
+    if (s.filled.wait_until(l, deadline) == std::cv_status::timeout)
+      return t;
+  }
+}
+
+void cppws::microcache::fill(ticket &t, request_manager &manager) {
+  if (!t.shard_)
+    return;
+
+  // A 304 or 412 answered by the handler through validate() says nothing
+  // about the full response, so the entry is left for the next request to
+  // fill rather than marked as uncacheable.
+  //
+  const response_buffer &r = manager.response();
+  int code = r.status().status_code;
+  if (manager.sent() && (code == 304 || code == 412))
+    return;
+
+  std::shared_ptr<stored_response> response;
+  std::chrono::milliseconds ttl = options_.ttl;
+  if (!manager.sent()) {
+    ttl = freshness(r, ttl);
+    if (ttl.count() > 0) {
+      response = std::make_shared<stored_response>();
+      response->etag = r.header_value(to_string(http_response_header::ETag));
+      std::string_view modified =
+          r.header_value(to_string(http_response_header::LastModified));
+      if (!modified.empty() &&
+          !parse_http_date(modified, response->last_modified))
+        response->last_modified = -1;
+      response->conditional = code == 200 || code == 203;
+      if (!manager.snapshot(response->response))
+        response.reset();
+    }
+    if (!response)
+      ttl = options_.ttl;
+  }
+
+  shard &s = *t.shard_;
+  std::size_t size = sizeof(entry) + 2 * t.key_.size() + 64 +
+                     (response ? response->response.bytes().size() +
+                                     response->etag.size()
+                               : 0);
+  {
+    std::unique_lock l{s.lock};
+    if (auto it = s.index.find(t.key_); it != s.index.end())
+      s.erase(it->second);
+
+    if (size <= s.limit) {
+      while (s.bytes + size > s.limit)
+        s.erase(std::prev(s.lru.end()));
+      s.lru.push_front({t.key_, response, clock_type::now() + ttl, size});
+      s.index.emplace(s.lru.front().key, s.lru.begin());
+      s.bytes += size;
+    }
+  }
+  release(s, t.key_);
+  t.shard_ = nullptr;
+
+  if (!response)
+    return;
+
+  // The response built by the handler already carries its validators.
+  //
+  if (response->conditional &&
+      evaluate_preconditions(manager.request(),
+                             {response->etag, response->last_modified}) ==
+          precondition_result::NotModified)
+    manager.status(http::NOT_MODIFIED).send();
+  else
+    manager.write(response->response);
+}
+
+std::size_t cppws::microcache::size() const {
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < options_.shards; ++i) {
+    std::unique_lock l{shards_[i].lock};
+    total += shards_[i].bytes;
+  }
+  return total;
+}
@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include <cppws/output_queue.hpp>
+
+bool cppws::output_queue::push(chunk data) {
+  if (!data || data->empty())
+    return true;
+
+  if (!chunks_.empty() && bytes_ + data->size() > maxBytes_) {
+    switch (policy_) {
+    case overflow_policy::Disconnect:
+      return false;
+
+    case overflow_policy::DropNewest:
+      ++dropped_;
+      return true;
+
+    case overflow_policy::DropOldest: {
+      // A partially written chunk has to be completed, or the peer would
+      // see a truncated chunk followed by the next one.
+      //
+      std::size_t keep = offset_ > 0 ? 1 : 0;
+      while (chunks_.size() > keep && bytes_ + data->size() > maxBytes_) {
+        auto it = chunks_.begin() + keep;
+        bytes_ -= (*it)->size();
+        chunks_.erase(it);
+        ++dropped_;
+      }
+      break;
+    }
+    }
+  }
+
+  bytes_ += data->size();
+  chunks_.push_back(std::move(data));
+  if (bytes_ >= highWater_)
+    paused_ = true;
+  return true;
+}
+
+void cppws::output_queue::watermarks(std::size_t high,
+                                     std::size_t low) noexcept {
+  highWater_ = high;
+  lowWater_ = std::min(low, high);
+  paused_ = paused_ ? bytes_ > lowWater_ : bytes_ >= highWater_;
+}
+
+bool cppws::output_queue::flush(class socket &connection) {
+  constexpr std::size_t max_iov = 64;
+  struct iovec iov[max_iov];
+
+  while (!chunks_.empty()) {
+    std::size_t count = std::min(chunks_.size(), max_iov);
+    for (std::size_t i = 0; i < count; ++i) {
+      const std::string &c = *chunks_[i];
+      std::size_t skip = i == 0 ? offset_ : 0;
+      iov[i] = {const_cast<char *>(c.data()) + skip, c.size() - skip};
+    }
+
+    std::ptrdiff_t n = connection.try_write(iov, static_cast<int>(count));
+    if (n < 0) {
+      if (bytes_ <= lowWater_)
+        paused_ = false;
+      return false;
+    }
+
+    bytes_ -= static_cast<std::size_t>(n);
+    std::size_t written = static_cast<std::size_t>(n) + offset_;
+    while (!chunks_.empty() && written >= chunks_.front()->size()) {
+      written -= chunks_.front()->size();
+      chunks_.pop_front();
+    }
+    offset_ = written;
+  }
+  paused_ = false;
+  return true;
+}
+
+void cppws::output_queue::clear() noexcept {
+  chunks_.clear();
+  offset_ = 0;
+  bytes_ = 0;
+  paused_ = false;
+}
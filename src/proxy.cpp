@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <cppws/http_response.hpp>
+#include <cppws/proxy.hpp>
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+/**
+ * Points each upstream gets on the hash ring. More points spread the keys
+ * more evenly.
+ */
+constexpr std::size_t RING_POINTS = 160;
+
+/**
+ * FNV-1a, followed by the splitmix64 finalizer so that similar keys land
+ * far apart on the ring.
+ */
+static std::uint64_t hash_key(std::string_view key) noexcept {
+  std::uint64_t h = 0xcbf29ce484222325;
+  for (char c : key) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001b3;
+  }
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111eb;
+  h ^= h >> 31;
+  return h;
+}
+
+static std::int64_t now_ticks() noexcept {
+  return clock_type::now().time_since_epoch().count();
+}
+
+static bool idempotent(cppws::http_method method) noexcept {
+  using enum cppws::http_method;
+  return method != POST && method != PATCH && method != CONNECT;
+}
+
+cppws::upstream_group::upstream_group(std::vector<upstream_address> upstreams,
+                                       proxy_options options)
+    : options_(std::move(options)), members_(upstreams.size()),
+      pool_(options_.upstream) {
+  if (upstreams.empty())
+    throw std::invalid_argument("An upstream group needs an upstream");
+
+  for (std::size_t i = 0; i < upstreams.size(); ++i)
+    members_[i].address = std::move(upstreams[i]);
+
+  if (options_.policy == balancing::consistent_hash) {
+    ring_.reserve(members_.size() * RING_POINTS);
+    for (std::size_t i = 0; i < members_.size(); ++i) {
+      std::string key = members_[i].address.host + ':' +
+                        std::to_string(members_[i].address.port) + '#';
+      for (std::size_t p = 0; p < RING_POINTS; ++p)
+        ring_.emplace_back(hash_key(key + std::to_string(p)), i);
+    }
+    std::ranges::sort(ring_);
+  }
+}
+
+std::size_t cppws::upstream_group::pick(const http_request &request) const {
+  return pick(request, NONE);
+}
+
+std::size_t cppws::upstream_group::pick(const http_request &request,
+                                        std::size_t skip) const {
+  std::int64_t now = now_ticks();
+  std::size_t n = members_.size();
+
+  // Ejected upstreams are only considered once no other one is left.
+  //
+  for (bool ejected : {false, true}) {
+    auto eligible = [&](std::size_t i) {
+      return i != skip &&
+             (ejected || members_[i].ejectedUntil.load(
+                             std::memory_order_relaxed) <= now);
+    };
+
+    switch (options_.policy) {
+    case balancing::round_robin: {
+      std::size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+      for (std::size_t k = 0; k < n; ++k) {
+        if (eligible((start + k) % n))
+          return (start + k) % n;
+      }
+      break;
+    }
+    case balancing::least_outstanding: {
+      // Scanning from a rotating start spreads ties over the upstreams.
+      //
+      std::size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+      std::size_t best = NONE;
+      for (std::size_t k = 0; k < n; ++k) {
+        std::size_t i = (start + k) % n;
+        if (eligible(i) &&
+            (best == NONE || members_[i].outstanding.load() <
+                                 members_[best].outstanding.load()))
+          best = i;
+      }
+      if (best != NONE)
+        return best;
+      break;
+    }
+    case balancing::consistent_hash: {
+      std::string_view key = request.target();
+      if (!options_.hash_header.empty()) {
+        if (const std::pmr::string *value =
+                request.http_header(options_.hash_header))
+          key = *value;
+      }
+      auto it = std::ranges::lower_bound(
+          ring_, std::pair<std::uint64_t, std::size_t>{hash_key(key), 0});
+
+      // The next point clockwise, or the next one of another upstream if
+      // that one is not eligible.
+      //
+      for (std::size_t k = 0; k < ring_.size(); ++k, ++it) {
+        if (it == ring_.end())
+          it = ring_.begin();
+        if (eligible(it->second))
+          return it->second;
+      }
+      break;
+    }
+    }
+  }
+  return NONE;
+}
+
+void cppws::upstream_group::succeeded(member &m) noexcept {
+  m.fails.store(0, std::memory_order_relaxed);
+}
+
+void cppws::upstream_group::failed(member &m) noexcept {
+  // The count is not reset by an ejection: an upstream that fails again
+  // right after it is back is ejected again at once.
+  //
+  if (m.fails.fetch_add(1, std::memory_order_relaxed) + 1 >=
+      options_.max_fails) {
+    auto span =
+        std::chrono::duration_cast<clock_type::duration>(options_.eject_time);
+    m.ejectedUntil.store(now_ticks() + span.count(),
+                         std::memory_order_relaxed);
+  }
+}
+
+void cppws::upstream_group::forward(request_manager &manager) {
+  const http_request &request = manager.request();
+  std::size_t skip = NONE;
+
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    std::size_t i = pick(request, skip);
+    if (i == NONE)
+      break;
+
+    member &m = members_[i];
+    ++m.outstanding;
+    try {
+      pool_.forward(m.address, manager, options_.via);
+      --m.outstanding;
+      succeeded(m);
+      return;
+    } catch (const upstream_error &) {
+      --m.outstanding;
+
+      // Once the response is under way, the failure may be the client's
+      // and the response cannot be replaced any more.
+      //
+      if (manager.sent())
+        throw;
+      failed(m);
+      if (!idempotent(request.http_method()))
+        break;
+      skip = i;
+    } catch (...) {
+      --m.outstanding;
+      throw;
+    }
+  }
+
+  manager.response().clear();
+  manager.status(http::BAD_GATEWAY)
+      .body(http::body("The upstream server could not be reached."));
+}
+
+std::vector<cppws::upstream_status> cppws::upstream_group::status() const {
+  std::int64_t now = now_ticks();
+  std::vector<upstream_status> out;
+  out.reserve(members_.size());
+  for (const member &m : members_)
+    out.push_back({.address = m.address,
+                   .outstanding = m.outstanding.load(),
+                   .fails = m.fails.load(),
+                   .ejected = m.ejectedUntil.load() > now});
+  return out;
+}
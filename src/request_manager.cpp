@@ -0,0 +1,199 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+#include <cppws/byte_range.hpp>
+#include <cppws/http_date.hpp>
+#include <cppws/request_manager.hpp>
+
+void cppws::request_manager::encode() {
+  compression_governor &governor = compression_governor::global();
+  if (compression_ && response_->compressible(governor.options().min_size)) {
+    response_->header(http_response_header::Vary, "Accept-Encoding");
+    const std::pmr::string *accept =
+        request_->http_header(http_request_header::AcceptEncoding);
+    if (accept)
+      response_->compress(negotiate_encoding(*accept), governor.level());
+  }
+  compression_ = false;
+}
+
+void cppws::request_manager::send() {
+  if (sent_)
+    return;
+  sent_ = true;
+
+  encode();
+  bool includeBody = request_->http_method() != http_method::HEAD;
+  if (sink_) {
+    sink_->write_response(*response_, includeBody);
+    return;
+  }
+  response_->send(*connection_, includeBody);
+}
+
+bool cppws::request_manager::snapshot(prebuilt_response &out) {
+  if (sent_)
+    return false;
+  encode();
+  return response_->snapshot(out);
+}
+
+bool cppws::request_manager::validate(const resource_validators &validators) {
+  validators_ = validators;
+
+  if (!validators.etag.empty())
+    header(http_response_header::ETag, validators.etag);
+
+  if (validators.last_modified >= 0) {
+    char date[http_date_length];
+    header(http_response_header::LastModified,
+           std::string_view(
+               date, format_http_date(date, validators.last_modified)));
+  }
+
+  switch (evaluate_preconditions(*request_, validators)) {
+  case precondition_result::NotModified:
+    status(http::NOT_MODIFIED);
+    break;
+  case precondition_result::PreconditionFailed:
+    status(http::PRECONDITION_FAILED);
+    break;
+  default:
+    return false;
+  }
+  send();
+  return true;
+}
+
+void cppws::request_manager::write(std::string_view bytes) {
+  sent_ = true;
+  if (sink_) {
+    sink_->write_response(bytes);
+    return;
+  }
+  while (!bytes.empty()) {
+    std::size_t n = connection_->write(bytes.data(), bytes.length());
+    if (n == 0)
+      throw std::runtime_error("Connection closed while writing response");
+    bytes.remove_prefix(n);
+  }
+}
+
+void cppws::request_manager::write(const prebuilt_response &response) {
+  sent_ = true;
+  if (sink_) {
+    std::string out;
+    response.serialize(out);
+    sink_->write_response(out);
+    return;
+  }
+  response.send(*connection_);
+}
+
+cppws::socket cppws::request_manager::detach() {
+  if (!connection_)
+    throw std::logic_error("Connection cannot be detached from its protocol");
+  sent_ = true;
+  return std::move(*connection_);
+}
+
+/**
+ * True if the If-Range header of a request (if any) still matches the
+ * representation, i.e. the requested ranges may be served.
+ */
+static bool if_range_matches(const cppws::http_request &request,
+                             const cppws::resource_validators &validators) {
+  const std::pmr::string *header =
+      request.http_header(cppws::http_request_header::IfRange);
+  if (!header)
+    return true;
+
+  std::string_view value = cppws::trim_ows(*header);
+  if (value.starts_with('"') || value.starts_with("W/"))
+    return cppws::etag_equals(value, validators.etag, false);
+
+  std::time_t date;
+  return validators.last_modified >= 0 &&
+         cppws::parse_http_date(value, date) &&
+         date == validators.last_modified;
+}
+
+/**
+ * Makes a boundary for a multipart/byteranges body that is unique to the
+ * process and unlikely to appear in the file.
+ */
+static std::array<char, 24> make_boundary() {
+  static std::atomic<std::uint64_t> counter{static_cast<std::uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count())};
+  std::uint64_t n = counter.fetch_add(0x9e3779b97f4a7c15,
+                                      std::memory_order_relaxed);
+
+  std::array<char, 24> out{'c', 'p', 'p', 'w', 's', '-', '-', '-'};
+  for (std::size_t i = 8; i < out.size(); ++i, n >>= 4)
+    out[i] = "0123456789abcdef"[n & 0xf];
+  return out;
+}
+
+void cppws::request_manager::send_file(int fd, std::uint64_t size) {
+  response_->clear_body();
+  header(http_response_header::AcceptRanges, "bytes");
+
+  const std::pmr::string *range =
+      request_->http_header(http_request_header::Range);
+  if (!range || request_->http_method() != http_method::GET ||
+      response_->status().status_code != 200 ||
+      !if_range_matches(*request_, validators_)) {
+    response_->file(fd, 0, size);
+    send();
+    return;
+  }
+
+  std::array<std::byte, 512> mem;
+  std::pmr::monotonic_buffer_resource res{mem.data(), mem.size()};
+  std::pmr::vector<byte_range> ranges{&res};
+
+  switch (parse_byte_ranges(*range, size, ranges)) {
+  case range_result::Ignore:
+    response_->file(fd, 0, size);
+    break;
+
+  case range_result::Unsatisfiable: {
+    char value[32];
+    auto end = std::format_to(value, "bytes */{}", size);
+    status(http::RANGE_NOT_SATISFIABLE);
+    header(http_response_header::ContentRange, std::string_view(value, end));
+    response_->content_type("");
+    break;
+  }
+
+  case range_result::Satisfiable:
+    status(http::PARTIAL_CONTENT);
+    if (ranges.size() == 1) {
+      char value[64];
+      auto end = std::format_to(value, "bytes {}-{}/{}", ranges[0].first,
+                                ranges[0].last, size);
+      header(http_response_header::ContentRange,
+             std::string_view(value, end));
+      response_->file(fd, ranges[0].first, ranges[0].length());
+      break;
+    }
+
+    std::array<char, 24> boundary = make_boundary();
+    std::string_view b(boundary.data(), boundary.size());
+    std::pmr::string type{response_->content_type(), &res};
+    content_type(std::format("multipart/byteranges; boundary={}", b));
+
+    for (const byte_range &r : ranges) {
+      format("\r\n--{}\r\n", b);
+      if (!type.empty())
+        format("Content-Type: {}\r\n", type);
+      format("Content-Range: bytes {}-{}/{}\r\n\r\n", r.first, r.last, size);
+      response_->file(fd, r.first, r.length());
+    }
+    format("\r\n--{}--\r\n", b);
+    break;
+  }
+  send();
+}
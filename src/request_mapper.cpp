@@ -0,0 +1,22 @@
+#include <cppws/http_response.hpp>
+#include <cppws/request_mapper.hpp>
+
+void cppws::dispatch_request(request_mapper &mapper,
+                             request_manager &manager) {
+  const request_mapper::handler *handler = mapper.resolve(manager.request());
+  if (!handler) {
+    manager.status(http::NOT_FOUND)
+        .body(http::body("No handler is mapped to the resource."));
+  } else {
+    try {
+      (*handler)(manager);
+    } catch (...) {
+      if (!manager.sent()) {
+        manager.response().clear();
+        manager.status(http::INTERNAL_SERVER_ERROR)
+            .body(http::body("An unexpected internal server error occured."));
+      }
+    }
+  }
+  manager.send();
+}
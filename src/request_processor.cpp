@@ -1,3 +1,10 @@
+#include <algorithm>
+#include <charconv>
+#include <future>
+#include <system_error>
+
+#include <sys/socket.h>
+
 #include <cppws/http_def.hpp>
 #include <cppws/http_response.hpp>
 #include <cppws/request_processor.hpp>
@@ -5,10 +12,122 @@
 
 cppws::request_processor::request_processor(
     std::shared_ptr<request_mapper> mapper, std::pmr::memory_resource *upstream)
-    : mapper_(mapper), buffer_(upstream) {
-  std::thread thread([this]() { run(); });
-  runner_ = thread.get_id();
-  thread.detach();
+    : request_processor(std::move(mapper), nullptr, upstream) {}
+
+cppws::request_processor::request_processor(
+    std::shared_ptr<request_mapper> mapper,
+    std::shared_ptr<const tls_context> tls, std::pmr::memory_resource *upstream)
+    : buffer_(upstream), response_(&buffer_), mapper_(std::move(mapper)),
+      tls_(std::move(tls)) {
+  thread_ = std::thread([this]() { run(); });
+}
+
+cppws::request_processor::~request_processor() noexcept {
+  terminate();
+  thread_.join();
+}
+
+cppws::connection_watchdog::connection_watchdog()
+    : thread_([this] { loop_.run(); }) {}
+
+cppws::connection_watchdog::~connection_watchdog() noexcept {
+  // Deadlines destroyed meanwhile wait for the lock and then cancel their
+  // timers themselves. Tasks the thread did not get to are run here, so
+  // that no deadline waits for them forever.
+  //
+  std::unique_lock l{lock_};
+  running_ = false;
+  loop_.stop();
+  thread_.join();
+  try {
+    loop_.run_once(0);
+  } catch (const std::system_error &) {
+  }
+}
+
+std::shared_ptr<cppws::connection_watchdog>
+cppws::connection_watchdog::shared() {
+  static std::shared_ptr<connection_watchdog> watchdog =
+      std::make_shared<connection_watchdog>();
+  return watchdog;
+}
+
+cppws::connection_watchdog::deadline::~deadline() {
+  std::promise<void> done;
+  {
+    // Without a running watchdog thread, nothing else touches the timer.
+    //
+    std::unique_lock l{watchdog_->lock_};
+    if (!watchdog_->running_ || watchdog_->loop_.in_loop_thread()) {
+      timer_.cancel();
+      return;
+    }
+
+    // Tasks run in order: once this one ran, no earlier task refers to the
+    // deadline any more.
+    //
+    watchdog_->loop_.post([this, &done] {
+      timer_.cancel();
+      done.set_value();
+    });
+  }
+  done.get_future().wait();
+}
+
+void cppws::connection_watchdog::deadline::arm(
+    int fd, std::chrono::milliseconds timeout) {
+  auto due = timer_wheel::clock::now() + timeout;
+  {
+    std::unique_lock l{lock_};
+    fd_ = fd;
+    due_ = due;
+    expired_ = false;
+  }
+
+  // The timer belongs to the watchdog thread. If it fires for an earlier
+  // deadline, expire() sees the new one and leaves the connection alone.
+  //
+  watchdog_->loop_.post([this, due] {
+    auto delay = std::chrono::ceil<std::chrono::milliseconds>(
+        due - timer_wheel::clock::now());
+    watchdog_->loop_.timers().arm(timer_, delay, [this] { expire(); });
+  });
+}
+
+void cppws::connection_watchdog::deadline::cancel() noexcept {
+  std::unique_lock l{lock_};
+  fd_ = -1;
+}
+
+bool cppws::connection_watchdog::deadline::expired() const noexcept {
+  std::unique_lock l{lock_};
+  return expired_;
+}
+
+void cppws::connection_watchdog::deadline::expire() {
+  std::unique_lock l{lock_};
+  if (fd_ < 0 || timer_wheel::clock::now() < due_)
+    return;
+  ::shutdown(fd_, SHUT_RDWR);
+  fd_ = -1;
+  expired_ = true;
+}
+
+/**
+ * Time allowed for a body of the given length: the grace period plus the
+ * time the body takes at the minimum rate. Saturates at a year rather than
+ * overflowing for huge lengths or tiny rates.
+ */
+static std::chrono::milliseconds
+body_deadline(const cppws::processor_timeouts &timeouts, std::size_t length) {
+  constexpr std::chrono::milliseconds limit = std::chrono::hours(24 * 365);
+  double ms = static_cast<double>(length) * 1000.0 /
+              static_cast<double>(timeouts.min_body_rate);
+  std::chrono::milliseconds transfer =
+      ms < static_cast<double>(limit.count())
+          ? std::chrono::milliseconds(static_cast<std::int64_t>(ms))
+          : limit;
+  return std::min(std::min(timeouts.body_grace, limit) + transfer, limit);
 }
 
 bool cppws::request_processor::accept(socket &&connection) {
@@ -16,15 +135,75 @@ bool cppws::request_processor::accept(socket &&connection) {
   if (!wait_until_available())
     return false;
 
+  // The deadlines cover every blocking read up to the dispatch: handshake
+  // and head first, then the body at the minimum rate.
+  //
+  int fd = connection.native_handle();
+  deadline_.arm(fd, timeouts_.header_read);
+
+  if (tls_) {
+    try {
+      connection.tls_accept(*tls_);
+    } catch (const std::exception &) {
+      deadline_.cancel();
+      return false; // Failed handshake
+    }
+  }
+
   {
     std::unique_lock l{lock_};
 
-    stream_ = pmr::socket_iostream{
-        pmr::socket_streambuf(std::move(connection), &buffer_)};
-    if (!http_request::accept(processedRequest_, stream_))
-      return false; // Bad format
+    connection_ = std::move(connection);
+    input_.clear();
+    if (!http_request::accept_head(processedRequest_, input_, connection_)) {
+      deadline_.cancel();
+      connection_ = {};
+      input_.clear();
+      input_.release();
+      return false; // Bad format or too slow
+    }
+
+    std::size_t length = 0;
+    if (const std::pmr::string *value = processedRequest_.http_header(
+            http_request_header::ContentLength))
+      std::from_chars(value->data(), value->data() + value->size(), length);
+
+    // Bodies above the limit are not read: the client is answered while
+    // the head deadline still runs, and the connection is closed.
+    //
+    if (length > maxRequestBody_) {
+      static const prebuilt_response too_large{
+          http::CONTENT_TOO_LARGE,
+          {http::header("Connection", "close")},
+          http::body("The request body is too large.")};
+      try {
+        too_large.send(connection_);
+      } catch (const std::exception &) {
+      }
+      deadline_.cancel();
+      connection_ = {};
+      input_.clear();
+      input_.release();
+      return false;
+    }
+
+    if (length > 0 && timeouts_.min_body_rate > 0)
+      deadline_.arm(fd, body_deadline(timeouts_, length));
+    else if (length > 0)
+      deadline_.cancel();
+
+    bool complete = http_request::accept_body(processedRequest_, input_,
+                                              connection_, maxRequestBody_);
+    deadline_.cancel();
+    if (!complete) {
+      connection_ = {};
+      input_.clear();
+      input_.release();
+      return false; // Bad format or too slow
+    }
 
     hasRequest_ = true;
+    busy_ = true;
 
     // connection made, notify handler
     //
@@ -33,7 +212,24 @@ bool cppws::request_processor::accept(socket &&connection) {
   return true;
 }
 
-void cppws::request_processor::terminate() { running_ = false; }
+void cppws::request_processor::terminate() {
+  {
+    std::unique_lock l{lock_};
+    running_ = false;
+  }
+  newConnectionCondition_.notify_one();
+  availableCondition_.notify_all();
+}
+
+void cppws::request_processor::timeouts(const processor_timeouts &timeouts) {
+  std::unique_lock l{lock_};
+  timeouts_ = timeouts;
+}
+
+void cppws::request_processor::max_request_body(std::size_t bytes) {
+  std::unique_lock l{lock_};
+  maxRequestBody_ = bytes;
+}
 
 bool cppws::request_processor::active() const noexcept { return running_; }
 
@@ -51,6 +247,8 @@ bool cppws::request_processor::wait_until_available(
   std::unique_lock l{lock_};
   time_point dl = clock::now() + timeout;
   while (busy_) {
+    if (!running_)
+      return false;
     if (availableCondition_.wait_until(l, dl) == std::cv_status::timeout)
       return false;
   }
@@ -58,16 +256,16 @@ bool cppws::request_processor::wait_until_available(
 }
 
 void cppws::request_processor::run() {
-  while (running_) {
+  for (;;) {
 
-    // Await new connection
+    // Await new connection; a request accepted before terminate() is
+    // still served.
     {
       std::unique_lock l{lock_};
-      if (!hasRequest_) {
-        newConnectionCondition_.wait(l);
-        if (!hasRequest_)
-          continue;
-      }
+      newConnectionCondition_.wait(
+          l, [this] { return hasRequest_ || !running_; });
+      if (!hasRequest_)
+        return;
     }
 
     process_request();
@@ -75,27 +273,109 @@ void cppws::request_processor::run() {
     // Lock and notify available
     {
       std::unique_lock l{lock_};
+      hasRequest_ = false;
+      busy_ = false;
       availableCondition_.notify_all();
     }
   }
 }
 
-void cppws::request_processor::process_request() {
+cppws::processor_pool::processor_pool(std::shared_ptr<request_mapper> mapper,
+                                      std::size_t size,
+                                      std::shared_ptr<const tls_context> tls) {
+  size = std::max<std::size_t>(size, 1);
+  processors_.reserve(size);
+  feeders_.reserve(size);
+  for (std::size_t i = 0; i < size; ++i)
+    processors_.push_back(std::make_unique<request_processor>(mapper, tls));
+  for (std::unique_ptr<request_processor> &processor : processors_)
+    feeders_.emplace_back([this, &processor = *processor] { feed(processor); });
+}
 
-  try {
-    request_mapper::handler handler = mapper_->resolve(processedRequest_);
-    if (!handler) {
-      stream_ << http::FORBIDDEN << http::body("Entry blocked by filter.");
-      throw std::exception();
+cppws::processor_pool::~processor_pool() noexcept {
+  {
+    std::unique_lock l{lock_};
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (std::thread &feeder : feeders_)
+    feeder.join();
+  queue_.clear();
+}
+
+void cppws::processor_pool::post(std::span<socket> connections) {
+  if (connections.empty())
+    return;
+  {
+    std::unique_lock l{lock_};
+    for (socket &connection : connections)
+      queue_.push_back(std::move(connection));
+  }
+  if (connections.size() == 1)
+    ready_.notify_one();
+  else
+    ready_.notify_all();
+}
+
+void cppws::processor_pool::timeouts(const processor_timeouts &timeouts) {
+  for (std::unique_ptr<request_processor> &processor : processors_)
+    processor->timeouts(timeouts);
+}
+
+void cppws::processor_pool::max_request_body(std::size_t bytes) {
+  for (std::unique_ptr<request_processor> &processor : processors_)
+    processor->max_request_body(bytes);
+}
+
+std::size_t cppws::processor_pool::queued() {
+  std::unique_lock l{lock_};
+  return queue_.size();
+}
+
+void cppws::processor_pool::feed(request_processor &processor) {
+  for (;;) {
+
+    // Only an idle processor takes a connection, so that the others get
+    // the rest of a batch.
+    //
+    while (!processor.wait_until_available()) {
+      std::unique_lock l{lock_};
+      if (stopping_)
+        return;
     }
-    try {
-      request_manager manager;
-      handler(manager);
-    } catch (...) {
-      stream_ << http::INTERNAL_SERVER_ERROR
-              << http::body("An unexpected internal server error occured.");
+
+    class socket connection;
+    {
+      std::unique_lock l{lock_};
+      ready_.wait(l, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_)
+        return;
+      connection = std::move(queue_.front());
+      queue_.pop_front();
     }
+    processor.accept(std::move(connection));
+  }
+}
+
+void cppws::request_processor::process_request() {
+
+  if (timeouts_.handler > 0ms)
+    deadline_.arm(connection_.native_handle(), timeouts_.handler);
+  try {
+    request_manager manager{processedRequest_, connection_, response_};
+    dispatch_request(*mapper_, manager);
   } catch (...) {
   }
-  stream_ = {};
+  deadline_.cancel();
+
+  // Bodies sent with zero-copy are read by the kernel until the client
+  // acknowledged them, which can only be told before the connection closes.
+  //
+  response_.reclaim(connection_, timeouts_.zerocopy_ack);
+  connection_ = {};
+
+  // Idle processors hold no input buffer.
+  //
+  input_.clear();
+  input_.release();
 }
@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include <cppws/http_date.hpp>
+#include <cppws/response_buffer.hpp>
+
+cppws::response_buffer::response_buffer(std::pmr::memory_resource *upstream)
+    : statusLine_(upstream), headers_(upstream), contentType_(upstream),
+      body_(upstream), parts_(upstream), pending_(upstream),
+      scratch_(upstream) {}
+
+void cppws::response_buffer::clear() noexcept {
+  status_ = http::OK;
+  statusLine_.clear();
+  headers_.clear();
+  contentType_.clear();
+  clear_body();
+  encoded_ = false;
+  streaming_ = false;
+  zerocopy_ = false;
+}
+
+void cppws::response_buffer::clear_body() noexcept {
+  body_.clear();
+  parts_.clear();
+  mapped_ = 0;
+  fileBytes_ = 0;
+}
+
+void cppws::response_buffer::file(int fd, std::uint64_t offset,
+                                  std::uint64_t length) {
+  if (length == 0)
+    return;
+  if (body_.size() > mapped_) {
+    parts_.push_back({-1, mapped_, body_.size() - mapped_});
+    mapped_ = body_.size();
+  }
+  parts_.push_back({fd, offset, length});
+  fileBytes_ += length;
+}
+
+void cppws::response_buffer::header(std::string_view name,
+                                    std::string_view value) {
+  if (iequals(name, to_string(http_response_header::ContentEncoding)))
+    encoded_ = true;
+  headers_.append(name);
+  headers_.append(": ");
+  headers_.append(value);
+  headers_.append("\r\n");
+}
+
+void cppws::response_buffer::content_type(std::string_view type) {
+  contentType_.assign(type);
+}
+
+void cppws::response_buffer::header(http_response_header name,
+                                    std::string_view value) {
+  if (name == http_response_header::ContentEncoding)
+    encoded_ = true;
+  headers_.append(header_prefix(name));
+  headers_.append(value);
+  headers_.append("\r\n");
+}
+
+bool cppws::response_buffer::compressible(std::size_t minSize) const noexcept {
+  return !encoded_ && !streaming_ && parts_.empty() &&
+         body_.size() >= minSize &&
+         is_compressible(contentType_);
+}
+
+bool cppws::response_buffer::compress(content_coding coding, int level) {
+  if (coding == content_coding::Identity || encoded_)
+    return false;
+
+  if (!compressor_)
+    compressor_ = std::make_unique<compressor>();
+
+  // Stop as soon as the encoded body is no smaller than the original, rather
+  // than encoding an incompressible body in full next to it.
+  //
+  scratch_.clear();
+  if (body_.empty() ||
+      !compressor_->compress(coding, level, body_, scratch_, body_.size() - 1))
+    return false;
+
+  body_.swap(scratch_);
+  header(http_response_header::ContentEncoding, to_string(coding));
+  return true;
+}
+
+std::string_view cppws::response_buffer::header_value(
+    std::string_view name) const noexcept {
+  std::string_view rest = headers_;
+  while (!rest.empty()) {
+    std::size_t eol = rest.find("\r\n");
+    std::string_view line = rest.substr(0, eol);
+    std::size_t colon = line.find(':');
+    if (colon != std::string_view::npos && iequals(line.substr(0, colon), name))
+      return trim_ows(line.substr(colon + 1));
+    if (eol == std::string_view::npos)
+      break;
+    rest.remove_prefix(eol + 2);
+  }
+  return {};
+}
+
+std::string_view cppws::response_buffer::serialize_status() {
+  std::string_view line = serialized_status_line(status_);
+  if (!line.empty())
+    return line;
+
+  char num[24];
+  statusLine_.assign("HTTP/");
+  statusLine_.append(1, static_cast<char>('0' + status_.http_version / 100));
+  if (status_.http_version % 100 != 0) {
+    statusLine_.append(1, '.');
+    statusLine_.append(
+        1, static_cast<char>('0' + (status_.http_version % 100) / 10));
+  }
+  statusLine_.append(1, ' ');
+  statusLine_.append(num, format_decimal(num, status_.status_code));
+  statusLine_.append(1, ' ');
+  statusLine_.append(status_.reason);
+  statusLine_.append("\r\n");
+  return statusLine_;
+}
+
+/**
+ * 1xx, 204 and 304 responses never carry a body, nor the headers that
+ * describe one.
+ */
+static bool allows_body(int code) noexcept {
+  return code >= 200 && code != 204 && code != 304;
+}
+
+bool cppws::response_buffer::has_body() const noexcept {
+  return allows_body(status_.status_code);
+}
+
+template <typename String>
+void cppws::response_buffer::append_entity_headers(String &out) const {
+  if (has_body()) {
+    if (!streaming_) {
+      char len[20];
+      out.append(header_prefix(http_response_header::ContentLength));
+      out.append(len, format_decimal(len, content_length()));
+      out.append("\r\n");
+    }
+    if (!contentType_.empty()) {
+      out.append(header_prefix(http_response_header::ContentType));
+      out.append(contentType_);
+      out.append("\r\n");
+    }
+  }
+  out.append("\r\n");
+}
+
+std::string_view cppws::response_buffer::serialize_head() {
+  std::string_view line = serialize_status();
+  finish_head();
+  return line;
+}
+
+void cppws::response_buffer::finish_head() {
+  std::size_t at = headers_.size();
+  headers_.resize(at + http_date_cache::line_length);
+  http_date_cache::copy(headers_.data() + at);
+  headers_.append(server_header_line);
+
+  if (!has_body())
+    clear_body();
+  append_entity_headers(headers_);
+}
+
+bool cppws::response_buffer::snapshot(prebuilt_response &out) {
+  if (!parts_.empty() || streaming_)
+    return false;
+
+  std::string_view line = serialize_status();
+  std::string &bytes = out.bytes_;
+  bytes.clear();
+  bytes.reserve(line.size() + headers_.size() + 64 + body_.size());
+  bytes.append(line);
+  bytes.append(headers_);
+  append_entity_headers(bytes);
+  if (has_body())
+    bytes.append(body_);
+  out.statusLength_ = line.size();
+  return true;
+}
+
+/**
+ * Keeps a connection corked for the lifetime of the guard.
+ */
+struct cork_guard {
+  cppws::socket &connection;
+  bool corked = connection.cork(true);
+
+  ~cork_guard() {
+    if (corked)
+      connection.cork(false);
+  }
+};
+
+void cppws::response_buffer::send(socket &connection, bool includeBody) {
+  std::string_view line = serialize_head();
+
+  if (zerocopy_ && includeBody && parts_.empty() &&
+      body_.size() >= ZEROCOPY_MIN_SIZE && connection.zerocopy(true)) {
+    send_zerocopy(connection, line);
+    return;
+  }
+
+  if (parts_.empty() || !includeBody) {
+    struct iovec iov[3] = {
+        {const_cast<char *>(line.data()), line.size()},
+        {headers_.data(), headers_.size()},
+        {body_.data(), includeBody ? body_.size() : 0},
+    };
+    write_all(connection, iov, 3);
+    return;
+  }
+
+  // Text is gathered up to the next file slice, which is then sent from the
+  // page cache with sendfile(). The connection is corked meanwhile, so that
+  // the head and the text between slices do not leave in short segments of
+  // their own.
+  //
+  cork_guard guard{connection};
+
+  constexpr int max_iov = 16;
+  struct iovec iov[max_iov] = {
+      {const_cast<char *>(line.data()), line.size()},
+      {headers_.data(), headers_.size()},
+  };
+  int count = 2;
+  for (const body_part &part : parts_) {
+    if (part.fd < 0) {
+      if (count == max_iov) {
+        write_all(connection, iov, count);
+        count = 0;
+      }
+      iov[count++] = {body_.data() + part.offset, part.length};
+      continue;
+    }
+
+    write_all(connection, iov, count);
+    count = 0;
+
+    std::uint64_t offset = part.offset;
+    std::uint64_t remaining = part.length;
+    while (remaining > 0) {
+      std::size_t n = connection.send_file(part.fd, offset, remaining);
+      if (n == 0)
+        throw std::runtime_error("File truncated while writing response");
+      remaining -= n;
+    }
+  }
+  if (count == max_iov) {
+    write_all(connection, iov, count);
+    count = 0;
+  }
+  iov[count++] = {body_.data() + mapped_, body_.size() - mapped_};
+  write_all(connection, iov, count);
+}
+
+void cppws::response_buffer::send_zerocopy(socket &connection,
+                                           std::string_view line) {
+  collect(connection, {});
+
+  // The head is copied as usual, since it is built in place again for the
+  // next response, and leaves together with the start of the body.
+  //
+  cork_guard guard{connection};
+  struct iovec head[2] = {
+      {const_cast<char *>(line.data()), line.size()},
+      {headers_.data(), headers_.size()},
+  };
+  write_all(connection, head, 2);
+
+  // The body is set aside before it is written, so that it stays alive even
+  // if the connection fails halfway.
+  //
+  pending_.push_back({connection.zerocopy_sent(), std::move(body_)});
+  pending_body &pending = pending_.back();
+  std::string_view rest = pending.body;
+  while (!rest.empty()) {
+    struct iovec iov = {const_cast<char *>(rest.data()), rest.size()};
+    std::size_t n = connection.write_zerocopy(&iov, 1);
+    if (n == 0)
+      throw std::runtime_error("Connection closed while writing response");
+    pending.send = connection.zerocopy_sent();
+    rest.remove_prefix(n);
+  }
+}
+
+void cppws::response_buffer::collect(socket &connection,
+                                     std::chrono::milliseconds timeout) {
+  if (pending_.empty())
+    return;
+
+  // Sends complete in order, so the bodies do too.
+  //
+  std::uint32_t completed = connection.zerocopy_completed(timeout);
+  auto done = std::find_if(
+      pending_.begin(), pending_.end(), [completed](const pending_body &p) {
+        return static_cast<std::int32_t>(completed - p.send) < 0;
+      });
+  pending_.erase(pending_.begin(), done);
+}
+
+bool cppws::response_buffer::reclaim(socket &connection,
+                                     std::chrono::milliseconds timeout) {
+  collect(connection, timeout);
+  if (pending_.empty())
+    return true;
+
+  connection.abort();
+  pending_.clear();
+  return false;
+}
+
+void cppws::response_buffer::body_parts(std::vector<body_part> &out) const {
+  out.insert(out.end(), parts_.begin(), parts_.end());
+  if (body_.size() > mapped_)
+    out.push_back({-1, mapped_, body_.size() - mapped_});
+}
+
+cppws::prebuilt_response::prebuilt_response(
+    const http_resonse_line &status,
+    std::initializer_list<http_header_line> headers, const http_body &body) {
+  std::ostringstream ss;
+  ss << status;
+  statusLength_ = ss.tellp();
+  for (const http_header_line &header : headers)
+    ss << header;
+
+  if (!allows_body(status.status_code)) {
+    ss << "\r\n";
+    bytes_ = std::move(ss).str();
+    return;
+  }
+
+  char len[20];
+  ss << header_prefix(http_response_header::ContentLength)
+     << std::string_view(len, format_decimal(len, body.content.size()))
+     << "\r\n"
+     << header_prefix(http_response_header::ContentType) << body.content_type
+     << "\r\n\r\n";
+  ss.write(reinterpret_cast<const char *>(body.content.data()),
+           body.content.size());
+  bytes_ = std::move(ss).str();
+}
+
+void cppws::prebuilt_response::send(socket &connection) const {
+  char date[http_date_cache::line_length];
+  http_date_cache::copy(date);
+
+  std::string_view line = status_line();
+  std::string_view tail = rest();
+  struct iovec iov[4] = {
+      {const_cast<char *>(line.data()), line.size()},
+      {date, sizeof date},
+      {const_cast<char *>(server_header_line.data()),
+       server_header_line.size()},
+      {const_cast<char *>(tail.data()), tail.size()},
+  };
+  write_all(connection, iov, 4);
+}
+
+void cppws::prebuilt_response::serialize(std::string &out) const {
+  std::size_t at = out.size();
+  out.append(status_line());
+  out.resize(out.size() + http_date_cache::line_length);
+  http_date_cache::copy(out.data() + at + statusLength_);
+  out.append(server_header_line);
+  out.append(rest());
+}
+
+void cppws::write_all(socket &connection, struct iovec *iov, int count) {
+  while (count > 0) {
+    if (iov->iov_len == 0) {
+      ++iov;
+      --count;
+      continue;
+    }
+
+    std::size_t n = connection.write(iov, count);
+    if (n == 0)
+      throw std::runtime_error("Connection closed while writing response");
+
+    while (n > 0 && count > 0) {
+      std::size_t c = std::min(n, iov->iov_len);
+      iov->iov_base = static_cast<char *>(iov->iov_base) + c;
+      iov->iov_len -= c;
+      n -= c;
+      if (iov->iov_len == 0) {
+        ++iov;
+        --count;
+      }
+    }
+  }
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <array>
+#include <ranges>
+
+#include <cppws/route_mapper.hpp>
+
+/**
+ * Strips the query string and fragment from a path segment.
+ */
+static std::string_view path_segment(std::string_view seg) {
+  std::size_t pos = seg.find_first_of("?#");
+  return pos == std::string_view::npos ? seg : seg.substr(0, pos);
+}
+
+template <typename Key, typename Range>
+static void make_key(Key &out, cppws::http_method method, Range &&segments) {
+  out.append(to_string(method));
+  out.append(1, ' ');
+  bool first = true;
+  for (std::string_view seg : segments) {
+    if (seg.empty())
+      continue;
+    if (!first)
+      out.append(1, '/');
+    out.append(seg);
+    first = false;
+  }
+}
+
+void cppws::route_mapper::add_route(enum http_method method,
+                                    std::string_view path, bool prefix,
+                                    handler &&fn) {
+  route &r = routes_.emplace_back(method, std::vector<std::string>{},
+                                  std::move(fn));
+  for (auto rng : path | std::views::split('/')) {
+    std::string_view seg = path_segment({rng.begin(), rng.end()});
+    if (!seg.empty())
+      r.segments.emplace_back(seg);
+  }
+
+  if (!prefix) {
+    std::string key;
+    make_key(key, method, r.segments);
+    exact_.insert_or_assign(std::move(key), &r);
+    return;
+  }
+
+  auto it = std::ranges::upper_bound(
+      prefixes_, r.segments.size(), std::greater<>{},
+      [](const route *p) { return p->segments.size(); });
+  prefixes_.insert(it, &r);
+}
+
+void cppws::route_mapper::preflight(cors_filter filter) {
+  preflight_ = make_handler([filter = std::move(filter)](request_manager &m) {
+    if (const prebuilt_response *r = filter(m))
+      m.write(*r);
+    else
+      m.status(http::NO_CONTENT).send();
+  });
+}
+
+const cppws::request_mapper::handler *
+cppws::route_mapper::resolve(const http_request &request) {
+  if (preflight_ && request.http_method() == http_method::OPTIONS &&
+      request.http_header("Origin") &&
+      request.http_header("Access-Control-Request-Method"))
+    return &preflight_;
+
+  const auto &uri = request.uri();
+  auto segments = uri | std::views::transform([](const std::pmr::string &s) {
+                    return path_segment(s);
+                  });
+
+  // Build the lookup key on the stack so that resolving does not allocate
+  // for typical path lengths.
+  //
+  std::array<std::byte, 512> mem;
+  std::pmr::monotonic_buffer_resource res{mem.data(), mem.size()};
+  std::pmr::string key{&res};
+  make_key(key, request.http_method(), segments);
+
+  if (auto it = exact_.find(std::string_view(key)); it != exact_.end())
+    return &it->second->fn;
+
+  for (const route *r : prefixes_) {
+    if (r->method != request.http_method())
+      continue;
+
+    auto seg = segments.begin();
+    bool match = true;
+    for (const std::string &expected : r->segments) {
+      while (seg != segments.end() && (*seg).empty())
+        ++seg;
+      if (seg == segments.end() || *seg != expected) {
+        match = false;
+        break;
+      }
+      ++seg;
+    }
+    if (match)
+      return &r->fn;
+  }
+  return nullptr;
+}
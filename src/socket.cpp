@@ -1,9 +1,21 @@
 #include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
 #include <system_error>
 
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/errqueue.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
 
 #include <cppws/socket.hpp>
@@ -23,8 +35,8 @@ struct check_sock {
 
 static constexpr check_sock check{};
 
-static int make_socket() {
-  int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+static int make_socket(int family = AF_INET) {
+  int sockfd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
   if (sockfd < 0)
     throw std::system_error(errno, std::system_category());
   return sockfd;
@@ -34,22 +46,208 @@ cppws::socket::socket() : fd_(make_socket()) {}
 
 cppws::socket::socket(int fd) : fd_(fd) {}
 
+/**
+ * Maps a socket family to its address family.
+ */
+static int address_family(cppws::socket_family family) {
+  switch (family) {
+  case cppws::socket_family::IPv6:
+    return AF_INET6;
+  case cppws::socket_family::Unix:
+    return AF_UNIX;
+  default:
+    return AF_INET;
+  }
+}
+
+cppws::socket::socket(socket_family family)
+    : fd_(make_socket(address_family(family))) {}
+
+cppws::socket::socket(int fd, const struct sockaddr_storage &peer) : fd_(fd) {
+  char host[INET6_ADDRSTRLEN];
+  if (peer.ss_family == AF_INET) {
+    const auto &in = reinterpret_cast<const struct sockaddr_in &>(peer);
+    if (::inet_ntop(AF_INET, &in.sin_addr, host, sizeof host))
+      host_ = host;
+    port_ = ntohs(in.sin_port);
+  } else if (peer.ss_family == AF_INET6) {
+    // IPv4 peers of dual-stack listeners are shown as plain IPv4 addresses.
+    //
+    const auto &in6 = reinterpret_cast<const struct sockaddr_in6 &>(peer);
+    bool mapped = IN6_IS_ADDR_V4MAPPED(&in6.sin6_addr);
+    if (mapped ? ::inet_ntop(AF_INET, &in6.sin6_addr.s6_addr[12], host,
+                             sizeof host)
+               : ::inet_ntop(AF_INET6, &in6.sin6_addr, host, sizeof host))
+      host_ = host;
+    port_ = ntohs(in6.sin6_port);
+  } else {
+    // Clients of Unix domain sockets are usually unnamed, in which case
+    // only the family is filled in.
+    //
+    const auto &un = reinterpret_cast<const struct sockaddr_un &>(peer);
+    host_ = "unix:";
+    host_.append(un.sun_path, ::strnlen(un.sun_path, sizeof un.sun_path));
+    port_ = 0;
+  }
+}
+
+/**
+ * Gets the address family of a socket.
+ */
+static int family_of(int fd) {
+  int family = AF_UNSPEC;
+  socklen_t length = sizeof family;
+  check | ::getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &family, &length);
+  return family;
+}
+
+/**
+ * Makes the address of a Unix domain socket, where names starting with '@'
+ * are in the abstract namespace.
+ */
+static socklen_t unix_address(std::string_view path, struct sockaddr_un &addr) {
+  addr = {};
+  addr.sun_family = AF_UNIX;
+
+  // Abstract names start with a null byte instead and are not terminated.
+  //
+  bool abstract = path.starts_with('@');
+  if (path.empty() || path.size() >= sizeof addr.sun_path)
+    throw std::invalid_argument("Bad Unix domain socket path");
+  path.copy(addr.sun_path, path.size());
+  if (abstract)
+    addr.sun_path[0] = '\0';
+  return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) +
+                                path.size() + (abstract ? 0 : 1));
+}
+
+/**
+ * Sets an integer socket option.
+ */
+static void set_option(int fd, int level, int name, int value) {
+  check | ::setsockopt(fd, level, name, &value, sizeof value);
+}
+
+/**
+ * True for errors of accept() that concern a single pending connection,
+ * e.g. one reset by its peer, one with a pending network error, or one
+ * refused by a firewall rule. Accepting the next one may succeed.
+ */
+static bool connection_error(int error) noexcept {
+  switch (error) {
+  case ECONNABORTED:
+  case EPROTO:
+  case EPERM:
+  case ENETDOWN:
+  case ENOPROTOOPT:
+  case EHOSTDOWN:
+  case ENONET:
+  case EHOSTUNREACH:
+  case EOPNOTSUPP:
+  case ENETUNREACH:
+    return true;
+  default:
+    return false;
+  }
+}
+
 void cppws::socket::listen(int port, int n) {
+  listen_options options;
+  options.backlog = n;
+  listen(port, options);
+}
+
+void cppws::socket::listen(int port, const listen_options &options) {
   if (fd_ < 0)
     throw std::runtime_error("Bad socket");
 
-  struct sockaddr_in addr;
-  addr.sin_port = htons(port);
-  addr.sin_addr.s_addr = INADDR_ANY;
-  addr.sin_family = AF_INET;
-
-  int opt = 1;
-  check |
-      ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt,
-                   sizeof opt) |
-      ::bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) |
-      ::listen(fd_, n);
-  port_ = port;
+  // IPv6 sockets bind to the IPv6 wildcard address, which covers IPv4 as
+  // well unless they are made IPv6 only.
+  //
+  struct sockaddr_storage addr = {};
+  socklen_t length;
+  if (family_of(fd_) == AF_INET6) {
+    auto &in6 = reinterpret_cast<struct sockaddr_in6 &>(addr);
+    in6.sin6_family = AF_INET6;
+    in6.sin6_port = htons(port);
+    in6.sin6_addr = in6addr_any;
+    length = sizeof in6;
+    set_option(fd_, IPPROTO_IPV6, IPV6_V6ONLY, options.ipv6_only);
+  } else {
+    auto &in = reinterpret_cast<struct sockaddr_in &>(addr);
+    in.sin_family = AF_INET;
+    in.sin_port = htons(port);
+    in.sin_addr.s_addr = htonl(INADDR_ANY);
+    length = sizeof in;
+  }
+
+  set_option(fd_, SOL_SOCKET, SO_REUSEADDR, 1);
+  if (options.reuse_port)
+    set_option(fd_, SOL_SOCKET, SO_REUSEPORT, 1);
+  if (options.defer_accept.count() > 0)
+    set_option(fd_, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+               static_cast<int>(options.defer_accept.count()));
+  if (options.fast_open > 0)
+    set_option(fd_, IPPROTO_TCP, TCP_FASTOPEN, options.fast_open);
+
+  // Accepted connections inherit the settings of the listening socket,
+  // which saves setting them on every connection.
+  //
+  apply(options.connection);
+
+  check | ::bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), length);
+  check | ::listen(fd_, options.backlog);
+
+  // Port 0 binds to a free port, which is looked up. The port is at the
+  // same offset in IPv4 and IPv6 addresses.
+  //
+  length = sizeof addr;
+  check | ::getsockname(fd_, reinterpret_cast<struct sockaddr *>(&addr),
+                        &length);
+  port_ = ntohs(reinterpret_cast<struct sockaddr_in &>(addr).sin_port);
+}
+
+void cppws::socket::listen_unix(std::string_view path, int n) {
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
+
+  struct sockaddr_un addr;
+  socklen_t length = unix_address(path, addr);
+
+  // A socket file outlives its listener, and would make bind() fail.
+  //
+  struct stat st;
+  if (addr.sun_path[0] && ::stat(addr.sun_path, &st) == 0 &&
+      S_ISSOCK(st.st_mode))
+    ::unlink(addr.sun_path);
+
+  check | ::bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), length);
+  check | ::listen(fd_, n);
+  host_ = "unix:";
+  host_.append(path);
+  port_ = 0;
+}
+
+void cppws::socket::apply(const socket_options &options) {
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
+
+  set_option(fd_, IPPROTO_TCP, TCP_NODELAY, options.no_delay);
+  if (options.receive_buffer > 0)
+    set_option(fd_, SOL_SOCKET, SO_RCVBUF, options.receive_buffer);
+  if (options.send_buffer > 0)
+    set_option(fd_, SOL_SOCKET, SO_SNDBUF, options.send_buffer);
+  if (options.user_timeout.count() > 0)
+    set_option(fd_, IPPROTO_TCP, TCP_USER_TIMEOUT,
+               static_cast<int>(options.user_timeout.count()));
+  if (options.busy_poll.count() > 0)
+    set_option(fd_, SOL_SOCKET, SO_BUSY_POLL,
+               static_cast<int>(options.busy_poll.count()));
+}
+
+bool cppws::socket::cork(bool enabled) noexcept {
+  int value = enabled;
+  return ::setsockopt(fd_, IPPROTO_TCP, TCP_CORK, &value, sizeof value) == 0;
 }
 
 cppws::socket cppws::socket::accept() {
@@ -60,16 +258,43 @@ cppws::socket cppws::socket::accept() {
   if (port_ < 0)
     throw std::runtime_error("listen() has to be called before accept()");
 
-  struct sockaddr_in addr;
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons(port_);
-  addr.sin_addr.s_addr = INADDR_ANY;
+  struct sockaddr_storage addr = {};
+  socklen_t len = sizeof addr;
+
+  int fd = check | ::accept4(fd_, reinterpret_cast<struct sockaddr *>(&addr),
+                             &len, SOCK_CLOEXEC);
+  return socket(fd, addr);
+}
+
+std::size_t cppws::socket::accept_some(std::span<socket> out,
+                                       bool nonBlocking) {
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
 
-  socklen_t len = sizeof(struct sockaddr_in);
+  if (port_ < 0)
+    throw std::runtime_error("listen() has to be called before accept()");
 
-  int fd =
-      check | ::accept(fd_, reinterpret_cast<struct sockaddr *>(&addr), &len);
-  return socket(fd);
+  int flags = SOCK_CLOEXEC | (nonBlocking ? SOCK_NONBLOCK : 0);
+  std::size_t n = 0;
+  while (n < out.size()) {
+    struct sockaddr_storage addr = {};
+    socklen_t len = sizeof addr;
+    int fd = ::accept4(fd_, reinterpret_cast<struct sockaddr *>(&addr), &len,
+                       flags);
+    if (fd < 0) {
+      if (errno == EINTR || connection_error(errno))
+        continue;
+
+      // Errors after the first connection are left for the next call to
+      // report, so that the connections accepted so far are not lost.
+      //
+      if (errno == EAGAIN || errno == EWOULDBLOCK || n > 0)
+        break;
+      check | -1;
+    }
+    out[n++] = socket(fd, addr);
+  }
+  return n;
 }
 
 void cppws::socket::connect(std::string_view host, int port) {
@@ -82,13 +307,26 @@ void cppws::socket::connect(std::string_view host, int port) {
 
   std::string hname{host};
 
-  struct sockaddr_in addr;
-  addr.sin_port = htons(port);
-  addr.sin_family = AF_INET;
+  struct sockaddr_storage addr = {};
+  socklen_t length;
+  int parsed;
+  if (family_of(fd_) == AF_INET6) {
+    auto &in6 = reinterpret_cast<struct sockaddr_in6 &>(addr);
+    in6.sin6_family = AF_INET6;
+    in6.sin6_port = htons(port);
+    parsed = ::inet_pton(AF_INET6, hname.c_str(), &in6.sin6_addr);
+    length = sizeof in6;
+  } else {
+    auto &in = reinterpret_cast<struct sockaddr_in &>(addr);
+    in.sin_family = AF_INET;
+    in.sin_port = htons(port);
+    parsed = ::inet_pton(AF_INET, hname.c_str(), &in.sin_addr);
+    length = sizeof in;
+  }
+  if (parsed != 1)
+    throw std::invalid_argument("Bad address: " + hname);
 
-  check | ::inet_pton(AF_INET, hname.c_str(), &addr.sin_addr);
-  check |
-      ::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+  check | ::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr), length);
 
   // Set here for exception safety
   //
@@ -96,43 +334,267 @@ void cppws::socket::connect(std::string_view host, int port) {
   port_ = port;
 }
 
+void cppws::socket::connect_unix(std::string_view path) {
+
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
+
+  struct sockaddr_un addr;
+  socklen_t length = unix_address(path, addr);
+  check | ::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr), length);
+
+  host_ = "unix:";
+  host_.append(path);
+  port_ = 0;
+}
+
 std::size_t cppws::socket::write(const char *str, std::size_t len) {
 
   if (fd_ < 0)
     throw std::runtime_error("Bad socket");
 
+  if (tls_ && !ktls_) {
+    struct iovec iov = {const_cast<char *>(str), len};
+    return write(&iov, 1);
+  }
+
   ::ssize_t nc = ::write(fd_, str, len);
   if (nc < 0)
     check | -1;
   return static_cast<std::size_t>(nc);
 }
 
+std::size_t cppws::socket::write(const struct iovec *iov, int count) {
+
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
+
+  if (tls_ && !ktls_) {
+    // Blocking sockets only report -1 when interrupted.
+    //
+    std::ptrdiff_t n;
+    do
+      n = tls_write(iov, count);
+    while (n < 0);
+    return static_cast<std::size_t>(n);
+  }
+
+  ::ssize_t nc = ::writev(fd_, iov, count);
+  if (nc < 0)
+    check | -1;
+  return static_cast<std::size_t>(nc);
+}
+
+std::size_t cppws::socket::send_file(int fd, std::uint64_t &offset,
+                                     std::size_t count) {
+
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
+
+  if (tls_)
+    return tls_send_file(fd, offset, count);
+
+  ::off_t off = static_cast<::off_t>(offset);
+  ::ssize_t nc = ::sendfile(fd_, fd, &off, count);
+  if (nc < 0)
+    check | -1;
+  offset = static_cast<std::uint64_t>(off);
+  return static_cast<std::size_t>(nc);
+}
+
 std::size_t cppws::socket::read(char *str, std::size_t len) {
 
   if (fd_ < 0)
     throw std::runtime_error("Bad socket");
 
+  if (tls_) {
+    // Blocking sockets only report -1 when interrupted.
+    //
+    std::ptrdiff_t n;
+    do
+      n = tls_read(str, len);
+    while (n < 0);
+    return static_cast<std::size_t>(n);
+  }
+
   ::ssize_t nc = ::read(fd_, str, len);
   if (nc < 0)
     check | -1;
   return static_cast<std::size_t>(nc);
 }
 
+std::ptrdiff_t cppws::socket::try_read(char *str, std::size_t len) {
+
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
+
+  if (tls_)
+    return tls_read(str, len);
+
+  ::ssize_t nc = ::recv(fd_, str, len, 0);
+  if (nc < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return -1;
+    check | -1;
+  }
+  return nc;
+}
+
+std::ptrdiff_t cppws::socket::try_write(const struct iovec *iov, int count) {
+
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
+
+  // With kTLS the kernel encrypts whatever is written to the socket.
+  //
+  if (tls_ && !ktls_)
+    return tls_write(iov, count);
+
+  struct msghdr msg = {};
+  msg.msg_iov = const_cast<struct iovec *>(iov);
+  msg.msg_iovlen = count;
+  ::ssize_t nc = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+  if (nc < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return -1;
+    check | -1;
+  }
+  return nc;
+}
+
+void cppws::socket::non_blocking(bool enabled) {
+
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
+
+  int flags = check | ::fcntl(fd_, F_GETFL);
+  flags = enabled ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+  check | ::fcntl(fd_, F_SETFL, flags);
+}
+
+bool cppws::socket::zerocopy(bool enabled) noexcept {
+  if (zerocopy_ == enabled)
+    return true;
+  // kTLS encrypts into buffers of its own and rejects MSG_ZEROCOPY.
+  //
+  if (fd_ < 0 || tls_)
+    return false;
+
+  int value = enabled;
+  if (::setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &value, sizeof value) != 0)
+    return false;
+  zerocopy_ = enabled;
+  return true;
+}
+
+std::size_t cppws::socket::write_zerocopy(const struct iovec *iov,
+                                          int count) {
+
+  if (!zerocopy_)
+    return write(iov, count);
+
+  struct msghdr msg = {};
+  msg.msg_iov = const_cast<struct iovec *>(iov);
+  msg.msg_iovlen = count;
+  ::ssize_t nc;
+  do
+    nc = ::sendmsg(fd_, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+  while (nc < 0 && errno == EINTR);
+
+  // Pinning the pages is charged to the socket's option memory; past its
+  // limit the data is copied instead.
+  //
+  if (nc < 0 && errno == ENOBUFS)
+    return write(iov, count);
+  if (nc < 0)
+    check | -1;
+  if (nc > 0)
+    ++zerocopySent_;
+  return static_cast<std::size_t>(nc);
+}
+
+std::uint32_t
+cppws::socket::zerocopy_completed(std::chrono::milliseconds timeout) {
+
+  if (fd_ < 0 || !zerocopy_)
+    return zerocopyDone_;
+
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  for (;;) {
+    // Each notification covers a range of sends, which the kernel merges
+    // while they wait in the queue.
+    //
+    char control[128];
+    struct msghdr msg = {};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    while (::recvmsg(fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0) {
+      for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c;
+           c = CMSG_NXTHDR(&msg, c)) {
+        if (!(c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) &&
+            !(c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR))
+          continue;
+        struct sock_extended_err err;
+        std::memcpy(&err, CMSG_DATA(c), sizeof err);
+        if (err.ee_errno == 0 && err.ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+          zerocopyDone_ += err.ee_data - err.ee_info + 1;
+      }
+      msg.msg_controllen = sizeof control;
+    }
+
+    if (zerocopyDone_ == zerocopySent_)
+      return zerocopyDone_;
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (left <= std::chrono::milliseconds::zero())
+      return zerocopyDone_;
+
+    // Notifications make the socket report POLLERR; a connection that is
+    // gone has nothing more to deliver.
+    //
+    struct pollfd p = {fd_, 0, 0};
+    if (::poll(&p, 1, static_cast<int>(left.count())) <= 0 ||
+        !(p.revents & POLLERR))
+      return zerocopyDone_;
+  }
+}
+
+void cppws::socket::abort() noexcept {
+  if (fd_ < 0)
+    return;
+  struct linger l = {1, 0};
+  ::setsockopt(fd_, SOL_SOCKET, SO_LINGER, &l, sizeof l);
+  close();
+}
+
 void cppws::socket::move(socket &other) noexcept {
 
   fd_ = other.fd_;
   host_ = std::move(other.host_);
   port_ = other.port_;
+  tls_ = other.tls_;
+  ktls_ = other.ktls_;
+  zerocopy_ = other.zerocopy_;
+  zerocopySent_ = other.zerocopySent_;
+  zerocopyDone_ = other.zerocopyDone_;
 
   other.port_ = -1;
   other.fd_ = -1;
+  other.tls_ = nullptr;
+  other.ktls_ = false;
+  other.zerocopy_ = false;
+  other.zerocopySent_ = other.zerocopyDone_ = 0;
 }
 
 void cppws::socket::close() noexcept {
   if (fd_ < 0)
     return;
+  if (tls_)
+    tls_close();
   ::close(fd_);
   fd_ = -1;
   host_.clear();
   port_ = -1;
+  zerocopy_ = false;
+  zerocopySent_ = zerocopyDone_ = 0;
 }
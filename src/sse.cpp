@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <system_error>
+
+#include <sys/epoll.h>
+
+#include <cppws/sse.hpp>
+
+/**
+ * Cuts a field value at its first line break.
+ */
+static std::string_view single_line(std::string_view value) noexcept {
+  return value.substr(0, value.find_first_of("\r\n"));
+}
+
+void cppws::append_sse_event(std::string &out, const sse_event &event) {
+  if (!event.event.empty()) {
+    out.append("event: ");
+    out.append(single_line(event.event));
+    out.append(1, '\n');
+  }
+  if (!event.id.empty()) {
+    out.append("id: ");
+    out.append(single_line(event.id));
+    out.append(1, '\n');
+  }
+  if (event.retry.count() > 0) {
+    char num[24];
+    out.append("retry: ");
+    out.append(num, format_decimal(num, event.retry.count()));
+    out.append(1, '\n');
+  }
+
+  std::string_view data = event.data;
+  for (;;) {
+    std::size_t eol = data.find_first_of("\r\n");
+    out.append("data: ");
+    out.append(data.substr(0, eol));
+    out.append(1, '\n');
+    if (eol == std::string_view::npos)
+      break;
+    if (data[eol] == '\r' && eol + 1 < data.size() && data[eol + 1] == '\n')
+      ++eol;
+    data.remove_prefix(eol + 1);
+  }
+  out.append(1, '\n');
+}
+
+std::shared_ptr<cppws::sse_stream>
+cppws::sse_stream::accept(request_manager &manager, event_loop &loop,
+                          const sse_options &options) {
+  const std::pmr::string *last = manager.request().http_header("Last-Event-ID");
+
+  manager.status(http::OK)
+      .header(http_response_header::CacheControl, "no-store")
+      .header("Connection", "close")
+      .content_type(http_content_type::TextEventStream)
+      .compression(false);
+  manager.response().clear_body();
+  manager.response().streaming(true);
+  manager.send();
+
+  class socket connection = manager.detach();
+  connection.non_blocking(true);
+  auto stream = std::make_shared<sse_stream>(
+      private_tag{}, std::move(connection), loop, options,
+      last ? std::string(trim_ows(*last)) : std::string());
+
+  if (options.retry.count() > 0) {
+    std::string retry = "retry: ";
+    char num[24];
+    retry.append(num, format_decimal(num, options.retry.count()));
+    retry.append("\n\n");
+    stream->queue_.push(retry);
+  }
+  loop.post([stream] { stream->start(); });
+  return stream;
+}
+
+cppws::sse_stream::sse_stream(private_tag, class socket &&connection,
+                              event_loop &loop, const sse_options &options,
+                              std::string lastEventId)
+    : socket_(std::move(connection)), loop_(&loop),
+      queue_(options.max_queued_bytes, options.overflow),
+      lastEventId_(std::move(lastEventId)) {
+  queue_.watermarks(options.high_water, options.low_water);
+}
+
+void cppws::sse_stream::start() {
+  started_ = true;
+  loop_->add(socket_.native_handle(), EPOLLIN | EPOLLRDHUP,
+             [self = shared_from_this()](std::uint32_t events) {
+               self->on_event(events);
+             });
+  flush();
+  update_paused();
+}
+
+void cppws::sse_stream::send(const sse_event &event) {
+  auto data = std::make_shared<std::string>();
+  append_sse_event(*data, event);
+  send(std::move(data));
+}
+
+void cppws::sse_stream::comment(std::string_view text) {
+  auto data = std::make_shared<std::string>(": ");
+  data->append(single_line(text));
+  data->append("\n\n");
+  send(std::move(data));
+}
+
+void cppws::sse_stream::send(output_queue::chunk data) {
+  if (loop_->in_loop_thread()) {
+    enqueue(std::move(data));
+    return;
+  }
+  loop_->post([self = shared_from_this(), data = std::move(data)] {
+    self->enqueue(data);
+  });
+}
+
+void cppws::sse_stream::enqueue(output_queue::chunk data) {
+  if (closed() || closeAfterFlush_)
+    return;
+  if (!queue_.push(std::move(data))) {
+    shutdown();
+    return;
+  }
+  flush();
+  update_paused();
+}
+
+void cppws::sse_stream::on_resume(event_loop::task fn) {
+  onResume_ = std::move(fn);
+}
+
+void cppws::sse_stream::close() {
+  if (!loop_->in_loop_thread()) {
+    loop_->post([self = shared_from_this()] { self->close(); });
+    return;
+  }
+  closeAfterFlush_ = true;
+  flush();
+}
+
+void cppws::sse_stream::on_event(std::uint32_t events) {
+  if (closed())
+    return;
+
+  if (events & EPOLLOUT) {
+    flush();
+    update_paused();
+  }
+  if (closed() || !(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+    return;
+
+  // Clients do not send anything after the request; any input is discarded
+  // and only the end of the stream matters.
+  //
+  char buf[512];
+  for (;;) {
+    std::ptrdiff_t n;
+    try {
+      n = socket_.try_read(buf, sizeof buf);
+    } catch (const std::system_error &) {
+      n = 0;
+    }
+    if (n == 0) {
+      shutdown();
+      return;
+    }
+    if (n < 0)
+      return;
+  }
+}
+
+void cppws::sse_stream::flush() {
+  // Events queued before the stream is registered are written by start().
+  //
+  if (closed() || !started_)
+    return;
+
+  bool drained;
+  try {
+    drained = queue_.flush(socket_);
+  } catch (const std::system_error &) {
+    shutdown();
+    return;
+  }
+
+  if (drained == pollingOutput_) {
+    pollingOutput_ = !drained;
+    std::uint32_t events = EPOLLIN | EPOLLRDHUP;
+    if (!drained)
+      events |= EPOLLOUT;
+    loop_->modify(socket_.native_handle(), events);
+  }
+  if (drained && closeAfterFlush_)
+    shutdown();
+}
+
+void cppws::sse_stream::update_paused() {
+  bool paused = queue_.paused();
+  if (paused == paused_.load(std::memory_order_relaxed))
+    return;
+  paused_.store(paused, std::memory_order_relaxed);
+  if (!paused && onResume_)
+    onResume_();
+}
+
+void cppws::sse_stream::shutdown() {
+  if (closed())
+    return;
+  closed_.store(true, std::memory_order_relaxed);
+  queue_.clear();
+  loop_->remove(socket_.native_handle());
+  socket_.close();
+
+  // Producers waiting for the stream to resume learn that it closed.
+  //
+  update_paused();
+  onResume_ = nullptr;
+}
+
+void cppws::sse_channel::subscribe(std::shared_ptr<sse_stream> stream) {
+  std::unique_lock l{lock_};
+  event_loop *loop = &stream->loop();
+  auto it = std::ranges::find(groups_, loop, &group::loop);
+  if (it == groups_.end())
+    it = groups_.insert(groups_.end(), {loop, nullptr});
+
+  auto streams = it->streams ? std::make_shared<stream_list>(*it->streams)
+                             : std::make_shared<stream_list>();
+  streams->push_back(std::move(stream));
+  it->streams = std::move(streams);
+}
+
+std::size_t cppws::sse_channel::publish(const sse_event &event) {
+  auto data = std::make_shared<std::string>();
+  append_sse_event(*data, event);
+  return publish(std::move(data));
+}
+
+std::size_t cppws::sse_channel::publish(output_queue::chunk data) {
+  std::unique_lock l{lock_};
+  std::size_t count = 0;
+  for (auto it = groups_.begin(); it != groups_.end();) {
+    const stream_list &streams = *it->streams;
+    if (std::ranges::any_of(streams, &sse_stream::closed)) {
+      auto open = std::make_shared<stream_list>();
+      std::ranges::copy_if(streams, std::back_inserter(*open),
+                           [](const auto &s) { return !s->closed(); });
+      it->streams = std::move(open);
+    }
+    if (it->streams->empty()) {
+      it = groups_.erase(it);
+      continue;
+    }
+
+    count += it->streams->size();
+    it->loop->post([streams = it->streams, data] {
+      for (const auto &stream : *streams)
+        stream->enqueue(data);
+    });
+    ++it;
+  }
+  return count;
+}
+
+std::size_t cppws::sse_channel::size() const {
+  std::unique_lock l{lock_};
+  std::size_t count = 0;
+  for (const group &g : groups_)
+    count += g.streams->size();
+  return count;
+}
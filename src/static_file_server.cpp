@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <format>
+#include <list>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cppws/compression.hpp>
+#include <cppws/static_file_server.hpp>
+#include <cppws/url.hpp>
+
+namespace {
+
+/**
+ * An open file holding one representation of a served file.
+ */
+struct file_variant {
+  int fd = -1;
+  std::uint64_t size = 0;
+  std::string etag;
+};
+
+/**
+ * A served file together with everything needed to answer requests for it:
+ * the file itself and its precompressed variants.
+ */
+struct file_entry {
+  /** Path of the file relative to the root. */
+  std::string path;
+  std::time_t mtime = 0;
+  std::string_view content_type;
+  /** Codings of the available precompressed variants. */
+  cppws::content_coding_set codings = 0;
+  /** Representations of the file by content_coding, identity first. */
+  std::array<file_variant, 5> variants;
+
+  file_entry() = default;
+  file_entry(const file_entry &) = delete;
+  file_entry &operator=(const file_entry &) = delete;
+
+  ~file_entry() {
+    for (file_variant &v : variants)
+      if (v.fd >= 0)
+        ::close(v.fd);
+  }
+
+  file_variant &variant(cppws::content_coding coding) noexcept {
+    return variants[static_cast<std::size_t>(coding)];
+  }
+
+  const file_variant &variant(cppws::content_coding coding) const noexcept {
+    return variants[static_cast<std::size_t>(coding)];
+  }
+};
+
+/**
+ * File name suffixes of precompressed variants.
+ */
+constexpr std::pair<cppws::content_coding, std::string_view>
+    variant_suffixes[] = {
+        {cppws::content_coding::Brotli, ".br"},
+        {cppws::content_coding::Zstd, ".zst"},
+        {cppws::content_coding::Gzip, ".gz"},
+};
+
+using entry_ptr = std::shared_ptr<const file_entry>;
+
+constexpr std::uint32_t watch_mask =
+    IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO |
+    IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF;
+
+[[noreturn]] void throw_errno() {
+  throw std::system_error(errno, std::system_category());
+}
+
+} // namespace
+
+struct cppws::static_file_server::state {
+  std::string root;
+  int rootFd = -1;
+  int inotifyFd = -1;
+  int wakeFd = -1;
+  std::size_t mount = 0;
+  static_file_options options;
+
+  std::mutex lock;
+  /** Cached files by request path, most recently used first. */
+  std::list<std::pair<std::string, entry_ptr>> lru;
+  std::unordered_map<std::string_view,
+                     std::list<std::pair<std::string, entry_ptr>>::iterator>
+      index;
+  /**
+   * Number of invalidations so far. Files opened while it changed are
+   * served without being cached, since their change may have been handled
+   * before they were added.
+   */
+  std::uint64_t generation = 0;
+  /** Watched directories relative to the root, by watch descriptor. */
+  std::unordered_map<int, std::string> watches;
+  std::thread watcher;
+
+  ~state();
+
+  entry_ptr find(std::string_view key);
+  entry_ptr open(std::string_view key);
+  void open_variants(file_entry &entry, const struct stat &st);
+  void watch(std::string_view dir);
+  void invalidate(std::string_view path);
+  void run_watcher();
+};
+
+cppws::static_file_server::state::~state() {
+  if (watcher.joinable()) {
+    std::uint64_t one = 1;
+    [[maybe_unused]] ::ssize_t n = ::write(wakeFd, &one, sizeof one);
+    watcher.join();
+  }
+  for (int fd : {rootFd, inotifyFd, wakeFd})
+    if (fd >= 0)
+      ::close(fd);
+}
+
+entry_ptr cppws::static_file_server::state::find(std::string_view key) {
+  std::uint64_t opened;
+  {
+    std::unique_lock l{lock};
+    if (auto it = index.find(key); it != index.end()) {
+      lru.splice(lru.begin(), lru, it->second);
+      return it->second->second;
+    }
+    opened = generation;
+  }
+
+  entry_ptr entry = open(key);
+  if (!entry)
+    return entry;
+
+  // A change handled while the file was opened found nothing to erase, so
+  // the entry may already be stale; it is served once without caching.
+  //
+  std::unique_lock l{lock};
+  if (generation != opened)
+    return entry;
+  if (index.contains(key))
+    return entry; // Raced with another request; serve without caching.
+  lru.emplace_front(std::string(key), entry);
+  index.emplace(lru.front().first, lru.begin());
+  while (lru.size() > options.max_open_files) {
+    index.erase(lru.back().first);
+    lru.pop_back();
+  }
+  return entry;
+}
+
+entry_ptr cppws::static_file_server::state::open(std::string_view key) {
+  // The directory is watched before the file is opened, so that every
+  // later change is reported. One handled before find() adds the entry is
+  // caught by the invalidation generation.
+  //
+  std::size_t slash = key.rfind('/');
+  watch(slash == std::string_view::npos ? std::string_view()
+                                        : key.substr(0, slash));
+
+  auto entry = std::make_shared<file_entry>();
+  file_variant &file = entry->variant(content_coding::Identity);
+  entry->path.assign(key);
+  file.fd = ::openat(rootFd, key.empty() ? "." : entry->path.c_str(),
+                     O_RDONLY | O_CLOEXEC);
+  if (file.fd < 0)
+    return nullptr;
+
+  struct stat st;
+  if (::fstat(file.fd, &st) < 0)
+    return nullptr;
+
+  if (S_ISDIR(st.st_mode)) {
+    watch(key);
+    ::close(file.fd);
+    if (!entry->path.empty())
+      entry->path.append(1, '/');
+    entry->path.append(options.index);
+    file.fd = ::openat(rootFd, entry->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file.fd < 0 || ::fstat(file.fd, &st) < 0)
+      return nullptr;
+  }
+  if (!S_ISREG(st.st_mode))
+    return nullptr;
+
+  std::uint64_t version =
+      static_cast<std::uint64_t>(st.st_mtim.tv_sec) * 1'000'000'000 +
+      static_cast<std::uint64_t>(st.st_mtim.tv_nsec);
+  file.size = static_cast<std::uint64_t>(st.st_size);
+  file.etag = std::format("\"{:x}-{:x}\"", file.size, version);
+  entry->mtime = st.st_mtim.tv_sec;
+
+  std::string_view name = entry->path;
+  name = name.substr(name.rfind('/') + 1);
+  std::size_t dot = name.rfind('.');
+  entry->content_type = to_string(
+      dot == std::string_view::npos
+          ? http_content_type::ApplicationOctetStream
+          : content_type_for_extension(name.substr(dot + 1)));
+
+  if (options.precompress && is_compressible(entry->content_type))
+    open_variants(*entry, st);
+  return entry;
+}
+
+void cppws::static_file_server::state::open_variants(file_entry &entry,
+                                                     const struct stat &st) {
+  const file_variant &file = entry.variant(content_coding::Identity);
+
+  // Variants on disk are used unless they are older than the file.
+  //
+  for (auto [coding, suffix] : variant_suffixes) {
+    std::string path = entry.path + std::string(suffix);
+    int fd = ::openat(rootFd, path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      continue;
+
+    struct stat vst;
+    if (::fstat(fd, &vst) < 0 || !S_ISREG(vst.st_mode) ||
+        vst.st_mtim.tv_sec < st.st_mtim.tv_sec ||
+        static_cast<std::uint64_t>(vst.st_size) >= file.size) {
+      ::close(fd);
+      continue;
+    }
+
+    file_variant &v = entry.variant(coding);
+    v.fd = fd;
+    v.size = static_cast<std::uint64_t>(vst.st_size);
+    entry.codings |= coding_bit(coding);
+  }
+
+  // Otherwise gzip is built once in memory, and sent from a memfd so that
+  // it takes the same sendfile() path as files on disk.
+  //
+  file_variant &gzip = entry.variant(content_coding::Gzip);
+  if (gzip.fd < 0 && file.size >= options.precompress_min_size &&
+      file.size <= options.precompress_max_size) {
+    std::pmr::string in;
+    in.resize(file.size);
+    std::size_t read = 0;
+    while (read < in.size()) {
+      ::ssize_t n = ::pread(file.fd, in.data() + read, in.size() - read,
+                            static_cast<::off_t>(read));
+      if (n <= 0)
+        break;
+      read += static_cast<std::size_t>(n);
+    }
+
+    std::pmr::string out;
+    compressor c;
+    if (read == in.size() && !in.empty() &&
+        c.compress(content_coding::Gzip, 9, in, out, in.size() - 1)) {
+      int fd = ::memfd_create("cppws-gzip", MFD_CLOEXEC);
+      if (fd >= 0 && ::write(fd, out.data(), out.size()) ==
+                         static_cast<::ssize_t>(out.size())) {
+        gzip.fd = fd;
+        gzip.size = out.size();
+        entry.codings |= coding_bit(content_coding::Gzip);
+      } else if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+  }
+
+  // Each encoding is a representation of its own and needs its own strong
+  // validator.
+  //
+  for (auto [coding, suffix] : variant_suffixes) {
+    file_variant &v = entry.variant(coding);
+    if (v.fd >= 0)
+      v.etag = std::format("{}{}\"", std::string_view(file.etag).substr(
+                                         0, file.etag.size() - 1),
+                           suffix);
+  }
+}
+
+void cppws::static_file_server::state::watch(std::string_view dir) {
+  std::string path = root;
+  if (!dir.empty()) {
+    path.append(1, '/');
+    path.append(dir);
+  }
+
+  int wd = ::inotify_add_watch(inotifyFd, path.c_str(), watch_mask);
+  if (wd < 0)
+    return;
+
+  std::unique_lock l{lock};
+  watches.try_emplace(wd, dir);
+}
+
+void cppws::static_file_server::state::invalidate(std::string_view path) {
+  ++generation;
+  for (auto it = lru.begin(); it != lru.end();) {
+    std::string_view p = it->second->path;
+    if (path.empty() || p == path ||
+        (p.starts_with(path) && p[path.size()] == '/')) {
+      index.erase(it->first);
+      it = lru.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void cppws::static_file_server::state::run_watcher() {
+  struct pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+  alignas(struct inotify_event) char buf[4096];
+
+  for (;;) {
+    if (::poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    if (fds[1].revents)
+      return;
+
+    ::ssize_t n = ::read(inotifyFd, buf, sizeof buf);
+    if (n <= 0)
+      continue;
+
+    std::unique_lock l{lock};
+    for (char *p = buf; p < buf + n;) {
+      const auto *event = reinterpret_cast<const struct inotify_event *>(p);
+      p += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        invalidate({});
+        continue;
+      }
+
+      auto it = watches.find(event->wd);
+      if (it == watches.end())
+        continue;
+
+      std::string path = it->second;
+      if (event->len > 0) {
+        if (!path.empty())
+          path.append(1, '/');
+        path.append(event->name);
+      }
+      invalidate(path);
+      for (auto [coding, suffix] : variant_suffixes) {
+        if (path.ends_with(suffix))
+          invalidate(std::string_view(path).substr(0, path.size() -
+                                                          suffix.size()));
+      }
+
+      if (event->mask & IN_IGNORED)
+        watches.erase(it);
+    }
+  }
+}
+
+/**
+ * Appends the file system path that a request refers to, relative to the
+ * served directory, to \p out.
+ *
+ * \return false if the path is malformed or tries to leave the directory.
+ */
+template <typename String>
+static bool resolve_path(const cppws::http_request &request,
+                         std::size_t mount, String &out) {
+  std::size_t skipped = 0;
+  for (const std::pmr::string &s : request.uri()) {
+    std::string_view seg = s;
+    std::size_t end = seg.find_first_of("?#");
+    bool last = end != std::string_view::npos;
+    seg = seg.substr(0, end);
+
+    if (!seg.empty() && skipped++ >= mount) {
+      std::string decoded;
+      if (seg.find('%') != std::string_view::npos) {
+        try {
+          decoded = cppws::url::decode(seg);
+        } catch (const cppws::bad_url &) {
+          return false;
+        }
+        seg = decoded;
+      }
+      if (seg == "." || seg == ".." ||
+          seg.find_first_of(std::string_view("/\0", 2)) !=
+              std::string_view::npos)
+        return false;
+
+      if (!out.empty())
+        out.append(1, '/');
+      out.append(seg);
+    }
+    if (last)
+      break;
+  }
+  return true;
+}
+
+cppws::static_file_server::static_file_server(
+    const std::filesystem::path &root, std::string_view mount,
+    static_file_options options)
+    : state_(std::make_shared<state>()) {
+  state_->root = root.string();
+  state_->options = std::move(options);
+  for (std::size_t pos = 0; pos < mount.size();) {
+    std::size_t next = std::min(mount.find('/', pos), mount.size());
+    if (next > pos)
+      ++state_->mount;
+    pos = next + 1;
+  }
+
+  state_->rootFd =
+      ::open(state_->root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (state_->rootFd < 0)
+    throw_errno();
+  state_->inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (state_->inotifyFd < 0)
+    throw_errno();
+  state_->wakeFd = ::eventfd(0, EFD_CLOEXEC);
+  if (state_->wakeFd < 0)
+    throw_errno();
+
+  state_->watcher = std::thread([s = state_.get()] { s->run_watcher(); });
+}
+
+void cppws::static_file_server::operator()(request_manager &manager) const {
+  std::array<std::byte, 512> mem;
+  std::pmr::monotonic_buffer_resource res{mem.data(), mem.size()};
+  std::pmr::string key{&res};
+
+  if (!resolve_path(manager.request(), state_->mount, key)) {
+    manager.status(http::BAD_REQUEST).body(http::body("Malformed path."));
+    return;
+  }
+
+  entry_ptr entry = state_->find(key);
+  if (!entry) {
+    manager.status(http::NOT_FOUND).body(http::body("File not found."));
+    return;
+  }
+
+  content_coding coding = content_coding::Identity;
+  if (entry->codings) {
+    manager.header(http_response_header::Vary, "Accept-Encoding");
+    if (const std::pmr::string *accept = manager.request().http_header(
+            http_request_header::AcceptEncoding))
+      coding = negotiate_encoding(*accept, entry->codings);
+  }
+
+  const file_variant &file = entry->variant(coding);
+  if (manager.validate({.etag = file.etag, .last_modified = entry->mtime}))
+    return;
+  if (coding != content_coding::Identity)
+    manager.header(http_response_header::ContentEncoding, to_string(coding));
+  if (!state_->options.cache_control.empty())
+    manager.header(http_response_header::CacheControl,
+                   state_->options.cache_control);
+  manager.content_type(entry->content_type).send_file(file.fd, file.size);
+}
+
+void cppws::static_file_server::preload() const {
+  namespace fs = std::filesystem;
+
+  std::error_code ec;
+  fs::path root{state_->root};
+  for (auto it = fs::recursive_directory_iterator(root, ec);
+       !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (cached_files() >= state_->options.max_open_files)
+      break;
+    if (!it->is_regular_file(ec))
+      continue;
+
+    std::string key = it->path().lexically_relative(root).string();
+    bool variant = std::ranges::any_of(variant_suffixes, [&key](auto &v) {
+      return key.ends_with(v.second);
+    });
+    if (!variant)
+      state_->find(key);
+  }
+}
+
+std::size_t cppws::static_file_server::cached_files() const {
+  std::unique_lock l{state_->lock};
+  return state_->lru.size();
+}
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <bit>
+
+#include <cppws/timer_wheel.hpp>
+
+void cppws::timer_wheel::timer::cancel() noexcept {
+  if (!wheel_)
+    return;
+  wheel_->unlink(*this);
+  --wheel_->size_;
+  wheel_ = nullptr;
+  fn_ = nullptr;
+}
+
+cppws::timer_wheel::timer_wheel(std::chrono::milliseconds resolution)
+    : origin_(clock::now()),
+      resolution_(std::max<clock::duration>(resolution, 1ms)) {}
+
+cppws::timer_wheel::~timer_wheel() {
+  for (auto &level : slots_) {
+    for (timer *&head : level) {
+      while (timer *t = head) {
+        head = t->next_;
+        t->wheel_ = nullptr;
+        t->prev_ = t->next_ = nullptr;
+        t->fn_ = nullptr;
+      }
+    }
+  }
+}
+
+std::uint64_t
+cppws::timer_wheel::tick_of(clock::time_point t) const noexcept {
+  if (t <= origin_)
+    return 0;
+  return static_cast<std::uint64_t>((t - origin_) / resolution_);
+}
+
+void cppws::timer_wheel::link(timer &t) noexcept {
+  // Timers that are already due go to the next tick processed.
+  //
+  std::uint64_t expiry = std::max(t.expiry_, now_);
+  std::uint64_t delta = expiry - now_;
+
+  int level = 0;
+  while (level < LEVELS - 1 && delta >> (SLOT_BITS * (level + 1)))
+    ++level;
+
+  // Timers beyond the range of the wheel wait in the farthest slot and are
+  // placed again, from their actual expiry, when that slot moves down.
+  //
+  if (delta >> (SLOT_BITS * LEVELS))
+    expiry = now_ + (std::uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+
+  std::uint64_t index = (expiry >> (SLOT_BITS * level)) & (SLOTS - 1);
+  timer *&head = slots_[level][index];
+  t.slot_ = static_cast<std::uint16_t>(level * SLOTS + index);
+  t.prev_ = nullptr;
+  t.next_ = head;
+  if (head)
+    head->prev_ = &t;
+  head = &t;
+  occupied_[level] |= std::uint64_t(1) << index;
+}
+
+void cppws::timer_wheel::unlink(timer &t) noexcept {
+  int level = t.slot_ / SLOTS;
+  std::uint64_t index = t.slot_ % SLOTS;
+  if (t.prev_) {
+    t.prev_->next_ = t.next_;
+  } else {
+    slots_[level][index] = t.next_;
+    if (!t.next_)
+      occupied_[level] &= ~(std::uint64_t(1) << index);
+  }
+  if (t.next_)
+    t.next_->prev_ = t.prev_;
+  t.prev_ = t.next_ = nullptr;
+}
+
+void cppws::timer_wheel::cascade(int level) noexcept {
+  std::uint64_t index = (now_ >> (SLOT_BITS * level)) & (SLOTS - 1);
+  timer *t = slots_[level][index];
+  slots_[level][index] = nullptr;
+  occupied_[level] &= ~(std::uint64_t(1) << index);
+  while (t) {
+    timer *next = t->next_;
+    link(*t);
+    t = next;
+  }
+}
+
+void cppws::timer_wheel::arm(timer &t, std::chrono::milliseconds delay,
+                             callback fn) {
+  if (t.wheel_ == this)
+    unlink(t);
+  else
+    t.cancel();
+
+  // An empty wheel catches up at once instead of tick by tick in advance().
+  //
+  clock::time_point now = clock::now();
+  if (size_ == 0)
+    now_ = std::max(now_, tick_of(now));
+
+  // Rounded up to a whole tick, so that the timer never fires early.
+  //
+  auto due = now + std::max(delay, 0ms) - origin_;
+  auto ticks = (due + resolution_ - clock::duration(1)) / resolution_;
+  t.expiry_ = static_cast<std::uint64_t>(ticks);
+  if (t.wheel_ != this) {
+    t.wheel_ = this;
+    ++size_;
+  }
+  t.fn_ = std::move(fn);
+  link(t);
+}
+
+std::size_t cppws::timer_wheel::advance(clock::time_point now) {
+  std::uint64_t target = tick_of(now);
+  std::size_t expired = 0;
+
+  while (now_ <= target) {
+    std::uint64_t tick = now_;
+
+    // Nothing to do until the first level wraps around, when timers may
+    // move down from the levels above.
+    //
+    if (size_ == 0) {
+      now_ = target + 1;
+      break;
+    }
+    if (occupied_[0] == 0 && (tick & (SLOTS - 1)) != 0) {
+      now_ = std::min((tick | (SLOTS - 1)) + 1, target + 1);
+      continue;
+    }
+
+    for (int level = 1; level < LEVELS; ++level) {
+      if (tick & ((std::uint64_t(1) << (SLOT_BITS * level)) - 1))
+        break;
+      cascade(level);
+    }
+
+    // Timers armed by the callbacks expire from the next tick on, but may
+    // land in this same slot, so the slot is searched again after every
+    // callback rather than walked once.
+    //
+    ++now_;
+    timer *const &head = slots_[0][tick & (SLOTS - 1)];
+    for (;;) {
+      timer *t = head;
+      while (t && t->expiry_ > tick)
+        t = t->next_;
+      if (!t)
+        break;
+
+      unlink(*t);
+      --size_;
+      t->wheel_ = nullptr;
+      callback fn = std::move(t->fn_);
+      ++expired;
+      fn();
+    }
+  }
+  return expired;
+}
+
+int cppws::timer_wheel::next_timeout(clock::time_point now) const noexcept {
+  if (size_ == 0)
+    return -1;
+
+  // The first armed slot of the first level, or else the next wrap around,
+  // which may bring timers down from the levels above.
+  //
+  std::uint64_t offset = now_ & (SLOTS - 1);
+  std::uint64_t pending = std::rotr(occupied_[0], static_cast<int>(offset));
+  std::uint64_t ticks = pending ? std::countr_zero(pending) : SLOTS - offset;
+
+  clock::time_point due = origin_ + resolution_ * (now_ + ticks);
+  if (due <= now)
+    return 0;
+  auto wait = std::chrono::ceil<std::chrono::milliseconds>(due - now);
+  return static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+      wait.count(), 24 * 3600 * 1000));
+}
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <cppws/socket.hpp>
+#include <cppws/tls.hpp>
+
+/**
+ * Throws the oldest error queued by OpenSSL, prefixed with what failed.
+ */
+[[noreturn]] static void throw_tls_error(const char *what) {
+  char reason[256] = "unknown error";
+  if (unsigned long e = ERR_get_error())
+    ERR_error_string_n(e, reason, sizeof reason);
+  ERR_clear_error();
+  throw cppws::tls_error(std::string(what) + ": " + reason);
+}
+
+/**
+ * Picks the first protocol of the server's list that the client offers.
+ */
+static int select_alpn(SSL *, const unsigned char **out, unsigned char *outlen,
+                       const unsigned char *in, unsigned int inlen,
+                       void *arg) {
+  const auto *server = static_cast<const std::string *>(arg);
+  unsigned char *selected;
+  if (SSL_select_next_proto(
+          &selected, outlen,
+          reinterpret_cast<const unsigned char *>(server->data()),
+          static_cast<unsigned int>(server->size()), in,
+          inlen) != OPENSSL_NPN_NEGOTIATED)
+    return SSL_TLSEXT_ERR_NOACK;
+  *out = selected;
+  return SSL_TLSEXT_ERR_OK;
+}
+
+cppws::tls_context::tls_context(const tls_options &options) {
+  // OpenSSL writes to sockets with write(), which raises SIGPIPE if the
+  // peer has gone away, e.g. when a close_notify alert is sent.
+  //
+  std::signal(SIGPIPE, SIG_IGN);
+
+  ctx_ = SSL_CTX_new(TLS_server_method());
+  if (!ctx_)
+    throw_tls_error("Cannot create TLS context");
+
+  SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+
+  // Clients commonly close without a close_notify alert, which is treated
+  // as the end of the stream rather than as an error.
+  //
+  std::uint64_t op = SSL_OP_IGNORE_UNEXPECTED_EOF |
+                     SSL_OP_CIPHER_SERVER_PREFERENCE;
+  if (!options.session_tickets)
+    op |= SSL_OP_NO_TICKET;
+  if (options.kernel_tls)
+    op |= SSL_OP_ENABLE_KTLS;
+  SSL_CTX_set_options(ctx_, op);
+
+  // Writes may complete partially on non-blocking sockets and are retried
+  // with the remaining data, which need not be at the same address.
+  //
+  SSL_CTX_set_mode(ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                             SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                             SSL_MODE_RELEASE_BUFFERS);
+
+  if (SSL_CTX_use_certificate_chain_file(ctx_,
+                                         options.certificate_file.c_str()) !=
+          1 ||
+      SSL_CTX_use_PrivateKey_file(ctx_, options.private_key_file.c_str(),
+                                  SSL_FILETYPE_PEM) != 1 ||
+      SSL_CTX_check_private_key(ctx_) != 1) {
+    SSL_CTX_free(ctx_);
+    throw_tls_error("Cannot load TLS certificate");
+  }
+
+  static constexpr unsigned char session_context[] = "cppws";
+  SSL_CTX_set_session_id_context(ctx_, session_context,
+                                 sizeof session_context - 1);
+  SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_sess_set_cache_size(ctx_, static_cast<long>(
+                                        options.session_cache_size));
+  SSL_CTX_set_timeout(ctx_, static_cast<long>(options.session_timeout.count()));
+
+  // A single ticket per handshake is enough for a client that reuses its
+  // connections; the default of two doubles the work of every handshake.
+  //
+  SSL_CTX_set_num_tickets(ctx_, options.session_tickets ? 1 : 0);
+
+  for (const std::string &protocol : options.alpn) {
+    if (protocol.empty() || protocol.size() > 255) {
+      SSL_CTX_free(ctx_);
+      throw tls_error("Invalid ALPN protocol name");
+    }
+    alpn_.push_back(static_cast<char>(protocol.size()));
+    alpn_.append(protocol);
+  }
+  if (!alpn_.empty())
+    SSL_CTX_set_alpn_select_cb(ctx_, select_alpn, &alpn_);
+}
+
+cppws::tls_context::~tls_context() noexcept { SSL_CTX_free(ctx_); }
+
+cppws::tls_session_stats cppws::tls_context::stats() const noexcept {
+  return {.handshakes = SSL_CTX_sess_accept_good(ctx_),
+          .resumed = SSL_CTX_sess_hits(ctx_),
+          .misses = SSL_CTX_sess_misses(ctx_),
+          .cached = SSL_CTX_sess_number(ctx_)};
+}
+
+/**
+ * Maps the result of an SSL I/O call to the convention of the socket calls:
+ * the number of bytes transferred, 0 at the end of the stream, or -1 if the
+ * call would block.
+ */
+static std::ptrdiff_t io_result(SSL *ssl, int ret, std::size_t n) {
+  if (ret > 0)
+    return static_cast<std::ptrdiff_t>(n);
+
+  switch (SSL_get_error(ssl, ret)) {
+  case SSL_ERROR_ZERO_RETURN:
+    return 0;
+  case SSL_ERROR_WANT_READ:
+  case SSL_ERROR_WANT_WRITE:
+    return -1;
+  case SSL_ERROR_SYSCALL:
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return -1;
+    ERR_clear_error();
+    throw std::system_error(errno, std::system_category());
+  default:
+    throw_tls_error("TLS connection failed");
+  }
+}
+
+void cppws::socket::tls_accept(const tls_context &context) {
+  if (fd_ < 0)
+    throw std::runtime_error("Bad socket");
+  if (tls_)
+    throw std::logic_error("TLS is already enabled on the socket");
+
+  SSL *ssl = SSL_new(context.native_handle());
+  if (!ssl || SSL_set_fd(ssl, fd_) != 1) {
+    SSL_free(ssl);
+    throw_tls_error("Cannot create TLS connection");
+  }
+
+  int ret;
+  while ((ret = SSL_accept(ssl)) != 1) {
+    int error = SSL_get_error(ssl, ret);
+    if (error == SSL_ERROR_SYSCALL && errno == EINTR)
+      continue;
+    SSL_free(ssl);
+    if (error == SSL_ERROR_SYSCALL && errno != 0)
+      throw std::system_error(errno, std::system_category());
+    throw_tls_error("TLS handshake failed");
+  }
+
+  tls_ = ssl;
+  ktls_ = BIO_get_ktls_send(SSL_get_wbio(ssl)) != 0;
+}
+
+bool cppws::socket::tls_resumed() const noexcept {
+  return tls_ && SSL_session_reused(tls_) == 1;
+}
+
+std::string_view cppws::socket::alpn_protocol() const noexcept {
+  if (!tls_)
+    return {};
+  const unsigned char *protocol;
+  unsigned int length;
+  SSL_get0_alpn_selected(tls_, &protocol, &length);
+  return {reinterpret_cast<const char *>(protocol), length};
+}
+
+std::ptrdiff_t cppws::socket::tls_read(char *str, std::size_t len) {
+  std::size_t n = 0;
+  int ret = SSL_read_ex(tls_, str, len, &n);
+  return io_result(tls_, ret, n);
+}
+
+std::ptrdiff_t cppws::socket::tls_write(const struct iovec *iov, int count) {
+  while (count > 0 && iov->iov_len == 0) {
+    ++iov;
+    --count;
+  }
+  if (count == 0)
+    return 0;
+
+  // Each write becomes at least one record, with its own header, MAC and
+  // syscall: small buffers (status line, headers, short bodies) are
+  // gathered into a single record instead.
+  //
+  char record[SSL3_RT_MAX_PLAIN_LENGTH];
+  const void *data = iov->iov_base;
+  std::size_t length = iov->iov_len;
+  if (count > 1 && length < sizeof record) {
+    length = 0;
+    for (int i = 0; i < count && length < sizeof record; ++i) {
+      std::size_t n = std::min(iov[i].iov_len, sizeof record - length);
+      std::memcpy(record + length, iov[i].iov_base, n);
+      length += n;
+    }
+    data = record;
+  }
+
+  std::size_t n = 0;
+  int ret = SSL_write_ex(tls_, data, length, &n);
+  return io_result(tls_, ret, n);
+}
+
+std::size_t cppws::socket::tls_send_file(int fd, std::uint64_t &offset,
+                                         std::size_t count) {
+  if (ktls_) {
+    ossl_ssize_t n;
+    while ((n = SSL_sendfile(tls_, fd, static_cast<::off_t>(offset), count,
+                             0)) < 0) {
+      if (SSL_get_error(tls_, static_cast<int>(n)) != SSL_ERROR_SYSCALL ||
+          errno != EINTR)
+        throw std::system_error(errno, std::system_category());
+    }
+    offset += static_cast<std::uint64_t>(n);
+    return static_cast<std::size_t>(n);
+  }
+
+  // Without kTLS the file has to pass through user space to be encrypted.
+  //
+  char buffer[SSL3_RT_MAX_PLAIN_LENGTH];
+  ::ssize_t r;
+  while ((r = ::pread(fd, buffer, std::min(count, sizeof buffer),
+                      static_cast<::off_t>(offset))) < 0) {
+    if (errno != EINTR)
+      throw std::system_error(errno, std::system_category());
+  }
+  if (r == 0)
+    return 0;
+
+  struct iovec iov = {buffer, static_cast<std::size_t>(r)};
+  std::size_t n = write(&iov, 1);
+  offset += n;
+  return n;
+}
+
+void cppws::socket::tls_close() noexcept {
+  // Best effort close_notify; the peer may already be gone.
+  //
+  SSL_shutdown(tls_);
+  SSL_free(tls_);
+  ERR_clear_error();
+  tls_ = nullptr;
+  ktls_ = false;
+}
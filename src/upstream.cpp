@@ -0,0 +1,736 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <system_error>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cppws/upstream.hpp>
+
+using clock_type = std::chrono::steady_clock;
+
+/**
+ * How the end of a response body is found.
+ */
+enum class body_framing { None, Length, Chunked, Close };
+
+/**
+ * Status line and headers of an upstream response.
+ */
+struct response_head {
+  int version = 110;
+  int status = 0;
+  std::string reason;
+  std::vector<std::pair<std::string, std::string>> headers;
+  body_framing framing = body_framing::None;
+  std::uint64_t length = 0;
+  bool keepAlive = true;
+};
+
+/**
+ * Headers that only apply to a single connection and are not forwarded
+ * (RFC 9110 section 7.6.1).
+ */
+static bool hop_by_hop(std::string_view name) noexcept {
+  using cppws::iequals;
+  return iequals(name, "Connection") || iequals(name, "Keep-Alive") ||
+         iequals(name, "Proxy-Connection") || iequals(name, "TE") ||
+         iequals(name, "Trailer") || iequals(name, "Transfer-Encoding") ||
+         iequals(name, "Upgrade") || iequals(name, "Proxy-Authenticate") ||
+         iequals(name, "Proxy-Authorization");
+}
+
+/**
+ * True if \p name is listed in a Connection header value.
+ */
+static bool connection_option(std::string_view connection,
+                              std::string_view name) {
+  std::pmr::string value{connection};
+  return cppws::has_token(&value, name);
+}
+
+/**
+ * Appends the entry of a proxy named \p name, which received the message
+ * with HTTP version \p version, to the Via value \p received.
+ */
+static std::string via_value(std::string_view received, int version,
+                             std::string_view name) {
+  std::string out{received};
+  if (!out.empty())
+    out.append(", ");
+  out.append(version >= 200 ? "2" : version >= 110 ? "1.1" : "1.0");
+  out.push_back(' ');
+  out.append(name);
+  return out;
+}
+
+static bool idempotent(cppws::http_method method) noexcept {
+  using enum cppws::http_method;
+  return method != POST && method != PATCH && method != CONNECT;
+}
+
+static void write_bytes(cppws::socket &s, std::string_view head,
+                        std::string_view body = {}) {
+  struct iovec iov[2] = {{const_cast<char *>(head.data()), head.size()},
+                         {const_cast<char *>(body.data()), body.size()}};
+  cppws::write_all(s, iov, 2);
+}
+
+/**
+ * Connection to an upstream, with the bytes read but not consumed yet.
+ */
+class cppws::upstream_pool::connection {
+public:
+  connection(std::string key, class socket &&s)
+      : key(std::move(key)), socket(std::move(s)) {}
+
+  std::string key;
+  class socket socket;
+  std::string input;
+  std::size_t pos = 0;
+  std::size_t requests = 0;
+  clock_type::time_point idleSince;
+  bool reusable = true;
+  /** Pipe for splice_to(), created on first use. */
+  int pipe[2] = {-1, -1};
+
+  ~connection() {
+    if (pipe[0] >= 0) {
+      ::close(pipe[0]);
+      ::close(pipe[1]);
+    }
+  }
+
+  std::string_view buffered() const noexcept {
+    return std::string_view(input).substr(pos);
+  }
+
+  /**
+   * Reads more data from the upstream. Returns false at the end of the
+   * stream.
+   */
+  bool fill() {
+    constexpr std::size_t chunk = 64 * 1024;
+    if (pos == input.size()) {
+      input.clear();
+      pos = 0;
+    }
+    std::size_t at = input.size();
+    input.resize(at + chunk);
+    std::size_t n = socket.read(input.data() + at, chunk);
+    input.resize(at + n);
+    return n > 0;
+  }
+
+  /**
+   * Reads a CRLF terminated line, without the CRLF.
+   */
+  std::string_view read_line(std::size_t limit) {
+    for (;;) {
+      std::size_t eol = buffered().find("\r\n");
+      if (eol != std::string_view::npos) {
+        std::string_view line = buffered().substr(0, eol);
+        pos += eol + 2;
+        return line;
+      }
+      if (buffered().size() > limit)
+        throw upstream_error("Upstream response header too large");
+      // Compact so that the line starts at the beginning of the buffer.
+      //
+      input.erase(0, pos);
+      pos = 0;
+      if (!fill())
+        throw upstream_error("Upstream closed the connection");
+    }
+  }
+
+  /**
+   * Passes the next \p n bytes to \p fn, as they arrive.
+   */
+  template <typename F> void read_exact(std::uint64_t n, const F &fn) {
+    while (n > 0) {
+      if (buffered().empty() && !fill())
+        throw upstream_error("Upstream closed the connection");
+      std::string_view data = buffered().substr(0, n);
+      pos += data.size();
+      n -= data.size();
+      fn(data);
+    }
+  }
+
+  /**
+   * Passes everything up to the end of the stream to \p fn.
+   */
+  template <typename F> void read_to_end(const F &fn) {
+    do {
+      std::string_view data = buffered();
+      pos += data.size();
+      if (!data.empty())
+        fn(data);
+    } while (fill());
+  }
+
+  /**
+   * Moves the next \p n bytes, or everything up to the end of the stream
+   * if \p toEnd, to \p out. Data only passes through a pipe in the kernel
+   * instead of being copied to user space and back.
+   */
+  void splice_to(class socket &out, std::uint64_t n, bool toEnd) {
+    std::string_view data = buffered();
+    if (!toEnd)
+      data = data.substr(0, n);
+    pos += data.size();
+    n -= toEnd ? 0 : data.size();
+    if (!data.empty())
+      write_bytes(out, data);
+
+    if (pipe[0] < 0 && ::pipe2(pipe, O_CLOEXEC) != 0)
+      throw std::system_error(errno, std::system_category());
+
+    // The default pipe capacity.
+    //
+    constexpr std::uint64_t chunk = 64 * 1024;
+    constexpr unsigned flags = SPLICE_F_MOVE | SPLICE_F_MORE;
+    while (toEnd || n > 0) {
+      ::ssize_t r = ::splice(socket.native_handle(), nullptr, pipe[1],
+                             nullptr, toEnd ? chunk : std::min(n, chunk),
+                             flags);
+      if (r < 0) {
+        if (errno == EINTR)
+          continue;
+        throw std::system_error(errno, std::system_category());
+      }
+      if (r == 0) {
+        if (!toEnd)
+          throw upstream_error("Upstream closed the connection");
+        reusable = false;
+        return;
+      }
+      if (!toEnd)
+        n -= static_cast<std::uint64_t>(r);
+
+      for (::ssize_t left = r; left > 0;) {
+        ::ssize_t w = ::splice(pipe[0], nullptr, out.native_handle(), nullptr,
+                               static_cast<std::size_t>(left), flags);
+        if (w < 0) {
+          if (errno == EINTR)
+            continue;
+          throw std::system_error(errno, std::system_category());
+        }
+        left -= w;
+      }
+    }
+  }
+
+  /**
+   * Parses the status line and headers of a response, skipping interim (1xx)
+   * responses.
+   */
+  response_head read_head(bool headRequest, std::size_t limit) {
+    for (;;) {
+      response_head head;
+      std::string_view line = read_line(limit);
+      if (!line.starts_with("HTTP/1.") || line.size() < 12 || line[8] != ' ')
+        throw upstream_error("Malformed upstream status line");
+      head.version = line[7] == '0' ? 100 : 110;
+      if (std::from_chars(line.data() + 9, line.data() + 12, head.status).ec !=
+          std::errc{})
+        throw upstream_error("Malformed upstream status line");
+      head.reason = line.size() > 13 ? line.substr(13) : std::string_view();
+      head.keepAlive = head.version >= 110;
+
+      std::size_t size = line.size();
+      bool chunked = false;
+      bool hasLength = false;
+      for (;;) {
+        line = read_line(limit);
+        if (line.empty())
+          break;
+        size += line.size();
+        if (size > limit)
+          throw upstream_error("Upstream response header too large");
+
+        std::size_t colon = line.find(':');
+        if (colon == std::string_view::npos)
+          throw upstream_error("Malformed upstream header");
+        std::string_view name = line.substr(0, colon);
+        std::string_view value = trim_ows(line.substr(colon + 1));
+
+        if (iequals(name, "Content-Length")) {
+          if (std::from_chars(value.data(), value.data() + value.size(),
+                              head.length)
+                  .ec != std::errc{})
+            throw upstream_error("Malformed upstream Content-Length");
+          hasLength = true;
+        } else if (iequals(name, "Transfer-Encoding")) {
+          chunked = connection_option(value, "chunked");
+        } else if (iequals(name, "Connection")) {
+          if (connection_option(value, "close"))
+            head.keepAlive = false;
+          else if (connection_option(value, "keep-alive"))
+            head.keepAlive = true;
+        }
+        head.headers.emplace_back(name, value);
+      }
+
+      // Interim responses are followed by the final one.
+      //
+      if (head.status >= 100 && head.status < 200 && head.status != 101)
+        continue;
+
+      if (headRequest || head.status < 200 || head.status == 204 ||
+          head.status == 304)
+        head.framing = body_framing::None;
+      else if (chunked)
+        head.framing = body_framing::Chunked;
+      else if (hasLength)
+        head.framing = body_framing::Length;
+      else
+        head.framing = body_framing::Close;
+
+      if (head.framing == body_framing::Close || head.status == 101)
+        head.keepAlive = false;
+      if (head.framing != body_framing::Length)
+        head.length = 0;
+      return head;
+    }
+  }
+
+  /**
+   * Reads the body of a response and passes it to \p fn as it arrives. With
+   * \p raw, a chunked body is passed with its chunk framing, as received.
+   */
+  template <typename F>
+  void read_body(const response_head &head, bool raw, std::size_t limit,
+                 const F &fn) {
+    switch (head.framing) {
+    case body_framing::None:
+      break;
+    case body_framing::Length:
+      read_exact(head.length, fn);
+      break;
+    case body_framing::Close:
+      read_to_end(fn);
+      reusable = false;
+      break;
+    case body_framing::Chunked:
+      for (;;) {
+        std::string_view line = read_line(limit);
+        if (raw) {
+          fn(line);
+          fn("\r\n");
+        }
+        std::uint64_t size;
+        auto [end, ec] =
+            std::from_chars(line.data(), line.data() + line.size(), size, 16);
+        if (ec != std::errc{})
+          throw upstream_error("Malformed upstream chunk");
+
+        if (size == 0) {
+          // Trailer fields, up to an empty line.
+          //
+          do {
+            line = read_line(limit);
+            if (raw) {
+              fn(line);
+              fn("\r\n");
+            }
+          } while (!line.empty());
+          break;
+        }
+
+        read_exact(size, fn);
+        if (!read_line(limit).empty())
+          throw upstream_error("Malformed upstream chunk");
+        if (raw)
+          fn("\r\n");
+      }
+      break;
+    }
+  }
+};
+
+static void append_request_line(std::string &out, cppws::http_method method,
+                                 std::string_view target) {
+  out.append(to_string(method));
+  out.push_back(' ');
+  out.append(target.empty() ? std::string_view("/") : target);
+  out.append(" HTTP/1.1\r\n");
+}
+
+static void append_header(std::string &out, std::string_view name,
+                          std::string_view value) {
+  out.append(name);
+  out.append(": ");
+  out.append(value);
+  out.append("\r\n");
+}
+
+static void append_host(std::string &out,
+                        const cppws::upstream_address &address) {
+  out.append("Host: ");
+  if (address.host.starts_with("unix:")) {
+    out.append("localhost\r\n");
+    return;
+  }
+  if (address.host.find(':') != std::string::npos) {
+    out.push_back('[');
+    out.append(address.host);
+    out.push_back(']');
+  } else {
+    out.append(address.host);
+  }
+  if (address.port != 80) {
+    out.push_back(':');
+    out.append(std::to_string(address.port));
+  }
+  out.append("\r\n");
+}
+
+static void append_length(std::string &out, cppws::http_method method,
+                          std::size_t length) {
+  using enum cppws::http_method;
+  if (length > 0 || method == POST || method == PUT || method == PATCH)
+    append_header(out, "Content-Length", std::to_string(length));
+}
+
+/**
+ * Serializes a request of fetch() / fetch_all().
+ */
+static void append_request(std::string &out,
+                           const cppws::upstream_address &address,
+                           const cppws::upstream_request &request) {
+  append_request_line(out, request.method, request.target);
+  bool host = false;
+  for (const auto &[name, value] : request.headers) {
+    if (cppws::iequals(name, "Content-Length") || hop_by_hop(name))
+      continue;
+    host = host || cppws::iequals(name, "Host");
+    append_header(out, name, value);
+  }
+  if (!host)
+    append_host(out, address);
+  append_length(out, request.method, request.body.size());
+  out.append("\r\n");
+  out.append(request.body);
+}
+
+std::string_view
+cppws::upstream_response::header(std::string_view name) const noexcept {
+  for (const auto &[n, value] : headers) {
+    if (iequals(n, name))
+      return value;
+  }
+  return {};
+}
+
+cppws::upstream_pool::upstream_pool(const upstream_options &options)
+    : options_(options) {}
+
+cppws::upstream_pool::~upstream_pool() noexcept = default;
+
+std::unique_ptr<cppws::upstream_pool::connection>
+cppws::upstream_pool::acquire(const upstream_address &address, bool &reused) {
+  std::string key = address.host + ':' + std::to_string(address.port);
+  auto now = clock_type::now();
+
+  // The most recently used connection is taken first: it is the most likely
+  // to still be open, and the others are left to expire.
+  //
+  for (;;) {
+    std::unique_ptr<connection> c;
+    {
+      std::lock_guard l{lock_};
+      auto it = idle_.find(key);
+      if (it == idle_.end() || it->second.empty())
+        break;
+      c = std::move(it->second.back());
+      it->second.pop_back();
+    }
+
+    // An idle connection must have nothing to read: data would be a stray
+    // response and a zero-length read means the upstream closed it.
+    //
+    char probe;
+    ::ssize_t n = ::recv(c->socket.native_handle(), &probe, 1,
+                         MSG_PEEK | MSG_DONTWAIT);
+    bool healthy = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    if (healthy && now - c->idleSince <= options_.idle_timeout) {
+      reused = true;
+      ++reused_;
+      return c;
+    }
+    ++discarded_;
+  }
+
+  std::string_view host = address.host;
+  bool local = host.starts_with("unix:");
+  class socket s{local ? socket_family::Unix
+                 : host.find(':') != host.npos ? socket_family::IPv6
+                                               : socket_family::IPv4};
+  try {
+    if (local)
+      s.connect_unix(host.substr(5));
+    else
+      s.connect(host, address.port);
+  } catch (const std::exception &e) {
+    throw upstream_error("Cannot connect to upstream " + key + ": " +
+                         e.what());
+  }
+
+  // Requests are written in one go, so Nagle's algorithm would only delay
+  // them; timeouts keep a stuck upstream from blocking the handler forever.
+  //
+  int one = 1;
+  if (!local)
+    ::setsockopt(s.native_handle(), IPPROTO_TCP, TCP_NODELAY, &one,
+                 sizeof one);
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                options_.io_timeout)
+                .count();
+  struct timeval tv = {static_cast<time_t>(us / 1000000),
+                       static_cast<suseconds_t>(us % 1000000)};
+  ::setsockopt(s.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+  ::setsockopt(s.native_handle(), SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+
+  reused = false;
+  ++connects_;
+  return std::make_unique<connection>(std::move(key), std::move(s));
+}
+
+void cppws::upstream_pool::release(std::unique_ptr<connection> c) noexcept {
+  if (!c->reusable || c->requests >= options_.max_requests ||
+      options_.max_idle == 0)
+    return;
+
+  c->idleSince = clock_type::now();
+  std::lock_guard l{lock_};
+  auto &pool = idle_[c->key];
+  if (pool.size() >= options_.max_idle)
+    pool.erase(pool.begin());
+  pool.push_back(std::move(c));
+}
+
+std::vector<cppws::upstream_response>
+cppws::upstream_pool::fetch_all(const upstream_address &address,
+                                std::span<const upstream_request> requests) {
+  std::vector<upstream_response> out;
+  out.reserve(requests.size());
+  bool retried = false;
+
+  while (out.size() < requests.size()) {
+    bool reused;
+    std::unique_ptr<connection> c = acquire(address, reused);
+    std::size_t first = out.size();
+    try {
+      std::string bytes;
+      for (const upstream_request &request : requests.subspan(first))
+        append_request(bytes, address, request);
+      write_bytes(c->socket, bytes);
+      c->requests += requests.size() - first;
+
+      for (const upstream_request &request : requests.subspan(first)) {
+        response_head head = c->read_head(request.method == http_method::HEAD,
+                                       options_.max_header_size);
+        upstream_response &response = out.emplace_back();
+        c->read_body(head, false, options_.max_header_size,
+                  [&response](std::string_view data) {
+                    response.body.append(data);
+                  });
+        response.status = head.status;
+        response.reason = std::move(head.reason);
+        response.headers = std::move(head.headers);
+        if (!head.keepAlive) {
+          c->reusable = false;
+          break;
+        }
+      }
+    } catch (const std::exception &e) {
+      // A kept-alive connection may have been closed by the upstream just
+      // as it was reused; requests it did not answer at all are retried
+      // once on a new connection.
+      //
+      bool retry = reused && !retried && out.size() == first &&
+                   std::ranges::all_of(requests.subspan(first),
+                                       [](const upstream_request &r) {
+                                         return idempotent(r.method);
+                                       });
+      if (!retry)
+        throw upstream_error(std::string("Upstream request failed: ") +
+                             e.what());
+      retried = true;
+      continue;
+    }
+    release(std::move(c));
+  }
+  return out;
+}
+
+cppws::upstream_response
+cppws::upstream_pool::fetch(const upstream_address &address,
+                            const upstream_request &request) {
+  return std::move(fetch_all(address, {&request, 1}).front());
+}
+
+void cppws::upstream_pool::forward(const upstream_address &address,
+                                   request_manager &manager,
+                                   std::string_view via) {
+  const http_request &request = manager.request();
+  const std::pmr::string *requestConnection =
+      request.http_header(http_request_header::Connection);
+
+  std::string bytes;
+  append_request_line(bytes, request.http_method(), request.target());
+  request.for_each_header([&](std::string_view name, std::string_view value) {
+    if (hop_by_hop(name) || iequals(name, "Content-Length") ||
+        iequals(name, "Expect") || (!via.empty() && iequals(name, "Via")) ||
+        (requestConnection && connection_option(*requestConnection, name)))
+      return;
+    append_header(bytes, name, value);
+  });
+  if (!via.empty()) {
+    const std::pmr::string *received =
+        request.http_header(http_request_header::Via);
+    append_header(bytes, "Via",
+                  via_value(received ? std::string_view(*received) : "",
+                            request.http_version(), via));
+  }
+  if (!request.http_header(http_request_header::Host))
+    append_host(bytes, address);
+  append_length(bytes, request.http_method(), request.body().size());
+  bytes.append("\r\n");
+
+  bool headRequest = request.http_method() == http_method::HEAD;
+  bool retried = false;
+  std::unique_ptr<class connection> c;
+  response_head head;
+  for (;;) {
+    bool reused;
+    c = acquire(address, reused);
+    try {
+      write_bytes(c->socket, bytes, request.body_text());
+      ++c->requests;
+      head = c->read_head(headRequest, options_.max_header_size);
+      break;
+    } catch (const std::exception &e) {
+      if (!reused || retried || !idempotent(request.http_method()))
+        throw upstream_error(std::string("Upstream request failed: ") +
+                             e.what());
+      retried = true;
+    }
+  }
+  if (!head.keepAlive)
+    c->reusable = false;
+
+  // The response keeps the upstream's status and end-to-end headers. Date
+  // and Server are set by the response buffer.
+  //
+  bool stream = manager.has_connection();
+  const std::string *upstreamConnection = nullptr;
+  for (const auto &[name, value] : head.headers) {
+    if (iequals(name, "Connection"))
+      upstreamConnection = &value;
+  }
+  manager.status({.status_code = head.status, .reason = head.reason})
+      .compression(false);
+  std::string_view upstreamVia;
+  for (const auto &[name, value] : head.headers) {
+    if (hop_by_hop(name) || iequals(name, "Content-Length") ||
+        iequals(name, "Date") || iequals(name, "Server") ||
+        (upstreamConnection &&
+         connection_option(*upstreamConnection, name)))
+      continue;
+    if (!via.empty() && iequals(name, "Via"))
+      upstreamVia = value;
+    else
+      manager.header(name, value);
+  }
+  if (!via.empty())
+    manager.header(http_response_header::Via,
+                   via_value(upstreamVia, head.version, via));
+
+  auto body = [&c, &head, this](bool raw, const auto &fn) {
+    try {
+      c->read_body(head, raw, options_.max_header_size, fn);
+    } catch (const upstream_error &) {
+      throw;
+    } catch (const std::exception &e) {
+      throw upstream_error(std::string("Upstream response failed: ") +
+                           e.what());
+    }
+  };
+
+  if (!stream) {
+    std::pmr::string &out = manager.response().body();
+    body(false, [&out](std::string_view data) { out.append(data); });
+    if (headRequest) {
+      for (const auto &[name, value] : head.headers) {
+        if (iequals(name, "Content-Length"))
+          manager.header(name, value);
+      }
+    }
+    release(std::move(c));
+    manager.send();
+    return;
+  }
+
+  // The body is relayed as it arrives. Chunked bodies keep their framing
+  // for HTTP/1.1 clients; HTTP/1.0 clients get the decoded body, delimited
+  // by the end of the connection.
+  //
+  bool raw = head.framing == body_framing::Chunked &&
+             request.http_version() >= 110;
+  manager.response().streaming(true);
+  for (const auto &[name, value] : head.headers) {
+    if (iequals(name, "Content-Length") &&
+        (head.framing == body_framing::Length || headRequest))
+      manager.header(name, value);
+  }
+  if (raw)
+    manager.header("Transfer-Encoding", "chunked");
+  manager.send();
+
+  // Bodies that pass through unchanged are spliced from one socket to the
+  // other, unless the client's records are encrypted in user space.
+  //
+  class socket &client = manager.connection();
+  if (!raw &&
+      (head.framing == body_framing::Length ||
+       head.framing == body_framing::Close) &&
+      (!client.secure() || client.kernel_tls())) {
+    try {
+      c->splice_to(client, head.length, head.framing == body_framing::Close);
+    } catch (const upstream_error &) {
+      throw;
+    } catch (const std::exception &e) {
+      throw upstream_error(std::string("Upstream response failed: ") +
+                           e.what());
+    }
+  } else {
+    body(raw,
+         [&client](std::string_view data) { write_bytes(client, data); });
+  }
+  release(std::move(c));
+}
+
+void cppws::upstream_pool::clear() noexcept {
+  std::lock_guard l{lock_};
+  idle_.clear();
+}
+
+std::size_t cppws::upstream_pool::idle() const noexcept {
+  std::lock_guard l{lock_};
+  std::size_t n = 0;
+  for (const auto &[key, pool] : idle_)
+    n += pool.size();
+  return n;
+}
+
+cppws::upstream_stats cppws::upstream_pool::stats() const noexcept {
+  return {.connects = connects_, .reused = reused_, .discarded = discarded_};
+}
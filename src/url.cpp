@@ -66,18 +66,18 @@ std::string cppws::url::decode(const char *str, std::size_t length) {
       if (i + 2 >= length)
         throw bad_url(i, "2 digits required after '%'.");
 
-      char lo = str[i + 1];
-      char hi = str[i + 2];
+      char hi = str[i + 1];
+      char lo = str[i + 2];
 
-      if (!std::isxdigit(lo))
+      if (!std::isxdigit(hi))
         throw bad_url(i + 1, "Expected a hexadecimal digit.");
 
-      if (!std::isxdigit(hi))
+      if (!std::isxdigit(lo))
         throw bad_url(i + 2, "Expected a hexadecimal digit.");
 
-      str += static_cast<char>(toc(lo) | (toc(hi) << 4));
+      res += static_cast<char>(toc(lo) | (toc(hi) << 4));
 
-      i = i + 1;
+      i = i + 2;
       continue;
     }
     res += str[i];
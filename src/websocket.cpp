@@ -0,0 +1,601 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <system_error>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <cppws/websocket.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPPWS_WEBSOCKET_X86 1
+#endif
+
+/**
+ * Longest frame header: 2 bytes, an 8 byte length and the masking key.
+ */
+static constexpr std::size_t max_frame_header = 14;
+
+/**
+ * SHA-1 of a message, as needed by the opening handshake only.
+ */
+static std::array<std::uint8_t, 20> sha1(std::string_view message) {
+  std::uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                        0xC3D2E1F0};
+
+  std::string data{message};
+  data.push_back(static_cast<char>(0x80));
+  while (data.size() % 64 != 56)
+    data.push_back('\0');
+  std::uint64_t bits = static_cast<std::uint64_t>(message.size()) * 8;
+  for (int i = 7; i >= 0; --i)
+    data.push_back(static_cast<char>(bits >> (i * 8)));
+
+  for (std::size_t chunk = 0; chunk < data.size(); chunk += 64) {
+    std::uint32_t w[80];
+    for (int i = 0; i < 16; ++i) {
+      const auto *p =
+          reinterpret_cast<const unsigned char *>(data.data() + chunk + i * 4);
+      w[i] = (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) |
+             (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+    }
+    for (int i = 16; i < 80; ++i)
+      w[i] = std::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    std::uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; ++i) {
+      std::uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      std::uint32_t t = std::rotl(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = std::rotl(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  std::array<std::uint8_t, 20> out;
+  for (int i = 0; i < 20; ++i)
+    out[i] = static_cast<std::uint8_t>(h[i / 4] >> (24 - (i % 4) * 8));
+  return out;
+}
+
+static std::string base64(const std::uint8_t *data, std::size_t length) {
+  constexpr char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  out.reserve((length + 2) / 3 * 4);
+  for (std::size_t i = 0; i < length; i += 3) {
+    std::uint32_t n = std::uint32_t(data[i]) << 16;
+    if (i + 1 < length)
+      n |= std::uint32_t(data[i + 1]) << 8;
+    if (i + 2 < length)
+      n |= data[i + 2];
+    out.push_back(alphabet[(n >> 18) & 63]);
+    out.push_back(alphabet[(n >> 12) & 63]);
+    out.push_back(i + 1 < length ? alphabet[(n >> 6) & 63] : '=');
+    out.push_back(i + 2 < length ? alphabet[n & 63] : '=');
+  }
+  return out;
+}
+
+std::string cppws::websocket_accept_key(std::string_view key) {
+  std::string input{key};
+  input.append("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+  auto digest = sha1(input);
+  return base64(digest.data(), digest.size());
+}
+
+static void mask_scalar(char *data, std::size_t length,
+                        std::uint32_t key) noexcept {
+  std::uint64_t key64 = (std::uint64_t(key) << 32) | key;
+  for (; length >= 8; data += 8, length -= 8) {
+    std::uint64_t v;
+    std::memcpy(&v, data, 8);
+    v ^= key64;
+    std::memcpy(data, &v, 8);
+  }
+  const auto *k = reinterpret_cast<const unsigned char *>(&key);
+  for (std::size_t i = 0; i < length; ++i)
+    data[i] ^= static_cast<char>(k[i % 4]);
+}
+
+#ifdef CPPWS_WEBSOCKET_X86
+__attribute__((target("avx2"))) static void
+mask_avx2(char *data, std::size_t length, std::uint32_t key) noexcept {
+  __m256i k = _mm256_set1_epi32(static_cast<int>(key));
+  for (; length >= 32; data += 32, length -= 32) {
+    __m256i *p = reinterpret_cast<__m256i *>(data);
+    _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), k));
+  }
+  mask_scalar(data, length, key);
+}
+
+__attribute__((target("sse2"))) static void
+mask_sse2(char *data, std::size_t length, std::uint32_t key) noexcept {
+  __m128i k = _mm_set1_epi32(static_cast<int>(key));
+  for (; length >= 16; data += 16, length -= 16) {
+    __m128i *p = reinterpret_cast<__m128i *>(data);
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), k));
+  }
+  mask_scalar(data, length, key);
+}
+#endif
+
+void cppws::websocket_mask(char *data, std::size_t length,
+                           std::uint32_t key) noexcept {
+#ifdef CPPWS_WEBSOCKET_X86
+  // Blocks are multiples of 4 bytes, so the key stays in phase across the
+  // vector and scalar parts.
+  //
+  static const auto impl = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return &mask_avx2;
+    if (__builtin_cpu_supports("sse2"))
+      return &mask_sse2;
+    return &mask_scalar;
+  }();
+  impl(data, length, key);
+#else
+  mask_scalar(data, length, key);
+#endif
+}
+
+/**
+ * True if the text is valid UTF-8 (RFC 3629).
+ */
+static bool valid_utf8(std::string_view text) noexcept {
+  const auto *p = reinterpret_cast<const unsigned char *>(text.data());
+  const auto *end = p + text.size();
+  while (p != end) {
+    // Skip ASCII 8 bytes at a time.
+    //
+    if (end - p >= 8) {
+      std::uint64_t v;
+      std::memcpy(&v, p, 8);
+      if ((v & 0x8080808080808080ull) == 0) {
+        p += 8;
+        continue;
+      }
+    }
+
+    unsigned char c = *p;
+    int n;
+    std::uint32_t cp;
+    if (c < 0x80) {
+      ++p;
+      continue;
+    } else if ((c & 0xE0) == 0xC0) {
+      n = 1;
+      cp = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+      n = 2;
+      cp = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+      n = 3;
+      cp = c & 0x07;
+    } else {
+      return false;
+    }
+    if (end - p <= n)
+      return false;
+    for (int i = 1; i <= n; ++i) {
+      if ((p[i] & 0xC0) != 0x80)
+        return false;
+      cp = (cp << 6) | (p[i] & 0x3F);
+    }
+    constexpr std::uint32_t min[] = {0, 0x80, 0x800, 0x10000};
+    if (cp < min[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+      return false;
+    p += n + 1;
+  }
+  return true;
+}
+
+std::shared_ptr<cppws::websocket>
+cppws::websocket::accept(request_manager &manager, event_loop &loop,
+                         std::shared_ptr<websocket_handler> handler,
+                         const websocket_options &options) {
+  const http_request &request = manager.request();
+  const std::pmr::string *key = request.http_header("Sec-WebSocket-Key");
+  const std::pmr::string *version =
+      request.http_header("Sec-WebSocket-Version");
+
+  if (request.http_method() != http_method::GET ||
+      request.http_version() < 110 ||
+      !has_token(request.http_header(http_request_header::Upgrade),
+                 "websocket") ||
+      !has_token(request.http_header(http_request_header::Connection),
+                 "upgrade") ||
+      !key || trim_ows(*key).size() != 24) {
+    manager.status(http::BAD_REQUEST)
+        .body(http::body("Invalid WebSocket handshake."));
+    return nullptr;
+  }
+
+  if (!version || trim_ows(*version) != "13") {
+    manager.status(http::UPGRADE_REQUIRED)
+        .header("Sec-WebSocket-Version", "13")
+        .body(http::body("Unsupported WebSocket version."));
+    return nullptr;
+  }
+
+  // Select the first supported subprotocol offered by the client.
+  //
+  std::string protocol;
+  const std::pmr::string *offered =
+      request.http_header("Sec-WebSocket-Protocol");
+  for (const std::string &p : options.protocols) {
+    if (has_token(offered, p)) {
+      protocol = p;
+      break;
+    }
+  }
+
+  manager.status(http::SWITCHING_PROTOCOLS)
+      .header("Upgrade", "websocket")
+      .header("Connection", "Upgrade")
+      .header("Sec-WebSocket-Accept", websocket_accept_key(trim_ows(*key)))
+      .compression(false);
+  if (!protocol.empty())
+    manager.header("Sec-WebSocket-Protocol", protocol);
+  manager.send();
+
+  class socket connection = manager.detach();
+  connection.non_blocking(true);
+  auto ws = std::make_shared<websocket>(private_tag{}, std::move(connection),
+                                        loop, std::move(handler), options,
+                                        std::move(protocol));
+  loop.post([ws] { ws->start(); });
+  return ws;
+}
+
+cppws::websocket::websocket(private_tag, class socket &&connection,
+                            event_loop &loop,
+                            std::shared_ptr<websocket_handler> handler,
+                            const websocket_options &options,
+                            std::string protocol)
+    : socket_(std::move(connection)), loop_(&loop),
+      handler_(std::move(handler)), maxMessageSize_(options.max_message_size),
+      protocol_(std::move(protocol)),
+      input_(max_frame_header + options.max_message_size) {}
+
+void cppws::websocket::start() {
+  loop_->add(socket_.native_handle(), EPOLLIN | EPOLLRDHUP,
+             [self = shared_from_this()](std::uint32_t events) {
+               self->on_event(events);
+             });
+  handler_->on_open(*this);
+  flush();
+}
+
+/**
+ * Appends an unmasked frame, as sent by servers, to \p out.
+ */
+static void append_frame(std::string &out, cppws::websocket_opcode opcode,
+                         std::string_view payload) {
+  char header[10];
+  std::size_t n = 2;
+  header[0] = static_cast<char>(0x80 | static_cast<std::uint8_t>(opcode));
+  std::uint64_t length = payload.size();
+  if (length < 126) {
+    header[1] = static_cast<char>(length);
+  } else if (length <= 0xFFFF) {
+    header[1] = 126;
+    header[2] = static_cast<char>(length >> 8);
+    header[3] = static_cast<char>(length);
+    n = 4;
+  } else {
+    header[1] = 127;
+    for (int i = 0; i < 8; ++i)
+      header[2 + i] = static_cast<char>(length >> (56 - i * 8));
+    n = 10;
+  }
+  out.append(header, n);
+  out.append(payload);
+}
+
+void cppws::websocket::send(websocket_opcode opcode,
+                            std::string_view payload) {
+  if (loop_->in_loop_thread()) {
+    if (closeSent_ || closed_)
+      return;
+    append_frame(output_, opcode, payload);
+    flush();
+    return;
+  }
+
+  // Serialize on the calling thread; the loop only appends the bytes.
+  //
+  std::string frame;
+  append_frame(frame, opcode, payload);
+  loop_->post([self = shared_from_this(), frame = std::move(frame)] {
+    if (self->closeSent_ || self->closed_)
+      return;
+    self->output_.append(frame);
+    self->flush();
+  });
+}
+
+void cppws::websocket::close(std::uint16_t code, std::string_view reason) {
+  if (!loop_->in_loop_thread()) {
+    std::string r{reason.substr(0, 123)};
+    loop_->post([self = shared_from_this(), code, r = std::move(r)] {
+      self->close(code, r);
+    });
+    return;
+  }
+  if (closeSent_ || closed_)
+    return;
+
+  char payload[125];
+  payload[0] = static_cast<char>(code >> 8);
+  payload[1] = static_cast<char>(code);
+  reason = reason.substr(0, 123);
+  std::memcpy(payload + 2, reason.data(), reason.size());
+  append_frame(output_, websocket_opcode::Close,
+               std::string_view(payload, 2 + reason.size()));
+  closeSent_ = true;
+  flush();
+}
+
+void cppws::websocket::on_event(std::uint32_t events) {
+  if (closed_)
+    return;
+
+  if (events & EPOLLOUT)
+    flush();
+  if (!closed_ && events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+    if (!read_frames())
+      shutdown(websocket_close::ABNORMAL, {});
+  }
+}
+
+bool cppws::websocket::read_frames() {
+  // A full buffer holds a complete frame, which processing consumes; the
+  // rest of the input is read on the next event.
+  //
+  bool eof = false;
+  while (!input_.full()) {
+    std::ptrdiff_t n;
+    try {
+      n = input_.try_read_some(socket_);
+    } catch (const std::system_error &) {
+      n = 0;
+    }
+    if (n == 0)
+      eof = true;
+    if (n <= 0 || !input_.filled())
+      break;
+  }
+
+  std::size_t pos = 0;
+  while (!closed_ && input_.size() - pos >= 2) {
+    const auto *p =
+        reinterpret_cast<const unsigned char *>(input_.data().data());
+    std::size_t avail = input_.size() - pos;
+    bool fin = p[pos] & 0x80;
+    auto opcode = static_cast<websocket_opcode>(p[pos] & 0x0F);
+    bool masked = p[pos + 1] & 0x80;
+    std::uint64_t length = p[pos + 1] & 0x7F;
+
+    if (p[pos] & 0x70 || !masked) {
+      fail(websocket_close::PROTOCOL_ERROR);
+      break;
+    }
+
+    std::size_t header = 2;
+    if (length == 126) {
+      if (avail < 4)
+        break;
+      length = (std::uint64_t(p[pos + 2]) << 8) | p[pos + 3];
+      header = 4;
+    } else if (length == 127) {
+      if (avail < 10)
+        break;
+      length = 0;
+      for (int i = 0; i < 8; ++i)
+        length = (length << 8) | p[pos + 2 + i];
+      header = 10;
+    }
+
+    if (length > maxMessageSize_) {
+      fail(websocket_close::MESSAGE_TOO_BIG);
+      break;
+    }
+    if (avail < header + 4 + length)
+      break;
+
+    std::uint32_t key;
+    std::memcpy(&key, input_.data().data() + pos + header, 4);
+    char *payload = input_.data().data() + pos + header + 4;
+    websocket_mask(payload, length, key);
+    pos += header + 4 + length;
+
+    if (!handle_frame(fin, opcode, std::string_view(payload, length)))
+      break;
+  }
+  input_.consume(pos);
+
+  // Connections are idle between messages, and hold no input buffer then.
+  //
+  input_.release();
+  return !eof;
+}
+
+bool cppws::websocket::handle_frame(bool fin, websocket_opcode opcode,
+                                    std::string_view data) {
+  switch (opcode) {
+  case websocket_opcode::Close: {
+    if (!fin || data.size() > 125 || data.size() == 1) {
+      fail(websocket_close::PROTOCOL_ERROR);
+      return false;
+    }
+    std::uint16_t code = websocket_close::NO_STATUS;
+    std::string_view reason;
+    if (data.size() >= 2) {
+      code = static_cast<std::uint16_t>(
+          (static_cast<unsigned char>(data[0]) << 8) |
+          static_cast<unsigned char>(data[1]));
+      reason = data.substr(2);
+    }
+
+    // Echo the close frame, unless this answers our own, and close the
+    // connection once it is written.
+    //
+    if (!closeSent_)
+      close(code == websocket_close::NO_STATUS ? websocket_close::NORMAL
+                                               : code);
+    closeAfterFlush_ = true;
+    if (handler_) {
+      auto handler = std::move(handler_);
+      handler->on_close(*this, code, reason);
+    }
+    flush();
+    return false;
+  }
+
+  case websocket_opcode::Ping:
+    if (!fin || data.size() > 125) {
+      fail(websocket_close::PROTOCOL_ERROR);
+      return false;
+    }
+    if (!closeSent_) {
+      append_frame(output_, websocket_opcode::Pong, data);
+      flush();
+    }
+    return true;
+
+  case websocket_opcode::Pong:
+    if (!fin || data.size() > 125) {
+      fail(websocket_close::PROTOCOL_ERROR);
+      return false;
+    }
+    return true;
+
+  case websocket_opcode::Text:
+  case websocket_opcode::Binary:
+    if (messageOpcode_ != websocket_opcode::Continuation) {
+      fail(websocket_close::PROTOCOL_ERROR);
+      return false;
+    }
+    if (fin) {
+      deliver(data, opcode == websocket_opcode::Binary);
+    } else {
+      messageOpcode_ = opcode;
+      message_.assign(data);
+    }
+    return !closed_;
+
+  case websocket_opcode::Continuation:
+    if (messageOpcode_ == websocket_opcode::Continuation) {
+      fail(websocket_close::PROTOCOL_ERROR);
+      return false;
+    }
+    if (message_.size() + data.size() > maxMessageSize_) {
+      fail(websocket_close::MESSAGE_TOO_BIG);
+      return false;
+    }
+    message_.append(data);
+    if (fin) {
+      bool binary = messageOpcode_ == websocket_opcode::Binary;
+      messageOpcode_ = websocket_opcode::Continuation;
+      deliver(message_, binary);
+      message_.clear();
+    }
+    return !closed_;
+
+  default:
+    fail(websocket_close::PROTOCOL_ERROR);
+    return false;
+  }
+}
+
+void cppws::websocket::deliver(std::string_view message, bool binary) {
+  if (!binary && !valid_utf8(message)) {
+    fail(websocket_close::INVALID_PAYLOAD);
+    return;
+  }
+  if (handler_ && !closeSent_)
+    handler_->on_message(*this, message, binary);
+}
+
+void cppws::websocket::fail(std::uint16_t code) {
+  close(code);
+  closeAfterFlush_ = true;
+  if (handler_) {
+    auto handler = std::move(handler_);
+    handler->on_close(*this, code, {});
+  }
+  flush();
+}
+
+void cppws::websocket::flush() {
+  if (closed_)
+    return;
+
+  while (written_ < output_.size()) {
+    struct iovec iov = {output_.data() + written_, output_.size() - written_};
+    std::ptrdiff_t n;
+    try {
+      n = socket_.try_write(&iov, 1);
+    } catch (const std::system_error &) {
+      shutdown(websocket_close::ABNORMAL, {});
+      return;
+    }
+    if (n < 0) {
+      // Socket buffer full: resume when the loop reports it writable.
+      //
+      if (!pollingOutput_) {
+        loop_->modify(socket_.native_handle(),
+                      EPOLLIN | EPOLLOUT | EPOLLRDHUP);
+        pollingOutput_ = true;
+      }
+      return;
+    }
+    written_ += static_cast<std::size_t>(n);
+  }
+
+  output_.clear();
+  written_ = 0;
+  if (pollingOutput_) {
+    loop_->modify(socket_.native_handle(), EPOLLIN | EPOLLRDHUP);
+    pollingOutput_ = false;
+  }
+  if (closeAfterFlush_)
+    shutdown(websocket_close::NORMAL, {});
+}
+
+void cppws::websocket::shutdown(std::uint16_t code, std::string_view reason) {
+  if (closed_)
+    return;
+  closed_ = true;
+  loop_->remove(socket_.native_handle());
+  socket_.close();
+  if (handler_) {
+    auto handler = std::move(handler_);
+    handler->on_close(*this, code, reason);
+  }
+}
@@ -0,0 +1,68 @@
+#include <algorithm>
+
+#include <cppws/worker_pool.hpp>
+
+cppws::worker_pool::worker_pool(std::size_t threads) {
+  threads = std::max<std::size_t>(threads, 1);
+  threads_.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i)
+    threads_.emplace_back([this] { run(); });
+}
+
+cppws::worker_pool::~worker_pool() noexcept {
+  {
+    std::unique_lock l{lock_};
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for (std::thread &thread : threads_)
+    thread.join();
+}
+
+void cppws::worker_pool::post(task fn) {
+  {
+    std::unique_lock l{lock_};
+    queue_.push_back(std::move(fn));
+  }
+  ready_.notify_one();
+}
+
+void cppws::worker_pool::post(std::span<task> tasks) {
+  if (tasks.empty())
+    return;
+  {
+    std::unique_lock l{lock_};
+    for (task &fn : tasks)
+      queue_.push_back(std::move(fn));
+  }
+  if (tasks.size() == 1)
+    ready_.notify_one();
+  else
+    ready_.notify_all();
+}
+
+std::shared_ptr<cppws::worker_pool> cppws::worker_pool::shared() {
+  static std::shared_ptr<worker_pool> pool = std::make_shared<worker_pool>();
+  return pool;
+}
+
+void cppws::worker_pool::run() {
+  for (;;) {
+    task fn;
+    {
+      std::unique_lock l{lock_};
+      ready_.wait(l, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty())
+        return;
+      fn = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    // A task that throws must not take the thread down with it.
+    //
+    try {
+      fn();
+    } catch (...) {
+    }
+  }
+}
@@ -0,0 +1,136 @@
+#include <cstdio>
+#include <string>
+
+#include <cppws/byte_range.hpp>
+#include <cppws/request_manager.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+std::pmr::vector<cppws::byte_range> ranges;
+
+cppws::range_result parse_ranges(std::string_view value,
+                                 std::uint64_t size) {
+  return cppws::parse_byte_ranges(value, size, ranges);
+}
+
+/**
+ * Sends a 26 byte file for the given request and returns the response
+ * without its Date line.
+ */
+std::string serve(std::string_view text) {
+  connection_pair conn;
+
+  std::FILE *file = std::tmpfile();
+  std::fputs("abcdefghijklmnopqrstuvwxyz", file);
+  std::fflush(file);
+
+  cppws::http_request request;
+  std::stringstream ss{std::string(text)};
+  EXPECT_TRUE(cppws::http_request::accept(request, ss));
+
+  cppws::response_buffer response;
+  cppws::request_manager manager{request, conn.server, response};
+  manager.validate({.etag = "\"v1\""});
+  manager.content_type("text/plain").send_file(fileno(file), 26);
+  std::fclose(file);
+  conn.server.close();
+  return conn.read_all(true);
+}
+
+} // namespace
+
+TEST(cppws_test, parse_byte_ranges) {
+  using namespace cppws;
+  using enum range_result;
+
+  ASSERT_EQ(parse_ranges("bytes=0-499", 1000), Satisfiable);
+  ASSERT_EQ(ranges, (std::pmr::vector<byte_range>{{0, 499}}));
+
+  ASSERT_EQ(parse_ranges("bytes=-500", 1000), Satisfiable);
+  ASSERT_EQ(ranges, (std::pmr::vector<byte_range>{{500, 999}}));
+
+  ASSERT_EQ(parse_ranges("bytes=900-", 1000), Satisfiable);
+  ASSERT_EQ(ranges, (std::pmr::vector<byte_range>{{900, 999}}));
+
+  ASSERT_EQ(parse_ranges("bytes=-5000", 1000), Satisfiable);
+  ASSERT_EQ(ranges, (std::pmr::vector<byte_range>{{0, 999}}));
+
+  ASSERT_EQ(parse_ranges("Bytes=500-600, 0-10 ,550-700,701-800", 1000),
+            Satisfiable);
+  ASSERT_EQ(ranges, (std::pmr::vector<byte_range>{{0, 10}, {500, 800}}));
+
+  ASSERT_EQ(parse_ranges("bytes=990-2000,5000-", 1000), Satisfiable);
+  ASSERT_EQ(ranges, (std::pmr::vector<byte_range>{{990, 999}}));
+
+  ASSERT_EQ(parse_ranges("bytes=1000-", 1000), Unsatisfiable);
+  ASSERT_EQ(parse_ranges("bytes=-0", 1000), Unsatisfiable);
+  ASSERT_EQ(parse_ranges("bytes=0-", 0), Unsatisfiable);
+
+  ASSERT_EQ(parse_ranges("bytes=5-1", 1000), Ignore);
+  ASSERT_EQ(parse_ranges("items=0-5", 1000), Ignore);
+  ASSERT_EQ(parse_ranges("bytes=a-b", 1000), Ignore);
+  ASSERT_EQ(parse_ranges("bytes=", 1000), Ignore);
+
+  std::string many = "bytes=0-0";
+  for (int i = 1; i <= 16; ++i)
+    many += "," + std::to_string(i * 2) + "-" + std::to_string(i * 2);
+  ASSERT_EQ(parse_ranges(many, 1000), Ignore);
+}
+
+TEST(cppws_test, send_file_ranges) {
+  std::string full = serve("GET /f HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(full.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_NE(full.find("Accept-Ranges: bytes\r\n"), std::string::npos);
+  ASSERT_NE(full.find("Content-Length: 26\r\n"), std::string::npos);
+  ASSERT_TRUE(full.ends_with("\r\n\r\nabcdefghijklmnopqrstuvwxyz"));
+
+  std::string single = serve("GET /f HTTP/1.1\r\nRange: bytes=2-4\r\n\r\n");
+  ASSERT_TRUE(single.starts_with("HTTP/1.1 206 Partial Content\r\n"));
+  ASSERT_NE(single.find("Content-Range: bytes 2-4/26\r\n"), std::string::npos);
+  ASSERT_NE(single.find("Content-Length: 3\r\n"), std::string::npos);
+  ASSERT_TRUE(single.ends_with("\r\n\r\ncde"));
+
+  std::string multi =
+      serve("GET /f HTTP/1.1\r\nRange: bytes=0-1,-2\r\n\r\n");
+  ASSERT_TRUE(multi.starts_with("HTTP/1.1 206 Partial Content\r\n"));
+  std::size_t at = multi.find("multipart/byteranges; boundary=");
+  ASSERT_NE(at, std::string::npos);
+  at += 31;
+  std::string boundary = multi.substr(at, multi.find("\r\n", at) - at);
+  std::string body = "\r\n--" + boundary +
+                     "\r\nContent-Type: text/plain"
+                     "\r\nContent-Range: bytes 0-1/26\r\n\r\nab"
+                     "\r\n--" +
+                     boundary +
+                     "\r\nContent-Type: text/plain"
+                     "\r\nContent-Range: bytes 24-25/26\r\n\r\nyz"
+                     "\r\n--" +
+                     boundary + "--\r\n";
+  ASSERT_TRUE(multi.ends_with("\r\n\r\n" + body));
+  ASSERT_NE(multi.find("Content-Length: " + std::to_string(body.size())),
+            std::string::npos);
+
+  std::string unsatisfiable =
+      serve("GET /f HTTP/1.1\r\nRange: bytes=26-\r\n\r\n");
+  ASSERT_TRUE(
+      unsatisfiable.starts_with("HTTP/1.1 416 Range Not Satisfiable\r\n"));
+  ASSERT_NE(unsatisfiable.find("Content-Range: bytes */26\r\n"),
+            std::string::npos);
+  ASSERT_TRUE(unsatisfiable.ends_with("Content-Length: 0\r\n\r\n"));
+
+  std::string stale = serve("GET /f HTTP/1.1\r\nRange: bytes=2-4\r\n"
+                            "If-Range: \"v0\"\r\n\r\n");
+  ASSERT_TRUE(stale.starts_with("HTTP/1.1 200 OK\r\n"));
+
+  std::string current = serve("GET /f HTTP/1.1\r\nRange: bytes=2-4\r\n"
+                              "If-Range: \"v1\"\r\n\r\n");
+  ASSERT_TRUE(current.ends_with("\r\n\r\ncde"));
+
+  std::string head = serve("HEAD /f HTTP/1.1\r\nRange: bytes=2-4\r\n\r\n");
+  ASSERT_TRUE(head.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_TRUE(head.ends_with("Content-Length: 26\r\n"
+                             "Content-Type: text/plain\r\n\r\n"));
+}
@@ -0,0 +1,97 @@
+#include <zlib.h>
+
+#include <cppws/compression.hpp>
+#include <cppws/response_buffer.hpp>
+#include <gtest/gtest.h>
+
+static std::string inflate(std::string_view in, int windowBits) {
+  z_stream zs{};
+  EXPECT_EQ(::inflateInit2(&zs, windowBits), Z_OK);
+  zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+  zs.avail_in = static_cast<uInt>(in.size());
+
+  std::string out(64 * 1024, '\0');
+  zs.next_out = reinterpret_cast<Bytef *>(out.data());
+  zs.avail_out = static_cast<uInt>(out.size());
+  EXPECT_EQ(::inflate(&zs, Z_FINISH), Z_STREAM_END);
+  out.resize(zs.total_out);
+  ::inflateEnd(&zs);
+  return out;
+}
+
+TEST(cppws_test, negotiate_encoding) {
+  using cppws::content_coding;
+  using cppws::negotiate_encoding;
+
+  ASSERT_EQ(negotiate_encoding("gzip, deflate, br"), content_coding::Gzip);
+  ASSERT_EQ(negotiate_encoding("deflate"), content_coding::Deflate);
+  ASSERT_EQ(negotiate_encoding("gzip;q=0.5, deflate;q=0.8"),
+            content_coding::Deflate);
+  ASSERT_EQ(negotiate_encoding("gzip;q=0, *"), content_coding::Deflate);
+  ASSERT_EQ(negotiate_encoding("*;q=0"), content_coding::Identity);
+  ASSERT_EQ(negotiate_encoding("br"), content_coding::Identity);
+  ASSERT_EQ(negotiate_encoding(""), content_coding::Identity);
+
+  constexpr cppws::content_coding_set all =
+      cppws::coding_bit(content_coding::Brotli) |
+      cppws::coding_bit(content_coding::Zstd) |
+      cppws::coding_bit(content_coding::Gzip);
+  ASSERT_EQ(negotiate_encoding("gzip, deflate, br, zstd", all),
+            content_coding::Brotli);
+  ASSERT_EQ(negotiate_encoding("gzip, br;q=0.5, zstd", all),
+            content_coding::Zstd);
+  ASSERT_EQ(negotiate_encoding("deflate", all), content_coding::Identity);
+  ASSERT_EQ(negotiate_encoding("*", cppws::coding_bit(content_coding::Gzip)),
+            content_coding::Gzip);
+
+  ASSERT_TRUE(cppws::is_compressible("application/json"));
+  ASSERT_TRUE(cppws::is_compressible("text/html; charset=utf-8"));
+  ASSERT_FALSE(cppws::is_compressible("image/png"));
+  ASSERT_FALSE(cppws::is_compressible("application/gzip"));
+}
+
+TEST(cppws_test, compressor) {
+  using namespace cppws;
+
+  std::string payload;
+  for (int i = 0; i < 2000; ++i)
+    payload += "{\"id\": " + std::to_string(i) + ", \"name\": \"item\"},";
+
+  compressor c;
+  for (content_coding coding : {content_coding::Gzip, content_coding::Deflate,
+                                content_coding::Gzip}) {
+    std::pmr::string out;
+    c.compress(coding, 6, payload, out);
+    ASSERT_LT(out.size(), payload.size() / 4);
+    ASSERT_EQ(inflate(out, coding == content_coding::Gzip ? 31 : 15), payload);
+  }
+
+  // Compression is abandoned once the output would outgrow the limit.
+  std::string noise(64 * 1024, '\0');
+  std::uint32_t x = 1;
+  for (char &ch : noise)
+    ch = static_cast<char>((x = x * 1103515245 + 12345) >> 24);
+  std::pmr::string out;
+  ASSERT_FALSE(c.compress(content_coding::Gzip, 6, noise, out,
+                          noise.size() - 1));
+  ASSERT_LT(out.size(), noise.size());
+
+  response_buffer response;
+  response.body().assign(noise);
+  ASSERT_FALSE(response.compress(content_coding::Gzip, 1));
+  ASSERT_EQ(std::string_view(response.body()), noise);
+  ASSERT_TRUE(response.header_value("Content-Encoding").empty());
+
+  response.clear();
+  response.content_type("application/json");
+  response.body().assign(payload);
+  ASSERT_TRUE(response.compressible(1024));
+  ASSERT_TRUE(response.compress(content_coding::Gzip, 1));
+  ASSERT_EQ(inflate(response.body(), 31), payload);
+  ASSERT_NE(response.headers().find("Content-Encoding: gzip\r\n"),
+            std::string_view::npos);
+
+  // Already encoded bodies are left alone.
+  ASSERT_FALSE(response.compressible(1024));
+  ASSERT_FALSE(response.compress(content_coding::Gzip, 1));
+}
@@ -0,0 +1,96 @@
+#include <cppws/conditional.hpp>
+#include <cppws/request_manager.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+void parse(cppws::http_request &request, std::string_view text) {
+  std::stringstream ss{std::string(text)};
+  ASSERT_TRUE(cppws::http_request::accept(request, ss));
+}
+
+cppws::precondition_result evaluate(std::string_view text,
+                                    cppws::resource_validators validators) {
+  cppws::http_request request;
+  parse(request, text);
+  return cppws::evaluate_preconditions(request, validators);
+}
+
+} // namespace
+
+TEST(cppws_test, evaluate_preconditions) {
+  using namespace cppws;
+  using enum precondition_result;
+
+  resource_validators v{.etag = "\"v2\"", .last_modified = 784111777};
+
+  ASSERT_TRUE(etag_equals("W/\"a\"", "\"a\"", true));
+  ASSERT_FALSE(etag_equals("W/\"a\"", "\"a\"", false));
+
+  ASSERT_EQ(evaluate("GET / HTTP/1.1\r\n\r\n", v), Proceed);
+  ASSERT_EQ(evaluate("GET / HTTP/1.1\r\n"
+                     "If-None-Match: \"v1\", W/\"v2\"\r\n\r\n",
+                     v),
+            NotModified);
+  ASSERT_EQ(evaluate("GET / HTTP/1.1\r\n"
+                     "If-None-Match: \"v1\"\r\n"
+                     "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n",
+                     v),
+            Proceed);
+  ASSERT_EQ(evaluate("HEAD / HTTP/1.1\r\n"
+                     "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n",
+                     v),
+            NotModified);
+  ASSERT_EQ(evaluate("GET / HTTP/1.1\r\n"
+                     "If-Modified-Since: Sun, 06 Nov 1994 08:49:36 GMT\r\n\r\n",
+                     v),
+            Proceed);
+  ASSERT_EQ(evaluate("PUT / HTTP/1.1\r\n"
+                     "If-None-Match: *\r\n\r\n",
+                     v),
+            PreconditionFailed);
+  ASSERT_EQ(evaluate("PUT / HTTP/1.1\r\n"
+                     "If-Match: \"v1\"\r\n\r\n",
+                     v),
+            PreconditionFailed);
+  ASSERT_EQ(evaluate("PUT / HTTP/1.1\r\n"
+                     "If-Match: \"v2\"\r\n\r\n",
+                     v),
+            Proceed);
+  ASSERT_EQ(evaluate("PUT / HTTP/1.1\r\n"
+                     "If-Match: *\r\n\r\n",
+                     {.etag = "", .last_modified = 784111777}),
+            Proceed);
+  ASSERT_EQ(evaluate("GET / HTTP/1.1\r\n"
+                     "If-None-Match: *\r\n\r\n",
+                     {}),
+            NotModified);
+  ASSERT_EQ(evaluate("DELETE / HTTP/1.1\r\n"
+                     "If-Unmodified-Since: Sun, 06 Nov 1994 08:00:00 GMT\r\n"
+                     "\r\n",
+                     v),
+            PreconditionFailed);
+}
+
+TEST(cppws_test, request_manager_validate) {
+  using namespace cppws;
+
+  connection_pair conn;
+
+  http_request request;
+  response_buffer response;
+  parse(request, "GET /feed HTTP/1.1\r\n"
+                 "If-None-Match: \"42\"\r\n\r\n");
+
+  request_manager manager{request, conn.server, response};
+  ASSERT_TRUE(manager.validate({.etag = "\"42\""}));
+  ASSERT_TRUE(manager.sent());
+
+  std::string out = conn.read();
+  ASSERT_TRUE(out.starts_with("HTTP/1.1 304 Not Modified\r\n"));
+  ASSERT_NE(out.find("ETag: \"42\"\r\n"), std::string::npos);
+  ASSERT_EQ(out.find("Content-Length"), std::string::npos);
+  ASSERT_TRUE(out.ends_with("\r\n\r\n"));
+}
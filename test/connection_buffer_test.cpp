@@ -0,0 +1,129 @@
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <cppws/connection_buffer.hpp>
+#include <cppws/http_request.hpp>
+#include <cppws/socket.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+TEST(cppws_test, connection_buffer) {
+  using namespace cppws;
+
+  connection_buffer buffer{16};
+  ASSERT_TRUE(buffer.empty());
+
+  std::span<char> space = buffer.prepare(10);
+  ASSERT_EQ(space.size(), 10u);
+  std::memcpy(space.data(), "0123456789", 10);
+  buffer.commit(10);
+  ASSERT_EQ(buffer.view(), "0123456789");
+
+  // Consumed space is reclaimed when more room is needed, and the buffer
+  // never holds more than its maximum.
+  //
+  buffer.consume(6);
+  space = buffer.prepare(100);
+  ASSERT_EQ(space.size(), 12u);
+  std::memcpy(space.data(), "abcdefghijkl", 12);
+  buffer.commit(12);
+  ASSERT_EQ(buffer.view(), "6789abcdefghijkl");
+  ASSERT_TRUE(buffer.full());
+  ASSERT_TRUE(buffer.prepare(1).empty());
+
+  char out[8];
+  ASSERT_EQ(buffer.take(out), 8u);
+  ASSERT_EQ(std::string_view(out, 8), "6789abcd");
+  ASSERT_EQ(buffer.view(), "efghijkl");
+  buffer.consume(8);
+  ASSERT_TRUE(buffer.empty());
+}
+
+TEST(cppws_test, connection_buffer_requests) {
+  using namespace cppws;
+  using namespace std::chrono_literals;
+
+  connection_pair conn;
+  auto &[server, client] = conn;
+
+  // Pipelined requests, with the head and the body of the second one split
+  // across writes.
+  //
+  std::string body(100000, 'x');
+  std::thread writer([&] {
+    std::string first = "GET /a HTTP/1.1\r\nHost: example.com\r\n\r\n"
+                        "POST /b HTTP/1.0\r\nContent-";
+    client.write(first.data(), first.size());
+    std::this_thread::sleep_for(10ms);
+    std::string second = "Length: " + std::to_string(body.size()) +
+                         "\r\n\r\n" + body + "GET /c HTTP/1.1\r\n\r\n";
+    client.write(second.data(), second.size());
+    client.close();
+  });
+
+  connection_buffer input{4096};
+  http_request request;
+  ASSERT_TRUE(http_request::accept_head(request, input, server));
+  ASSERT_EQ(request.target(), "/a");
+  ASSERT_EQ(*request.http_header("host"), "example.com");
+  ASSERT_TRUE(http_request::accept_body(request, input, server));
+  ASSERT_TRUE(request.body().empty());
+
+  ASSERT_TRUE(http_request::accept_head(request, input, server));
+  ASSERT_EQ(request.http_method(), http_method::POST);
+  ASSERT_EQ(request.http_version(), 100);
+  ASSERT_TRUE(http_request::accept_body(request, input, server));
+  ASSERT_EQ(request.body_text(), body);
+
+  ASSERT_TRUE(http_request::accept_head(request, input, server));
+  ASSERT_EQ(request.target(), "/c");
+  ASSERT_FALSE(http_request::accept_head(request, input, server));
+  writer.join();
+
+  // A head larger than the buffer is rejected.
+  //
+  conn = connection_pair{};
+  std::string huge = "GET / HTTP/1.1\r\nX: " + std::string(8192, 'y');
+  client.write(huge.data(), huge.size());
+  input.clear();
+  ASSERT_FALSE(http_request::accept_head(request, input, server));
+}
+
+TEST(cppws_test, connection_buffer_sizing) {
+  using namespace cppws;
+
+  connection_pair conn;
+  auto &[server, client] = conn;
+  std::string input(8000, 'x');
+  client.write(input.data(), input.size());
+
+  // Buffers start without storage and move up a size class after every
+  // read that filled them, so a large head takes few reads.
+  //
+  connection_buffer_stats before = connection_buffer::stats();
+  connection_buffer buffer;
+  ASSERT_EQ(buffer.capacity(), 0u);
+  int reads = 0;
+  while (buffer.size() < input.size()) {
+    buffer.read_some(server);
+    ++reads;
+  }
+  ASSERT_EQ(buffer.view(), input);
+  ASSERT_LE(reads, 4);
+  ASSERT_EQ(buffer.capacity(), 8192u);
+  connection_buffer_stats grown = connection_buffer::stats();
+  ASSERT_EQ(grown.grows - before.grows, 3u);
+  ASSERT_EQ(grown.allocated - before.allocated, 8192u);
+
+  // Only empty buffers are released.
+  //
+  ASSERT_FALSE(buffer.release());
+  buffer.consume(input.size());
+  ASSERT_TRUE(buffer.release());
+  ASSERT_EQ(buffer.capacity(), 0u);
+  connection_buffer_stats released = connection_buffer::stats();
+  ASSERT_EQ(released.releases - before.releases, 1u);
+  ASSERT_EQ(released.allocated, before.allocated);
+}
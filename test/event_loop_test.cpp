@@ -0,0 +1,148 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <cppws/acceptor.hpp>
+#include <cppws/event_loop.hpp>
+#include <cppws/request_processor.hpp>
+#include <cppws/route_mapper.hpp>
+#include <cppws/socket.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+TEST(cppws_test, event_loop) {
+  using namespace cppws;
+
+  connection_pair conn;
+  auto &[a, b] = conn;
+
+  event_loop loop;
+  std::string received;
+  loop.add(b.native_handle(), EPOLLIN, [&](std::uint32_t) {
+    char buf[64];
+    std::size_t n = b.read(buf, sizeof buf);
+    received.append(buf, n);
+    if (received == "ping") {
+      loop.remove(b.native_handle());
+      loop.stop();
+    }
+  });
+  ASSERT_EQ(loop.size(), 1u);
+
+  std::thread writer([&] {
+    a.write("pi", 2);
+    loop.post([&] { a.write("ng", 2); });
+  });
+  loop.run();
+  writer.join();
+
+  ASSERT_EQ(received, "ping");
+  ASSERT_EQ(loop.size(), 0u);
+
+  bool ran = false;
+  loop.post([&] { ran = true; });
+  loop.run_once(0);
+  ASSERT_TRUE(ran);
+}
+
+TEST(cppws_test, acceptor) {
+  using namespace cppws;
+
+  cppws::socket listener;
+  listener.listen(0);
+  event_loop loop;
+  std::vector<std::size_t> batches;
+  std::vector<cppws::socket> connections;
+  acceptor accept{loop, listener,
+                  [&](std::span<cppws::socket> batch) {
+                    batches.push_back(batch.size());
+                    connections.push_back(std::move(batch[0]));
+                  },
+                  {.batch_size = 16}};
+
+  // A storm of connections is drained at one wakeup, a batch at a time.
+  // Connections the handler leaves behind are closed.
+  //
+  std::vector<cppws::socket> clients(40);
+  for (cppws::socket &c : clients)
+    c.connect("127.0.0.1", listener.port());
+  loop.run_once(1000);
+  ASSERT_EQ(batches, (std::vector<std::size_t>{16, 16, 8}));
+  ASSERT_EQ(accept.accepted(), 40u);
+  ASSERT_EQ(accept.batches(), 3u);
+  ASSERT_EQ(connections.size(), 3u);
+
+  char c;
+  ASSERT_EQ(clients[1].read(&c, 1), 0u);
+  connections[0].write("x", 1);
+  ASSERT_EQ(clients[0].read(&c, 1), 1u);
+}
+
+TEST(cppws_test, acceptor_errors) {
+  using namespace cppws;
+
+  cppws::socket listener;
+  listener.listen(0);
+  event_loop loop;
+  acceptor accept{loop, listener, [](std::span<cppws::socket>) {},
+                  {.retry_delay = std::chrono::milliseconds(10)}};
+
+  // A listener that fails to accept is retried later rather than ending
+  // the loop.
+  //
+  ::shutdown(listener.native_handle(), SHUT_RD);
+  ASSERT_NO_THROW(loop.run_once(100));
+  ASSERT_NO_THROW(loop.run_once(100));
+  ASSERT_EQ(accept.accepted(), 0u);
+}
+
+TEST(cppws_test, acceptor_processor_pool) {
+  using namespace cppws;
+
+  auto mapper = std::make_shared<route_mapper>();
+  mapper->map(http_method::GET, "/hello", [](request_manager &m) {
+    m.body(http::body("hello"));
+  });
+  processor_pool pool{mapper, 2};
+  ASSERT_EQ(pool.size(), 2u);
+
+  cppws::socket listener;
+  listener.listen(0);
+  event_loop loop;
+  acceptor accept{loop, listener, [&pool](std::span<cppws::socket> batch) {
+                    pool.post(batch);
+                  }};
+
+  // Connections are blocking, so a request arriving in pieces is waited
+  // for rather than dropped.
+  //
+  cppws::socket slow;
+  slow.connect("127.0.0.1", listener.port());
+  cppws::socket quick;
+  quick.connect("127.0.0.1", listener.port());
+  loop.run_once(1000);
+  if (accept.accepted() < 2)
+    loop.run_once(1000);
+  ASSERT_EQ(accept.accepted(), 2u);
+
+  std::string head = "GET /hello HTTP/1.1\r\n";
+  std::string rest = "Host: localhost\r\n\r\n";
+  slow.write(head.data(), head.size());
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  std::string request = head + rest;
+  quick.write(request.data(), request.size());
+  slow.write(rest.data(), rest.size());
+
+  for (cppws::socket *client : {&slow, &quick}) {
+    std::string reply;
+    char buffer[256];
+    for (std::size_t n; (n = client->read(buffer, sizeof buffer)) > 0;)
+      reply.append(buffer, n);
+    ASSERT_TRUE(reply.starts_with("HTTP/1.1 200 OK\r\n"));
+    ASSERT_TRUE(reply.ends_with("hello"));
+  }
+}
@@ -0,0 +1,101 @@
+#include <stdexcept>
+#include <type_traits>
+
+#include <cppws/filter.hpp>
+#include <cppws/request_mapper.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+void parse(cppws::http_request &request, std::string_view text) {
+  std::stringstream ss{std::string(text)};
+  ASSERT_TRUE(cppws::http_request::accept(request, ss));
+}
+
+} // namespace
+
+TEST(cppws_test, filter_pipeline) {
+  using namespace cppws;
+
+  int handled = 0;
+  auto handler = filtered([&handled](request_manager &) { ++handled; },
+                          cors_filter("https://app.example"),
+                          bearer_auth_filter("s3cret"));
+  static_assert(
+      std::is_constructible_v<request_mapper::handler, decltype(handler)>);
+
+  connection_pair conn;
+  http_request request;
+  response_buffer response;
+  request_manager manager{request, conn.server, response};
+
+  parse(request, "GET /data HTTP/1.1\r\n"
+                 "Authorization: Bearer s3cret\r\n\r\n");
+  handler(manager);
+  ASSERT_EQ(handled, 1);
+
+  parse(request, "GET /data HTTP/1.1\r\n"
+                 "Authorization: Bearer wrong!\r\n\r\n");
+  handler(manager);
+  ASSERT_EQ(handled, 1);
+  ASSERT_TRUE(conn.read().starts_with("HTTP/1.1 401 Unauthorized\r\n"));
+
+  parse(request, "OPTIONS /data HTTP/1.1\r\n"
+                 "Origin: https://app.example\r\n\r\n");
+  handler(manager);
+  ASSERT_EQ(handled, 1);
+  std::string preflight = conn.read();
+  ASSERT_TRUE(preflight.starts_with("HTTP/1.1 204 No Content\r\n"));
+  ASSERT_NE(preflight.find("Access-Control-Allow-Origin: https://app.example"),
+            std::string::npos);
+  ASSERT_EQ(preflight.find("\r\nContent-Length:"), std::string::npos);
+  ASSERT_EQ(preflight.find("\r\nContent-Type:"), std::string::npos);
+
+  parse(request, "GET /data HTTP/1.1\r\n"
+                 "Origin: https://app.example\r\n"
+                 "Authorization: Bearer s3cret\r\n\r\n");
+  response.clear();
+  handler(manager);
+  ASSERT_EQ(handled, 2);
+  ASSERT_EQ(response.header_value("Access-Control-Allow-Origin"),
+            "https://app.example");
+  ASSERT_EQ(response.header_value("Vary"), "Origin");
+
+  parse(request, "GET /data HTTP/1.1\r\n"
+                 "Origin: https://evil.example\r\n"
+                 "Authorization: Bearer s3cret\r\n\r\n");
+  handler(manager);
+  ASSERT_EQ(handled, 2);
+  ASSERT_TRUE(conn.read().starts_with("HTTP/1.1 403 Forbidden\r\n"));
+}
+
+TEST(cppws_test, rate_limit_filter) {
+  using namespace cppws;
+
+  connection_pair conn;
+  http_request request;
+  response_buffer response;
+  request_manager manager{request, conn.server, response};
+  parse(request, "GET / HTTP/1.1\r\n\r\n");
+
+  rate_limit_filter limiter{1.0, 3};
+  ASSERT_EQ(limiter(manager), nullptr);
+  ASSERT_EQ(limiter(manager), nullptr);
+  ASSERT_EQ(limiter(manager), nullptr);
+
+  const prebuilt_response *limited = limiter(manager);
+  ASSERT_NE(limited, nullptr);
+  ASSERT_TRUE(limited->bytes().starts_with("HTTP/1.1 429 Too Many Requests"));
+
+  // Copies share the limiter state.
+  rate_limit_filter copy = limiter;
+  ASSERT_NE(copy(manager), nullptr);
+
+  ASSERT_THROW(rate_limit_filter{0.0}, std::invalid_argument);
+  ASSERT_THROW(rate_limit_filter{-1.0}, std::invalid_argument);
+
+  rate_limit_filter slow{1e-30, UINT32_MAX};
+  ASSERT_EQ(slow(manager), nullptr);
+}
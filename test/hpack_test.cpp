@@ -0,0 +1,149 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cppws/hpack.hpp>
+#include <gtest/gtest.h>
+
+namespace {
+
+using field_list = std::vector<std::pair<std::string, std::string>>;
+
+std::string from_hex(std::string_view hex) {
+  std::string out;
+  int nibble = -1;
+  for (char c : hex) {
+    if (c == ' ')
+      continue;
+    int v = c <= '9' ? c - '0' : c - 'a' + 10;
+    if (nibble < 0) {
+      nibble = v;
+    } else {
+      out.push_back(static_cast<char>(nibble << 4 | v));
+      nibble = -1;
+    }
+  }
+  return out;
+}
+
+field_list decode(cppws::hpack_decoder &decoder, std::string_view block) {
+  field_list out;
+  decoder.decode(block, [&](std::string_view name, std::string_view value) {
+    out.emplace_back(name, value);
+  });
+  return out;
+}
+
+} // namespace
+
+TEST(cppws_test, hpack_huffman) {
+  using namespace cppws;
+
+  std::string out;
+  hpack_huffman_encode(out, "www.example.com");
+  ASSERT_EQ(out, from_hex("f1e3 c2e5 f23a 6ba0 ab90 f4ff"));
+  ASSERT_EQ(hpack_huffman_length("www.example.com"), out.size());
+
+  std::string decoded;
+  hpack_huffman_decode(decoded, out);
+  ASSERT_EQ(decoded, "www.example.com");
+
+  std::string all;
+  for (int c = 0; c < 256; ++c)
+    all.push_back(static_cast<char>(c));
+  out.clear();
+  decoded.clear();
+  hpack_huffman_encode(out, all);
+  hpack_huffman_decode(decoded, out);
+  ASSERT_EQ(decoded, all);
+
+  // Padding longer than 7 bits, or not made of ones, is an error.
+  //
+  decoded.clear();
+  ASSERT_THROW(hpack_huffman_decode(decoded, "\xff\xff\xff\xff"), hpack_error);
+  ASSERT_THROW(hpack_huffman_decode(decoded, from_hex("f1e3 c2e5 f23a 6ba0 "
+                                                      "ab90 f4fe")),
+               hpack_error);
+}
+
+TEST(cppws_test, hpack_decode_requests) {
+  using namespace cppws;
+
+  // RFC 7541 appendix C.4.
+  //
+  hpack_decoder decoder;
+  ASSERT_EQ(decode(decoder, from_hex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab "
+                                     "90f4 ff")),
+            (field_list{{":method", "GET"},
+                        {":scheme", "http"},
+                        {":path", "/"},
+                        {":authority", "www.example.com"}}));
+  ASSERT_EQ(decoder.table().size(), 57u);
+
+  ASSERT_EQ(decode(decoder, from_hex("8286 84be 5886 a8eb 1064 9cbf")),
+            (field_list{{":method", "GET"},
+                        {":scheme", "http"},
+                        {":path", "/"},
+                        {":authority", "www.example.com"},
+                        {"cache-control", "no-cache"}}));
+  ASSERT_EQ(decoder.table().size(), 110u);
+
+  ASSERT_EQ(decode(decoder, from_hex("8287 85bf 4088 25a8 49e9 5ba9 7d7f "
+                                     "8925 a849 e95b b8e8 b4bf")),
+            (field_list{{":method", "GET"},
+                        {":scheme", "https"},
+                        {":path", "/index.html"},
+                        {":authority", "www.example.com"},
+                        {"custom-key", "custom-value"}}));
+  ASSERT_EQ(decoder.table().size(), 164u);
+  ASSERT_EQ(decoder.table().entries(), 3u);
+
+  ASSERT_THROW(decode(decoder, from_hex("c2")), hpack_error);
+  ASSERT_THROW(decode(decoder, from_hex("4088 25a8")), hpack_error);
+  ASSERT_THROW(decode(decoder, from_hex("3fe1 3f")), hpack_error);
+  ASSERT_THROW(decode(decoder, from_hex("82 20")), hpack_error);
+}
+
+TEST(cppws_test, hpack_encode_responses) {
+  using namespace cppws;
+
+  // RFC 7541 appendix C.6: the encoder makes the same choices as the
+  // examples, so its output is identical.
+  //
+  hpack_encoder encoder{256};
+  std::string block;
+  encoder.encode(block, ":status", "302");
+  encoder.encode(block, "cache-control", "private");
+  encoder.encode(block, "date", "Mon, 21 Oct 2013 20:13:21 GMT");
+  encoder.encode(block, "location", "https://www.example.com");
+  ASSERT_EQ(block, from_hex("4882 6402 5885 aec3 771a 4b61 96d0 7abe "
+                            "9410 54d4 44a8 2005 9504 0b81 66e0 82a6 "
+                            "2d1b ff6e 919d 29ad 1718 63c7 8f0b 97c8 "
+                            "e9ae 82ae 43d3"));
+  ASSERT_EQ(encoder.table().size(), 222u);
+
+  block.clear();
+  encoder.encode(block, ":status", "307");
+  encoder.encode(block, "cache-control", "private");
+  encoder.encode(block, "date", "Mon, 21 Oct 2013 20:13:21 GMT");
+  encoder.encode(block, "location", "https://www.example.com");
+  ASSERT_EQ(block, from_hex("4883 640e ffc1 c0bf"));
+  ASSERT_EQ(encoder.table().size(), 222u);
+
+  // Round trip through a decoder, including a table size update and a field
+  // kept out of the table.
+  //
+  hpack_decoder decoder{256};
+  encoder.max_table_size(128);
+  block.clear();
+  encoder.encode(block, ":status", "200");
+  encoder.encode(block, "set-cookie", "id=1", false);
+  encoder.encode(block, "x-custom", "value");
+  ASSERT_EQ(static_cast<unsigned char>(block[0]), 0x3f);
+  ASSERT_EQ(decode(decoder, block), (field_list{{":status", "200"},
+                                                {"set-cookie", "id=1"},
+                                                {"x-custom", "value"}}));
+  ASSERT_EQ(decoder.table().max_size(), 128u);
+  ASSERT_EQ(decoder.table().entries(), 1u);
+  ASSERT_EQ(encoder.table().entries(), 2u);
+}
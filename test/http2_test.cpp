@@ -0,0 +1,501 @@
+#include <atomic>
+#include <cstdio>
+#include <future>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <cppws/http2.hpp>
+#include <cppws/route_mapper.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+struct frame {
+  cppws::http2_frame_type type;
+  std::uint8_t flags;
+  std::uint32_t id;
+  std::string payload;
+};
+
+/**
+ * Reads exactly n bytes.
+ */
+std::string read_n(cppws::socket &s, std::size_t n) {
+  std::string out(n, '\0');
+  std::size_t at = 0;
+  while (at < n) {
+    std::size_t r = s.read(out.data() + at, n - at);
+    if (r == 0)
+      break;
+    at += r;
+  }
+  out.resize(at);
+  return out;
+}
+
+std::string frame_bytes(cppws::http2_frame_type type, std::uint8_t flags,
+                        std::uint32_t id, std::string_view payload) {
+  std::string out;
+  out.push_back(static_cast<char>(payload.size() >> 16));
+  out.push_back(static_cast<char>(payload.size() >> 8));
+  out.push_back(static_cast<char>(payload.size()));
+  out.push_back(static_cast<char>(type));
+  out.push_back(static_cast<char>(flags));
+  out.push_back(static_cast<char>(id >> 24));
+  out.push_back(static_cast<char>(id >> 16));
+  out.push_back(static_cast<char>(id >> 8));
+  out.push_back(static_cast<char>(id));
+  out.append(payload);
+  return out;
+}
+
+std::string u32(std::uint32_t v) {
+  return {static_cast<char>(v >> 24), static_cast<char>(v >> 16),
+          static_cast<char>(v >> 8), static_cast<char>(v)};
+}
+
+/**
+ * Minimal HTTP/2 client side of a connection.
+ */
+struct client {
+  cppws::socket &s;
+  cppws::hpack_encoder encoder{};
+  cppws::hpack_decoder decoder{};
+
+  void send(cppws::http2_frame_type type, std::uint8_t flags,
+            std::uint32_t id, std::string_view payload) {
+    std::string bytes = frame_bytes(type, flags, id, payload);
+    s.write(bytes.data(), bytes.size());
+  }
+
+  void request(std::uint32_t id, std::string_view method,
+               std::string_view path, bool endStream) {
+    std::string block;
+    encoder.encode(block, ":method", method);
+    encoder.encode(block, ":scheme", "http");
+    encoder.encode(block, ":path", path);
+    encoder.encode(block, ":authority", "localhost");
+    encoder.encode(block, "user-agent", "test");
+    send(cppws::http2_frame_type::Headers, endStream ? 0x5 : 0x4, id, block);
+  }
+
+  frame read() {
+    std::string head = read_n(s, 9);
+    if (head.size() < 9)
+      throw std::runtime_error("Connection closed");
+    const auto *u = reinterpret_cast<const unsigned char *>(head.data());
+    std::size_t length = std::size_t(u[0]) << 16 | u[1] << 8 | u[2];
+    return {static_cast<cppws::http2_frame_type>(u[3]), u[4],
+            (std::uint32_t(u[5]) << 24 | u[6] << 16 | u[7] << 8 | u[8]) &
+                0x7fffffff,
+            read_n(s, length)};
+  }
+
+  std::map<std::string, std::string> headers(std::string_view block) {
+    std::map<std::string, std::string> out;
+    decoder.decode(block, [&out](std::string_view name,
+                                 std::string_view value) {
+      out.emplace(name, value);
+    });
+    return out;
+  }
+};
+
+std::shared_ptr<cppws::route_mapper> make_mapper() {
+  using namespace cppws;
+  auto mapper = std::make_shared<route_mapper>();
+  mapper->map(http_method::GET, "/hello", [](request_manager &m) {
+    m.body(http::body("hello " + std::string(m.request().uri().back())));
+  });
+  mapper->map(http_method::GET, "/big", [](request_manager &m) {
+    m.compression(false).body(http::body(std::string(100000, 'b')));
+  });
+  mapper->map(http_method::POST, "/echo", [](request_manager &m) {
+    m.header("Set-Cookie", "a=1").body(http::body(m.request().body()));
+  });
+  return mapper;
+}
+
+} // namespace
+
+TEST(cppws_test, http2_prior_knowledge) {
+  using namespace cppws;
+
+  connection_pair conn;
+  cppws::socket &clientSocket = conn.client;
+  event_loop loop;
+  auto connection =
+      http2_connection::accept(std::move(conn.server), loop, make_mapper());
+  std::thread runner([&] { loop.run(); });
+
+  client c{clientSocket};
+  std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  clientSocket.write(preface.data(), preface.size());
+  c.send(http2_frame_type::Settings, 0, 0, "");
+
+  frame f = c.read();
+  ASSERT_EQ(f.type, http2_frame_type::Settings);
+  ASSERT_EQ(f.flags, 0);
+  ASSERT_EQ(f.payload.size() % 6, 0u);
+  ASSERT_EQ(c.read().type, http2_frame_type::WindowUpdate);
+  f = c.read();
+  ASSERT_EQ(f.type, http2_frame_type::Settings);
+  ASSERT_EQ(f.flags, 0x1);
+
+  // Two requests in flight at once, a body split over two DATA frames and a
+  // ping in between.
+  //
+  c.request(1, "GET", "/hello", true);
+  c.request(3, "POST", "/echo", false);
+  c.send(http2_frame_type::Data, 0, 3, "ping ");
+  c.send(http2_frame_type::Ping, 0, 0, "12345678");
+  c.send(http2_frame_type::Data, 0x1, 3, "pong");
+  c.request(5, "GET", "/missing", true);
+
+  std::map<std::uint32_t, std::map<std::string, std::string>> heads;
+  std::map<std::uint32_t, std::string> bodies;
+  std::set<std::uint32_t> done;
+  bool pinged = false;
+  while (done.size() < 3) {
+    f = c.read();
+    if (f.type == http2_frame_type::Ping) {
+      ASSERT_EQ(f.flags, 0x1);
+      ASSERT_EQ(f.payload, "12345678");
+      pinged = true;
+      continue;
+    }
+    if (f.type == http2_frame_type::Headers) {
+      ASSERT_TRUE(f.flags & 0x4);
+      heads[f.id] = c.headers(f.payload);
+    } else {
+      ASSERT_EQ(f.type, http2_frame_type::Data);
+      bodies[f.id] += f.payload;
+    }
+    if (f.flags & 0x1)
+      done.insert(f.id);
+  }
+  ASSERT_TRUE(pinged);
+
+  ASSERT_EQ(heads[1][":status"], "200");
+  ASSERT_EQ(heads[1]["content-length"], "11");
+  ASSERT_TRUE(heads[1].contains("date"));
+  ASSERT_EQ(bodies[1], "hello hello");
+  ASSERT_EQ(heads[3][":status"], "200");
+  ASSERT_EQ(heads[3]["set-cookie"], "a=1");
+  ASSERT_EQ(bodies[3], "ping pong");
+  ASSERT_EQ(heads[5][":status"], "404");
+
+  // Connection-specific headers make a request malformed.
+  //
+  std::string block;
+  c.encoder.encode(block, ":method", "GET");
+  c.encoder.encode(block, ":scheme", "http");
+  c.encoder.encode(block, ":path", "/hello");
+  c.encoder.encode(block, "connection", "keep-alive");
+  c.send(http2_frame_type::Headers, 0x5, 7, block);
+  f = c.read();
+  ASSERT_EQ(f.type, http2_frame_type::RstStream);
+  ASSERT_EQ(f.id, 7u);
+  ASSERT_EQ(f.payload, u32(http2_error::PROTOCOL_ERROR));
+
+  connection->close();
+  f = c.read();
+  ASSERT_EQ(f.type, http2_frame_type::Goaway);
+  ASSERT_EQ(f.payload, u32(7) + u32(http2_error::NO_ERROR));
+  ASSERT_EQ(read_n(clientSocket, 1), "");
+
+  loop.stop();
+  runner.join();
+  ASSERT_EQ(loop.size(), 0u);
+}
+
+TEST(cppws_test, http2_flow_control) {
+  using namespace cppws;
+
+  connection_pair conn;
+  cppws::socket &clientSocket = conn.client;
+  event_loop loop;
+  auto connection =
+      http2_connection::accept(std::move(conn.server), loop, make_mapper());
+  std::thread runner([&] { loop.run(); });
+
+  // Frames of at most 16384 bytes and a 65535 byte window at first.
+  //
+  client c{clientSocket};
+  std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  clientSocket.write(preface.data(), preface.size());
+  c.send(http2_frame_type::Settings, 0, 0, "");
+  c.request(1, "GET", "/big", true);
+
+  std::string body;
+  while (body.size() < 65535) {
+    frame f = c.read();
+    if (f.type == http2_frame_type::Data) {
+      ASSERT_LE(f.payload.size(), 16384u);
+      ASSERT_FALSE(f.flags & 0x1);
+      body += f.payload;
+    }
+  }
+  ASSERT_EQ(body.size(), 65535u);
+
+  // Nothing more is sent until the client opens the windows again; a ping
+  // is answered right away.
+  //
+  c.send(http2_frame_type::Ping, 0, 0, "abcdefgh");
+  frame f = c.read();
+  ASSERT_EQ(f.type, http2_frame_type::Ping);
+
+  c.send(http2_frame_type::WindowUpdate, 0, 1, u32(100000));
+  c.send(http2_frame_type::WindowUpdate, 0, 0, u32(100000));
+  do {
+    f = c.read();
+    ASSERT_EQ(f.type, http2_frame_type::Data);
+    body += f.payload;
+  } while (!(f.flags & 0x1));
+  ASSERT_EQ(body, std::string(100000, 'b'));
+
+  // A window increment of zero is a connection error.
+  //
+  c.send(http2_frame_type::WindowUpdate, 0, 0, u32(0));
+  f = c.read();
+  ASSERT_EQ(f.type, http2_frame_type::Goaway);
+  ASSERT_EQ(f.payload.substr(4), u32(http2_error::PROTOCOL_ERROR));
+  ASSERT_EQ(read_n(clientSocket, 1), "");
+
+  loop.stop();
+  runner.join();
+  ASSERT_EQ(loop.size(), 0u);
+}
+
+TEST(cppws_test, http2_worker_handlers) {
+  using namespace cppws;
+
+  // A handler waits for the one of a later stream, which only works if
+  // they run side by side, off the loop thread.
+  //
+  event_loop loop;
+  std::promise<void> released;
+  std::shared_future<void> release = released.get_future().share();
+  std::atomic_bool onLoopThread = false;
+  std::string content(40000, '\0');
+  for (std::size_t i = 0; i < content.size(); ++i)
+    content[i] = static_cast<char>('a' + i % 26);
+
+  auto mapper = std::make_shared<route_mapper>();
+  mapper->map(http_method::GET, "/wait", [&](request_manager &m) {
+    onLoopThread = onLoopThread || loop.in_loop_thread();
+    release.wait();
+    m.body(http::body("waited"));
+  });
+  mapper->map(http_method::GET, "/release", [&](request_manager &m) {
+    released.set_value();
+    m.body(http::body("released"));
+  });
+
+  // The file is closed as soon as send_file() returns, while its frames
+  // are still to be built.
+  //
+  mapper->map(http_method::GET, "/file", [&](request_manager &m) {
+    std::FILE *file = std::tmpfile();
+    std::fwrite(content.data(), 1, content.size(), file);
+    std::fflush(file);
+    m.content_type("text/plain").send_file(fileno(file), content.size());
+    std::fclose(file);
+  });
+
+  connection_pair conn;
+  cppws::socket &clientSocket = conn.client;
+  auto connection =
+      http2_connection::accept(std::move(conn.server), loop, mapper,
+                               {.workers = std::make_shared<worker_pool>(2)});
+  std::thread runner([&] { loop.run(); });
+
+  client c{clientSocket};
+  std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  clientSocket.write(preface.data(), preface.size());
+  c.send(http2_frame_type::Settings, 0, 0, "");
+  c.request(1, "GET", "/wait", true);
+  c.request(3, "GET", "/release", true);
+
+  std::vector<std::uint32_t> finished;
+  std::map<std::uint32_t, std::map<std::string, std::string>> heads;
+  std::map<std::uint32_t, std::string> bodies;
+  auto read_streams = [&](std::size_t count) {
+    while (finished.size() < count) {
+      frame f = c.read();
+      if (f.type == http2_frame_type::Headers)
+        heads[f.id] = c.headers(f.payload);
+      else if (f.type == http2_frame_type::Data)
+        bodies[f.id] += f.payload;
+      else
+        continue;
+      if (f.flags & 0x1)
+        finished.push_back(f.id);
+    }
+  };
+  read_streams(2);
+  ASSERT_EQ(bodies[1], "waited");
+  ASSERT_EQ(bodies[3], "released");
+  ASSERT_FALSE(onLoopThread);
+
+  c.send(http2_frame_type::WindowUpdate, 0, 0, u32(100000));
+  c.request(5, "GET", "/file", true);
+  c.send(http2_frame_type::WindowUpdate, 0, 5, u32(100000));
+  read_streams(3);
+  ASSERT_EQ(heads[5][":status"], "200");
+  ASSERT_EQ(heads[5]["content-length"], "40000");
+  ASSERT_EQ(heads[5]["content-type"], "text/plain");
+  ASSERT_EQ(bodies[5], content);
+
+  connection->close();
+  while (loop.size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  loop.stop();
+  runner.join();
+}
+
+TEST(cppws_test, http2_upgrade) {
+  using namespace cppws;
+
+  connection_pair conn;
+  auto &[server, clientSocket] = conn;
+
+  // SETTINGS_MAX_CONCURRENT_STREAMS = 100, base64url encoded.
+  //
+  http_request request;
+  std::stringstream ss{"GET /hello HTTP/1.1\r\n"
+                       "Host: localhost\r\n"
+                       "Connection: Upgrade, HTTP2-Settings\r\n"
+                       "Upgrade: h2c\r\n"
+                       "HTTP2-Settings: AAMAAABk\r\n\r\n"};
+  ASSERT_TRUE(http_request::accept(request, ss));
+  ASSERT_TRUE(is_h2c_upgrade(request));
+
+  event_loop loop;
+  h2c_upgrade_mapper mapper{make_mapper(), loop};
+  response_buffer response;
+  {
+    request_manager manager{request, server, response};
+    dispatch_request(mapper, manager);
+  }
+  ASSERT_FALSE(server);
+
+  std::string head;
+  while (!head.ends_with("\r\n\r\n"))
+    head += read_n(clientSocket, 1);
+  ASSERT_TRUE(head.starts_with("HTTP/1.1 101 Switching Protocols\r\n"));
+  ASSERT_NE(head.find("Upgrade: h2c"), std::string::npos);
+
+  std::thread runner([&] { loop.run(); });
+  client c{clientSocket};
+  std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  clientSocket.write(preface.data(), preface.size());
+  c.send(http2_frame_type::Settings, 0, 0, "");
+
+  // The upgrade request is answered on stream 1.
+  //
+  std::map<std::string, std::string> headers;
+  std::string body;
+  for (;;) {
+    frame f = c.read();
+    if (f.type == http2_frame_type::Headers) {
+      ASSERT_EQ(f.id, 1u);
+      headers = c.headers(f.payload);
+    } else if (f.type == http2_frame_type::Data) {
+      ASSERT_EQ(f.id, 1u);
+      body += f.payload;
+      if (f.flags & 0x1)
+        break;
+    }
+  }
+  ASSERT_EQ(headers[":status"], "200");
+  ASSERT_EQ(body, "hello hello");
+
+  // Streams opened by the client are routed by the same mapper.
+  //
+  c.request(3, "GET", "/hello", true);
+  body.clear();
+  for (;;) {
+    frame f = c.read();
+    if (f.type == http2_frame_type::Data) {
+      ASSERT_EQ(f.id, 3u);
+      body += f.payload;
+      if (f.flags & 0x1)
+        break;
+    }
+  }
+  ASSERT_EQ(body, "hello hello");
+
+  clientSocket.close();
+  while (loop.size() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  loop.stop();
+  runner.join();
+}
+
+TEST(cppws_test, http2_upgrade_fallback) {
+  using namespace cppws;
+
+  // Requests that are not valid upgrades are answered over HTTP/1.1.
+  //
+  http_request request;
+  std::stringstream ss{"GET /hello HTTP/1.1\r\n"
+                       "Connection: Upgrade, HTTP2-Settings\r\n"
+                       "Upgrade: h2c\r\n"
+                       "HTTP2-Settings: A*\r\n\r\n"};
+  ASSERT_TRUE(http_request::accept(request, ss));
+
+  connection_pair conn;
+  auto &[server, clientSocket] = conn;
+  event_loop loop;
+  h2c_upgrade_mapper mapper{make_mapper(), loop};
+  response_buffer response;
+  {
+    request_manager manager{request, server, response};
+    dispatch_request(mapper, manager);
+  }
+  ASSERT_TRUE(server);
+  server.close();
+
+  std::string reply;
+  for (std::string chunk; !(chunk = read_n(clientSocket, 1)).empty();)
+    reply += chunk;
+  ASSERT_TRUE(reply.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_TRUE(reply.ends_with("hello hello"));
+}
+
+TEST(cppws_test, http2_idle_timeout) {
+  using namespace cppws;
+
+  connection_pair conn;
+  cppws::socket &clientSocket = conn.client;
+  event_loop loop;
+  auto connection = http2_connection::accept(
+      std::move(conn.server), loop, make_mapper(), {.idle_timeout = 100ms});
+  std::thread runner([&] { loop.run(); });
+
+  client c{clientSocket};
+  std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  clientSocket.write(preface.data(), preface.size());
+  c.send(http2_frame_type::Settings, 0, 0, "");
+  c.request(1, "GET", "/hello", true);
+
+  // The connection is closed once it has been idle for the timeout after
+  // its last stream.
+  //
+  auto start = std::chrono::steady_clock::now();
+  frame f;
+  do {
+    f = c.read();
+  } while (f.type != http2_frame_type::Goaway);
+  ASSERT_GE(std::chrono::steady_clock::now() - start, 100ms);
+  ASSERT_EQ(f.payload.substr(0, 8), u32(1) + u32(0));
+  ASSERT_THROW(c.read(), std::runtime_error);
+
+  loop.stop();
+  runner.join();
+}
@@ -0,0 +1,74 @@
+#include <sstream>
+
+#include <cppws/http_response.hpp>
+#include <gtest/gtest.h>
+
+TEST(cppws_test, http_response_serialization) {
+  using namespace cppws;
+
+  static_assert(serialized_status_line(http::OK) == "HTTP/1.1 200 OK\r\n");
+  static_assert(serialized_status_line(http::NOT_FOUND) ==
+                "HTTP/1.1 404 Not Found\r\n");
+  static_assert(header_prefix(http_response_header::ContentLength) ==
+                "Content-Length: ");
+
+  http_resonse_line custom{
+      .http_version = 100, .status_code = 299, .reason = "Custom"};
+  ASSERT_TRUE(serialized_status_line(custom).empty());
+
+  char buf[20];
+  for (std::uint64_t v : {0ull, 7ull, 10ull, 99ull, 100ull, 12345ull,
+                          18446744073709551615ull}) {
+    ASSERT_EQ(std::string_view(buf, format_decimal(buf, v)),
+              std::to_string(v));
+  }
+
+  std::ostringstream ss;
+  ss << http::NOT_FOUND << custom << http::body("missing");
+
+  std::string out = ss.str();
+  ASSERT_TRUE(out.starts_with("HTTP/1.1 404 Not Found\r\n"
+                              "HTTP/1 299 Custom\r\n"
+                              "Date: "));
+  ASSERT_TRUE(out.ends_with(" GMT\r\n"
+                            "Server: cppws\r\n"
+                            "Content-Length: 7\r\n"
+                            "Content-Type: text/plain\r\n"
+                            "\r\n"
+                            "missing"));
+}
+
+TEST(cppws_test, http_date) {
+  using namespace cppws;
+
+  char buf[http_date_length];
+  ASSERT_EQ(std::string_view(buf, format_http_date(buf, 784111777)),
+            "Sun, 06 Nov 1994 08:49:37 GMT");
+
+  std::time_t t;
+  ASSERT_TRUE(parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT", t));
+  ASSERT_EQ(t, 784111777);
+  ASSERT_TRUE(parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", t));
+  ASSERT_EQ(t, 784111777);
+  ASSERT_TRUE(parse_http_date("Sun Nov  6 08:49:37 1994", t));
+  ASSERT_EQ(t, 784111777);
+  ASSERT_FALSE(parse_http_date("yesterday", t));
+  ASSERT_FALSE(parse_http_date("Sun, 06 Nov 1994 08:49:37 CET", t));
+
+  // Truncated and malformed dates.
+  for (std::string_view bad :
+       {"", ",", "Sun,", "Sun, ", "Sunday,", "Sunday, ", "Sun,06 Nov 1994",
+        "Sun, 06 Nov 1994 08:49:37", "Sun, 06 Nov 1994 08:49:37 GMT ",
+        "Sun, 06 Nov 94 08:49:37 GMT", "Sun, 32 Nov 1994 08:49:37 GMT",
+        "Sun, 06 Nov 1994 24:49:37 GMT", "Sunday,06-Nov-94 08:49:37 GMT",
+        "Sunday, 06-Nov-94", "Sunday, 06-Xyz-94 08:49:37 GMT",
+        "Sun Nov  6 08:49:37 199", "Sun Nov    08:49:37 1994"})
+    ASSERT_FALSE(parse_http_date(bad, t)) << bad;
+
+  char line[http_date_cache::line_length];
+  ASSERT_EQ(http_date_cache::copy(line), line + sizeof line);
+
+  std::string_view view{line, sizeof line};
+  ASSERT_TRUE(view.starts_with("Date: "));
+  ASSERT_TRUE(view.ends_with(" GMT\r\n"));
+}
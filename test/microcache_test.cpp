@@ -0,0 +1,212 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cppws/microcache.hpp>
+#include <cppws/route_mapper.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+/**
+ * Runs a handler for a request and returns the response without its Date
+ * line.
+ */
+template <typename Handler>
+std::string serve(Handler &handler, std::string_view text) {
+  connection_pair conn;
+  cppws::socket &server = conn.server;
+
+  cppws::http_request request;
+  std::stringstream ss{std::string(text)};
+  EXPECT_TRUE(cppws::http_request::accept(request, ss));
+
+  cppws::response_buffer response;
+  {
+    cppws::request_manager manager{request, server, response};
+    handler(manager);
+    manager.send();
+  }
+  server.close();
+
+  return conn.read_all(true);
+}
+
+} // namespace
+
+TEST(cppws_test, microcache) {
+  using namespace cppws;
+
+  auto cache = std::make_shared<microcache>();
+  int calls = 0;
+  auto handler = cached(
+      [&calls](request_manager &m) {
+        m.format("call {} for {}", ++calls, m.request().uri().back());
+      },
+      cache);
+
+  std::string first = serve(handler, "GET /a HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(first.ends_with("call 1 for a"));
+  ASSERT_EQ(serve(handler, "GET /a HTTP/1.1\r\n\r\n"), first);
+  ASSERT_EQ(calls, 1);
+  ASSERT_GT(cache->size(), first.size());
+
+  ASSERT_TRUE(
+      serve(handler, "GET /b HTTP/1.1\r\n\r\n").ends_with("call 2 for b"));
+  ASSERT_TRUE(serve(handler, "GET /a HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n")
+                  .ends_with("call 3 for a"));
+  ASSERT_TRUE(serve(handler, "POST /a HTTP/1.1\r\n\r\n")
+                  .ends_with("call 4 for a"));
+  ASSERT_TRUE(serve(handler, "GET /a HTTP/1.1\r\nAuthorization: x\r\n\r\n")
+                  .ends_with("call 5 for a"));
+  ASSERT_EQ(serve(handler, "GET /a HTTP/1.1\r\n\r\n"), first);
+  ASSERT_EQ(calls, 5);
+}
+
+TEST(cppws_test, microcache_route) {
+  using namespace cppws;
+
+  // Cached handlers are registered like any other handler.
+  //
+  auto cache = std::make_shared<microcache>();
+  int calls = 0;
+  auto feed = [&calls](request_manager &m) { m.format("feed {}", ++calls); };
+  route_mapper mapper;
+  mapper.map(http_method::GET, "/feed", cached(feed, cache));
+  auto dispatch = [&mapper](request_manager &m) {
+    dispatch_request(mapper, m);
+  };
+
+  std::string first = serve(dispatch, "GET /feed HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(first.ends_with("feed 1"));
+  ASSERT_EQ(serve(dispatch, "GET /feed HTTP/1.1\r\n\r\n"), first);
+  ASSERT_EQ(calls, 1);
+}
+
+TEST(cppws_test, microcache_freshness) {
+  using namespace cppws;
+
+  auto cache = std::make_shared<microcache>(
+      microcache_options{.ttl = std::chrono::milliseconds(20)});
+  int calls = 0;
+  auto handler = cached(
+      [&calls](request_manager &m) {
+        ++calls;
+        if (m.request().uri().back() == "private")
+          m.header(http_response_header::CacheControl, "private, max-age=60");
+        else if (m.request().uri().back() == "long")
+          m.header(http_response_header::CacheControl,
+                   "s-maxage=60, max-age=0");
+      },
+      cache);
+
+  serve(handler, "GET /short HTTP/1.1\r\n\r\n");
+  serve(handler, "GET /short HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(calls, 1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  serve(handler, "GET /short HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(calls, 2);
+
+  serve(handler, "GET /private HTTP/1.1\r\n\r\n");
+  serve(handler, "GET /private HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(calls, 4);
+
+  serve(handler, "GET /long HTTP/1.1\r\n\r\n");
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  serve(handler, "GET /long HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(calls, 5);
+}
+
+TEST(cppws_test, microcache_eviction) {
+  using namespace cppws;
+
+  auto cache = std::make_shared<microcache>(
+      microcache_options{.max_bytes = 4096, .shards = 1});
+  int calls = 0;
+  auto handler = cached(
+      [&calls](request_manager &m) {
+        ++calls;
+        m.append(std::string(1000, 'x'));
+      },
+      cache);
+
+  for (char c : std::string_view("abcde"))
+    serve(handler, std::string("GET /") + c + " HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(calls, 5);
+  ASSERT_LE(cache->size(), 4096u);
+
+  serve(handler, "GET /e HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(calls, 5);
+  serve(handler, "GET /a HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(calls, 6);
+}
+
+TEST(cppws_test, microcache_single_refill) {
+  using namespace cppws;
+
+  auto cache = std::make_shared<microcache>();
+  std::atomic_int calls = 0;
+  auto handler = cached(
+      [&calls](request_manager &m) {
+        ++calls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        m.append("slow");
+      },
+      cache);
+
+  std::vector<std::thread> threads;
+  std::atomic_int ok = 0;
+  for (int i = 0; i < 8; ++i)
+    threads.emplace_back([&] {
+      if (serve(handler, "GET /slow HTTP/1.1\r\n\r\n").ends_with("slow"))
+        ++ok;
+    });
+  for (std::thread &t : threads)
+    t.join();
+
+  ASSERT_EQ(ok, 8);
+  ASSERT_EQ(calls, 1);
+}
+
+TEST(cppws_test, microcache_conditional) {
+  using namespace cppws;
+
+  auto cache = std::make_shared<microcache>();
+  int calls = 0;
+  auto handler = cached(
+      [&calls](request_manager &m) {
+        ++calls;
+        if (m.validate({.etag = "\"v1\"", .last_modified = 784111777}))
+          return;
+        m.append("full body");
+      },
+      cache);
+
+  // A 304 from the handler is not remembered as an uncacheable response.
+  std::string notModified = serve(handler, "GET /c HTTP/1.1\r\n"
+                                           "If-None-Match: \"v1\"\r\n\r\n");
+  ASSERT_TRUE(notModified.starts_with("HTTP/1.1 304 Not Modified\r\n"));
+  ASSERT_EQ(calls, 1);
+
+  std::string full = serve(handler, "GET /c HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(full.ends_with("full body"));
+  ASSERT_EQ(calls, 2);
+
+  // Hits are evaluated against the validators of the stored response.
+  notModified = serve(handler, "GET /c HTTP/1.1\r\n"
+                               "If-None-Match: \"v1\"\r\n\r\n");
+  ASSERT_TRUE(notModified.starts_with("HTTP/1.1 304 Not Modified\r\n"));
+  ASSERT_NE(notModified.find("ETag: \"v1\"\r\n"), std::string::npos);
+  ASSERT_FALSE(notModified.ends_with("full body"));
+  notModified = serve(handler,
+                      "GET /c HTTP/1.1\r\n"
+                      "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                      "\r\n");
+  ASSERT_TRUE(notModified.starts_with("HTTP/1.1 304 Not Modified\r\n"));
+  ASSERT_EQ(serve(handler, "GET /c HTTP/1.1\r\n"
+                           "If-None-Match: \"v0\"\r\n\r\n"),
+            full);
+  ASSERT_EQ(calls, 2);
+}
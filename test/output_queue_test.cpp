@@ -0,0 +1,175 @@
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+
+#include <cppws/output_queue.hpp>
+#include <cppws/socket_stream.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+/**
+ * Reads everything currently available on a non-blocking socket.
+ */
+std::string drain(cppws::socket &s) {
+  std::string out;
+  char buf[4096];
+  std::ptrdiff_t n;
+  while ((n = s.try_read(buf, sizeof buf)) > 0)
+    out.append(buf, n);
+  return out;
+}
+
+} // namespace
+
+TEST(cppws_test, output_queue_overflow) {
+  using namespace cppws;
+
+  output_queue oldest{10, overflow_policy::DropOldest};
+  ASSERT_TRUE(oldest.push("aaaa"));
+  ASSERT_TRUE(oldest.push("bbbb"));
+  ASSERT_TRUE(oldest.push("cccc"));
+  ASSERT_EQ(oldest.size(), 8u);
+  ASSERT_EQ(oldest.dropped(), 1u);
+
+  output_queue newest{10, overflow_policy::DropNewest};
+  ASSERT_TRUE(newest.push("aaaa"));
+  ASSERT_TRUE(newest.push("bbbb"));
+  ASSERT_TRUE(newest.push("cccc"));
+  ASSERT_EQ(newest.size(), 8u);
+  ASSERT_EQ(newest.dropped(), 1u);
+
+  output_queue disconnect{10, overflow_policy::Disconnect};
+  ASSERT_TRUE(disconnect.push("aaaaaaaaaaaaaaaa"));
+  ASSERT_FALSE(disconnect.push("b"));
+
+  connection_pair conn;
+  auto &[a, b] = conn;
+  a.non_blocking(true);
+  b.non_blocking(true);
+
+  ASSERT_TRUE(oldest.flush(a));
+  ASSERT_TRUE(oldest.empty());
+  ASSERT_EQ(drain(b), "bbbbcccc");
+}
+
+TEST(cppws_test, output_queue_partial_writes) {
+  using namespace cppws;
+
+  connection_pair conn;
+  auto &[a, b] = conn;
+  a.non_blocking(true);
+  b.non_blocking(true);
+  int size = 4096;
+  ::setsockopt(a.native_handle(), SOL_SOCKET, SO_SNDBUF, &size, sizeof size);
+
+  // The same chunk queued many times is written without copies until the
+  // socket buffer fills up.
+  //
+  auto chunk = std::make_shared<const std::string>(1000, 'x');
+  output_queue queue{1 << 20};
+  for (int i = 0; i < 500; ++i)
+    ASSERT_TRUE(queue.push(chunk));
+  ASSERT_EQ(chunk.use_count(), 501);
+
+  std::string received;
+  while (!queue.flush(a))
+    received += drain(b);
+  received += drain(b);
+  ASSERT_EQ(received, std::string(500 * 1000, 'x'));
+  ASSERT_EQ(chunk.use_count(), 1);
+}
+
+TEST(cppws_test, output_queue_keeps_partial_chunk) {
+  using namespace cppws;
+
+  connection_pair conn;
+  auto &[a, b] = conn;
+  a.non_blocking(true);
+  b.non_blocking(true);
+
+  output_queue queue{1 << 16, overflow_policy::DropOldest};
+  std::string big(4 << 20, 'a');
+  ASSERT_TRUE(queue.push(big));
+  ASSERT_FALSE(queue.flush(a));
+  std::size_t pending = queue.size();
+  ASSERT_GT(pending, 0u);
+
+  // The partially written chunk stays; only whole chunks are dropped.
+  //
+  ASSERT_TRUE(queue.push(std::string(100, 'b')));
+  ASSERT_TRUE(queue.push(std::string(100, 'c')));
+  ASSERT_EQ(queue.size(), pending + 100);
+  ASSERT_EQ(queue.dropped(), 1u);
+
+  std::string received;
+  while (!queue.flush(a))
+    received += drain(b);
+  received += drain(b);
+  ASSERT_EQ(received, big + std::string(100, 'c'));
+}
+
+TEST(cppws_test, output_queue_watermarks) {
+  using namespace cppws;
+
+  connection_pair conn;
+  auto &[a, b] = conn;
+  a.non_blocking(true);
+  b.non_blocking(true);
+
+  output_queue queue{8 << 20};
+  queue.watermarks(3000, 1000);
+  ASSERT_TRUE(queue.push(std::string(2000, 'a')));
+  ASSERT_FALSE(queue.paused());
+  ASSERT_TRUE(queue.push(std::string(1000, 'b')));
+  ASSERT_TRUE(queue.paused());
+
+  // Flushing the queue below the high watermark is not enough to resume.
+  //
+  std::string big(4 << 20, 'c');
+  ASSERT_TRUE(queue.push(big));
+  ASSERT_FALSE(queue.flush(a));
+  ASSERT_TRUE(queue.paused());
+
+  std::size_t received = drain(b).size();
+  while (!queue.flush(a))
+    received += drain(b).size();
+  ASSERT_FALSE(queue.paused());
+  received += drain(b).size();
+  ASSERT_EQ(received, 3000 + big.size());
+}
+
+TEST(cppws_test, socket_streambuf_partial_writes) {
+  using namespace cppws;
+
+  connection_pair conn;
+  int size = 4096;
+  ::setsockopt(conn.server.native_handle(), SOL_SOCKET, SO_SNDBUF, &size,
+               sizeof size);
+  cppws::socket &b = conn.client;
+
+  // Writes larger than the socket buffer go out in full and in order.
+  //
+  std::string expected;
+  for (int i = 0; i < 100000; ++i)
+    expected += std::to_string(i) + ' ';
+  std::string received;
+  std::thread reader([&] {
+    char buf[4096];
+    while (std::size_t n = b.read(buf, sizeof buf))
+      received.append(buf, n);
+  });
+  {
+    socket_ostream out{std::move(conn.server)};
+    for (int i = 0; i < 100000; ++i)
+      out << i << ' ';
+    out.flush();
+    ASSERT_TRUE(out.good());
+  }
+  reader.join();
+  ASSERT_EQ(received, expected);
+}
@@ -0,0 +1,234 @@
+#include <atomic>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cppws/proxy.hpp>
+#include <cppws/route_mapper.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+constexpr std::size_t BIG = 1 << 20;
+
+/**
+ * Upstream on a loopback port answering with its name and the request head,
+ * or with BIG bytes for /big.
+ */
+class backend {
+public:
+  explicit backend(std::string name) : name_(std::move(name)) {
+    fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof addr;
+    if (::bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0 ||
+        ::listen(fd_, 16) != 0 ||
+        ::getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &length) != 0)
+      throw std::system_error(errno, std::system_category());
+    port_ = ntohs(addr.sin_port);
+    acceptor_ = std::thread([this] { run(); });
+  }
+
+  ~backend() {
+    ::shutdown(fd_, SHUT_RDWR);
+    acceptor_.join();
+    for (std::thread &t : connections_)
+      t.join();
+    ::close(fd_);
+  }
+
+  cppws::upstream_address address() const { return {"127.0.0.1", port_}; }
+
+private:
+  void run() {
+    for (;;) {
+      int fd = ::accept(fd_, nullptr, nullptr);
+      if (fd < 0)
+        return;
+      connections_.emplace_back([this, fd] { serve(fd); });
+    }
+  }
+
+  void serve(int fd) {
+    cppws::socket s{fd};
+    std::string input;
+    char buffer[4096];
+    for (;;) {
+      std::size_t end;
+      while ((end = input.find("\r\n\r\n")) == std::string::npos) {
+        std::size_t n = s.read(buffer, sizeof buffer);
+        if (n == 0)
+          return;
+        input.append(buffer, n);
+      }
+      std::string head = input.substr(0, end + 4);
+      input.erase(0, end + 4);
+
+      std::string body = head.starts_with("GET /big ")
+                             ? std::string(BIG, 'x')
+                             : name_ + "\n" + head;
+      std::string out = "HTTP/1.1 200 OK\r\nVia: 1.0 origin\r\n"
+                        "Content-Length: " +
+                        std::to_string(body.size()) + "\r\n\r\n" + body;
+      s.write(out.data(), out.size());
+    }
+  }
+
+  std::string name_;
+  int fd_;
+  int port_;
+  std::thread acceptor_;
+  std::vector<std::thread> connections_;
+};
+
+/**
+ * Runs a request through a handler and returns the response.
+ */
+template <typename Handler>
+std::string serve(const Handler &handler, std::string_view text) {
+  connection_pair conn;
+  cppws::socket &downstream = conn.server;
+
+  cppws::http_request request;
+  std::stringstream ss{std::string(text)};
+  EXPECT_TRUE(cppws::http_request::accept(request, ss));
+
+  std::string out;
+  std::thread reader([&] { out = conn.read_all(); });
+  cppws::response_buffer response;
+  {
+    cppws::request_manager manager{request, downstream, response};
+    handler(manager);
+    manager.send();
+  }
+  downstream.close();
+  reader.join();
+  return out;
+}
+
+/**
+ * Runs a request through a group and returns the response.
+ */
+std::string forward(cppws::upstream_group &group, std::string_view text) {
+  return serve([&group](cppws::request_manager &m) { group.forward(m); },
+               text);
+}
+
+/**
+ * Name of the backend that answered a response.
+ */
+std::string answered_by(const std::string &response) {
+  std::size_t body = response.find("\r\n\r\n") + 4;
+  return response.substr(body, response.find('\n', body) - body);
+}
+
+} // namespace
+
+TEST(cppws_test, proxy_round_robin) {
+  using namespace cppws;
+
+  backend a{"a"}, b{"b"};
+  upstream_group group{{a.address(), b.address()}};
+
+  std::string first = forward(group, "GET /x HTTP/1.1\r\n"
+                                     "Via: 1.1 edge\r\n\r\n");
+  std::string second = forward(group, "GET /x HTTP/1.0\r\n\r\n");
+  ASSERT_NE(answered_by(first), answered_by(second));
+  ASSERT_EQ(answered_by(forward(group, "GET /x HTTP/1.1\r\n\r\n")),
+            answered_by(first));
+
+  // Via carries the protocol version each hop received the message with.
+  //
+  ASSERT_NE(first.find("\r\nVia: 1.0 origin, 1.1 cppws\r\n"),
+            std::string::npos);
+  ASSERT_NE(first.find("\nVia: 1.1 edge, 1.1 cppws\r\n"), std::string::npos);
+  ASSERT_NE(second.find("\nVia: 1.0 cppws\r\n"), std::string::npos);
+
+  // Bodies are spliced through in full.
+  //
+  std::string big = forward(group, "GET /big HTTP/1.1\r\n\r\n");
+  ASSERT_NE(big.find("Content-Length: " + std::to_string(BIG)),
+            std::string::npos);
+  ASSERT_TRUE(big.ends_with("\r\n\r\n" + std::string(BIG, 'x')));
+  ASSERT_EQ(group.pool().idle(), 2u);
+}
+
+TEST(cppws_test, proxy_route) {
+  using namespace cppws;
+
+  // proxy() handlers are registered like any other handler.
+  //
+  backend a{"a"};
+  auto group = std::make_shared<upstream_group>(
+      std::vector<upstream_address>{a.address()});
+  route_mapper mapper;
+  mapper.map(http_method::GET, "/api", proxy(group));
+
+  std::string response =
+      serve([&mapper](request_manager &m) { dispatch_request(mapper, m); },
+            "GET /api HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(response.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_EQ(answered_by(response), "a");
+}
+
+TEST(cppws_test, proxy_consistent_hash) {
+  using namespace cppws;
+
+  backend a{"a"}, b{"b"}, c{"c"};
+  upstream_group group{{a.address(), b.address(), c.address()},
+                       {.policy = balancing::consistent_hash,
+                        .hash_header = "X-Session"}};
+
+  std::map<std::string, int> counts;
+  for (int i = 0; i < 60; ++i) {
+    std::string target = "/item/" + std::to_string(i);
+    std::string text = "GET " + target + " HTTP/1.1\r\n\r\n";
+    std::string name = answered_by(forward(group, text));
+    ++counts[name];
+    ASSERT_EQ(answered_by(forward(group, text)), name);
+  }
+  ASSERT_EQ(counts.size(), 3u);
+
+  std::string session = "GET /a HTTP/1.1\r\nX-Session: 42\r\n\r\n";
+  std::string name = answered_by(forward(group, session));
+  ASSERT_EQ(answered_by(forward(
+                group, "GET /b HTTP/1.1\r\nX-Session: 42\r\n\r\n")),
+            name);
+}
+
+TEST(cppws_test, proxy_passive_health) {
+  using namespace cppws;
+
+  backend live{"live"};
+  upstream_address dead{"127.0.0.1", 1};
+  upstream_group group{{dead, live.address()},
+                       {.policy = balancing::least_outstanding,
+                        .max_fails = 2}};
+
+  // Idempotent requests that hit the dead upstream are retried on the live
+  // one, until the dead one is ejected.
+  //
+  for (int i = 0; i < 6; ++i)
+    ASSERT_EQ(answered_by(forward(group, "GET / HTTP/1.1\r\n\r\n")), "live");
+  std::vector<upstream_status> status = group.status();
+  ASSERT_TRUE(status[0].ejected);
+  ASSERT_EQ(status[0].fails, 2u);
+  ASSERT_FALSE(status[1].ejected);
+  ASSERT_EQ(status[1].fails, 0u);
+  ASSERT_EQ(status[1].outstanding, 0u);
+
+  // With every upstream down, requests are answered with 502.
+  //
+  upstream_group down{{dead}};
+  std::string response = forward(down, "POST / HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(response.starts_with("HTTP/1.1 502 Bad Gateway\r\n"));
+}
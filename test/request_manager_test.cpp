@@ -0,0 +1,119 @@
+#include <string>
+#include <thread>
+
+#include <cppws/request_manager.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+void parse(cppws::http_request &request, std::string_view text) {
+  std::stringstream ss{std::string(text)};
+  ASSERT_TRUE(cppws::http_request::accept(request, ss));
+}
+
+} // namespace
+
+TEST(cppws_test, request_manager) {
+  using namespace cppws;
+
+  connection_pair conn;
+  http_request request;
+  response_buffer response;
+  parse(request, "GET /users/7 HTTP/1.1\r\n\r\n");
+
+  {
+    request_manager manager{request, conn.server, response};
+    manager.status(http::CREATED)
+        .header(http_response_header::CacheControl, "no-store")
+        .content_type(http_content_type::ApplicationJson)
+        .format("{{\"id\": {}", 7);
+
+    std::span<char> space = manager.prepare_body(16);
+    space[0] = '}';
+    manager.commit_body(1);
+
+    ASSERT_FALSE(manager.sent());
+    manager.send();
+    ASSERT_TRUE(manager.sent());
+  }
+
+  ASSERT_EQ(conn.read(true), "HTTP/1.1 201 Created\r\n"
+                         "Cache-Control: no-store\r\n"
+                         "Server: cppws\r\n"
+                         "Content-Length: 9\r\n"
+                         "Content-Type: application/json\r\n"
+                         "\r\n"
+                         "{\"id\": 7}");
+
+  // The buffer is reset for the next request and HEAD omits the body.
+  //
+  parse(request, "HEAD /users/7 HTTP/1.1\r\n\r\n");
+  {
+    request_manager manager{request, conn.server, response};
+    manager.body(http::body("hello"));
+    manager.send();
+    manager.send();
+  }
+
+  ASSERT_EQ(conn.read(true), "HTTP/1.1 200 OK\r\n"
+                         "Server: cppws\r\n"
+                         "Content-Length: 5\r\n"
+                         "Content-Type: text/plain\r\n"
+                         "\r\n");
+}
+
+TEST(cppws_test, response_buffer_zerocopy) {
+  using namespace cppws;
+  using namespace std::chrono_literals;
+
+  server_socket server{0};
+  cppws::socket client;
+  client.connect("127.0.0.1", server.port());
+  cppws::socket connection = server.accept();
+
+  http_request request;
+  response_buffer response;
+  parse(request, "GET /export HTTP/1.1\r\n\r\n");
+  std::string body(4 << 20, '\0');
+  for (std::size_t i = 0; i < body.size(); ++i)
+    body[i] = static_cast<char>('a' + i % 26);
+
+  std::string received;
+  std::thread reader([&] {
+    char buffer[64 << 10];
+    while (std::size_t n = client.read(buffer, sizeof buffer))
+      received.append(buffer, n);
+  });
+
+  // The body is set aside until the kernel is done with it, and the next
+  // response is built in a new buffer.
+  //
+  {
+    request_manager manager{request, connection, response};
+    manager.zerocopy(true).append(body);
+    manager.send();
+  }
+  ASSERT_EQ(response.zerocopy_pending(), 1u);
+  ASSERT_TRUE(response.body().empty());
+  ASSERT_TRUE(response.reclaim(connection, 5s));
+  ASSERT_EQ(response.zerocopy_pending(), 0u);
+
+  connection.close();
+  reader.join();
+  ASSERT_NE(received.find("Content-Length: 4194304\r\n"), std::string::npos);
+  ASSERT_TRUE(received.ends_with(body));
+
+  // Connections without zero-copy support copy the body as usual.
+  //
+  connection_pair conn;
+  {
+    request_manager manager{request, conn.server, response};
+    manager.zerocopy(true).append(
+        std::string(response_buffer::ZEROCOPY_MIN_SIZE, 'x'));
+    manager.send();
+  }
+  ASSERT_EQ(response.zerocopy_pending(), 0u);
+  ASSERT_EQ(response.body().size(), response_buffer::ZEROCOPY_MIN_SIZE);
+}
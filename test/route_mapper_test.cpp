@@ -0,0 +1,127 @@
+#include <array>
+#include <memory>
+#include <type_traits>
+
+#include <cppws/route_mapper.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+static void make_request(cppws::http_request &request, std::string_view text) {
+  std::stringstream ss{std::string(text)};
+  ASSERT_TRUE(cppws::http_request::accept(request, ss));
+}
+
+TEST(cppws_test, inplace_function) {
+  using fn = cppws::inplace_function<int(int)>;
+
+  int base = 40;
+  fn f = [&base](int x) { return base + x; };
+  ASSERT_TRUE(f);
+  ASSERT_EQ(f(2), 42);
+
+  fn g = std::move(f);
+  ASSERT_FALSE(f);
+  ASSERT_EQ(g(1), 41);
+
+  auto owned = std::make_shared<int>(7);
+  g = [owned](int x) { return *owned * x; };
+  ASSERT_EQ(owned.use_count(), 2);
+  ASSERT_EQ(g(6), 42);
+  g = nullptr;
+  ASSERT_EQ(owned.use_count(), 1);
+
+  static_assert(!fn::stores_inline<std::array<char, 128>>);
+
+  // Functions may be called from several threads at once, so callables
+  // that change their own state are rejected.
+  //
+  auto counter = [n = 0](int x) mutable { return n += x; };
+  static_assert(!std::is_constructible_v<fn, decltype(counter)>);
+}
+
+TEST(cppws_test, route_mapper) {
+  using namespace cppws;
+
+  int hit = 0;
+  std::array<char, 256> large{};
+
+  route_mapper mapper;
+  mapper.map(http_method::POST, "/users/login",
+             [&hit](request_manager &) { hit = 1; });
+  mapper.map(http_method::GET, "/users",
+             [&hit](request_manager &) { hit = 2; });
+  mapper.map_prefix(http_method::GET, "/static",
+                    [&hit, large](request_manager &) { hit = 3; });
+  mapper.map_prefix(http_method::GET, "/static/private",
+                    [&hit](request_manager &) { hit = 4; });
+
+  http_request request;
+  cppws::socket connection;
+  response_buffer response;
+  request_manager manager{request, connection, response};
+  const request_mapper::handler *h;
+
+  make_request(request, "POST /users/login HTTP/1.1\r\n\r\n");
+  ASSERT_NE((h = mapper.resolve(request)), nullptr);
+  (*h)(manager);
+  ASSERT_EQ(hit, 1);
+  ASSERT_EQ(mapper.resolve(request), h);
+
+  make_request(request, "GET /users/?page=2 HTTP/1.1\r\n\r\n");
+  ASSERT_NE((h = mapper.resolve(request)), nullptr);
+  (*h)(manager);
+  ASSERT_EQ(hit, 2);
+
+  make_request(request, "GET /static/css/site.css HTTP/1.1\r\n\r\n");
+  ASSERT_NE((h = mapper.resolve(request)), nullptr);
+  (*h)(manager);
+  ASSERT_EQ(hit, 3);
+
+  make_request(request, "GET /static/private/key HTTP/1.1\r\n\r\n");
+  ASSERT_NE((h = mapper.resolve(request)), nullptr);
+  (*h)(manager);
+  ASSERT_EQ(hit, 4);
+
+  make_request(request, "GET /users/login HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(mapper.resolve(request), nullptr);
+
+  make_request(request, "GET /staticx HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(mapper.resolve(request), nullptr);
+}
+
+TEST(cppws_test, route_mapper_preflight) {
+  using namespace cppws;
+
+  int hit = 0;
+  route_mapper mapper;
+  mapper.map(http_method::GET, "/data",
+             [&hit](request_manager &) { ++hit; });
+
+  http_request request;
+  make_request(request, "OPTIONS /data HTTP/1.1\r\n"
+                        "Origin: https://app.example\r\n"
+                        "Access-Control-Request-Method: GET\r\n\r\n");
+  ASSERT_EQ(mapper.resolve(request), nullptr);
+
+  mapper.preflight(cors_filter("https://app.example"));
+  const request_mapper::handler *h = mapper.resolve(request);
+  ASSERT_NE(h, nullptr);
+
+  connection_pair conn;
+  auto &[server, client] = conn;
+  response_buffer response;
+  request_manager manager{request, server, response};
+  (*h)(manager);
+  ASSERT_EQ(hit, 0);
+
+  std::string out(4096, '\0');
+  out.resize(client.read(out.data(), out.size()));
+  ASSERT_TRUE(out.starts_with("HTTP/1.1 204 No Content\r\n"));
+  ASSERT_NE(out.find("Access-Control-Allow-Methods: "), std::string::npos);
+
+  // Without the request headers of a preflight, OPTIONS is routed as usual.
+  //
+  make_request(request, "OPTIONS /data HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(mapper.resolve(request), nullptr);
+}
@@ -0,0 +1,195 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cppws/socket.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+int get_option(const cppws::socket &s, int level, int name) {
+  int value = 0;
+  socklen_t length = sizeof value;
+  if (::getsockopt(s.native_handle(), level, name, &value, &length) != 0)
+    throw std::system_error(errno, std::system_category());
+  return value;
+}
+
+int local_port(const cppws::socket &s) {
+  struct sockaddr_storage addr;
+  socklen_t length = sizeof addr;
+  if (::getsockname(s.native_handle(),
+                    reinterpret_cast<struct sockaddr *>(&addr), &length) != 0)
+    throw std::system_error(errno, std::system_category());
+  return ntohs(reinterpret_cast<struct sockaddr_in &>(addr).sin_port);
+}
+
+} // namespace
+
+TEST(cppws_test, socket_listen_options) {
+  using namespace cppws;
+  using namespace std::chrono_literals;
+
+  server_socket server{0, listen_options{
+                              .defer_accept = 1s,
+                              .connection = {.user_timeout = 5000ms}}};
+  ASSERT_GT(server.port(), 0);
+
+  // Accepted connections inherit the settings of the listening socket.
+  // With deferred accepts, they are only accepted once data arrived.
+  //
+  cppws::socket client;
+  client.connect("127.0.0.1", server.port());
+  client.write("x", 1);
+  cppws::socket connection = server.accept();
+  ASSERT_EQ(get_option(connection, IPPROTO_TCP, TCP_NODELAY), 1);
+  ASSERT_EQ(get_option(connection, IPPROTO_TCP, TCP_USER_TIMEOUT), 5000);
+  char c;
+  ASSERT_EQ(connection.read(&c, 1), 1u);
+
+  client.apply({.no_delay = false, .send_buffer = 64 << 10});
+  ASSERT_EQ(get_option(client, IPPROTO_TCP, TCP_NODELAY), 0);
+  ASSERT_GE(get_option(client, SOL_SOCKET, SO_SNDBUF), 64 << 10);
+
+  // Ports can be shared, e.g. by one listening socket per thread.
+  //
+  cppws::socket second;
+  second.listen(server.port());
+  ASSERT_EQ(second.port(), server.port());
+}
+
+TEST(cppws_test, socket_cork) {
+  using namespace cppws;
+
+  server_socket server{0};
+  cppws::socket client;
+  client.connect("127.0.0.1", server.port());
+  cppws::socket connection = server.accept();
+
+  // Corked data leaves once the socket is uncorked.
+  //
+  ASSERT_TRUE(connection.cork(true));
+  connection.write("head", 4);
+  connection.write("body", 4);
+  ASSERT_TRUE(connection.cork(false));
+  std::string received(8, '\0');
+  std::size_t n = 0;
+  while (n < received.size())
+    n += client.read(received.data() + n, received.size() - n);
+  ASSERT_EQ(received, "headbody");
+
+  connection_pair conn;
+  auto &[local, peer] = conn;
+  ASSERT_FALSE(local.cork(true));
+}
+
+TEST(cppws_test, socket_accept) {
+  using namespace cppws;
+
+  cppws::socket listener;
+  listener.listen(0);
+
+  // Accepted connections know their peer and are closed on exec.
+  //
+  cppws::socket client;
+  client.connect("127.0.0.1", listener.port());
+  cppws::socket connection = listener.accept();
+  ASSERT_EQ(connection.host(), "127.0.0.1");
+  ASSERT_EQ(connection.port(), local_port(client));
+  ASSERT_TRUE(::fcntl(connection.native_handle(), F_GETFD) & FD_CLOEXEC);
+  ASSERT_FALSE(::fcntl(connection.native_handle(), F_GETFL) & O_NONBLOCK);
+
+  // The backlog is drained in batches of connections, non-blocking on
+  // request.
+  //
+  listener.non_blocking(true);
+  std::vector<cppws::socket> batch;
+  for (int i = 0; i < 4; ++i)
+    batch.emplace_back(-1);
+  ASSERT_EQ(listener.accept_some(batch), 0u);
+
+  std::vector<cppws::socket> clients(5);
+  for (cppws::socket &c : clients)
+    c.connect("127.0.0.1", listener.port());
+  ASSERT_EQ(listener.accept_some(batch, true), 4u);
+  for (cppws::socket &s : batch) {
+    ASSERT_TRUE(s);
+    ASSERT_TRUE(::fcntl(s.native_handle(), F_GETFL) & O_NONBLOCK);
+    ASSERT_TRUE(::fcntl(s.native_handle(), F_GETFD) & FD_CLOEXEC);
+  }
+  ASSERT_EQ(batch[0].port(), local_port(clients[0]));
+  ASSERT_EQ(listener.accept_some(batch), 1u);
+  ASSERT_EQ(batch[0].port(), local_port(clients[4]));
+  ASSERT_FALSE(::fcntl(batch[0].native_handle(), F_GETFL) & O_NONBLOCK);
+  ASSERT_EQ(listener.accept_some(batch), 0u);
+}
+
+TEST(cppws_test, socket_unix) {
+  using namespace cppws;
+
+  // Socket files left over by a previous listener are replaced. The name is
+  // unique to the process, so that concurrent runs do not share it.
+  //
+  std::string path = ::testing::TempDir() + "cppws-socket-test-" +
+                     std::to_string(::getpid()) + ".sock";
+  for (int i = 0; i < 2; ++i) {
+    server_socket server{path};
+    cppws::socket client{socket_family::Unix};
+    client.connect_unix(path);
+    ASSERT_EQ(client.host(), "unix:" + path);
+    cppws::socket connection = server.accept();
+    ASSERT_EQ(connection.host(), "unix:");
+    ASSERT_EQ(connection.port(), 0);
+    client.write("x", 1);
+    char c;
+    ASSERT_EQ(connection.read(&c, 1), 1u);
+  }
+  ::unlink(path.c_str());
+
+  // Names in the abstract namespace leave no file behind.
+  //
+  std::string name = "@cppws-socket-test-" + std::to_string(::getpid());
+  server_socket server{name};
+  cppws::socket client{socket_family::Unix};
+  client.connect_unix(name);
+  cppws::socket connection = server.accept();
+  ASSERT_FALSE(connection.cork(true));
+
+  cppws::socket other{socket_family::Unix};
+  ASSERT_THROW(other.connect_unix(std::string(200, 'x')),
+               std::invalid_argument);
+}
+
+TEST(cppws_test, socket_ipv6) {
+  using namespace cppws;
+
+  // Dual-stack listeners accept IPv4 connections too, and show their peers
+  // as plain IPv4 addresses.
+  //
+  server_socket server{socket_family::IPv6, 0};
+  ASSERT_GT(server.port(), 0);
+
+  cppws::socket v6{socket_family::IPv6};
+  v6.connect("::1", server.port());
+  cppws::socket connection = server.accept();
+  ASSERT_EQ(connection.host(), "::1");
+  ASSERT_EQ(connection.port(), local_port(v6));
+  ASSERT_EQ(get_option(connection, IPPROTO_TCP, TCP_NODELAY), 1);
+
+  cppws::socket v4;
+  v4.connect("127.0.0.1", server.port());
+  connection = server.accept();
+  ASSERT_EQ(connection.host(), "127.0.0.1");
+  ASSERT_EQ(connection.port(), local_port(v4));
+
+  cppws::socket bad;
+  ASSERT_THROW(bad.connect("::1", server.port()), std::invalid_argument);
+}
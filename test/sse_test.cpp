@@ -0,0 +1,205 @@
+#include <thread>
+
+#include <sys/socket.h>
+
+#include <cppws/sse.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+/**
+ * Client side of an event stream, connected to a server socket.
+ */
+struct sse_client : connection_pair {
+  cppws::http_request request;
+  cppws::response_buffer response;
+
+  explicit sse_client(std::string_view head) {
+    std::stringstream ss{std::string(head)};
+    cppws::http_request::accept(request, ss);
+  }
+
+  /**
+   * Reads until \p suffix was received.
+   */
+  std::string read_until(std::string_view suffix) {
+    std::string out;
+    char c;
+    while (!out.ends_with(suffix) && client.read(&c, 1) == 1)
+      out.push_back(c);
+    return out;
+  }
+};
+
+} // namespace
+
+TEST(cppws_test, sse_event_format) {
+  using namespace cppws;
+  using namespace std::chrono_literals;
+
+  std::string out;
+  append_sse_event(out, {.data = "hello"});
+  ASSERT_EQ(out, "data: hello\n\n");
+
+  out.clear();
+  append_sse_event(out, {.event = "update\nx",
+                         .data = "a\r\nb\rc\nd",
+                         .id = "42",
+                         .retry = 1500ms});
+  ASSERT_EQ(out, "event: update\nid: 42\nretry: 1500\n"
+                 "data: a\ndata: b\ndata: c\ndata: d\n\n");
+}
+
+TEST(cppws_test, sse_stream) {
+  using namespace cppws;
+  using namespace std::chrono_literals;
+
+  sse_client c{"GET /events HTTP/1.1\r\nLast-Event-ID: 7\r\n"
+               "Accept-Encoding: gzip\r\n\r\n"};
+
+  event_loop loop;
+  std::shared_ptr<sse_stream> stream;
+  {
+    request_manager manager{c.request, c.server, c.response};
+    stream = sse_stream::accept(manager, loop, {.retry = 2s});
+    manager.send();
+  }
+  ASSERT_FALSE(c.server);
+  ASSERT_EQ(stream->last_event_id(), "7");
+  std::thread runner([&] { loop.run(); });
+
+  std::string head = c.read_until("\r\n\r\n");
+  ASSERT_TRUE(head.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_NE(head.find("Content-Type: text/event-stream\r\n"),
+            std::string::npos);
+  ASSERT_EQ(head.find("Content-Length"), std::string::npos);
+  ASSERT_EQ(head.find("Content-Encoding"), std::string::npos);
+
+  ASSERT_EQ(c.read_until("\n\n"), "retry: 2000\n\n");
+  stream->send({.data = "one", .id = "8"});
+  ASSERT_EQ(c.read_until("\n\n"), "id: 8\ndata: one\n\n");
+  stream->comment("ping");
+  ASSERT_EQ(c.read_until("\n\n"), ": ping\n\n");
+
+  stream->send({.data = "last"});
+  stream->close();
+  ASSERT_EQ(c.read_until("\n\n"), "data: last\n\n");
+  char byte;
+  ASSERT_EQ(c.client.read(&byte, 1), 0u);
+
+  loop.stop();
+  runner.join();
+  ASSERT_TRUE(stream->closed());
+  ASSERT_EQ(loop.size(), 0u);
+}
+
+TEST(cppws_test, sse_channel) {
+  using namespace cppws;
+
+  event_loop loops[2];
+  std::vector<std::unique_ptr<sse_client>> clients;
+  sse_channel channel;
+  for (int i = 0; i < 6; ++i) {
+    auto &c = *clients.emplace_back(
+        std::make_unique<sse_client>("GET /events HTTP/1.1\r\n\r\n"));
+    request_manager manager{c.request, c.server, c.response};
+    channel.subscribe(sse_stream::accept(manager, loops[i % 2]));
+    c.read_until("\r\n\r\n");
+  }
+  ASSERT_EQ(channel.size(), 6u);
+
+  std::thread runners[2] = {std::thread([&] { loops[0].run(); }),
+                            std::thread([&] { loops[1].run(); })};
+
+  ASSERT_EQ(channel.publish({.event = "tick", .data = "1"}), 6u);
+  for (auto &c : clients)
+    ASSERT_EQ(c->read_until("\n\n"), "event: tick\ndata: 1\n\n");
+
+  // Disconnected clients are noticed by the loop and pruned on the next
+  // publish.
+  //
+  clients[0]->client.close();
+  clients[3]->client.close();
+  ASSERT_GE(channel.publish({.data = "2"}), 4u);
+  for (std::size_t i : {1, 2, 4, 5})
+    ASSERT_EQ(clients[i]->read_until("\n\n"), "data: 2\n\n");
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (channel.publish({.data = "3"}) != 4u)
+    ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+  ASSERT_EQ(channel.size(), 4u);
+
+  for (event_loop &loop : loops)
+    loop.stop();
+  for (std::thread &t : runners)
+    t.join();
+}
+
+TEST(cppws_test, sse_slow_client) {
+  using namespace cppws;
+
+  sse_client c{"GET /events HTTP/1.1\r\n\r\n"};
+  int size = 4096;
+  ::setsockopt(c.server.native_handle(), SOL_SOCKET, SO_SNDBUF, &size,
+               sizeof size);
+
+  event_loop loop;
+  request_manager manager{c.request, c.server, c.response};
+  auto stream = sse_stream::accept(
+      manager, loop,
+      {.max_queued_bytes = 64 << 10, .overflow = overflow_policy::Disconnect});
+  c.read_until("\r\n\r\n");
+  loop.run_once(0);
+
+  // The client never reads, so its queue fills up and it is disconnected
+  // instead of holding on to an unbounded backlog.
+  //
+  std::string payload(1000, 'x');
+  for (int i = 0; i < 1000 && !stream->closed(); ++i)
+    stream->send({.data = payload});
+  ASSERT_TRUE(stream->closed());
+  ASSERT_EQ(loop.size(), 0u);
+}
+
+TEST(cppws_test, sse_paused) {
+  using namespace cppws;
+
+  sse_client c{"GET /events HTTP/1.1\r\n\r\n"};
+  int size = 4096;
+  ::setsockopt(c.server.native_handle(), SOL_SOCKET, SO_SNDBUF, &size,
+               sizeof size);
+
+  event_loop loop;
+  request_manager manager{c.request, c.server, c.response};
+  auto stream = sse_stream::accept(
+      manager, loop, {.high_water = 16 << 10, .low_water = 4 << 10});
+  c.read_until("\r\n\r\n");
+  loop.run_once(0);
+
+  // A producer that respects the watermark stops well before events would
+  // be dropped.
+  //
+  std::string payload(1000, 'x');
+  int sent = 0;
+  for (; sent < 1000 && !stream->paused(); ++sent)
+    stream->send({.data = payload});
+  ASSERT_TRUE(stream->paused());
+  ASSERT_LT(sent, 1000);
+  ASSERT_EQ(stream->dropped(), 0u);
+
+  bool resumed = false;
+  stream->on_resume([&] { resumed = true; });
+  c.client.non_blocking(true);
+  std::size_t received = 0;
+  char buf[4096];
+  while (!resumed) {
+    std::ptrdiff_t n;
+    while ((n = c.client.try_read(buf, sizeof buf)) > 0)
+      received += n;
+    loop.run_once(10);
+  }
+  ASSERT_FALSE(stream->paused());
+  ASSERT_FALSE(stream->closed());
+  ASSERT_GT(received, 0u);
+}
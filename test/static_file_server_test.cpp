@@ -0,0 +1,176 @@
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include <cppws/static_file_server.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+/**
+ * Temporary directory tree that is removed with the fixture.
+ */
+struct temp_tree {
+  fs::path root;
+
+  temp_tree() {
+    char tmpl[] = "/tmp/cppws_static_XXXXXX";
+    root = ::mkdtemp(tmpl);
+  }
+
+  ~temp_tree() { fs::remove_all(root); }
+
+  void write(const fs::path &rel, std::string_view text) {
+    fs::create_directories((root / rel).parent_path());
+    std::ofstream(root / rel, std::ios::binary | std::ios::trunc) << text;
+  }
+};
+
+/**
+ * Serves a request and returns the response without its Date line.
+ */
+std::string serve(const cppws::static_file_server &server,
+                  std::string_view text) {
+  connection_pair conn;
+  cppws::socket &out = conn.server;
+
+  cppws::http_request request;
+  std::stringstream ss{std::string(text)};
+  EXPECT_TRUE(cppws::http_request::accept(request, ss));
+
+  cppws::response_buffer response;
+  {
+    cppws::request_manager manager{request, out, response};
+    server(manager);
+    manager.send();
+  }
+  out.close();
+  return conn.read_all(true);
+}
+
+std::string header(std::string_view response, std::string_view name) {
+  std::size_t at = response.find(std::string(name) + ": ");
+  if (at == std::string_view::npos)
+    return {};
+  at += name.size() + 2;
+  return std::string(response.substr(at, response.find("\r\n", at) - at));
+}
+
+} // namespace
+
+TEST(cppws_test, static_file_server) {
+  using namespace cppws;
+
+  temp_tree tree;
+  tree.write("index.html", "<h1>home</h1>");
+  tree.write("css/site.css", "body{}");
+  tree.write("docs/a b.txt", "spaced");
+
+  static_file_server server{tree.root, "/static"};
+
+  std::string css = serve(server, "GET /static/css/site.css HTTP/1.1\r\n\r\n");
+  ASSERT_TRUE(css.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_EQ(header(css, "Content-Type"), "text/css");
+  ASSERT_EQ(header(css, "Cache-Control"), "public, max-age=3600");
+  ASSERT_EQ(header(css, "Accept-Ranges"), "bytes");
+  ASSERT_TRUE(css.ends_with("\r\n\r\nbody{}"));
+
+  std::string etag = header(css, "ETag");
+  ASSERT_FALSE(etag.empty());
+  std::string cached = serve(server, "GET /static/css/site.css HTTP/1.1\r\n"
+                                     "If-None-Match: " +
+                                         etag + "\r\n\r\n");
+  ASSERT_TRUE(cached.starts_with("HTTP/1.1 304 Not Modified\r\n"));
+
+  ASSERT_TRUE(serve(server, "GET /static HTTP/1.1\r\n\r\n")
+                  .ends_with("<h1>home</h1>"));
+  ASSERT_TRUE(serve(server, "GET /static/docs/a%20b.txt?v=1/2 HTTP/1.1\r\n\r\n")
+                  .ends_with("\r\n\r\nspaced"));
+  ASSERT_TRUE(serve(server, "GET /static/css/site.css HTTP/1.1\r\n"
+                            "Range: bytes=0-3\r\n\r\n")
+                  .ends_with("\r\n\r\nbody"));
+  ASSERT_EQ(server.cached_files(), 3u);
+
+  ASSERT_TRUE(serve(server, "GET /static/missing.css HTTP/1.1\r\n\r\n")
+                  .starts_with("HTTP/1.1 404 Not Found\r\n"));
+  ASSERT_TRUE(serve(server, "GET /static/../secret HTTP/1.1\r\n\r\n")
+                  .starts_with("HTTP/1.1 400 Bad Request\r\n"));
+  ASSERT_TRUE(serve(server, "GET /static/%2e%2e/secret HTTP/1.1\r\n\r\n")
+                  .starts_with("HTTP/1.1 400 Bad Request\r\n"));
+  ASSERT_TRUE(serve(server, "GET /static/docs HTTP/1.1\r\n\r\n")
+                  .starts_with("HTTP/1.1 404 Not Found\r\n"));
+}
+
+TEST(cppws_test, static_file_server_invalidation) {
+  using namespace cppws;
+
+  temp_tree tree;
+  tree.write("js/app.js", "v1");
+  static_file_server server{tree.root, "/"};
+
+  ASSERT_TRUE(
+      serve(server, "GET /js/app.js HTTP/1.1\r\n\r\n").ends_with("\r\n\r\nv1"));
+  ASSERT_EQ(server.cached_files(), 1u);
+
+  tree.write("js/app.js", "version 2");
+  for (int i = 0; i < 100 && server.cached_files() != 0; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(server.cached_files(), 0u);
+  ASSERT_TRUE(serve(server, "GET /js/app.js HTTP/1.1\r\n\r\n")
+                  .ends_with("\r\n\r\nversion 2"));
+
+  fs::remove(tree.root / "js/app.js");
+  for (int i = 0; i < 100 && server.cached_files() != 0; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_TRUE(serve(server, "GET /js/app.js HTTP/1.1\r\n\r\n")
+                  .starts_with("HTTP/1.1 404 Not Found\r\n"));
+}
+
+TEST(cppws_test, static_file_server_precompressed) {
+  using namespace cppws;
+
+  temp_tree tree;
+  std::string css;
+  for (int i = 0; i < 200; ++i)
+    css += ".c" + std::to_string(i) + " { color: red; }\n";
+  tree.write("site.css", css);
+  tree.write("app.js", std::string(2048, 'a'));
+  tree.write("app.js.br", "brotli");
+  tree.write("logo.png", std::string(2048, 'p'));
+
+  static_file_server server{tree.root};
+  server.preload();
+  ASSERT_EQ(server.cached_files(), 3u);
+
+  std::string plain = serve(server, "GET /site.css HTTP/1.1\r\n\r\n");
+  ASSERT_EQ(header(plain, "Vary"), "Accept-Encoding");
+  ASSERT_EQ(header(plain, "Content-Encoding"), "");
+  ASSERT_TRUE(plain.ends_with(css));
+
+  std::string gz = serve(server, "GET /site.css HTTP/1.1\r\n"
+                                 "Accept-Encoding: gzip, deflate\r\n\r\n");
+  ASSERT_EQ(header(gz, "Content-Encoding"), "gzip");
+  ASSERT_NE(header(gz, "ETag"), header(plain, "ETag"));
+  std::size_t length = std::stoul(header(gz, "Content-Length"));
+  ASSERT_LT(length, css.size());
+  ASSERT_EQ(gz.substr(gz.size() - length, 2), "\x1f\x8b");
+
+  std::string br = serve(server, "GET /app.js HTTP/1.1\r\n"
+                                 "Accept-Encoding: gzip, br\r\n\r\n");
+  ASSERT_EQ(header(br, "Content-Encoding"), "br");
+  ASSERT_TRUE(br.ends_with("\r\n\r\nbrotli"));
+
+  std::string png = serve(server, "GET /logo.png HTTP/1.1\r\n"
+                                  "Accept-Encoding: gzip\r\n\r\n");
+  ASSERT_EQ(header(png, "Vary"), "");
+  ASSERT_EQ(header(png, "Content-Encoding"), "");
+
+  tree.write("app.js.br", "stale");
+  for (int i = 0; i < 100 && server.cached_files() != 2; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(server.cached_files(), 2u);
+}
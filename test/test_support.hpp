@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <sys/socket.h>
+
+#include <cppws/socket.hpp>
+
+/**
+ * Connected socket pair: handlers write to `server`, the test reads what was
+ * written from `client`.
+ */
+struct connection_pair {
+  cppws::socket server;
+  cppws::socket client;
+
+  connection_pair() {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+      throw std::system_error(errno, std::system_category());
+    server = cppws::socket(fds[0]);
+    client = cppws::socket(fds[1]);
+  }
+
+  /**
+   * Reads what the client has received, up to 4 KiB. With \p stripDate, the
+   * Date header is dropped, since it changes over time.
+   */
+  std::string read(bool stripDate = false) {
+    std::string out(4096, '\0');
+    out.resize(client.read(out.data(), out.size()));
+    return stripDate ? strip_date(std::move(out)) : out;
+  }
+
+  /**
+   * Reads everything the client receives until `server` is closed.
+   */
+  std::string read_all(bool stripDate = false) {
+    std::string out;
+    char buffer[4096];
+    while (std::size_t n = client.read(buffer, sizeof buffer))
+      out.append(buffer, n);
+    return stripDate ? strip_date(std::move(out)) : out;
+  }
+
+  /**
+   * Drops the first Date header line of a response.
+   */
+  static std::string strip_date(std::string out) {
+    std::size_t date = out.find("Date: ");
+    if (date != std::string::npos)
+      out.erase(date, out.find("\r\n", date) + 2 - date);
+    return out;
+  }
+};
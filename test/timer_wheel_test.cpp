@@ -0,0 +1,170 @@
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <cppws/event_loop.hpp>
+#include <cppws/request_processor.hpp>
+#include <cppws/route_mapper.hpp>
+#include <cppws/timer_wheel.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+TEST(cppws_test, timer_wheel) {
+  using namespace cppws;
+  using clock = timer_wheel::clock;
+
+  timer_wheel wheel{1ms};
+  ASSERT_EQ(wheel.next_timeout(), -1);
+
+  clock::time_point start = clock::now();
+  std::vector<int> fired;
+  timer_wheel::timer a, b, c, d;
+  wheel.arm(a, 3ms, [&] { fired.push_back(1); });
+  wheel.arm(b, 100ms, [&] { fired.push_back(3); });
+  wheel.arm(c, 20ms, [&] { fired.push_back(2); });
+  wheel.arm(d, 50ms, [&] { fired.push_back(4); });
+  ASSERT_EQ(wheel.size(), 4u);
+  ASSERT_LE(wheel.next_timeout(), 4);
+
+  d.cancel();
+  ASSERT_FALSE(d.armed());
+  ASSERT_EQ(wheel.size(), 3u);
+
+  // Nothing fires early.
+  //
+  ASSERT_EQ(wheel.advance(start), 0u);
+  ASSERT_EQ(wheel.advance(start + 19ms), 1u);
+  ASSERT_EQ(fired, std::vector<int>{1});
+  ASSERT_EQ(wheel.advance(start + 99ms), 1u);
+  ASSERT_EQ(wheel.advance(clock::now() + 101ms), 1u);
+  ASSERT_EQ(fired, (std::vector<int>{1, 2, 3}));
+  ASSERT_EQ(wheel.size(), 0u);
+  ASSERT_FALSE(b.armed());
+}
+
+TEST(cppws_test, timer_wheel_levels) {
+  using namespace cppws;
+  using clock = timer_wheel::clock;
+
+  timer_wheel wheel{1ms};
+  clock::time_point start = clock::now();
+
+  // Timers on every level, and one beyond the range of the wheel, move down
+  // as time passes and expire on time.
+  //
+  std::vector<std::chrono::milliseconds> delays = {
+      10ms, 1s, 70s, std::chrono::hours(1), std::chrono::hours(10)};
+  std::vector<timer_wheel::timer> timers(delays.size());
+  std::vector<int> fired;
+  for (std::size_t i = 0; i < delays.size(); ++i)
+    wheel.arm(timers[i], delays[i], [&fired, i] { fired.push_back(i); });
+
+  for (std::size_t i = 0; i < delays.size(); ++i) {
+    wheel.advance(start + delays[i] - 1ms);
+    ASSERT_EQ(fired.size(), i);
+    wheel.advance(start + delays[i] + 2ms);
+    ASSERT_EQ(fired.size(), i + 1);
+    ASSERT_EQ(fired.back(), static_cast<int>(i));
+  }
+
+  // A timer re-armed from its own callback expires again on the next tick,
+  // within the same advance() if that tick is due.
+  //
+  timer_wheel::timer t;
+  int runs = 0;
+  auto again = [&](auto &self) -> void {
+    ++runs;
+    if (runs < 3)
+      wheel.arm(t, 0ms, [&] { self(self); });
+  };
+  wheel.arm(t, 0ms, [&] { again(again); });
+  ASSERT_EQ(wheel.advance(clock::now() + std::chrono::hours(11)), 3u);
+  ASSERT_EQ(runs, 3);
+  ASSERT_EQ(wheel.size(), 0u);
+}
+
+TEST(cppws_test, event_loop_timers) {
+  using namespace cppws;
+
+  event_loop loop;
+  timer_wheel::timer t;
+  auto start = timer_wheel::clock::now();
+  loop.timers().arm(t, 30ms, [&] { loop.stop(); });
+  loop.run();
+  ASSERT_GE(timer_wheel::clock::now() - start, 30ms);
+}
+
+TEST(cppws_test, connection_watchdog) {
+  using namespace cppws;
+
+  connection_watchdog watchdog;
+  connection_watchdog::deadline deadline{watchdog};
+
+  connection_pair conn;
+  auto &[server, client] = conn;
+
+  // A cancelled deadline leaves the connection alone.
+  //
+  deadline.arm(server.native_handle(), 10ms);
+  deadline.cancel();
+  std::this_thread::sleep_for(30ms);
+  client.write("x", 1);
+  char c;
+  ASSERT_EQ(server.read(&c, 1), 1u);
+  ASSERT_FALSE(deadline.expired());
+
+  // A read blocked past the deadline returns.
+  //
+  auto start = timer_wheel::clock::now();
+  deadline.arm(server.native_handle(), 50ms);
+  ASSERT_EQ(server.read(&c, 1), 0u);
+  ASSERT_GE(timer_wheel::clock::now() - start, 50ms);
+  ASSERT_TRUE(deadline.expired());
+}
+
+TEST(cppws_test, request_processor_header_timeout) {
+  using namespace cppws;
+
+  request_processor processor{std::make_shared<route_mapper>()};
+  processor.timeouts({.header_read = 100ms});
+
+  // A client that trickles its request line never gets a request in.
+  //
+  connection_pair conn;
+  cppws::socket &client = conn.client;
+  std::thread slow([&] {
+    for (char c : std::string_view("GET / HTTP/1.1\r\n")) {
+      if (::send(client.native_handle(), &c, 1, MSG_NOSIGNAL) != 1)
+        return;
+      std::this_thread::sleep_for(20ms);
+    }
+  });
+
+  auto start = timer_wheel::clock::now();
+  ASSERT_FALSE(processor.accept(std::move(conn.server)));
+  ASSERT_LT(timer_wheel::clock::now() - start, 300ms);
+  slow.join();
+}
+
+TEST(cppws_test, request_processor_body_limit) {
+  using namespace cppws;
+
+  request_processor processor{std::make_shared<route_mapper>()};
+  processor.max_request_body(16);
+
+  // A body above the limit is refused before anything is allocated or read
+  // for it.
+  //
+  connection_pair conn;
+  cppws::socket &client = conn.client;
+  std::string request = "POST / HTTP/1.1\r\n"
+                        "Content-Length: 18446744073709551615\r\n\r\n";
+  client.write(request.data(), request.size());
+  ASSERT_FALSE(processor.accept(std::move(conn.server)));
+
+  std::string reply = conn.read_all();
+  ASSERT_TRUE(reply.starts_with("HTTP/1.1 413 Content Too Large\r\n"));
+  ASSERT_NE(reply.find("Connection: close\r\n"), std::string::npos);
+}
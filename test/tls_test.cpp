@@ -0,0 +1,216 @@
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <cppws/response_buffer.hpp>
+#include <cppws/tls.hpp>
+#include <gtest/gtest.h>
+
+namespace {
+
+/**
+ * Makes the path of a temporary file that is unique to the running test and
+ * process, so that concurrent runs do not share files.
+ */
+std::string temp_path(std::string_view name) {
+  return std::format(
+      "{}cppws_{}_{}_{}", testing::TempDir(),
+      testing::UnitTest::GetInstance()->current_test_info()->name(),
+      ::getpid(), name);
+}
+
+/**
+ * Writes a self-signed certificate and its key to temporary files.
+ */
+cppws::tls_options make_certificate() {
+  cppws::tls_options options;
+  options.certificate_file = temp_path("cert.pem");
+  options.private_key_file = temp_path("key.pem");
+
+  EVP_PKEY *key = EVP_EC_gen("P-256");
+  X509 *cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME *name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char *>("test"),
+                             -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  X509_sign(cert, key, EVP_sha256());
+
+  FILE *f = std::fopen(options.certificate_file.c_str(), "w");
+  PEM_write_X509(f, cert);
+  std::fclose(f);
+  f = std::fopen(options.private_key_file.c_str(), "w");
+  PEM_write_PrivateKey(f, key, nullptr, nullptr, 0, nullptr, nullptr);
+  std::fclose(f);
+
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return options;
+}
+
+/**
+ * Removes the files of make_certificate() once a context has loaded them.
+ */
+void remove_certificate(const cppws::tls_options &options) {
+  std::remove(options.certificate_file.c_str());
+  std::remove(options.private_key_file.c_str());
+}
+
+/**
+ * Sends a request over a client connection and reads the response until
+ * the server closes the connection.
+ */
+std::string client_request(SSL *ssl, std::string_view request) {
+  std::size_t n;
+  if (SSL_write_ex(ssl, request.data(), request.size(), &n) != 1)
+    return {};
+  std::string response;
+  char buffer[4096];
+  while (SSL_read_ex(ssl, buffer, sizeof buffer, &n) == 1)
+    response.append(buffer, n);
+  return response;
+}
+
+} // namespace
+
+TEST(cppws_test, tls_session_resumption) {
+  using namespace cppws;
+
+  tls_options options = make_certificate();
+  options.alpn = {"h2", "http/1.1"};
+  tls_context context{options};
+  remove_certificate(options);
+
+  std::string path = temp_path("body.txt");
+  std::string content(100000, '\0');
+  for (std::size_t i = 0; i < content.size(); ++i)
+    content[i] = static_cast<char>('a' + i % 26);
+  std::ofstream(path, std::ios::binary) << content;
+  FILE *file = std::fopen(path.c_str(), "rb");
+
+  SSL_CTX *clientContext = SSL_CTX_new(TLS_client_method());
+  const unsigned char alpn[] = "\x08http/1.1";
+  SSL_CTX_set_alpn_protos(clientContext, alpn, sizeof alpn - 1);
+  SSL_SESSION *session = nullptr;
+
+  for (int round = 0; round < 2; ++round) {
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    bool resumed = false;
+    std::string protocol;
+    std::string request;
+    std::thread server([&] {
+      cppws::socket connection{fds[0]};
+      connection.tls_accept(context);
+      resumed = connection.tls_resumed();
+      protocol = connection.alpn_protocol();
+      ASSERT_TRUE(connection.secure());
+
+      char buffer[1024];
+      while (!request.ends_with("\r\n\r\n")) {
+        std::size_t n = connection.read(buffer, sizeof buffer);
+        if (n == 0)
+          break;
+        request.append(buffer, n);
+      }
+
+      // Text around a file slice: gathered records and send_file().
+      //
+      response_buffer response;
+      response.header("X-Round", std::to_string(round));
+      response.body().append("<");
+      response.file(::fileno(file), 10, content.size() - 10);
+      response.body().append(">");
+      response.send(connection);
+    });
+
+    SSL *ssl = SSL_new(clientContext);
+    SSL_set_fd(ssl, fds[1]);
+    if (session)
+      SSL_set_session(ssl, session);
+    ASSERT_EQ(SSL_connect(ssl), 1);
+    std::string reply = client_request(ssl, "GET / HTTP/1.1\r\n\r\n");
+    server.join();
+
+    ASSERT_EQ(request, "GET / HTTP/1.1\r\n\r\n");
+    ASSERT_TRUE(reply.starts_with("HTTP/1.1 200 OK\r\n"));
+    ASSERT_NE(reply.find("X-Round: " + std::to_string(round)),
+              std::string::npos);
+    ASSERT_TRUE(reply.ends_with("\r\n\r\n<" + content.substr(10) + ">"));
+    ASSERT_EQ(protocol, "http/1.1");
+    ASSERT_EQ(resumed, round == 1);
+    ASSERT_EQ(SSL_session_reused(ssl), round == 1);
+
+    SSL_shutdown(ssl);
+    if (!session)
+      session = SSL_get1_session(ssl);
+    SSL_free(ssl);
+    ::close(fds[1]);
+  }
+
+  tls_session_stats stats = context.stats();
+  ASSERT_EQ(stats.handshakes, 2);
+  ASSERT_EQ(stats.resumed, 1);
+
+  SSL_SESSION_free(session);
+  SSL_CTX_free(clientContext);
+  std::fclose(file);
+  std::remove(path.c_str());
+}
+
+TEST(cppws_test, tls_non_blocking) {
+  using namespace cppws;
+
+  tls_options options = make_certificate();
+  tls_context context{options};
+  remove_certificate(options);
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  SSL_CTX *clientContext = SSL_CTX_new(TLS_client_method());
+  SSL *ssl = SSL_new(clientContext);
+  SSL_set_fd(ssl, fds[1]);
+  std::thread client([&] { SSL_connect(ssl); });
+
+  cppws::socket connection{fds[0]};
+  connection.tls_accept(context);
+  client.join();
+  connection.non_blocking(true);
+
+  char buffer[64];
+  ASSERT_EQ(connection.try_read(buffer, sizeof buffer), -1);
+
+  std::size_t n;
+  ASSERT_EQ(SSL_write_ex(ssl, "ping", 4, &n), 1);
+  std::ptrdiff_t r;
+  while ((r = connection.try_read(buffer, sizeof buffer)) < 0)
+    std::this_thread::yield();
+  ASSERT_EQ(std::string_view(buffer, r), "ping");
+
+  std::string a = "po", b = "ng";
+  struct iovec iov[2] = {{a.data(), a.size()}, {b.data(), b.size()}};
+  ASSERT_EQ(connection.try_write(iov, 2), 4);
+  ASSERT_EQ(SSL_read_ex(ssl, buffer, sizeof buffer, &n), 1);
+  ASSERT_EQ(std::string_view(buffer, n), "pong");
+
+  connection.close();
+  ASSERT_EQ(SSL_read_ex(ssl, buffer, sizeof buffer, &n), 0);
+  ASSERT_EQ(SSL_get_error(ssl, 0), SSL_ERROR_ZERO_RETURN);
+
+  SSL_free(ssl);
+  SSL_CTX_free(clientContext);
+  ::close(fds[1]);
+}
@@ -0,0 +1,306 @@
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cppws/upstream.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+/**
+ * Upstream server on a loopback port, answering requests according to their
+ * target:
+ * - /chunked: a chunked body, with a header listed in Connection.
+ * - /echo...: the request head and body as the body.
+ * - /close: an HTTP/1.0 body delimited by closing the connection.
+ * - /stale: a kept-alive response, after which the connection is closed.
+ * - anything else: the target as the body.
+ * Responses carry the number of the connection in X-Connection.
+ */
+class backend {
+public:
+  backend() {
+    fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof addr;
+    if (::bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0 ||
+        ::listen(fd_, 16) != 0 ||
+        ::getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &length) != 0)
+      throw std::system_error(errno, std::system_category());
+    port_ = ntohs(addr.sin_port);
+    acceptor_ = std::thread([this] { run(); });
+  }
+
+  /**
+   * Upstream server on a Unix domain socket in the abstract namespace.
+   */
+  explicit backend(std::string name) : name_(std::move(name)), port_(0) {
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    name_.copy(addr.sun_path + 1, sizeof addr.sun_path - 1);
+    socklen_t length = offsetof(sockaddr_un, sun_path) + 1 + name_.size();
+    if (::bind(fd_, reinterpret_cast<sockaddr *>(&addr), length) != 0 ||
+        ::listen(fd_, 16) != 0)
+      throw std::system_error(errno, std::system_category());
+    acceptor_ = std::thread([this] { run(); });
+  }
+
+  ~backend() {
+    ::shutdown(fd_, SHUT_RDWR);
+    acceptor_.join();
+    for (std::thread &t : connections_)
+      t.join();
+    ::close(fd_);
+  }
+
+  cppws::upstream_address address() const {
+    if (!name_.empty())
+      return {"unix:@" + name_};
+    return {"127.0.0.1", port_};
+  }
+
+  int accepted() const { return accepted_; }
+
+private:
+  void run() {
+    for (;;) {
+      int fd = ::accept(fd_, nullptr, nullptr);
+      if (fd < 0)
+        return;
+      int id = ++accepted_;
+      connections_.emplace_back([fd, id] { serve(fd, id); });
+    }
+  }
+
+  static void serve(int fd, int id) {
+    cppws::socket s{fd};
+    std::string input;
+    char buffer[4096];
+    for (;;) {
+      std::size_t end;
+      while ((end = input.find("\r\n\r\n")) == std::string::npos) {
+        std::size_t n = s.read(buffer, sizeof buffer);
+        if (n == 0)
+          return;
+        input.append(buffer, n);
+      }
+      std::string head = input.substr(0, end + 4);
+      std::size_t length = 0;
+      if (std::size_t at = head.find("Content-Length: ");
+          at != std::string::npos)
+        std::from_chars(head.data() + at + 16, head.data() + head.size(),
+                        length);
+      while (input.size() < end + 4 + length) {
+        std::size_t n = s.read(buffer, sizeof buffer);
+        if (n == 0)
+          return;
+        input.append(buffer, n);
+      }
+      std::string body = input.substr(end + 4, length);
+      input.erase(0, end + 4 + length);
+
+      std::string target = head.substr(head.find(' ') + 1);
+      target.resize(target.find(' '));
+      std::string connection = "X-Connection: " + std::to_string(id) + "\r\n";
+      std::string out;
+      if (target == "/chunked") {
+        out = "HTTP/1.1 200 OK\r\n" + connection +
+              "Transfer-Encoding: chunked\r\nConnection: X-Hop\r\n"
+              "X-Hop: 1\r\n\r\n"
+              "7\r\nhello, \r\n5\r\nworld\r\n0\r\n\r\n";
+      } else if (target == "/close") {
+        out = "HTTP/1.0 200 OK\r\n" + connection + "\r\nuntil close";
+      } else {
+        std::string text = target.starts_with("/echo") ? head + body : target;
+        out = "HTTP/1.1 200 OK\r\n" + connection +
+              "Content-Length: " + std::to_string(text.size()) +
+              "\r\nKeep-Alive: timeout=5\r\n\r\n" + text;
+      }
+      s.write(out.data(), out.size());
+      if (target == "/close" || target == "/stale")
+        return;
+    }
+  }
+
+  int fd_;
+  std::string name_;
+  int port_;
+  std::atomic<int> accepted_ = 0;
+  std::thread acceptor_;
+  std::vector<std::thread> connections_;
+};
+
+} // namespace
+
+TEST(cppws_test, upstream_keep_alive) {
+  using namespace cppws;
+
+  backend server;
+  upstream_pool pool;
+
+  upstream_response a = pool.fetch(server.address(), {.target = "/a"});
+  upstream_response b = pool.fetch(server.address(), {.target = "/b"});
+  ASSERT_EQ(a.status, 200);
+  ASSERT_EQ(a.reason, "OK");
+  ASSERT_EQ(a.body, "/a");
+  ASSERT_EQ(b.body, "/b");
+  ASSERT_EQ(a.header("x-connection"), b.header("X-Connection"));
+  ASSERT_EQ(pool.idle(), 1u);
+
+  upstream_response chunked = pool.fetch(server.address(),
+                                         {.target = "/chunked"});
+  ASSERT_EQ(chunked.body, "hello, world");
+
+  upstream_response echo = pool.fetch(
+      server.address(), {.method = http_method::POST,
+                         .target = "/echo",
+                         .headers = {{"Connection", "close"}, {"X-A", "1"}},
+                         .body = "data"});
+  ASSERT_TRUE(echo.body.starts_with("POST /echo HTTP/1.1\r\nX-A: 1\r\n"));
+  ASSERT_NE(echo.body.find("Host: 127.0.0.1:"), std::string::npos);
+  ASSERT_EQ(echo.body.find("Connection"), std::string::npos);
+  ASSERT_TRUE(echo.body.ends_with("Content-Length: 4\r\n\r\ndata"));
+
+  upstream_stats stats = pool.stats();
+  ASSERT_EQ(stats.connects, 1u);
+  ASSERT_EQ(stats.reused, 3u);
+  ASSERT_EQ(server.accepted(), 1);
+
+  // Bodies delimited by the end of the connection are read completely and
+  // the connection is not returned to the pool.
+  //
+  upstream_response close = pool.fetch(server.address(), {.target = "/close"});
+  ASSERT_EQ(close.body, "until close");
+  ASSERT_EQ(pool.idle(), 0u);
+}
+
+TEST(cppws_test, upstream_unix_socket) {
+  using namespace cppws;
+
+  backend server{"cppws-upstream-" + std::to_string(::getpid())};
+  upstream_pool pool;
+
+  upstream_response echo = pool.fetch(server.address(), {.target = "/echo"});
+  ASSERT_EQ(echo.status, 200);
+  ASSERT_NE(echo.body.find("Host: localhost\r\n"), std::string::npos);
+  ASSERT_EQ(pool.fetch(server.address(), {.target = "/b"}).body, "/b");
+  ASSERT_EQ(server.accepted(), 1);
+}
+
+TEST(cppws_test, upstream_pipelining) {
+  using namespace cppws;
+
+  backend server;
+  upstream_pool pool;
+
+  std::vector<upstream_request> requests = {
+      {.target = "/1"}, {.target = "/chunked"}, {.target = "/3"}};
+  std::vector<upstream_response> responses =
+      pool.fetch_all(server.address(), requests);
+  ASSERT_EQ(responses.size(), 3u);
+  ASSERT_EQ(responses[0].body, "/1");
+  ASSERT_EQ(responses[1].body, "hello, world");
+  ASSERT_EQ(responses[2].body, "/3");
+  ASSERT_EQ(server.accepted(), 1);
+  ASSERT_EQ(pool.idle(), 1u);
+}
+
+TEST(cppws_test, upstream_stale_connection) {
+  using namespace cppws;
+
+  backend server;
+  upstream_pool pool;
+
+  // The upstream closes the connection after answering, without saying so:
+  // the pool notices before reusing it.
+  //
+  ASSERT_EQ(pool.fetch(server.address(), {.target = "/stale"}).body,
+            "/stale");
+  ASSERT_EQ(pool.idle(), 1u);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  ASSERT_EQ(pool.fetch(server.address(), {.target = "/next"}).body, "/next");
+  upstream_stats stats = pool.stats();
+  ASSERT_EQ(stats.connects, 2u);
+  ASSERT_EQ(stats.discarded, 1u);
+  ASSERT_EQ(stats.reused, 0u);
+
+  // Expired connections are not reused either.
+  //
+  upstream_pool expiring{{.idle_timeout = std::chrono::milliseconds(0)}};
+  expiring.fetch(server.address(), {.target = "/a"});
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  expiring.fetch(server.address(), {.target = "/b"});
+  ASSERT_EQ(expiring.stats().connects, 2u);
+  ASSERT_EQ(expiring.stats().discarded, 1u);
+
+  ASSERT_THROW(pool.fetch({"127.0.0.1", 1}, {}), upstream_error);
+}
+
+TEST(cppws_test, upstream_forward) {
+  using namespace cppws;
+
+  backend server;
+  upstream_pool pool;
+
+  auto forward = [&](std::string_view text) {
+    connection_pair conn;
+    cppws::socket &downstream = conn.server;
+
+    http_request request;
+    std::stringstream ss{std::string(text)};
+    EXPECT_TRUE(http_request::accept(request, ss));
+    response_buffer response;
+    {
+      request_manager manager{request, downstream, response};
+      pool.forward(server.address(), manager);
+      manager.send();
+    }
+    downstream.close();
+
+    return conn.read_all();
+  };
+
+  std::string echo = forward("POST /echo?x=1 HTTP/1.1\r\n"
+                             "Host: example.com\r\n"
+                             "Connection: keep-alive, X-Private\r\n"
+                             "X-Private: secret\r\n"
+                             "Content-Length: 5\r\n\r\nhello");
+  ASSERT_TRUE(echo.starts_with("HTTP/1.1 200 OK\r\n"));
+  ASSERT_NE(echo.find("\r\nX-Connection: 1\r\n"), std::string::npos);
+  ASSERT_EQ(echo.find("Keep-Alive"), std::string::npos);
+  ASSERT_NE(echo.find("\r\n\r\nPOST /echo?x=1 HTTP/1.1\r\n"),
+            std::string::npos);
+  ASSERT_NE(echo.find("Host: example.com\r\n"), std::string::npos);
+  ASSERT_EQ(echo.find("X-Private"), std::string::npos);
+  ASSERT_TRUE(echo.ends_with("Content-Length: 5\r\n\r\nhello"));
+
+  // Chunked bodies are relayed as is to HTTP/1.1 clients and decoded for
+  // HTTP/1.0 clients.
+  //
+  std::string chunked = forward("GET /chunked HTTP/1.1\r\n\r\n");
+  ASSERT_NE(chunked.find("Transfer-Encoding: chunked\r\n"), std::string::npos);
+  ASSERT_EQ(chunked.find("X-Hop"), std::string::npos);
+  ASSERT_TRUE(chunked.ends_with(
+      "\r\n\r\n7\r\nhello, \r\n5\r\nworld\r\n0\r\n\r\n"));
+
+  std::string decoded = forward("GET /chunked HTTP/1.0\r\n\r\n");
+  ASSERT_EQ(decoded.find("Transfer-Encoding"), std::string::npos);
+  ASSERT_TRUE(decoded.ends_with("\r\n\r\nhello, world"));
+
+  ASSERT_EQ(server.accepted(), 1);
+}
@@ -46,3 +46,16 @@ TEST(cppws_test, url) {
   ASSERT_EQ(url.query("var3").value(), "value3");
   ASSERT_EQ(url.fragment(), "fragment");
 }
+
+TEST(cppws_test, url_decode) {
+  ASSERT_EQ(cppws::url::decode("a%20b%2Fc%3f"), "a b/c?");
+  ASSERT_EQ(cppws::url::decode("%41%62%63"), "Abc");
+  ASSERT_EQ(cppws::url::decode("%e2%82%ac"), "\xe2\x82\xac");
+  ASSERT_THROW(cppws::url::decode("%4"), cppws::bad_url);
+  ASSERT_THROW(cppws::url::decode("%4g"), cppws::bad_url);
+
+  std::string decoded;
+  for (char c : cppws::url_decode_range::from_string_view("%41b%2F%7e"))
+    decoded += c;
+  ASSERT_EQ(decoded, "Ab/~");
+}
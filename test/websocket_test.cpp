@@ -0,0 +1,221 @@
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include <cppws/websocket.hpp>
+#include <gtest/gtest.h>
+
+#include "test_support.hpp"
+
+namespace {
+
+/**
+ * Handler that echoes messages and records what it saw.
+ */
+struct echo_handler : cppws::websocket_handler {
+  std::vector<std::string> messages;
+  std::uint16_t closeCode = 0;
+
+  void on_message(cppws::websocket &ws, std::string_view message,
+                  bool binary) override {
+    messages.emplace_back(message);
+    if (binary)
+      ws.send_binary(message);
+    else
+      ws.send_text(message);
+  }
+
+  void on_close(cppws::websocket &, std::uint16_t code,
+                std::string_view) override {
+    closeCode = code;
+  }
+};
+
+/**
+ * Serializes a masked client frame.
+ */
+std::string client_frame(std::uint8_t first, std::string_view payload) {
+  std::string out(1, static_cast<char>(first));
+  if (payload.size() < 126) {
+    out.push_back(static_cast<char>(0x80 | payload.size()));
+  } else {
+    out.push_back(static_cast<char>(0x80 | 126));
+    out.push_back(static_cast<char>(payload.size() >> 8));
+    out.push_back(static_cast<char>(payload.size()));
+  }
+  const char key[4] = {0x12, 0x34, 0x56, 0x78};
+  out.append(key, 4);
+  for (std::size_t i = 0; i < payload.size(); ++i)
+    out.push_back(static_cast<char>(payload[i] ^ key[i % 4]));
+  return out;
+}
+
+/**
+ * Reads exactly n bytes.
+ */
+std::string read_n(cppws::socket &s, std::size_t n) {
+  std::string out(n, '\0');
+  std::size_t at = 0;
+  while (at < n) {
+    std::size_t r = s.read(out.data() + at, n - at);
+    if (r == 0)
+      break;
+    at += r;
+  }
+  out.resize(at);
+  return out;
+}
+
+} // namespace
+
+TEST(cppws_test, websocket_accept_key) {
+  ASSERT_EQ(cppws::websocket_accept_key("dGhlIHNhbXBsZSBub25jZQ=="),
+            "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST(cppws_test, websocket_mask) {
+  std::mt19937 rng(42);
+  for (std::size_t length : {0, 1, 3, 4, 7, 15, 16, 31, 32, 33, 100, 1000}) {
+    std::string data(length, '\0');
+    for (char &c : data)
+      c = static_cast<char>(rng());
+    std::uint32_t key = rng();
+
+    std::string expected = data;
+    const auto *k = reinterpret_cast<const unsigned char *>(&key);
+    for (std::size_t i = 0; i < length; ++i)
+      expected[i] ^= static_cast<char>(k[i % 4]);
+
+    cppws::websocket_mask(data.data(), data.size(), key);
+    ASSERT_EQ(data, expected) << "length " << length;
+  }
+}
+
+TEST(cppws_test, websocket_session) {
+  using namespace cppws;
+
+  connection_pair conn;
+  auto &[server, client] = conn;
+
+  http_request request;
+  std::stringstream ss{"GET /live HTTP/1.1\r\n"
+                       "Host: localhost\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: keep-alive, Upgrade\r\n"
+                       "sec-websocket-key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                       "Sec-WebSocket-Version: 13\r\n"
+                       "Sec-WebSocket-Protocol: chat, superchat\r\n\r\n"};
+  ASSERT_TRUE(http_request::accept(request, ss));
+
+  event_loop loop;
+  auto handler = std::make_shared<echo_handler>();
+  response_buffer response;
+  {
+    request_manager manager{request, server, response};
+    auto ws = websocket::accept(manager, loop, handler,
+                                {.protocols = {"superchat"}});
+    ASSERT_TRUE(ws);
+    ASSERT_EQ(ws->protocol(), "superchat");
+    manager.send();
+  }
+  ASSERT_FALSE(server);
+  std::thread runner([&] { loop.run(); });
+
+  std::string head;
+  while (!head.ends_with("\r\n\r\n"))
+    head += read_n(client, 1);
+  ASSERT_TRUE(head.starts_with("HTTP/1.1 101 Switching Protocols\r\n"));
+  ASSERT_NE(head.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo="),
+            std::string::npos);
+  ASSERT_NE(head.find("Sec-WebSocket-Protocol: superchat"), std::string::npos);
+  ASSERT_EQ(head.find("Content-Length"), std::string::npos);
+
+  // Fragmented text message with a ping in between.
+  //
+  std::string frames = client_frame(0x01, "Hel") + client_frame(0x89, "hb") +
+                       client_frame(0x80, "lo");
+  client.write(frames.data(), frames.size());
+  ASSERT_EQ(read_n(client, 4), std::string("\x8a\x02hb", 4));
+  ASSERT_EQ(read_n(client, 7), std::string("\x81\x05Hello", 7));
+
+  std::string big(300, 'x');
+  std::string frame = client_frame(0x82, big);
+  client.write(frame.data(), frame.size());
+  ASSERT_EQ(read_n(client, 4), std::string("\x82\x7e\x01\x2c", 4));
+  ASSERT_EQ(read_n(client, 300), big);
+
+  frame = client_frame(0x88, std::string("\x03\xe8", 2));
+  client.write(frame.data(), frame.size());
+  ASSERT_EQ(read_n(client, 4), std::string("\x88\x02\x03\xe8", 4));
+  ASSERT_EQ(read_n(client, 1), "");
+
+  loop.stop();
+  runner.join();
+  ASSERT_EQ(handler->messages,
+            (std::vector<std::string>{"Hello", std::string(300, 'x')}));
+  ASSERT_EQ(handler->closeCode, websocket_close::NORMAL);
+  ASSERT_EQ(loop.size(), 0u);
+}
+
+TEST(cppws_test, websocket_protocol_errors) {
+  using namespace cppws;
+
+  auto session = [](std::string_view frames) {
+    connection_pair conn;
+    auto &[server, client] = conn;
+
+    http_request request;
+    std::stringstream ss{"GET / HTTP/1.1\r\nUpgrade: websocket\r\n"
+                         "Connection: Upgrade\r\n"
+                         "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                         "Sec-WebSocket-Version: 13\r\n\r\n"};
+    EXPECT_TRUE(http_request::accept(request, ss));
+
+    event_loop loop;
+    auto handler = std::make_shared<echo_handler>();
+    response_buffer response;
+    request_manager manager{request, server, response};
+    websocket::accept(manager, loop, handler);
+
+    std::string head;
+    while (!head.ends_with("\r\n\r\n"))
+      head += read_n(client, 1);
+    client.write(frames.data(), frames.size());
+    while (loop.size() > 0 || handler->closeCode == 0)
+      loop.run_once(100);
+    return handler->closeCode;
+  };
+
+  std::string unmasked = "\x81\x02hi";
+  ASSERT_EQ(session(unmasked), websocket_close::PROTOCOL_ERROR);
+  ASSERT_EQ(session(client_frame(0x80, "x")), websocket_close::PROTOCOL_ERROR);
+  ASSERT_EQ(session(client_frame(0x81, "\xc3\x28")),
+            websocket_close::INVALID_PAYLOAD);
+  ASSERT_EQ(session(client_frame(0x09, "")), websocket_close::PROTOCOL_ERROR);
+  ASSERT_EQ(session(client_frame(0x83, "")), websocket_close::PROTOCOL_ERROR);
+}
+
+TEST(cppws_test, websocket_bad_handshake) {
+  using namespace cppws;
+
+  connection_pair conn;
+  auto &[server, client] = conn;
+
+  event_loop loop;
+  response_buffer response;
+  http_request request;
+  std::stringstream ss{"GET / HTTP/1.1\r\nUpgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                       "Sec-WebSocket-Version: 8\r\n\r\n"};
+  ASSERT_TRUE(http_request::accept(request, ss));
+  request_manager manager{request, server, response};
+  ASSERT_FALSE(
+      websocket::accept(manager, loop, std::make_shared<echo_handler>()));
+  manager.send();
+
+  std::string out(1024, '\0');
+  out.resize(client.read(out.data(), out.size()));
+  ASSERT_TRUE(out.starts_with("HTTP/1.1 426 Upgrade Required\r\n"));
+  ASSERT_NE(out.find("Sec-WebSocket-Version: 13\r\n"), std::string::npos);
+}
@@ -0,0 +1,43 @@
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include <cppws/worker_pool.hpp>
+#include <gtest/gtest.h>
+
+TEST(cppws_test, worker_pool) {
+  using namespace cppws;
+
+  std::atomic<int> count = 0;
+  {
+    worker_pool pool{2};
+    ASSERT_EQ(pool.size(), 2u);
+
+    // Tasks run side by side: the first one waits for the second.
+    //
+    std::promise<void> released;
+    std::future<void> release = released.get_future();
+    std::promise<void> done;
+    pool.post([&release, &count] {
+      release.wait();
+      ++count;
+    });
+    pool.post([&released, &count] {
+      ++count;
+      released.set_value();
+    });
+
+    std::vector<worker_pool::task> batch;
+    for (int i = 0; i < 10; ++i)
+      batch.emplace_back([&count] { ++count; });
+    pool.post(batch);
+    pool.post([] { throw std::runtime_error("ignored"); });
+    pool.post([&done] { done.set_value(); });
+    done.get_future().wait();
+  }
+
+  // The pool runs what was queued before its threads are joined.
+  //
+  ASSERT_EQ(count, 12);
+}